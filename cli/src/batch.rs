@@ -0,0 +1,787 @@
+//! batch runs sharded to worker processes.
+//!
+//! The coordinator expands a job file into `program × input × config` jobs
+//! and serves them to workers connecting over TCP or a Unix socket. A worker
+//! runs each job as a child process of this executable and sends back the
+//! outputs. Jobs of lost or failed workers are retried, while a program
+//! failing by itself is not; results are written (and reported on stdout as
+//! json lines) as soon as they arrive, and the counters in the stats dumps
+//! of all jobs are summed up at the end.
+//!
+//! Every message is a length-prefixed json header followed by the binary
+//! blobs it names, each length-prefixed as well (lengths are u32 LE).
+
+use std::{
+    collections::VecDeque,
+    fs,
+    io::{self, Read, Write},
+    net::{TcpListener, TcpStream},
+    os::unix::net::{UnixListener, UnixStream},
+    path::{Path, PathBuf},
+    process::{Command, Stdio},
+    sync::{Arc, Condvar, Mutex},
+    thread,
+    time::{Duration, Instant},
+};
+
+use anyhow::{bail, Context, Result};
+use serde::{Deserialize, Serialize};
+use serde_json::Value;
+
+const MAX_FRAME_BYTES: usize = 1 << 30;
+/// lines of stderr of a failed job sent back to the coordinator
+const ERROR_TAIL_LINES: usize = 20;
+/// time to wait for idle workers to be shut down after all jobs finished
+const SHUTDOWN_GRACE: Duration = Duration::from_secs(5);
+
+#[derive(Serialize, Deserialize, Debug)]
+#[serde(tag = "type", rename_all = "snake_case")]
+enum Msg {
+    Ready {
+        worker: String,
+    },
+    Job {
+        id: usize,
+        command: String,
+        args: Vec<String>,
+    },
+    Result {
+        id: usize,
+        ok: bool,
+        error: Option<String>,
+        /// the failure is of the worker rather than of the program, so
+        /// running the job again may succeed
+        #[serde(default)]
+        retriable: bool,
+    },
+    Shutdown,
+}
+
+#[derive(Serialize, Deserialize)]
+struct Envelope {
+    msg: Msg,
+    blobs: Vec<String>,
+}
+
+struct Packet {
+    msg: Msg,
+    blobs: Vec<(String, Vec<u8>)>,
+}
+
+impl Packet {
+    fn new(msg: Msg) -> Self {
+        Self { msg, blobs: vec![] }
+    }
+    fn blob(&self, name: &str) -> Option<&[u8]> {
+        self.blobs
+            .iter()
+            .find(|(n, _)| n == name)
+            .map(|(_, b)| b.as_slice())
+    }
+}
+
+fn write_frame(w: &mut impl Write, bytes: &[u8]) -> io::Result<()> {
+    w.write_all(&(bytes.len() as u32).to_le_bytes())?;
+    w.write_all(bytes)
+}
+
+fn read_frame(r: &mut impl Read) -> io::Result<Vec<u8>> {
+    let mut len = [0; 4];
+    r.read_exact(&mut len)?;
+    let len = u32::from_le_bytes(len) as usize;
+    if len > MAX_FRAME_BYTES {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            format!("frame too large: {len} bytes"),
+        ));
+    }
+    let mut buf = vec![0; len];
+    r.read_exact(&mut buf)?;
+    Ok(buf)
+}
+
+fn send(w: &mut impl Write, Packet { msg, blobs }: Packet) -> io::Result<()> {
+    let (names, contents): (Vec<_>, Vec<_>) = blobs.into_iter().unzip();
+    let header = serde_json::to_vec(&Envelope { msg, blobs: names })?;
+    write_frame(w, &header)?;
+    for c in contents {
+        write_frame(w, &c)?;
+    }
+    w.flush()
+}
+
+fn recv(r: &mut impl Read) -> io::Result<Packet> {
+    let Envelope { msg, blobs } = serde_json::from_slice(&read_frame(r)?)?;
+    let blobs = blobs
+        .into_iter()
+        .map(|name| Ok((name, read_frame(r)?)))
+        .collect::<io::Result<_>>()?;
+    Ok(Packet { msg, blobs })
+}
+
+trait Stream: Read + Write + Send {}
+impl<T: Read + Write + Send> Stream for T {}
+
+/// `tcp:HOST:PORT` or `unix:PATH`
+enum Endpoint {
+    Tcp(String),
+    Unix(PathBuf),
+}
+
+impl Endpoint {
+    fn parse(s: &str) -> Result<Self> {
+        if let Some(addr) = s.strip_prefix("tcp:") {
+            Ok(Self::Tcp(addr.to_string()))
+        } else if let Some(path) = s.strip_prefix("unix:") {
+            Ok(Self::Unix(path.into()))
+        } else {
+            bail!("invalid endpoint `{s}` (expected `tcp:HOST:PORT` or `unix:PATH`)")
+        }
+    }
+    fn connect(&self) -> io::Result<Box<dyn Stream>> {
+        Ok(match self {
+            Self::Tcp(addr) => {
+                let s = TcpStream::connect(addr)?;
+                s.set_nodelay(true)?;
+                Box::new(s)
+            }
+            Self::Unix(path) => Box::new(UnixStream::connect(path)?),
+        })
+    }
+}
+
+enum Listener {
+    Tcp(TcpListener),
+    Unix(UnixListener),
+}
+
+impl Listener {
+    fn bind(e: &Endpoint) -> io::Result<Self> {
+        Ok(match e {
+            Endpoint::Tcp(addr) => Self::Tcp(TcpListener::bind(addr)?),
+            Endpoint::Unix(path) => {
+                // stale socket of a previous run
+                let _ = fs::remove_file(path);
+                Self::Unix(UnixListener::bind(path)?)
+            }
+        })
+    }
+    /// endpoint workers can connect to
+    fn endpoint(&self) -> io::Result<String> {
+        Ok(match self {
+            Self::Tcp(l) => format!("tcp:{}", l.local_addr()?),
+            Self::Unix(l) => format!(
+                "unix:{}",
+                l.local_addr()?
+                    .as_pathname()
+                    .map_or_else(String::new, |p| p.display().to_string())
+            ),
+        })
+    }
+    fn accept(&self) -> io::Result<Box<dyn Stream>> {
+        Ok(match self {
+            Self::Tcp(l) => {
+                let (s, _) = l.accept()?;
+                s.set_nodelay(true)?;
+                Box::new(s)
+            }
+            Self::Unix(l) => Box::new(l.accept()?.0),
+        })
+    }
+}
+
+/// job file: every program is run with every input under every config.
+#[derive(Deserialize)]
+struct JobFile {
+    programs: Vec<PathBuf>,
+    /// runs `rt` with these SLD files
+    #[serde(default)]
+    slds: Vec<PathBuf>,
+    /// runs `exe` with these stdin contents (or without input if both
+    /// `slds` and `stdins` are empty)
+    #[serde(default)]
+    stdins: Vec<PathBuf>,
+    /// name to extra arguments of the simulator
+    #[serde(default)]
+    configs: serde_json::Map<String, Value>,
+    #[serde(default)]
+    debug_symbol: Option<PathBuf>,
+}
+
+struct Job {
+    name: String,
+    command: &'static str,
+    args: Vec<String>,
+    blobs: Vec<(String, Vec<u8>)>,
+}
+
+impl Job {
+    fn output_ext(&self) -> &'static str {
+        if self.command == "rt" {
+            "ppm"
+        } else {
+            "out"
+        }
+    }
+}
+
+fn stem(p: &Path) -> String {
+    p.file_stem()
+        .map_or_else(|| "_".into(), |s| s.to_string_lossy().into_owned())
+}
+
+fn read(p: &Path) -> Result<Vec<u8>> {
+    fs::read(p).with_context(|| format!("failed to read {}", p.display()))
+}
+
+fn load_jobs(path: &Path) -> Result<Vec<Job>> {
+    let f: JobFile = serde_json::from_slice(&read(path)?)
+        .with_context(|| format!("failed to parse {}", path.display()))?;
+    if !f.slds.is_empty() && !f.stdins.is_empty() {
+        bail!("`slds` and `stdins` cannot be given at once");
+    }
+    let (command, inputs, input_blob) = if !f.slds.is_empty() {
+        ("rt", f.slds.iter().map(Some).collect(), "sld")
+    } else if !f.stdins.is_empty() {
+        ("exe", f.stdins.iter().map(Some).collect(), "stdin")
+    } else {
+        ("exe", vec![None], "stdin")
+    };
+    let mut configs = vec![];
+    for (name, args) in &f.configs {
+        let args: Vec<String> = serde_json::from_value(args.clone())
+            .with_context(|| format!("config `{name}` must be an array of strings"))?;
+        configs.push((name.clone(), args));
+    }
+    if configs.is_empty() {
+        configs.push(("default".into(), vec![]));
+    }
+    let debug_symbol = f.debug_symbol.as_deref().map(read).transpose()?;
+
+    let mut jobs = vec![];
+    for program in &f.programs {
+        let program_bin = read(program)?;
+        for input in &inputs {
+            let input_bin = input.map(|p| read(p)).transpose()?;
+            for (config, args) in &configs {
+                let mut blobs = vec![("program".to_string(), program_bin.clone())];
+                if let Some(b) = &input_bin {
+                    blobs.push((input_blob.to_string(), b.clone()));
+                }
+                if let Some(b) = &debug_symbol {
+                    blobs.push(("dbg".to_string(), b.clone()));
+                }
+                let input_name = input.map_or_else(|| "-".into(), |p| stem(p));
+                jobs.push(Job {
+                    name: format!("{}.{input_name}.{config}", stem(program)),
+                    command,
+                    args: args.clone(),
+                    blobs,
+                });
+            }
+        }
+    }
+    Ok(jobs)
+}
+
+/// how an attempt of a job ended
+enum Outcome {
+    Done,
+    /// fails the same way if run again
+    Failed(String),
+    /// failed by the worker or the connection; worth another attempt
+    Lost(String),
+}
+
+struct JobResult {
+    ok: bool,
+    worker: String,
+    attempts: usize,
+    error: Option<String>,
+}
+
+#[derive(Default)]
+struct Queue {
+    /// job index and the number of attempts made
+    pending: VecDeque<(usize, usize)>,
+    in_flight: usize,
+    results: Vec<Option<JobResult>>,
+    /// connections being served
+    connections: usize,
+}
+
+impl Queue {
+    fn is_finished(&self) -> bool {
+        self.pending.is_empty() && self.in_flight == 0
+    }
+}
+
+struct Coordinator {
+    jobs: Vec<Job>,
+    out_dir: PathBuf,
+    retries: usize,
+    queue: Mutex<Queue>,
+    cv: Condvar,
+    /// stats dumps of the succeeded jobs
+    stats: Mutex<Vec<Value>>,
+}
+
+impl Coordinator {
+    fn next_job(&self) -> Option<(usize, usize)> {
+        let mut q = self.queue.lock().unwrap();
+        loop {
+            if let Some(job) = q.pending.pop_front() {
+                q.in_flight += 1;
+                return Some(job);
+            }
+            if q.in_flight == 0 {
+                return None;
+            }
+            // a job in flight may be retried
+            q = self.cv.wait(q).unwrap();
+        }
+    }
+    fn finish_job(&self, index: usize, attempts: usize, worker: &str, outcome: Outcome) {
+        let mut q = self.queue.lock().unwrap();
+        q.in_flight -= 1;
+        let job = &self.jobs[index];
+        match outcome {
+            Outcome::Lost(e) if attempts <= self.retries => {
+                log::warn!("job {} failed on {worker} (retrying): {e}", job.name);
+                q.pending.push_back((index, attempts));
+            }
+            outcome => {
+                let error = match outcome {
+                    Outcome::Done => None,
+                    Outcome::Failed(e) | Outcome::Lost(e) => Some(e),
+                };
+                let result = JobResult {
+                    ok: error.is_none(),
+                    worker: worker.to_string(),
+                    attempts,
+                    error,
+                };
+                // stream the result as soon as it is known
+                let line = serde_json::json!({
+                    "job": job.name,
+                    "ok": result.ok,
+                    "worker": result.worker,
+                    "attempts": result.attempts,
+                    "error": result.error,
+                });
+                println!("{line}");
+                q.results[index] = Some(result);
+            }
+        }
+        self.cv.notify_all();
+    }
+    fn store(&self, index: usize, p: &Packet) -> Result<()> {
+        let job = &self.jobs[index];
+        let output = p.blob("output").unwrap_or_default();
+        let path = self
+            .out_dir
+            .join(format!("{}.{}", job.name, job.output_ext()));
+        fs::write(&path, output).with_context(|| format!("failed to write {}", path.display()))?;
+        if let Some(stat) = p.blob("stat_json") {
+            fs::write(self.out_dir.join(format!("{}.stat.json", job.name)), stat)?;
+            match serde_json::from_slice(stat) {
+                Ok(v) => self.stats.lock().unwrap().push(v),
+                Err(e) => log::warn!("broken stats dump of job {}: {e}", job.name),
+            }
+        }
+        Ok(())
+    }
+    fn serve(&self, s: Box<dyn Stream>) -> Result<()> {
+        self.queue.lock().unwrap().connections += 1;
+        let res = self.serve_inner(s);
+        self.queue.lock().unwrap().connections -= 1;
+        self.cv.notify_all();
+        res
+    }
+    fn serve_inner(&self, mut s: Box<dyn Stream>) -> Result<()> {
+        let worker = match recv(&mut s)?.msg {
+            Msg::Ready { worker } => worker,
+            m => bail!("unexpected message from a worker: {m:?}"),
+        };
+        log::info!("worker {worker} connected.");
+        while let Some((index, attempts)) = self.next_job() {
+            let job = &self.jobs[index];
+            let packet = Packet {
+                msg: Msg::Job {
+                    id: index,
+                    command: job.command.to_string(),
+                    args: job.args.clone(),
+                },
+                blobs: job.blobs.clone(),
+            };
+            let res = send(&mut s, packet).and_then(|_| recv(&mut s));
+            match res {
+                Ok(p) => {
+                    let outcome = match &p.msg {
+                        Msg::Result { ok: true, .. } => match self.store(index, &p) {
+                            Ok(()) => Outcome::Done,
+                            Err(e) => {
+                                // not the fault of the worker; do not retry
+                                log::error!("{e:#}");
+                                Outcome::Failed(format!("{e:#}"))
+                            }
+                        },
+                        Msg::Result {
+                            error, retriable, ..
+                        } => {
+                            let e = error.clone().unwrap_or_else(|| "failed".into());
+                            if *retriable {
+                                Outcome::Lost(e)
+                            } else {
+                                Outcome::Failed(e)
+                            }
+                        }
+                        m => Outcome::Lost(format!("unexpected message: {m:?}")),
+                    };
+                    self.finish_job(index, attempts + 1, &worker, outcome);
+                }
+                Err(e) => {
+                    self.finish_job(
+                        index,
+                        attempts + 1,
+                        &worker,
+                        Outcome::Lost(format!("worker lost: {e}")),
+                    );
+                    return Err(e.into());
+                }
+            }
+        }
+        send(&mut s, Packet::new(Msg::Shutdown))?;
+        log::info!("worker {worker} finished.");
+        Ok(())
+    }
+}
+
+pub struct BatchOptions {
+    pub jobs: PathBuf,
+    pub listen: String,
+    pub out_dir: PathBuf,
+    pub retries: usize,
+    pub local_workers: usize,
+    pub merged_stats: Option<PathBuf>,
+}
+
+/// runs the coordinator. returns whether all jobs succeeded.
+pub fn coordinate(opts: BatchOptions) -> Result<bool> {
+    let jobs = load_jobs(&opts.jobs)?;
+    fs::create_dir_all(&opts.out_dir)
+        .with_context(|| format!("failed to create {}", opts.out_dir.display()))?;
+    let listener = Listener::bind(&Endpoint::parse(&opts.listen)?)?;
+    let endpoint = listener.endpoint()?;
+    log::info!("{} jobs; waiting workers on {endpoint}", jobs.len());
+    eprintln!("listening on {endpoint}");
+
+    let begin = Instant::now();
+    let num_jobs = jobs.len();
+    let coordinator = Arc::new(Coordinator {
+        queue: Mutex::new(Queue {
+            pending: (0..num_jobs).map(|i| (i, 0)).collect(),
+            in_flight: 0,
+            results: (0..num_jobs).map(|_| None).collect(),
+            connections: 0,
+        }),
+        jobs,
+        out_dir: opts.out_dir,
+        retries: opts.retries,
+        cv: Condvar::new(),
+        stats: Mutex::new(vec![]),
+    });
+    {
+        let coordinator = Arc::clone(&coordinator);
+        thread::spawn(move || loop {
+            match listener.accept() {
+                Ok(s) => {
+                    let coordinator = Arc::clone(&coordinator);
+                    thread::spawn(move || {
+                        if let Err(e) = coordinator.serve(s) {
+                            log::warn!("connection closed: {e:#}");
+                        }
+                    });
+                }
+                Err(e) => log::warn!("failed to accept a worker: {e}"),
+            }
+        });
+    }
+    let exe = std::env::current_exe()?;
+    let mut children = (0..opts.local_workers)
+        .map(|i| {
+            Command::new(&exe)
+                .args(["worker", "--connect", &endpoint, "--name"])
+                .arg(format!("local{i}"))
+                .stdin(Stdio::null())
+                .stdout(Stdio::null())
+                .spawn()
+                .context("failed to spawn a local worker")
+        })
+        .collect::<Result<Vec<_>>>()?;
+
+    {
+        let mut q = coordinator.queue.lock().unwrap();
+        while !q.is_finished() {
+            q = coordinator.cv.wait(q).unwrap();
+        }
+        // let the connected workers receive shutdown
+        let deadline = Instant::now() + SHUTDOWN_GRACE;
+        while q.connections > 0 {
+            let Some(timeout) = deadline.checked_duration_since(Instant::now()) else {
+                break;
+            };
+            q = coordinator.cv.wait_timeout(q, timeout).unwrap().0;
+        }
+    }
+    for c in &mut children {
+        c.wait()?;
+    }
+
+    let q = coordinator.queue.lock().unwrap();
+    let failed: Vec<_> = q
+        .results
+        .iter()
+        .zip(&coordinator.jobs)
+        .filter(|(r, _)| !r.as_ref().is_some_and(|r| r.ok))
+        .map(|(_, j)| j.name.as_str())
+        .collect();
+    eprintln!(
+        "{} of {num_jobs} jobs succeeded in {:.1}s.",
+        num_jobs - failed.len(),
+        begin.elapsed().as_secs_f64()
+    );
+    for name in &failed {
+        eprintln!("  failed: {name}");
+    }
+    if let Some(path) = &opts.merged_stats {
+        let stats = coordinator.stats.lock().unwrap();
+        let merged = stats.iter().fold(Value::Null, |acc, v| merge_stats(acc, v));
+        fs::write(path, serde_json::to_vec_pretty(&merged)?)?;
+        log::info!(
+            "merged stats of {} jobs written to {}.",
+            stats.len(),
+            path.display()
+        );
+    }
+    Ok(failed.is_empty())
+}
+
+/// sums up the counters of two stats dumps, which each dump lists in
+/// `counters` (see [`core_sim::stat::Stat::counters`]). Any other field is
+/// kept only if both dumps agree on it, as the settings of the runs do.
+fn merge_stats(acc: Value, v: &Value) -> Value {
+    if acc.is_null() {
+        return v.clone();
+    }
+    let mut counters: Vec<String> = vec![];
+    for c in [&acc, v]
+        .into_iter()
+        .filter_map(|d| d["counters"].as_array())
+        .flatten()
+        .filter_map(Value::as_str)
+    {
+        if !counters.iter().any(|k| k == c) {
+            counters.push(c.to_string());
+        }
+    }
+    let patterns: Vec<Vec<&str>> = counters.iter().map(|c| c.split('.').collect()).collect();
+    let mut merged = merge_at(acc, v, &[], &patterns).unwrap_or_default();
+    if let Value::Object(m) = &mut merged {
+        m.insert("counters".into(), counters.into());
+    }
+    merged
+}
+
+fn merge_at(acc: Value, v: &Value, path: &[&str], counters: &[Vec<&str>]) -> Option<Value> {
+    if is_counter(path, counters) {
+        return Some(match (acc.as_u64(), v.as_u64()) {
+            (Some(a), Some(b)) => (a + b).into(),
+            _ => (acc.as_f64()? + v.as_f64()?).into(),
+        });
+    }
+    match (acc, v) {
+        (Value::Object(mut a), Value::Object(b)) => {
+            let mut m = serde_json::Map::new();
+            for (k, bv) in b {
+                let path = [path, &[k.as_str()]].concat();
+                let merged = match a.remove(k) {
+                    Some(av) => merge_at(av, bv, &path, counters),
+                    None => only_counters(bv, &path, counters),
+                };
+                if let Some(merged) = merged {
+                    m.insert(k.clone(), merged);
+                }
+            }
+            for (k, av) in a {
+                if let Some(av) = only_counters(&av, &[path, &[k.as_str()]].concat(), counters) {
+                    m.insert(k, av);
+                }
+            }
+            (!m.is_empty() || b.is_empty()).then_some(Value::Object(m))
+        }
+        (acc, v) => (acc == *v).then_some(acc),
+    }
+}
+
+fn is_counter(path: &[&str], counters: &[Vec<&str>]) -> bool {
+    counters
+        .iter()
+        .any(|c| c.len() == path.len() && c.iter().zip(path).all(|(c, k)| *c == "*" || c == k))
+}
+
+/// the counters in `v` at `path`, which the other dump lacks.
+fn only_counters(v: &Value, path: &[&str], counters: &[Vec<&str>]) -> Option<Value> {
+    if is_counter(path, counters) {
+        return Some(v.clone());
+    }
+    let m: serde_json::Map<_, _> = v
+        .as_object()?
+        .iter()
+        .filter_map(|(k, v)| {
+            let v = only_counters(v, &[path, &[k.as_str()]].concat(), counters)?;
+            Some((k.clone(), v))
+        })
+        .collect();
+    (!m.is_empty()).then_some(Value::Object(m))
+}
+
+/// runs a worker until the coordinator has no more jobs.
+pub fn work(connect: &str, name: Option<String>) -> Result<()> {
+    let name = name.unwrap_or_else(|| format!("pid{}", std::process::id()));
+    let mut s = Endpoint::parse(connect)?
+        .connect()
+        .with_context(|| format!("failed to connect to {connect}"))?;
+    send(&mut s, Packet::new(Msg::Ready { worker: name }))?;
+    loop {
+        let p = recv(&mut s)?;
+        match p.msg {
+            Msg::Job { id, command, args } => {
+                let result = run_job(id, &command, &args, &p.blobs);
+                send(&mut s, result)?;
+            }
+            Msg::Shutdown => break Ok(()),
+            m => bail!("unexpected message from the coordinator: {m:?}"),
+        }
+    }
+}
+
+fn run_job(id: usize, command: &str, args: &[String], blobs: &[(String, Vec<u8>)]) -> Packet {
+    let dir = std::env::temp_dir().join(format!("core_sim_worker.{}.{id}", std::process::id()));
+    let result = (|| -> Result<Packet> {
+        fs::create_dir_all(&dir)?;
+        let mut cmd = Command::new(std::env::current_exe()?);
+        cmd.arg(command);
+        for (name, content) in blobs {
+            let path = dir.join(name);
+            fs::write(&path, content)?;
+            let flag = match (command, name.as_str()) {
+                (_, "program") => "--input",
+                ("rt", "sld") => "--sld",
+                ("exe", "stdin") => "--stdin",
+                (_, "dbg") => "--dbg",
+                _ => bail!("unknown blob `{name}` for `{command}`"),
+            };
+            cmd.arg(flag).arg(path);
+        }
+        let output = dir.join("output");
+        let stat = dir.join("stat.json");
+        cmd.arg(if command == "rt" { "--ppm" } else { "--stdout" })
+            .arg(&output)
+            .arg("--stat-json")
+            .arg(&stat)
+            .args(args)
+            .stdin(Stdio::null())
+            .stdout(Stdio::null())
+            .stderr(Stdio::piped());
+        let out = cmd.output()?;
+        if !out.status.success() {
+            let stderr = String::from_utf8_lossy(&out.stderr);
+            let lines: Vec<_> = stderr.lines().collect();
+            let tail = lines[lines.len().saturating_sub(ERROR_TAIL_LINES)..].join("\n");
+            return Ok(Packet::new(Msg::Result {
+                id,
+                ok: false,
+                error: Some(format!("{}: {tail}", out.status)),
+                // killed by a signal, e.g. out of memory on this host
+                retriable: out.status.code().is_none(),
+            }));
+        }
+        let mut p = Packet::new(Msg::Result {
+            id,
+            ok: true,
+            error: None,
+            retriable: false,
+        });
+        p.blobs.push(("output".into(), fs::read(&output)?));
+        if let Ok(stat) = fs::read(&stat) {
+            p.blobs.push(("stat_json".into(), stat));
+        }
+        Ok(p)
+    })();
+    let _ = fs::remove_dir_all(&dir);
+    result.unwrap_or_else(|e| {
+        Packet::new(Msg::Result {
+            id,
+            ok: false,
+            error: Some(format!("{e:#}")),
+            retriable: true,
+        })
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_packet() {
+        let (mut a, mut b) = UnixStream::pair().unwrap();
+        let mut p = Packet::new(Msg::Job {
+            id: 3,
+            command: "rt".into(),
+            args: vec!["--no-cache".into()],
+        });
+        p.blobs.push(("program".into(), vec![1, 2, 3]));
+        send(&mut a, p).unwrap();
+        let p = recv(&mut b).unwrap();
+        assert!(matches!(p.msg, Msg::Job { id: 3, .. }));
+        assert_eq!(p.blob("program"), Some(&[1, 2, 3][..]));
+    }
+
+    #[test]
+    fn test_merge_stats() {
+        let a = serde_json::json!({
+            "format": 1,
+            "counters": ["sim.clocks", "energy.total_pj", "samples.samples"],
+            "sim": {"clocks": 10},
+            "loops": [1],
+            "energy": {"total_pj": 2.5, "power_mw": 3.0, "functions": {"main": 2.5}},
+            "regions": {"solve": {"instrs": 4}},
+        });
+        let b = serde_json::json!({
+            "format": 1,
+            "counters": ["sim.clocks", "energy.total_pj", "instr.*", "samples.samples"],
+            "sim": {"clocks": 5, "elapsed_ms": 1.5},
+            "instr": {"add": 2},
+            "energy": {"total_pj": 1.0, "power_mw": 4.0, "functions": {"f": 1.0}},
+            "regions": {"solve": {"instrs": 3}},
+            "redundancy": {"functions": {"f": {"loads": 1}}},
+            "samples": {"period": 10, "samples": 3},
+        });
+        let merged = [a, b.clone(), b]
+            .iter()
+            .fold(Value::Null, |acc, v| merge_stats(acc, v));
+        assert_eq!(
+            merged,
+            serde_json::json!({
+                "format": 1,
+                "counters": ["sim.clocks", "energy.total_pj", "samples.samples", "instr.*"],
+                "sim": {"clocks": 20},
+                "instr": {"add": 4},
+                "energy": {"total_pj": 4.5},
+                "samples": {"samples": 6},
+            })
+        );
+    }
+}
@@ -0,0 +1,259 @@
+//! on-disk cache of simulation results.
+//!
+//! A run is keyed by a content hash of the program image, its input, the
+//! debug symbol, the simulator build and the options changing the result.
+//! Each entry is a directory named by the key holding the outputs of the
+//! run; the least recently used entries are evicted when the cache grows
+//! beyond its capacity.
+
+use std::{
+    fs::{self, File},
+    io::ErrorKind,
+    path::{Path, PathBuf},
+    time::SystemTime,
+};
+
+use anyhow::{Context, Result};
+use clap::Args;
+
+/// bump when the layout of entries changes
+const CACHE_FORMAT: &str = "2";
+const OUTPUT_FILE: &str = "output";
+const STAT_JSON_FILE: &str = "stat.json";
+const STAT_TEXT_FILE: &str = "stat.txt";
+const PLACEMENT_MAP_FILE: &str = "placement.json";
+const PROFILE_FILE: &str = "profile.folded";
+/// touched on every hit; its mtime orders entries for eviction
+const STAMP_FILE: &str = "stamp";
+
+#[derive(Args, Debug)]
+pub struct CacheArgs {
+    /// Always simulate, neither looking up nor storing the result cache
+    #[arg(long)]
+    no_cache: bool,
+    /// Directory of the result cache (default: $CORE_SIM_CACHE_DIR or ~/.cache/core_sim)
+    #[arg(long)]
+    cache_dir: Option<PathBuf>,
+    /// Capacity of the result cache (MiB)
+    #[arg(long, default_value_t = 1024)]
+    cache_size: u64,
+}
+
+/// outputs of a run, as stored in the cache.
+#[derive(Default)]
+pub struct RunOutputs {
+    /// PPM or stdout of the program
+    pub output: Vec<u8>,
+    pub stat_json: Option<Vec<u8>>,
+    /// the statistics table logged at the end of the run
+    pub stat_text: Option<Vec<u8>>,
+    pub placement_map: Option<Vec<u8>>,
+    /// collapsed stacks of the sampled profile
+    pub profile: Option<Vec<u8>>,
+}
+
+/// 128-bit FNV-1a over length-prefixed fields.
+pub struct CacheKey(u128);
+
+impl CacheKey {
+    const OFFSET: u128 = 0x6c62272e07bb014262b821756295c58d;
+    const PRIME: u128 = 0x0000000001000000000000000000013b;
+
+    /// key of a run of `command`, covering the simulator build.
+    pub fn new(command: &str) -> Self {
+        let mut key = Self(Self::OFFSET);
+        key.add("format", CACHE_FORMAT.as_bytes());
+        key.add("version", env!("CARGO_PKG_VERSION").as_bytes());
+        key.add("features", core_sim::FEATURES.join(",").as_bytes());
+        key.add("cli_stat", &[u8::from(cfg!(feature = "stat"))]);
+        // rebuilding the simulator without bumping the version must not hit
+        if let Some((len, modified)) = std::env::current_exe()
+            .and_then(fs::metadata)
+            .and_then(|m| Ok((m.len(), m.modified()?)))
+            .ok()
+            .and_then(|(len, m)| Some((len, m.duration_since(SystemTime::UNIX_EPOCH).ok()?)))
+        {
+            key.add("exe_len", &len.to_le_bytes());
+            key.add("exe_modified", &modified.as_nanos().to_le_bytes());
+        }
+        key.add("command", command.as_bytes());
+        key
+    }
+    fn write(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.0 ^= b as u128;
+            self.0 = self.0.wrapping_mul(Self::PRIME);
+        }
+    }
+    pub fn add(&mut self, name: &str, bytes: &[u8]) {
+        self.write(&(name.len() as u64).to_le_bytes());
+        self.write(name.as_bytes());
+        self.write(&(bytes.len() as u64).to_le_bytes());
+        self.write(bytes);
+    }
+    /// adds the content of the file at `path`, if any.
+    pub fn add_file(&mut self, name: &str, path: Option<&Path>) -> Result<()> {
+        match path {
+            Some(p) => {
+                let content =
+                    fs::read(p).with_context(|| format!("failed to read {}", p.display()))?;
+                self.add(name, &content);
+            }
+            None => self.add(name, &[]),
+        }
+        Ok(())
+    }
+    fn hex(&self) -> String {
+        format!("{:032x}", self.0)
+    }
+}
+
+pub struct ResultCache {
+    dir: PathBuf,
+    /// in bytes
+    capacity: u64,
+}
+
+impl ResultCache {
+    /// returns `None` if the cache is disabled.
+    pub fn open(args: &CacheArgs, interactive: bool) -> Option<Self> {
+        if args.no_cache || interactive {
+            return None;
+        }
+        let dir = args.cache_dir.clone().or_else(|| {
+            std::env::var_os("CORE_SIM_CACHE_DIR")
+                .map(PathBuf::from)
+                .or_else(|| {
+                    std::env::var_os("XDG_CACHE_HOME").map(|d| PathBuf::from(d).join("core_sim"))
+                })
+                .or_else(|| {
+                    std::env::var_os("HOME").map(|d| PathBuf::from(d).join(".cache/core_sim"))
+                })
+        });
+        let Some(dir) = dir else {
+            log::warn!("no directory for the result cache; caching is disabled.");
+            return None;
+        };
+        Some(Self {
+            dir,
+            capacity: args.cache_size << 20,
+        })
+    }
+    /// looks up the outputs of a previous run.
+    pub fn get(&self, key: &CacheKey) -> Option<RunOutputs> {
+        let entry = self.dir.join(key.hex());
+        let read_opt = |name| match fs::read(entry.join(name)) {
+            Ok(v) => Ok(Some(v)),
+            Err(e) if e.kind() == ErrorKind::NotFound => Ok(None),
+            Err(e) => Err(e),
+        };
+        let outputs = (|| -> std::io::Result<_> {
+            Ok(RunOutputs {
+                output: fs::read(entry.join(OUTPUT_FILE))?,
+                stat_json: read_opt(STAT_JSON_FILE)?,
+                stat_text: read_opt(STAT_TEXT_FILE)?,
+                placement_map: read_opt(PLACEMENT_MAP_FILE)?,
+                profile: read_opt(PROFILE_FILE)?,
+            })
+        })();
+        match outputs {
+            Ok(outputs) => {
+                if let Err(e) = File::options()
+                    .write(true)
+                    .open(entry.join(STAMP_FILE))
+                    .and_then(|f| f.set_modified(SystemTime::now()))
+                {
+                    log::warn!("failed to touch cache entry {}: {e}", entry.display());
+                }
+                log::info!("result cache hit: {}", entry.display());
+                Some(outputs)
+            }
+            Err(e) => {
+                if e.kind() != ErrorKind::NotFound {
+                    log::warn!("broken cache entry {}: {e}", entry.display());
+                }
+                None
+            }
+        }
+    }
+    /// stores the outputs of a run and evicts old entries.
+    pub fn put(&self, key: &CacheKey, outputs: &RunOutputs) -> Result<()> {
+        let entry = self.dir.join(key.hex());
+        // write into a private directory first so that concurrent runs never
+        // observe a partial entry
+        let tmp = self
+            .dir
+            .join(format!(".{}.{}", key.hex(), std::process::id()));
+        fs::create_dir_all(&tmp).with_context(|| format!("failed to create {}", tmp.display()))?;
+        fs::write(tmp.join(OUTPUT_FILE), &outputs.output)?;
+        if let Some(v) = &outputs.stat_json {
+            fs::write(tmp.join(STAT_JSON_FILE), v)?;
+        }
+        if let Some(v) = &outputs.stat_text {
+            fs::write(tmp.join(STAT_TEXT_FILE), v)?;
+        }
+        if let Some(v) = &outputs.placement_map {
+            fs::write(tmp.join(PLACEMENT_MAP_FILE), v)?;
+        }
+        if let Some(v) = &outputs.profile {
+            fs::write(tmp.join(PROFILE_FILE), v)?;
+        }
+        File::create(tmp.join(STAMP_FILE))?;
+        if fs::rename(&tmp, &entry).is_err() {
+            // another run stored the same key
+            fs::remove_dir_all(&tmp)?;
+        }
+        log::info!("result cached: {}", entry.display());
+        self.evict()
+    }
+    fn evict(&self) -> Result<()> {
+        let mut entries = vec![];
+        let mut total = 0;
+        for e in fs::read_dir(&self.dir)? {
+            let path = e?.path();
+            let is_entry = path
+                .file_name()
+                .and_then(|n| n.to_str())
+                .is_some_and(|n| !n.starts_with('.'));
+            if !is_entry || !path.is_dir() {
+                continue;
+            }
+            let size: u64 = fs::read_dir(&path)?
+                .filter_map(|f| f.ok()?.metadata().ok())
+                .map(|m| m.len())
+                .sum();
+            let used = fs::metadata(path.join(STAMP_FILE))
+                .and_then(|m| m.modified())
+                .unwrap_or(SystemTime::UNIX_EPOCH);
+            total += size;
+            entries.push((used, size, path));
+        }
+        entries.sort_by_key(|(used, _, _)| *used);
+        for (_, size, path) in entries {
+            if total <= self.capacity {
+                break;
+            }
+            log::info!("evicting cache entry {}", path.display());
+            fs::remove_dir_all(&path)?;
+            total -= size;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_key() {
+        let key = |a: &[u8], b: &[u8]| {
+            let mut k = CacheKey(CacheKey::OFFSET);
+            k.add("a", a);
+            k.add("b", b);
+            k.hex()
+        };
+        assert_eq!(key(b"x", b"y"), key(b"x", b"y"));
+        assert_ne!(key(b"xy", b""), key(b"x", b"y"));
+    }
+}
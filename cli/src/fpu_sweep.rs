@@ -0,0 +1,169 @@
+//! sweeps the approximation parameters of fdiv/fsqrt in parallel.
+//!
+//! Every configuration runs on its own thread (the parameters of the C
+//! model are thread local) and reports the ULP error of both units and,
+//! if a raytracer is given, the error of its image against a reference.
+
+use std::{
+    fmt,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Mutex,
+    },
+    thread,
+};
+
+use anyhow::{bail, Result};
+use core_sim::{
+    fpu_approx::{self, Approx, UlpError, Unit},
+    ppm::{self, ImageDiff, PPMData},
+    sim::Simulator,
+    sld::SldData,
+};
+use serde::Serialize;
+
+pub struct Raytracer {
+    pub program: Vec<u8>,
+    pub sld: String,
+    /// image to compare with; rendered with the hardware parameters if absent
+    pub reference: Option<Vec<u8>>,
+}
+
+pub struct SweepOptions {
+    pub configs: Vec<Approx>,
+    /// units the configurations apply to; the others keep the hardware parameters
+    pub units: Vec<Unit>,
+    pub samples: usize,
+    pub seed: u64,
+    pub raytracer: Option<Raytracer>,
+    pub jobs: usize,
+}
+
+#[derive(Serialize)]
+pub struct SweepResult {
+    pub approx: Approx,
+    pub fdiv: UlpError,
+    pub fsqrt: UlpError,
+    pub image: Option<ImageDiff>,
+}
+
+fn render(rt: &Raytracer) -> Result<Vec<u8>> {
+    let mut sim = Simulator::new(&rt.program, SldData::parse(&rt.sld)?, PPMData::new())?;
+    loop {
+        let r = sim.single_cycle(&Default::default())?;
+        if let Some(c) = r.exit_code() {
+            if !c.is_success() {
+                bail!("raytracer failed: {}", sim.get_error_msg().unwrap());
+            }
+            break;
+        }
+    }
+    Ok(sim.into_output().cpu_output.into_inner())
+}
+
+fn evaluate(approx: Approx, opt: &SweepOptions, reference: Option<&[u8]>) -> Result<SweepResult> {
+    for unit in Unit::ALL {
+        let a = if opt.units.contains(&unit) {
+            approx
+        } else {
+            Approx::HARDWARE
+        };
+        fpu_approx::configure(unit, a)?;
+    }
+    let image = match (&opt.raytracer, reference) {
+        (Some(rt), Some(reference)) => Some(ppm::compare(reference, &render(rt)?)?),
+        _ => None,
+    };
+    Ok(SweepResult {
+        approx,
+        fdiv: fpu_approx::ulp_error(Unit::Fdiv, opt.samples, opt.seed),
+        fsqrt: fpu_approx::ulp_error(Unit::Fsqrt, opt.samples, opt.seed),
+        image,
+    })
+}
+
+/// results in the order of `opt.configs`.
+pub fn sweep(opt: &SweepOptions) -> Result<Vec<SweepResult>> {
+    // reject unsupported parameters before spending time on the others
+    for &approx in &opt.configs {
+        for &unit in &opt.units {
+            fpu_approx::configure(unit, approx)?;
+        }
+    }
+    for unit in Unit::ALL {
+        fpu_approx::configure(unit, Approx::HARDWARE)?;
+    }
+    let reference = match &opt.raytracer {
+        Some(Raytracer {
+            reference: Some(r), ..
+        }) => Some(r.clone()),
+        Some(rt) => {
+            log::info!("rendering the reference image with the hardware parameters");
+            Some(thread::scope(|s| s.spawn(|| render(rt)).join().unwrap())?)
+        }
+        None => None,
+    };
+    let next = AtomicUsize::new(0);
+    let results = Mutex::new((0..opt.configs.len()).map(|_| None).collect::<Vec<_>>());
+    thread::scope(|s| {
+        for _ in 0..opt.jobs.clamp(1, opt.configs.len().max(1)) {
+            s.spawn(|| loop {
+                let i = next.fetch_add(1, Ordering::Relaxed);
+                let Some(&approx) = opt.configs.get(i) else {
+                    break;
+                };
+                let r = evaluate(approx, opt, reference.as_deref());
+                match &r {
+                    Ok(_) => log::info!("done: {approx}"),
+                    Err(e) => log::warn!("{approx}: {e:#}"),
+                }
+                results.lock().unwrap()[i] = Some(r);
+            });
+        }
+    });
+    results
+        .into_inner()
+        .unwrap()
+        .into_iter()
+        .map(|r| r.unwrap())
+        .collect()
+}
+
+pub struct SweepReport<'a>(pub &'a [SweepResult]);
+
+impl fmt::Display for SweepReport<'_> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        writeln!(
+            f,
+            "{:>4}{:>6}{:>6}{:>12}{:>10}{:>12}{:>10}{:>10}{:>10}{:>10}",
+            "key",
+            "order",
+            "coef",
+            "fdiv max",
+            "mean",
+            "fsqrt max",
+            "mean",
+            "img max",
+            "img mean",
+            "psnr"
+        )?;
+        for r in self.0 {
+            write!(
+                f,
+                "{:>4}{:>6}{:>6}{:>12}{:>10.3}{:>12}{:>10.3}",
+                r.approx.key_bits,
+                r.approx.order,
+                r.approx.coef_bits,
+                r.fdiv.max,
+                r.fdiv.mean,
+                r.fsqrt.max,
+                r.fsqrt.mean
+            )?;
+            match &r.image {
+                Some(d) => writeln!(f, "{:>10}{:>10.4}{:>10.2}", d.max_abs, d.mean_abs, d.psnr)?,
+                None => writeln!(f)?,
+            }
+        }
+        Ok(())
+    }
+}
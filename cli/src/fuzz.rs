@@ -0,0 +1,127 @@
+//! drives the coverage-guided fuzzer and records interesting inputs.
+//!
+//! Under the output directory, `corpus/` holds inputs reaching new
+//! coverage, `crashes/` one input per distinct error message, `hangs/`
+//! inputs exceeding the cycle budget and `diffs/` inputs on which the
+//! reference program behaves differently.
+
+use std::{
+    collections::HashSet,
+    fs,
+    path::{Path, PathBuf},
+    time::{Duration, Instant},
+};
+
+use anyhow::{Context, Result};
+use core_sim::fuzz::{Fuzzer, Outcome};
+
+const REPORT_INTERVAL: Duration = Duration::from_secs(1);
+
+pub struct FuzzOptions {
+    pub program: Vec<u8>,
+    pub reference: Option<Vec<u8>>,
+    pub seeds: Option<PathBuf>,
+    pub out_dir: PathBuf,
+    pub max_cycles: usize,
+    pub iterations: Option<u64>,
+    pub duration: Option<Duration>,
+    pub seed: u64,
+}
+
+fn save(dir: &Path, n: u64, input: &[u8], note: Option<&str>) -> Result<()> {
+    fs::create_dir_all(dir).with_context(|| format!("failed to create {}", dir.display()))?;
+    let path = dir.join(format!("{n:06}"));
+    fs::write(&path, input)?;
+    if let Some(note) = note {
+        fs::write(path.with_extension("txt"), note)?;
+    }
+    Ok(())
+}
+
+/// returns the number of crashes, hangs and divergences found.
+pub fn fuzz(opt: FuzzOptions) -> Result<u64> {
+    let mut fuzzer = Fuzzer::new(&opt.program, opt.max_cycles, opt.seed)?;
+    if let Some(r) = &opt.reference {
+        fuzzer.set_reference(r)?;
+    }
+    let mut seeds = vec![];
+    if let Some(dir) = &opt.seeds {
+        for e in fs::read_dir(dir).with_context(|| format!("failed to read {}", dir.display()))? {
+            let path = e?.path();
+            if path.is_file() {
+                seeds.push(fs::read(path)?);
+            }
+        }
+    }
+    if seeds.is_empty() {
+        seeds.push(vec![]);
+    }
+
+    let mut crashes = HashSet::new();
+    let mut found = 0;
+    let start = Instant::now();
+    let mut last_report = start;
+    let mut record =
+        |fuzzer: &Fuzzer, input: &[u8], exec: core_sim::fuzz::Execution| -> Result<()> {
+            let n = fuzzer.execs;
+            if exec.new_coverage {
+                save(&opt.out_dir.join("corpus"), n, input, None)?;
+            }
+            match &exec.outcome {
+                Outcome::Failed(e) if crashes.insert(e.clone()) => {
+                    log::warn!("crash #{n}: {e}");
+                    save(&opt.out_dir.join("crashes"), n, input, Some(e))?;
+                    found += 1;
+                }
+                Outcome::Timeout if exec.new_coverage => {
+                    save(&opt.out_dir.join("hangs"), n, input, None)?;
+                    found += 1;
+                }
+                _ => {}
+            }
+            if exec.diverged {
+                log::warn!("divergence #{n}");
+                save(
+                    &opt.out_dir.join("diffs"),
+                    n,
+                    input,
+                    Some(&format!("{:?}\n{:?}", exec.outcome, exec.output)),
+                )?;
+                found += 1;
+            }
+            Ok(())
+        };
+    for input in seeds {
+        let exec = fuzzer.run(input.clone());
+        record(&fuzzer, &input, exec)?;
+    }
+    loop {
+        if opt.iterations.is_some_and(|n| fuzzer.execs >= n)
+            || opt.duration.is_some_and(|d| start.elapsed() >= d)
+        {
+            break;
+        }
+        let (input, exec) = fuzzer.fuzz_one();
+        record(&fuzzer, &input, exec)?;
+        if last_report.elapsed() >= REPORT_INTERVAL {
+            last_report = Instant::now();
+            log::info!(
+                "execs: {}, {:.0} execs/s, corpus: {}, edges: {}",
+                fuzzer.execs,
+                fuzzer.execs as f64 / start.elapsed().as_secs_f64(),
+                fuzzer.corpus().len(),
+                fuzzer.edges()
+            );
+        }
+    }
+    println!(
+        "{} execs in {:.1}s ({:.0} execs/s), corpus: {}, edges: {}, findings: {}",
+        fuzzer.execs,
+        start.elapsed().as_secs_f64(),
+        fuzzer.execs as f64 / start.elapsed().as_secs_f64(),
+        fuzzer.corpus().len(),
+        fuzzer.edges(),
+        found
+    );
+    Ok(found)
+}
@@ -119,6 +119,8 @@ peg::parser!(grammar command(ds: &DebugSymbol) for str {
         / ("definition" / "def") __ fold:folded() { ShowKind::LabelDefNearPc { fold } }
         / mem() __ addr:addr() { ShowKind::Memory(addr) }
         / "stat" { ShowKind::Stat(StatKind::Cpu) }
+        / ("backtrace" / "bt") { ShowKind::Backtrace }
+        / "history" { ShowKind::History }
         / reg:reg_name() {? Ok(ShowKind::RegisterI(reg)) }
         / reg:freg_name() {? Ok(ShowKind::RegisterF(reg)) }
     pub(crate) rule parse_command() -> Command
@@ -173,6 +175,8 @@ pub(crate) enum ShowKind {
     RegFile(ShowRegFileKind),
     RegisterI(RegId),
     RegisterF(FRegId),
+    Backtrace,
+    History,
 }
 
 pub(crate) enum StatKind {
@@ -185,6 +189,32 @@ enum WatchRegFile {
     RegFileF,
 }
 
+/// `label+offset` of the nearest preceding label, if any.
+fn symbolize(sim: &Simulator<impl Input, impl Output>, pc: u32) -> String {
+    let dbg = sim.debug_symbol();
+    match dbg.get_nearest_symbol_addr(pc) {
+        Ok(index) => {
+            let symbol = dbg.get_symbol(index);
+            format!("{pc:#010x} <{}+{:#x}>", symbol.label, pc - symbol.addr)
+        }
+        Err(_) => format!("{pc:#010x}"),
+    }
+}
+
+pub fn print_backtrace(sim: &Simulator<impl Input, impl Output>) {
+    if let Some(&pc) = sim.recent_pcs().last() {
+        println!("#0  {}", symbolize(sim, pc));
+    }
+    for (i, frame) in sim.call_stack().iter().rev().enumerate() {
+        println!(
+            "#{:<2} {} (called {})",
+            i + 1,
+            symbolize(sim, frame.call_site),
+            symbolize(sim, frame.target)
+        );
+    }
+}
+
 fn get_terminal_width() -> Option<u16> {
     terminal_size().map(|(w, _)| w.0 - 20)
 }
@@ -335,6 +365,12 @@ pub fn execute_interactive(sim: &mut Simulator<impl Input, impl Output>) -> Resu
                             }
                         }
                     }
+                    ShowKind::Backtrace => print_backtrace(sim),
+                    ShowKind::History => {
+                        for pc in sim.recent_pcs() {
+                            println!("  {}", symbolize(sim, pc));
+                        }
+                    }
                     ShowKind::AddedSpy(s) => {
                         println!("added spy on {s}");
                     }
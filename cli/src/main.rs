@@ -1,17 +1,34 @@
+mod batch;
+mod cache;
+mod fpu_sweep;
+#[cfg(feature = "coverage")]
+mod fuzz;
 mod interactive;
+#[cfg(feature = "stat")]
+mod stats_diff;
 
 use std::{
     fs::File,
-    io::{Read, Write},
-    path::PathBuf,
+    io::{BufReader, BufWriter, Read, Write},
+    path::{Path, PathBuf},
 };
 
-use anyhow::Result;
+use anyhow::{Context, Result};
+use cache::{CacheArgs, CacheKey, ResultCache, RunOutputs};
 use clap::{Args, Parser, Subcommand};
 use core_sim::{
+    aot, compressed,
+    core_dump::CoreDump,
     debug_symbol::DebugSymbol,
+    energy::EnergyModel,
+    fpu_approx::{Approx, Unit},
+    fuse::Fusions,
+    interval::TimingModel,
     io::{BinaryInput, BinaryOutput, EmptyIO, Input, Output},
+    multicore::MulticoreConfig,
     ppm::PPMData,
+    resim::{self, ResimOptions},
+    sampler::{SampleOn, SampleOptions},
     sim::Simulator,
     sld::SldData,
 };
@@ -32,6 +49,24 @@ enum Command {
     Rt(RtArgs),
     /// simulate core
     Exe(ExeArgs),
+    /// compare two stats dumps and exit with non-zero status on regression
+    #[cfg(feature = "stat")]
+    StatsDiff(StatsDiffArgs),
+    /// run batch jobs (program x input x config) on workers
+    Batch(BatchArgs),
+    /// serve batch jobs of a coordinator
+    Worker(WorkerArgs),
+    /// inspect a core file dumped by a failed run
+    Core(CoreArgs),
+    /// fuzz the input of a program guided by branch coverage
+    #[cfg(feature = "coverage")]
+    Fuzz(FuzzArgs),
+    /// report the error of fdiv/fsqrt approximations over their parameters
+    FpuSweep(FpuSweepArgs),
+    /// rewrite a program with the compressed 16-bit encoding
+    Compress(CompressArgs),
+    /// translate a program to Rust source to be compiled natively
+    Translate(TranslateArgs),
 }
 
 #[derive(Args, Debug)]
@@ -48,6 +83,116 @@ struct CommonArgs {
     /// File path to debug symbol
     #[arg(long = "dbg")]
     debug_symbol: Option<PathBuf>,
+    /// File path to write core file on runtime error
+    #[arg(long, default_value = "core_sim.core")]
+    core_file: PathBuf,
+    /// Number of cores sharing the memory; core `i` starts with `a0 = i`
+    #[arg(long, default_value_t = 1)]
+    cores: usize,
+    /// Instructions each core runs before switching to the next one
+    #[arg(long, default_value_t = 64)]
+    quantum: usize,
+    /// Instruction pairs to fuse: `builtin`, `none`, or a stats dump (json)
+    /// of a profiling run to fuse the pairs hot in it
+    #[arg(long, default_value = "builtin")]
+    fuse: String,
+    /// Model predicting the clocks: `detailed` (pipeline) or `interval`
+    /// (penalties of miss events; faster, approximate)
+    #[arg(long, default_value = "detailed")]
+    timing: TimingModel,
+    /// Estimate the clocks by the interval model alongside the detailed one
+    /// and report its error
+    #[arg(long)]
+    calibrate_interval: bool,
+    /// File path to the energy model (json of picojoules per event) to
+    /// estimate the energy and power of the run with
+    #[arg(long)]
+    energy: Option<PathBuf>,
+    /// Report loads of values already in a register and stores overwritten
+    /// before any read, by pc and function
+    #[arg(long)]
+    redundancy: bool,
+    /// Profile the data accesses to advise which globals and heap chunks to
+    /// place in BRAM
+    #[arg(long)]
+    placement: bool,
+    /// Report the trip counts and costs of loops, nested by function
+    #[arg(long)]
+    loops: bool,
+    #[command(flatten)]
+    resim: ResimArgs,
+    #[command(flatten)]
+    sample: SampleArgs,
+    #[command(flatten)]
+    stat_output: StatOutput,
+    #[command(flatten)]
+    cache: CacheArgs,
+}
+
+#[derive(Args, Debug)]
+struct ResimArgs {
+    /// Time the run in intervals of this many instructions, in parallel:
+    /// a run with the interval model saves a checkpoint per interval, then
+    /// the detailed model times each interval from its checkpoint
+    #[arg(long, conflicts_with = "interactive")]
+    resim_interval: Option<usize>,
+    /// Instructions run before each interval to warm up the pipeline, cache
+    /// and branch predictor
+    #[arg(long, default_value_t = 100_000, requires = "resim_interval")]
+    resim_warmup: usize,
+    /// Number of threads timing the intervals (default: number of cpus)
+    #[arg(long, requires = "resim_interval")]
+    resim_jobs: Option<usize>,
+}
+
+impl ResimArgs {
+    fn options(&self) -> Option<ResimOptions> {
+        Some(ResimOptions {
+            interval: self.resim_interval?,
+            warmup: self.resim_warmup,
+            jobs: self
+                .resim_jobs
+                .unwrap_or_else(|| std::thread::available_parallelism().map_or(1, |n| n.get())),
+        })
+    }
+}
+
+#[derive(Args, Debug)]
+struct SampleArgs {
+    /// Sample the pc every this many instructions (or clocks), checked at
+    /// the end of basic blocks; the profile is reported by function
+    #[arg(long)]
+    sample_period: Option<usize>,
+    /// What the sampling period counts: `instrs` or `clocks`
+    #[arg(long, default_value = "instrs", requires = "sample_period")]
+    sample_on: SampleOn,
+    /// Record the call stack of each sample
+    #[arg(long, requires = "sample_period")]
+    sample_stacks: bool,
+}
+
+impl SampleArgs {
+    fn options(&self) -> Option<SampleOptions> {
+        Some(SampleOptions {
+            period: self.sample_period?,
+            on: self.sample_on,
+            stacks: self.sample_stacks,
+        })
+    }
+}
+
+#[derive(Args, Debug)]
+struct StatOutput {
+    /// File path to write machine-readable statistics (json)
+    #[arg(long)]
+    stat_json: Option<PathBuf>,
+    /// File path to write BRAM/DDR2 placement map advised from the run (json)
+    #[arg(long, requires = "placement")]
+    placement_map: Option<PathBuf>,
+    /// File path to write the sampled profile as collapsed stacks
+    /// (`outer;inner;leaf count` per line) for flame graph tools
+    #[arg(long, requires = "sample_period")]
+    profile: Option<PathBuf>,
 }
 
 #[derive(Args, Debug)]
@@ -74,68 +219,246 @@ struct ExeArgs {
     stdout: Option<PathBuf>,
 }
 
+#[cfg(feature = "stat")]
+#[derive(Args, Debug)]
+struct StatsDiffArgs {
+    /// File path to stats dump of the baseline run
+    base: PathBuf,
+    /// File path to stats dump of the run to be checked
+    new: PathBuf,
+    /// Allowed relative change of clocks (percent)
+    #[arg(long, default_value_t = 1.0)]
+    clocks_threshold: f64,
+    /// Allowed relative change of executed instructions (percent)
+    #[arg(long, default_value_t = 5.0)]
+    instrs_threshold: f64,
+    /// Allowed change of cache hit rate and branch accuracy (percentage points)
+    #[arg(long, default_value_t = 0.5)]
+    rate_threshold: f64,
+    /// Allowed relative change of memory region traffic (percent)
+    #[arg(long, default_value_t = 5.0)]
+    memory_threshold: f64,
+}
+
+#[derive(Args, Debug)]
+struct BatchArgs {
+    /// File path to job file (json)
+    jobs: PathBuf,
+    /// Endpoint to wait workers on (`tcp:HOST:PORT` or `unix:PATH`)
+    #[arg(long, default_value = "tcp:127.0.0.1:0")]
+    listen: String,
+    /// Directory to write outputs of jobs
+    #[arg(long, default_value = "batch_out")]
+    out_dir: PathBuf,
+    /// Number of retries of a job lost with its worker; a program failing by
+    /// itself is not retried
+    #[arg(long, default_value_t = 2)]
+    retries: usize,
+    /// Number of workers spawned on this machine
+    #[arg(long, default_value_t = 0)]
+    local_workers: usize,
+    /// File path to write the counters of the stats summed over all jobs (json)
+    #[arg(long)]
+    merged_stats: Option<PathBuf>,
+}
+
+#[derive(Args, Debug)]
+struct WorkerArgs {
+    /// Endpoint of the coordinator (`tcp:HOST:PORT` or `unix:PATH`)
+    #[arg(long)]
+    connect: String,
+    /// Name of the worker shown in results
+    #[arg(long)]
+    name: Option<String>,
+}
+
+#[derive(Args, Debug)]
+struct CoreArgs {
+    /// File path to the program which dumped the core
+    #[arg(short, long)]
+    input: PathBuf,
+    /// File path to core file
+    #[arg(long, default_value = "core_sim.core")]
+    core: PathBuf,
+    /// File path to debug symbol
+    #[arg(long = "dbg")]
+    debug_symbol: Option<PathBuf>,
+}
+
+#[cfg(feature = "coverage")]
+#[derive(Args, Debug)]
+struct FuzzArgs {
+    /// File path to the program to fuzz
+    #[arg(short, long)]
+    input: PathBuf,
+    /// File path to a program expected to behave the same (e.g. built without optimization)
+    #[arg(long)]
+    reference: Option<PathBuf>,
+    /// Directory of initial inputs
+    #[arg(long)]
+    seeds: Option<PathBuf>,
+    /// Directory to write the corpus and findings
+    #[arg(long, default_value = "fuzz_out")]
+    out_dir: PathBuf,
+    /// Number of cycles after which a run is regarded as a hang
+    #[arg(long, default_value_t = 1_000_000)]
+    max_cycles: usize,
+    /// Number of executions to stop after
+    #[arg(long)]
+    iterations: Option<u64>,
+    /// Seconds to stop after
+    #[arg(long)]
+    duration: Option<u64>,
+    /// Seed of the mutation
+    #[arg(long, default_value_t = 1)]
+    seed: u64,
+}
+
+#[derive(Args, Debug)]
+struct FpuSweepArgs {
+    /// Widths of the table key in bits
+    #[arg(long, value_delimiter = ',', default_values_t = [8, 9, 10, 11, 12])]
+    key_bits: Vec<u32>,
+    /// Orders of the approximation (0: table only, 1: linear, 2: quadratic)
+    #[arg(long, value_delimiter = ',', default_values_t = [0, 1, 2])]
+    orders: Vec<u32>,
+    /// Mantissa widths of the table coefficients in bits
+    #[arg(long, value_delimiter = ',', default_values_t = [23])]
+    coef_bits: Vec<u32>,
+    /// Units the parameters apply to (the others keep the hardware parameters)
+    #[arg(long, value_delimiter = ',', default_values_t = Unit::ALL)]
+    units: Vec<Unit>,
+    /// Number of random operands per unit for the ULP error
+    #[arg(long, default_value_t = 1 << 20)]
+    samples: usize,
+    /// Seed of the operands
+    #[arg(long, default_value_t = 1)]
+    seed: u64,
+    /// File path to raytracer program to measure the image error with
+    #[arg(short, long, requires = "sld")]
+    input: Option<PathBuf>,
+    /// File path to input sld of the raytracer
+    #[arg(short, long, requires = "input")]
+    sld: Option<PathBuf>,
+    /// File path to reference image (default: rendered with the hardware parameters)
+    #[arg(long, requires = "input")]
+    reference: Option<PathBuf>,
+    /// Number of threads (default: number of cpus)
+    #[arg(short, long)]
+    jobs: Option<usize>,
+    /// File path to write the results (json)
+    #[arg(long)]
+    json: Option<PathBuf>,
+}
+
+#[derive(Args, Debug)]
+struct CompressArgs {
+    /// File path to the program to compress
+    #[arg(short, long)]
+    input: PathBuf,
+    /// File path to write the compressed program
+    #[arg(short, long)]
+    output: PathBuf,
+    /// File path to debug symbol of the program
+    #[arg(long = "dbg", requires = "debug_symbol_output")]
+    debug_symbol: Option<PathBuf>,
+    /// File path to write the debug symbol with the addresses moved
+    #[arg(long = "dbg-out")]
+    debug_symbol_output: Option<PathBuf>,
+}
+
+#[derive(Args, Debug)]
+struct TranslateArgs {
+    /// File path to the program to translate
+    #[arg(short, long)]
+    input: PathBuf,
+    /// File path to write the Rust source (e.g. `cli/examples/prog.rs`)
+    #[arg(short, long)]
+    output: PathBuf,
+    /// File path to debug symbol; its labels become targets of `jalr`
+    #[arg(long = "dbg")]
+    debug_symbol: Option<PathBuf>,
+}
+
 fn main() -> anyhow::Result<()> {
     let args = Cli::parse();
     match args.command {
-        Command::Rt(RtArgs {
-            delegate:
-                CommonArgs {
-                    input,
-                    interactive,
-                    debug_symbol,
-                    verbose,
-                },
-            sld,
-            ppm,
-        }) => {
-            if verbose {
+        Command::Rt(RtArgs { delegate, sld, ppm }) => {
+            if delegate.verbose {
                 env_logger::Builder::from_env(env_logger::Env::default().default_filter_or("info"))
                     .init();
             } else {
                 env_logger::init();
             }
-            let mem = read_input(input)?;
+            let config = RunConfig::new(&delegate)?;
+            let mem = read_input(delegate.input)?;
             let sld = {
                 let mut buf = String::new();
                 let mut file = File::open(sld)?;
                 file.read_to_string(&mut buf)?;
                 buf
             };
-            let debug_symbol = read_dbg_symb(debug_symbol)?;
+            let stat_output = &delegate.stat_output;
+            let cache = ResultCache::open(&delegate.cache, config.interactive);
+            let key = match &cache {
+                Some(_) => {
+                    let mut key = CacheKey::new("rt");
+                    key.add("program", &mem);
+                    key.add("sld", sld.as_bytes());
+                    config.add_to_key(&mut key)?;
+                    Some(key)
+                }
+                None => None,
+            };
+            if let Some(outputs) = cache_lookup(&cache, &key) {
+                return write_outputs(&outputs, Some(&ppm), stat_output);
+            }
 
             let input = SldData::parse(&sld)?;
             log::info!("finished parsing SLD. # of object: {}", input.num_objects);
-            let mut sim = Simulator::new(&mem, input, PPMData::new())?;
-            sim.provide_dbg_symb(debug_symbol);
-            execute(&mut sim, interactive)?;
-            log::info!("finished execution.");
-            output_stat(&sim);
-            let sim_output = sim.into_output();
-            let h = sim_output.cpu_output.verify_header()?;
+            let (ppm_data, mut outputs) = simulate(
+                &mem,
+                input,
+                PPMData::new(),
+                &config,
+                stat_output,
+                cache.is_some(),
+            )?;
+            let h = ppm_data.verify_header()?;
             log::info!("PPM generated. {h:?}");
-            let mut out = File::create(ppm)?;
-            out.write_all(&sim_output.cpu_output.into_inner())?;
-            Ok(())
+            outputs.output = ppm_data.into_inner();
+            cache_store(&cache, &key, &outputs);
+            write_outputs(&outputs, Some(&ppm), stat_output)
         }
         Command::Exe(ExeArgs {
-            delegate:
-                CommonArgs {
-                    input,
-                    interactive,
-                    debug_symbol,
-                    verbose,
-                },
+            delegate,
             stdin,
             stdout,
         }) => {
-            if verbose {
+            if delegate.verbose {
                 env_logger::Builder::from_env(env_logger::Env::default().default_filter_or("info"))
                     .init();
             } else {
                 env_logger::init();
             }
-            let mem = read_input(input)?;
-            let debug_symbol = read_dbg_symb(debug_symbol)?;
+            let config = RunConfig::new(&delegate)?;
+            let mem = read_input(delegate.input)?;
+            let stat_output = &delegate.stat_output;
+            let cache = ResultCache::open(&delegate.cache, config.interactive);
+            let key = match &cache {
+                Some(_) => {
+                    let mut key = CacheKey::new("exe");
+                    key.add("program", &mem);
+                    key.add_file("stdin", stdin.as_deref())?;
+                    key.add("stdout", &[u8::from(stdout.is_some())]);
+                    config.add_to_key(&mut key)?;
+                    Some(key)
+                }
+                None => None,
+            };
+            if let Some(outputs) = cache_lookup(&cache, &key) {
+                return write_outputs(&outputs, stdout.as_deref(), stat_output);
+            }
             macro_rules! b_in {
                 ($input:ident) => {{
                     let input = {
@@ -152,48 +475,476 @@ fn main() -> anyhow::Result<()> {
             }
             macro_rules! b_out {
                 ($output:ident) => {
-                    match stdin {
-                        Some(stdin) => {
-                            let mut sim = Simulator::new(&mem, b_in!(stdin), $output)?;
-                            sim.provide_dbg_symb(debug_symbol);
-                            execute(&mut sim, interactive)?;
-                            output_stat(&sim);
-                            sim.into_output()
-                        }
-                        None => {
-                            let mut sim = Simulator::new(&mem, b_in!(), $output)?;
-                            sim.provide_dbg_symb(debug_symbol);
-                            execute(&mut sim, interactive)?;
-                            output_stat(&sim);
-                            sim.into_output()
-                        }
+                    match &stdin {
+                        Some(stdin) => simulate(
+                            &mem,
+                            b_in!(stdin),
+                            $output,
+                            &config,
+                            stat_output,
+                            cache.is_some(),
+                        )?,
+                        None => simulate(
+                            &mem,
+                            b_in!(),
+                            $output,
+                            &config,
+                            stat_output,
+                            cache.is_some(),
+                        )?,
                     }
                 };
             }
-            match stdout {
-                Some(stdout) => {
+            let outputs = match &stdout {
+                Some(_) => {
                     let output = BinaryOutput::new();
-                    let sim_output = b_out!(output);
-                    let mut out = File::create(stdout)?;
-                    out.write_all(&sim_output.cpu_output.into_inner())?;
+                    let (output, mut outputs) = b_out!(output);
+                    outputs.output = output.into_inner();
+                    outputs
                 }
                 None => {
                     let output = EmptyIO::new();
-                    let _sim_output = b_out!(output);
+                    b_out!(output).1
+                }
+            };
+            cache_store(&cache, &key, &outputs);
+            write_outputs(&outputs, stdout.as_deref(), stat_output)
+        }
+        #[cfg(feature = "stat")]
+        Command::StatsDiff(StatsDiffArgs {
+            base,
+            new,
+            clocks_threshold,
+            instrs_threshold,
+            rate_threshold,
+            memory_threshold,
+        }) => {
+            env_logger::init();
+            let thresholds = stats_diff::Thresholds {
+                clocks: clocks_threshold,
+                instrs: instrs_threshold,
+                rate: rate_threshold,
+                memory: memory_threshold,
+            };
+            let report = stats_diff::diff(
+                &stats_diff::load(&base)?,
+                &stats_diff::load(&new)?,
+                &thresholds,
+            );
+            print!("{report}");
+            if report.has_regression() {
+                std::process::exit(1);
+            }
+            Ok(())
+        }
+        Command::Batch(BatchArgs {
+            jobs,
+            listen,
+            out_dir,
+            retries,
+            local_workers,
+            merged_stats,
+        }) => {
+            env_logger::init();
+            let ok = batch::coordinate(batch::BatchOptions {
+                jobs,
+                listen,
+                out_dir,
+                retries,
+                local_workers,
+                merged_stats,
+            })?;
+            if !ok {
+                std::process::exit(1);
+            }
+            Ok(())
+        }
+        Command::Worker(WorkerArgs { connect, name }) => {
+            env_logger::init();
+            batch::work(&connect, name)
+        }
+        Command::Core(CoreArgs {
+            input,
+            core,
+            debug_symbol,
+        }) => {
+            env_logger::init();
+            let mem = read_input(input)?;
+            let dump = CoreDump::read_from(&mut BufReader::new(
+                File::open(&core).with_context(|| format!("failed to open {}", core.display()))?,
+            ))?;
+            let mut sim = Simulator::new(&mem, EmptyIO::new(), EmptyIO::new())?;
+            sim.provide_dbg_symb(read_dbg_symb(debug_symbol)?);
+            sim.restore_core(&dump)?;
+            println!(
+                "core dumped at pc {:#010x}, cycle #{}: {}",
+                dump.pc, dump.cycle, dump.error
+            );
+            interactive::print_backtrace(&sim);
+            interactive::execute_interactive(&mut sim)
+        }
+        #[cfg(feature = "coverage")]
+        Command::Fuzz(FuzzArgs {
+            input,
+            reference,
+            seeds,
+            out_dir,
+            max_cycles,
+            iterations,
+            duration,
+            seed,
+        }) => {
+            env_logger::Builder::from_env(env_logger::Env::default().default_filter_or("info"))
+                .init();
+            let found = fuzz::fuzz(fuzz::FuzzOptions {
+                program: read_input(input)?,
+                reference: reference.map(read_input).transpose()?,
+                seeds,
+                out_dir,
+                max_cycles,
+                iterations,
+                duration: duration.map(std::time::Duration::from_secs),
+                seed,
+            })?;
+            if found > 0 {
+                std::process::exit(1);
+            }
+            Ok(())
+        }
+        Command::FpuSweep(FpuSweepArgs {
+            key_bits,
+            orders,
+            coef_bits,
+            units,
+            samples,
+            seed,
+            input,
+            sld,
+            reference,
+            jobs,
+            json,
+        }) => {
+            env_logger::init();
+            let raytracer = match (input, sld) {
+                (Some(input), Some(sld)) => Some(fpu_sweep::Raytracer {
+                    program: read_input(input)?,
+                    sld: std::fs::read_to_string(sld)?,
+                    reference: reference.map(read_input).transpose()?,
+                }),
+                _ => None,
+            };
+            let mut configs = vec![];
+            for &key_bits in &key_bits {
+                for &order in &orders {
+                    for &coef_bits in &coef_bits {
+                        configs.push(Approx {
+                            key_bits,
+                            order,
+                            coef_bits,
+                        });
+                    }
                 }
             }
+            let results = fpu_sweep::sweep(&fpu_sweep::SweepOptions {
+                configs,
+                units,
+                samples,
+                seed,
+                raytracer,
+                jobs: jobs
+                    .unwrap_or_else(|| std::thread::available_parallelism().map_or(1, |n| n.get())),
+            })?;
+            print!("{}", fpu_sweep::SweepReport(&results));
+            if let Some(path) = json {
+                File::create(path)?.write_all(&serde_json::to_vec_pretty(&results)?)?;
+            }
             Ok(())
         }
+        Command::Compress(CompressArgs {
+            input,
+            output,
+            debug_symbol,
+            debug_symbol_output,
+        }) => {
+            env_logger::init();
+            let c = compressed::compress(&read_input(input)?)?;
+            File::create(output)?.write_all(&c.image)?;
+            if let (Some(src), Some(dst)) = (debug_symbol, debug_symbol_output) {
+                let mut symb: serde_json::Value = serde_json::from_reader(File::open(src)?)?;
+                for kind in ["globals", "labels"] {
+                    let Some(defs) = symb[kind].as_array_mut() else {
+                        continue;
+                    };
+                    for def in defs {
+                        let addr = def["addr"].as_u64().map(|a| c.remap(a as u32));
+                        if let Some(Some(addr)) = addr {
+                            def["addr"] = addr.into();
+                        }
+                    }
+                }
+                File::create(dst)?.write_all(&serde_json::to_vec(&symb)?)?;
+            }
+            println!(
+                "compressed {} of {} instructions: text {} -> {} bytes ({:.2}% smaller)",
+                c.compressed_instrs,
+                c.instrs,
+                c.old_text_bytes,
+                c.new_text_bytes,
+                100. * (1. - c.new_text_bytes as f64 / c.old_text_bytes.max(1) as f64)
+            );
+            Ok(())
+        }
+        Command::Translate(TranslateArgs {
+            input,
+            output,
+            debug_symbol,
+        }) => {
+            env_logger::init();
+            let source = aot::translate(
+                &read_input(input.clone())?,
+                &read_dbg_symb(debug_symbol)?,
+                &input.display().to_string(),
+            )?;
+            File::create(&output)?.write_all(source.as_bytes())?;
+            log::info!("translated to {}.", output.display());
+            Ok(())
+        }
+    }
+}
+
+/// the settings of an `rt` or `exe` run other than its program and
+/// input/output.
+struct RunConfig {
+    debug_symbol: Option<PathBuf>,
+    multicore: MulticoreConfig,
+    fusions: Fusions,
+    timing: TimingModel,
+    calibrate_interval: bool,
+    energy: Option<PathBuf>,
+    redundancy: bool,
+    placement: bool,
+    loops: bool,
+    resim: Option<ResimOptions>,
+    sampling: Option<SampleOptions>,
+    interactive: bool,
+    core_file: PathBuf,
+}
+
+impl RunConfig {
+    fn new(args: &CommonArgs) -> Result<Self> {
+        Ok(Self {
+            debug_symbol: args.debug_symbol.clone(),
+            multicore: MulticoreConfig {
+                cores: args.cores,
+                quantum: args.quantum,
+                ..Default::default()
+            },
+            fusions: read_fusions(&args.fuse)?,
+            timing: args.timing,
+            calibrate_interval: args.calibrate_interval,
+            energy: args.energy.clone(),
+            redundancy: args.redundancy,
+            placement: args.placement,
+            loops: args.loops,
+            resim: args.resim.options(),
+            sampling: args.sample.options(),
+            interactive: args.interactive,
+            core_file: args.core_file.clone(),
+        })
+    }
+
+    /// adds the settings which change the results of the run to `key`.
+    fn add_to_key(&self, key: &mut CacheKey) -> Result<()> {
+        key.add_file("dbg", self.debug_symbol.as_deref())?;
+        let MulticoreConfig { cores, quantum, .. } = self.multicore;
+        if cores > 1 {
+            key.add("multicore", format!("{cores}/{quantum}").as_bytes());
+        }
+        // the results are the same; the stats tell what was fused
+        if self.fusions != Fusions::builtin() {
+            key.add("fuse", format!("{:?}", self.fusions).as_bytes());
+        }
+        if self.timing != TimingModel::Detailed {
+            key.add("timing", self.timing.name().as_bytes());
+        }
+        if self.calibrate_interval {
+            key.add("calibrate_interval", &[1]);
+        }
+        if let Some(r) = self.resim {
+            key.add("resim", format!("{}/{}", r.interval, r.warmup).as_bytes());
+        }
+        if let Some(s) = self.sampling {
+            key.add("sample", format!("{s:?}").as_bytes());
+        }
+        if self.energy.is_some() {
+            key.add_file("energy", self.energy.as_deref())?;
+        }
+        if self.redundancy {
+            key.add("redundancy", &[1]);
+        }
+        if self.placement {
+            key.add("placement", &[1]);
+        }
+        if self.loops {
+            key.add("loops", &[1]);
+        }
+        Ok(())
+    }
+
+    /// sets up `sim` to run with the settings.
+    fn apply<I: Input, O: Output>(&self, sim: &mut Simulator<I, O>) -> Result<()> {
+        sim.provide_dbg_symb(read_dbg_symb(self.debug_symbol.clone())?);
+        sim.set_multicore(self.multicore);
+        sim.set_fusions(self.fusions);
+        sim.set_timing(self.timing);
+        if self.calibrate_interval {
+            sim.calibrate_interval();
+        }
+        if let Some(model) = read_energy(self.energy.clone())? {
+            sim.set_energy_model(model);
+        }
+        if self.redundancy {
+            sim.check_redundancy();
+        }
+        if self.placement {
+            sim.advise_placement();
+        }
+        if self.loops {
+            sim.profile_loops();
+        }
+        if let Some(opt) = self.sampling {
+            sim.set_sampling(opt);
+        }
+        Ok(())
     }
 }
 
+/// runs the simulation and returns the output of the program with the
+/// statistics outputs. `all_stats` forces the statistics outputs to be made
+/// even if not requested (to be cached).
+fn simulate<I, O>(
+    mem: &[u8],
+    input: I,
+    output: O,
+    config: &RunConfig,
+    stat_output: &StatOutput,
+    all_stats: bool,
+) -> Result<(O, RunOutputs)>
+where
+    I: Input + Clone + Send + Sync,
+    O: Output,
+{
+    let mut sim = Simulator::new(mem, input, output)?;
+    config.apply(&mut sim)?;
+    let resim = match config.resim {
+        Some(opt) => {
+            anyhow::ensure!(
+                config.multicore.cores == 1,
+                "re-simulation in intervals runs a single core"
+            );
+            let rec = resim::record(&mut sim, &opt)?;
+            log::info!(
+                "saved {} checkpoints over {} instructions; timing them on {} threads.",
+                rec.intervals(),
+                rec.instrs(),
+                opt.jobs
+            );
+            let r = resim::replay(mem, &rec, &opt)?;
+            log::info!("clocks stitched from the intervals: {}", r.clocks());
+            Some(r)
+        }
+        None => {
+            execute(&mut sim, config.interactive, &config.core_file)?;
+            None
+        }
+    };
+    log::info!("finished execution.");
+    let outputs = output_stat(&sim, resim, stat_output, all_stats)?;
+    Ok((sim.into_output().cpu_output, outputs))
+}
+
 #[cfg(not(feature = "stat"))]
-fn output_stat<I, O>(_: &Simulator<I, O>) {}
+fn output_stat<I, O>(
+    _: &Simulator<I, O>,
+    _: Option<resim::Resim>,
+    _: &StatOutput,
+    _: bool,
+) -> Result<RunOutputs> {
+    Ok(Default::default())
+}
 
 #[cfg(feature = "stat")]
-fn output_stat<I, O>(sim: &Simulator<I, O>) {
+fn output_stat<I, O>(
+    sim: &Simulator<I, O>,
+    resim: Option<resim::Resim>,
+    out: &StatOutput,
+    all: bool,
+) -> Result<RunOutputs> {
     let max_width = get_terminal_width().unwrap_or(120) as usize;
-    log::info!("statistics:\n{}", sim.collect_stat().view(max_width));
+    let mut stats = sim.collect_stat();
+    if let Some(r) = resim {
+        stats.push(Box::new(r));
+    }
+    let text = stats.view(max_width).to_string();
+    log::info!("statistics:\n{text}");
+    let mut outputs = RunOutputs {
+        stat_text: Some(text.into_bytes()),
+        ..Default::default()
+    };
+    if out.stat_json.is_some() || all {
+        outputs.stat_json = Some(serde_json::to_vec_pretty(&stats.to_json())?);
+    }
+    if let Some(advice) = sim.placement_advice() {
+        log::info!(
+            "predicted reduction by the placement map: {} clocks.",
+            advice.predicted_reduction()
+        );
+        outputs.placement_map = Some(advice.to_map_json()?.into_bytes());
+    }
+    if out.profile.is_some() || all {
+        outputs.profile = Some(sim.sample_profile().collapsed().into_bytes());
+    }
+    Ok(outputs)
+}
+
+/// writes the outputs of a run (simulated or restored from the cache).
+fn write_outputs(outputs: &RunOutputs, output: Option<&Path>, out: &StatOutput) -> Result<()> {
+    if let Some(path) = output {
+        File::create(path)?.write_all(&outputs.output)?;
+    }
+    for (path, content, what) in [
+        (&out.stat_json, &outputs.stat_json, "statistics"),
+        (&out.placement_map, &outputs.placement_map, "placement map"),
+        (&out.profile, &outputs.profile, "sampled profile"),
+    ] {
+        let Some(path) = path else {
+            continue;
+        };
+        match content {
+            Some(content) => {
+                File::create(path)?.write_all(content)?;
+                log::info!("{what} written to {}.", path.display());
+            }
+            None => log::warn!("statistics are disabled in this build; {what} is not written."),
+        }
+    }
+    Ok(())
+}
+
+fn cache_lookup(cache: &Option<ResultCache>, key: &Option<CacheKey>) -> Option<RunOutputs> {
+    let outputs = cache.as_ref()?.get(key.as_ref()?)?;
+    if let Some(text) = &outputs.stat_text {
+        log::info!("statistics:\n{}", String::from_utf8_lossy(text));
+    }
+    Some(outputs)
+}
+
+fn cache_store(cache: &Option<ResultCache>, key: &Option<CacheKey>, outputs: &RunOutputs) {
+    if let (Some(cache), Some(key)) = (cache, key) {
+        if let Err(e) = cache.put(key, outputs) {
+            log::warn!("failed to store the result cache: {e:#}");
+        }
+    }
 }
 
 #[cfg(feature = "stat")]
@@ -201,6 +952,27 @@ fn get_terminal_width() -> Option<u16> {
     terminal_size().map(|(w, _)| w.0 - 20)
 }
 
+fn read_fusions(spec: &str) -> Result<Fusions> {
+    Ok(match spec {
+        "builtin" => Fusions::builtin(),
+        "none" => Fusions::none(),
+        path => {
+            let stats = serde_json::from_reader(BufReader::new(File::open(path)?))?;
+            Fusions::from_profile(&stats).with_context(|| format!("reading {path}"))?
+        }
+    })
+}
+
+fn read_energy(path: Option<PathBuf>) -> Result<Option<EnergyModel>> {
+    let Some(path) = path else {
+        return Ok(None);
+    };
+    let config = serde_json::from_reader(BufReader::new(File::open(&path)?))?;
+    let model =
+        EnergyModel::from_json(&config).with_context(|| format!("reading {}", path.display()))?;
+    Ok(Some(model))
+}
+
 fn read_dbg_symb(debug_symbol: Option<PathBuf>) -> Result<DebugSymbol> {
     let debug_symbol = match debug_symbol {
         Some(p) => {
@@ -219,7 +991,22 @@ fn read_input(input: PathBuf) -> Result<Vec<u8>> {
     Ok(buf)
 }
 
-fn execute<I: Input, O: Output>(sim: &mut Simulator<I, O>, interactive: bool) -> Result<()> {
+fn write_core<I: Input, O: Output>(sim: &Simulator<I, O>, path: &Path) -> Result<()> {
+    let Some(core) = sim.core_dump() else {
+        return Ok(());
+    };
+    let mut w = BufWriter::new(
+        File::create(path).with_context(|| format!("failed to create {}", path.display()))?,
+    );
+    core.write_to(&mut w)?;
+    Ok(())
+}
+
+fn execute<I: Input, O: Output>(
+    sim: &mut Simulator<I, O>,
+    interactive: bool,
+    core_file: &Path,
+) -> Result<()> {
     if interactive {
         interactive::execute_interactive(sim)
     } else {
@@ -230,7 +1017,16 @@ fn execute<I: Input, O: Output>(sim: &mut Simulator<I, O>, interactive: bool) ->
                     break Ok(());
                 } else {
                     let how = sim.get_error_msg().unwrap();
-                    break Err(anyhow::anyhow!("simulator returns an error: {how}. try executing process with --interactive to debug."));
+                    break Err(match write_core(sim, core_file) {
+                        Ok(()) => anyhow::anyhow!(
+                            "simulator returns an error: {how}. core dumped to {}; inspect it with `core --core {0} -i <program>`.",
+                            core_file.display()
+                        ),
+                        Err(e) => {
+                            log::warn!("failed to write core file: {e:#}");
+                            anyhow::anyhow!("simulator returns an error: {how}. try executing process with --interactive to debug.")
+                        }
+                    });
                 }
             }
         }
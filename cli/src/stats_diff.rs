@@ -0,0 +1,277 @@
+//! compare two stats dumps (written with `--stat-json`) and detect regressions.
+
+use std::{fmt, fs::File, path::Path};
+
+use anyhow::{Context, Result};
+use core_sim::stat::STATS_DUMP_FORMAT;
+use serde_json::Value;
+
+pub struct Thresholds {
+    /// allowed relative change of clocks (percent)
+    pub clocks: f64,
+    /// allowed relative change of executed instructions (percent)
+    pub instrs: f64,
+    /// allowed change of cache hit rate and branch accuracy (percentage points)
+    pub rate: f64,
+    /// allowed relative change of memory region traffic (percent)
+    pub memory: f64,
+}
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Verdict {
+    Regression,
+    Improvement,
+    Changed,
+}
+
+impl fmt::Display for Verdict {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        let s = match self {
+            Verdict::Regression => "REGRESSION",
+            Verdict::Improvement => "improvement",
+            Verdict::Changed => "changed",
+        };
+        write!(f, "{s:>11}")
+    }
+}
+
+struct Delta {
+    what: String,
+    base: String,
+    new: String,
+    change: String,
+    verdict: Verdict,
+}
+
+pub struct Report {
+    deltas: Vec<Delta>,
+}
+
+impl Report {
+    pub fn has_regression(&self) -> bool {
+        self.deltas.iter().any(|d| d.verdict == Verdict::Regression)
+    }
+}
+
+impl fmt::Display for Report {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        if self.deltas.is_empty() {
+            return writeln!(f, "no significant difference.");
+        }
+        for Delta {
+            what,
+            base,
+            new,
+            change,
+            verdict,
+        } in &self.deltas
+        {
+            writeln!(
+                f,
+                "  [{verdict}] {what:<28}{base:>14} -> {new:>14} ({change})"
+            )?;
+        }
+        Ok(())
+    }
+}
+
+pub fn load(path: &Path) -> Result<Value> {
+    let file = File::open(path).with_context(|| format!("failed to open {}", path.display()))?;
+    let v: Value = serde_json::from_reader(file)
+        .with_context(|| format!("failed to parse {}", path.display()))?;
+    let format = v.get("format").and_then(Value::as_u64);
+    if format != Some(STATS_DUMP_FORMAT) {
+        anyhow::bail!(
+            "{}: unsupported stats dump format {format:?} (expected {STATS_DUMP_FORMAT})",
+            path.display()
+        );
+    }
+    Ok(v)
+}
+
+fn count(v: &Value, path: &[&str]) -> Option<u64> {
+    path.iter().try_fold(v, |v, k| v.get(k))?.as_u64()
+}
+
+fn percent(num: u64, den: u64) -> Option<f64> {
+    (den != 0).then(|| 100. * num as f64 / den as f64)
+}
+
+fn relative(base: u64, new: u64) -> f64 {
+    if base == 0 {
+        if new == 0 {
+            0.
+        } else {
+            f64::INFINITY
+        }
+    } else {
+        100. * (new as f64 - base as f64) / base as f64
+    }
+}
+
+pub fn diff(base: &Value, new: &Value, th: &Thresholds) -> Report {
+    let mut deltas = vec![];
+
+    // larger is worse
+    let mut compare_count = |what: String, b: u64, n: u64, threshold: f64, report_only: bool| {
+        let rel = relative(b, n);
+        let verdict = if rel > threshold {
+            if report_only {
+                Verdict::Changed
+            } else {
+                Verdict::Regression
+            }
+        } else if rel < -threshold {
+            if report_only {
+                Verdict::Changed
+            } else {
+                Verdict::Improvement
+            }
+        } else {
+            return;
+        };
+        deltas.push(Delta {
+            what,
+            base: b.to_string(),
+            new: n.to_string(),
+            change: format!("{rel:+.2}%"),
+            verdict,
+        });
+    };
+
+    // clocks (cycles if time prediction is disabled)
+    for key in ["clocks", "cycles"] {
+        if let (Some(b), Some(n)) = (count(base, &["sim", key]), count(new, &["sim", key])) {
+            compare_count(key.to_string(), b, n, th.clocks, false);
+            break;
+        }
+    }
+
+    // instruction mix
+    if let (Some(Value::Object(b)), Some(Value::Object(n))) = (base.get("instr"), new.get("instr"))
+    {
+        let total_b: u64 = b.values().filter_map(Value::as_u64).sum();
+        let total_n: u64 = n.values().filter_map(Value::as_u64).sum();
+        compare_count("instrs total".into(), total_b, total_n, th.instrs, false);
+        // ignore instructions too rare to matter
+        let floor = total_b / 1000;
+        for (name, cb) in b {
+            let cb = cb.as_u64().unwrap_or(0);
+            let cn = n.get(name).and_then(Value::as_u64).unwrap_or(0);
+            if cb.max(cn) > floor {
+                compare_count(format!("instr {name}"), cb, cn, th.instrs, true);
+            }
+        }
+    }
+
+    // code size (e.g. with the compressed encoding)
+    if let (Some(b), Some(n)) = (
+        count(base, &["icache", "text_bytes"]),
+        count(new, &["icache", "text_bytes"]),
+    ) {
+        compare_count("text bytes".into(), b, n, 0., true);
+    }
+
+    // smaller is worse
+    let mut compare_rate = |what: &str, b: Option<f64>, n: Option<f64>| {
+        let (Some(b), Some(n)) = (b, n) else {
+            return;
+        };
+        let d = n - b;
+        let verdict = if d < -th.rate {
+            Verdict::Regression
+        } else if d > th.rate {
+            Verdict::Improvement
+        } else {
+            return;
+        };
+        deltas.push(Delta {
+            what: what.to_string(),
+            base: format!("{b:.3}%"),
+            new: format!("{n:.3}%"),
+            change: format!("{d:+.3}pt"),
+            verdict,
+        });
+    };
+
+    let hit_rate = |v: &Value| {
+        let hit = count(v, &["cache", "hit_count"])?;
+        let miss = count(v, &["cache", "miss_count"])?;
+        percent(hit, hit + miss)
+    };
+    compare_rate("cache hit rate", hit_rate(base), hit_rate(new));
+
+    let icache_hit_rate = |v: &Value| {
+        let hit = count(v, &["icache", "hit_count"])?;
+        let miss = count(v, &["icache", "miss_count"])?;
+        percent(hit, hit + miss)
+    };
+    compare_rate(
+        "icache hit rate",
+        icache_hit_rate(base),
+        icache_hit_rate(new),
+    );
+
+    let accuracy = |v: &Value| {
+        let c = |k| count(v, &["branch", k]);
+        let tt = c("taken_pred_taken_count")?;
+        let tu = c("taken_pred_untaken_count")?;
+        let ut = c("untaken_pred_taken_count")?;
+        let uu = c("untaken_pred_untaken_count")?;
+        percent(tt + uu, tt + tu + ut + uu)
+    };
+    compare_rate("branch accuracy", accuracy(base), accuracy(new));
+
+    // memory region traffic
+    for dir in ["read", "write"] {
+        for region in ["data_section", "heap", "stack"] {
+            let path = ["memory", dir, region];
+            if let (Some(b), Some(n)) = (count(base, &path), count(new, &path)) {
+                let rel = relative(b, n);
+                let verdict = if rel > th.memory {
+                    Verdict::Regression
+                } else if rel < -th.memory {
+                    Verdict::Improvement
+                } else {
+                    continue;
+                };
+                deltas.push(Delta {
+                    what: format!("{dir} {region}"),
+                    base: b.to_string(),
+                    new: n.to_string(),
+                    change: format!("{rel:+.2}%"),
+                    verdict,
+                });
+            }
+        }
+    }
+
+    Report { deltas }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn dump(clocks: u64, hit: u64, miss: u64) -> Value {
+        serde_json::json!({
+            "format": STATS_DUMP_FORMAT,
+            "sim": { "clocks": clocks, "cycles": 100 },
+            "cache": { "hit_count": hit, "miss_count": miss },
+        })
+    }
+
+    #[test]
+    fn test_diff() {
+        let th = Thresholds {
+            clocks: 1.0,
+            instrs: 5.0,
+            rate: 0.5,
+            memory: 5.0,
+        };
+        assert!(!diff(&dump(1000, 90, 10), &dump(1005, 90, 10), &th).has_regression());
+        assert!(diff(&dump(1000, 90, 10), &dump(1030, 90, 10), &th).has_regression());
+        assert!(diff(&dump(1000, 90, 10), &dump(1000, 80, 20), &th).has_regression());
+        assert!(!diff(&dump(1030, 80, 20), &dump(1000, 90, 10), &th).has_regression());
+    }
+}
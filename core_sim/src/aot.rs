@@ -0,0 +1,547 @@
+//! ahead-of-time translation of program images to Rust source.
+//!
+//! [`translate`] emits a standalone program whose `run` executes the text
+//! as a `loop` over a `match` on the pc, an arm per basic block. Direct
+//! branches jump to the arm of their target; `jalr` jumps through the same
+//! `match`, so its targets must be block leaders: the instructions after a
+//! `jal`, the labels of the debug symbol and the words of the data section
+//! pointing into the text (tables of code addresses). Registers are locals
+//! and floating point operations call the same [`fpu`] as the simulator,
+//! so the output is bit for bit the one of `exe`.
+//!
+//! The translated program depends on this crate for the [`Machine`], the
+//! FPU and the [`Input`](crate::io::Input)/[`Output`](crate::io::Output)
+//! traits; build it e.g. as an example of `cli` in release mode.
+
+use std::{collections::BTreeSet, fmt::Write};
+
+use anyhow::{anyhow, bail, Result};
+
+pub use crate::fpu_wrapper::fpu;
+use crate::{
+    debug_symbol::DebugSymbol,
+    instr::{
+        AInstr, BInstr, DecodedInstr, EInstr, FInstr, HInstr, IInstr, IOInstr, Instr, JInstr,
+        KInstr, MiscInstr, RInstr, SInstr, VInstr, WInstr, XInstr, YInstr,
+    },
+    memory::RAM_BYTE_SIZE,
+    register::{FRegId, RegId},
+};
+
+pub const MEMORY_WORDS: usize = RAM_BYTE_SIZE >> 2;
+
+/// the registers and memory of a translated program, initialized as the
+/// simulator does.
+pub struct Machine {
+    pub x: [u32; 32],
+    pub f: [f32; 32],
+    pub mem: Vec<u32>,
+}
+
+impl Machine {
+    /// `image` is the data and text sections, loaded at address 0.
+    pub fn new(image: &[u32]) -> Self {
+        let mut mem = vec![0xCCCCCCCC; MEMORY_WORDS];
+        mem[..image.len()].copy_from_slice(image);
+        let mut x = [0; 32];
+        x[2] = MEMORY_WORDS as u32 - 1;
+        x[4] = image.len() as u32;
+        let mut f = [0.0; 32];
+        f[1] = 1.0;
+        Self { x, f, mem }
+    }
+    #[inline(always)]
+    pub fn load(&self, addr: u32, pc: u32) -> Result<u32> {
+        match self.mem.get(addr as usize) {
+            Some(&v) => Ok(v),
+            None => Err(out_of_bounds(addr, pc)),
+        }
+    }
+    #[inline(always)]
+    pub fn store(&mut self, addr: u32, val: u32, pc: u32) -> Result<()> {
+        match self.mem.get_mut(addr as usize) {
+            Some(v) => {
+                *v = val;
+                Ok(())
+            }
+            None => Err(out_of_bounds(addr, pc)),
+        }
+    }
+}
+
+#[cold]
+fn out_of_bounds(addr: u32, pc: u32) -> anyhow::Error {
+    anyhow!("memory access to {addr:#x} out of bounds at pc {pc:#010x}")
+}
+
+fn x(r: RegId) -> String {
+    if r.is_zero() {
+        "0u32".into()
+    } else {
+        format!("x{}", r.inner())
+    }
+}
+
+fn f(r: FRegId) -> String {
+    if r.is_zero() {
+        "0f32".into()
+    } else {
+        format!("f{}", r.inner())
+    }
+}
+
+/// `x0` and `f0` are discarded, but the value is still evaluated for the
+/// errors of loads and input.
+fn set(rd: String, val: String) -> String {
+    if rd.starts_with('0') {
+        format!("let _ = {val};")
+    } else {
+        format!("{rd} = {val};")
+    }
+}
+
+fn add_imm(base: String, imm: u32) -> String {
+    match imm as i32 {
+        0 => base,
+        i if i < 0 => format!("{base}.wrapping_sub({})", i.unsigned_abs()),
+        i => format!("{base}.wrapping_add({i})"),
+    }
+}
+
+/// writes the return address of `jal`/`jalr` unless `rd` is `x0`.
+fn link(rd: RegId, next: u32) -> String {
+    if rd.is_zero() {
+        String::new()
+    } else {
+        format!("x{} = {next:#010x}; ", rd.inner())
+    }
+}
+
+/// the statements of `instr` at `pc`, and whether control never reaches the
+/// next instruction.
+fn emit(instr: &DecodedInstr, pc: u32) -> Result<(String, bool)> {
+    use Instr::*;
+    let next = pc.wrapping_add(4);
+    let jump = |target: u32| format!("pc = {target:#010x}; continue;");
+    let branch = |cond: String, imm: u32| format!("if {cond} {{ {} }}", jump(pc.wrapping_add(imm)));
+    Ok(match *instr {
+        R {
+            instr,
+            rd,
+            rs1,
+            rs2,
+        } => {
+            use RInstr::*;
+            let (a, b) = (x(rs1), x(rs2));
+            let val = match instr {
+                Add => format!("{a}.wrapping_add({b})"),
+                Sub => format!("{a}.wrapping_sub({b})"),
+                Xor => format!("{a} ^ {b}"),
+                Or => format!("{a} | {b}"),
+                And => format!("{a} & {b}"),
+                Sll => format!("{a}.wrapping_shl({b})"),
+                // logical, as in the simulator
+                Sra => format!("{a}.wrapping_shr({b})"),
+                Slt => format!("u32::from(({a} as i32) < ({b} as i32))"),
+            };
+            (set(x(rd), val), false)
+        }
+        I {
+            instr: IInstr::Jalr,
+            rd,
+            rs1,
+            imm,
+        } => (
+            format!(
+                "let t = {}; {}pc = t; continue;",
+                add_imm(x(rs1), imm),
+                link(rd, next)
+            ),
+            true,
+        ),
+        I {
+            instr,
+            rd,
+            rs1,
+            imm,
+        } => {
+            use IInstr::*;
+            let a = x(rs1);
+            let val = match instr {
+                Addi => add_imm(a, imm),
+                Xori => format!("{a} ^ {imm:#x}"),
+                Ori => format!("{a} | {imm:#x}"),
+                Andi => format!("{a} & {imm:#x}"),
+                Slli => format!("{a} << {imm}"),
+                Slti => format!("u32::from(({a} as i32) < {})", imm as i32),
+                Lw => format!("m.load({}, {pc:#010x})?", add_imm(a, imm)),
+                Jalr => unreachable!(),
+            };
+            (set(x(rd), val), false)
+        }
+        S {
+            instr: SInstr::Sw,
+            rs1,
+            rs2,
+            imm,
+        } => (
+            format!(
+                "m.store({}, {}, {pc:#010x})?;",
+                add_imm(x(rs1), imm),
+                x(rs2)
+            ),
+            false,
+        ),
+        B {
+            instr,
+            rs1,
+            rs2,
+            imm,
+        } => {
+            use BInstr::*;
+            let (a, b) = (x(rs1), x(rs2));
+            let cond = match instr {
+                Beq => format!("{a} == {b}"),
+                Bne => format!("{a} != {b}"),
+                Blt => format!("({a} as i32) < ({b} as i32)"),
+                Bge => format!("({a} as i32) >= ({b} as i32)"),
+            };
+            (branch(cond, imm), false)
+        }
+        J {
+            instr: JInstr::Jal,
+            rd,
+            imm,
+        } => (
+            format!("{}{}", link(rd, next), jump(pc.wrapping_add(imm))),
+            true,
+        ),
+        IO(ref io) => {
+            use IOInstr::*;
+            let s = match *io {
+                Outb { rs } => format!("output.outb({} as u8)?;", x(rs)),
+                Inw { rd } => set(x(rd), "input.inw()?".into()),
+                Finw { rd } => set(f(rd), "input.finw()?".into()),
+                // no timing model runs natively
+                Csrr { rd, .. } => set(x(rd), "0".into()),
+            };
+            (s, false)
+        }
+        F(ref fi) => {
+            use FInstr::*;
+            match *fi {
+                E {
+                    instr,
+                    rd,
+                    rs1,
+                    rs2,
+                } => {
+                    use EInstr::*;
+                    let (a, b) = (f(rs1), f(rs2));
+                    let val = match instr {
+                        Fadd => format!("fpu::fadd({a}, {b})"),
+                        Fsub => format!("fpu::fsub({a}, {b})"),
+                        Fmul => format!("fpu::fmul({a}, {b})"),
+                        Fdiv => format!("fpu::fdiv({a}, {b})"),
+                        Fsgnj => format!("{a}.copysign({b})"),
+                        Fsgnjn => format!("{a}.copysign(-{b})"),
+                        Fsgnjx => format!("{a}.copysign({a}.signum() * {b}.signum())"),
+                    };
+                    (set(f(rd), val), false)
+                }
+                H { instr, rd, rs1 } => {
+                    use HInstr::*;
+                    let val = match instr {
+                        Fsqrt => "fsqrt",
+                        Fhalf => "fhalf",
+                        Ffloor => "ffloor",
+                    };
+                    (set(f(rd), format!("fpu::{val}({})", f(rs1))), false)
+                }
+                K {
+                    instr: KInstr::Flt,
+                    rd,
+                    rs1,
+                    rs2,
+                } => (
+                    set(x(rd), format!("u32::from({} < {})", f(rs1), f(rs2))),
+                    false,
+                ),
+                X {
+                    instr: XInstr::Fitof,
+                    rd,
+                    rs1,
+                } => (set(f(rd), format!("fpu::fcvtsw({} as i32)", x(rs1))), false),
+                Y { instr, rd, rs1 } => {
+                    use YInstr::*;
+                    let a = f(rs1);
+                    let val = match instr {
+                        Fiszero => format!("u32::from({a} == 0.0)"),
+                        Fispos => format!("u32::from({a} > 0.0)"),
+                        Fisneg => format!("u32::from({a} < 0.0)"),
+                        Fftoi => format!("fpu::fcvtws({a}) as u32"),
+                    };
+                    (set(x(rd), val), false)
+                }
+                W {
+                    instr,
+                    rs1,
+                    rs2,
+                    imm,
+                } => {
+                    let op = match instr {
+                        WInstr::Fblt => "<",
+                        WInstr::Fbge => ">=",
+                    };
+                    (branch(format!("{} {op} {}", f(rs1), f(rs2)), imm), false)
+                }
+                V { instr, rs1, imm } => {
+                    let op = match instr {
+                        VInstr::Fbeqz => "==",
+                        VInstr::Fbnez => "!=",
+                    };
+                    (branch(format!("{} {op} 0.0", f(rs1)), imm), false)
+                }
+                Flw { rd, rs1, imm } => (
+                    set(
+                        f(rd),
+                        format!(
+                            "f32::from_bits(m.load({}, {pc:#010x})?)",
+                            add_imm(x(rs1), imm)
+                        ),
+                    ),
+                    false,
+                ),
+                Fsw { rs2, rs1, imm } => (
+                    format!(
+                        "m.store({}, {}.to_bits(), {pc:#010x})?;",
+                        add_imm(x(rs1), imm),
+                        f(rs2)
+                    ),
+                    false,
+                ),
+                G { .. } => unreachable!(),
+            }
+        }
+        A {
+            instr: AInstr::Fence,
+            ..
+        } => (String::new(), false),
+        A {
+            instr,
+            rd,
+            rs1,
+            rs2,
+        } => (
+            format!(
+                "let a = {}; let old = m.load(a, {pc:#010x})?; \
+                 m.store(a, AInstr::{instr:?}.apply(old, {}), {pc:#010x})?; {}",
+                x(rs1),
+                x(rs2),
+                set(x(rd), "old".into())
+            ),
+            false,
+        ),
+        Misc(MiscInstr::End) => ("break;".into(), true),
+        _ => bail!("`{instr}` at {pc:#010x} cannot be translated"),
+    })
+}
+
+fn is_control(instr: &DecodedInstr) -> bool {
+    matches!(
+        instr,
+        Instr::B { .. }
+            | Instr::J { .. }
+            | Instr::I {
+                instr: IInstr::Jalr,
+                ..
+            }
+            | Instr::F(FInstr::W { .. } | FInstr::V { .. })
+    )
+}
+
+fn direct_target(instr: &DecodedInstr, pc: u32) -> Option<u32> {
+    match *instr {
+        Instr::B { imm, .. }
+        | Instr::J { imm, .. }
+        | Instr::F(FInstr::W { imm, .. } | FInstr::V { imm, .. }) => Some(pc.wrapping_add(imm)),
+        _ => None,
+    }
+}
+
+/// Rust source of a program executing the image `mem`. `name` goes into
+/// the header comment.
+pub fn translate(mem: &[u8], symbols: &DebugSymbol, name: &str) -> Result<String> {
+    let words: Vec<u32> = mem
+        .chunks(4)
+        .map(|c| {
+            let mut b = [0; 4];
+            b[..c.len()].copy_from_slice(c);
+            u32::from_le_bytes(b)
+        })
+        .collect();
+    let [data_len, text_len] = [0, 1].map(|i| words.get(i).copied().unwrap_or(0) as usize);
+    let image = words
+        .get(2..2 + data_len + text_len)
+        .ok_or_else(|| anyhow!("the program image is truncated"))?;
+    let text_begin = (data_len as u32) << 2;
+    let text = text_begin..text_begin + ((text_len as u32) << 2);
+    let decoded: Vec<_> = image[data_len..]
+        .iter()
+        .map(|&bin| DecodedInstr::decode_from(bin))
+        .collect();
+
+    let mut leaders = BTreeSet::from([text.start]);
+    for (i, instr) in decoded.iter().enumerate() {
+        let pc = text.start + (i as u32) * 4;
+        let Ok(instr) = instr else {
+            continue;
+        };
+        if is_control(instr) {
+            leaders.insert(pc + 4);
+        }
+        leaders.extend(direct_target(instr, pc));
+    }
+    let symbol_addrs = symbols.sorted.iter().chain(symbols.globals.values());
+    leaders.extend(symbol_addrs.map(|s| s.addr));
+    leaders.extend(image[..data_len].iter().copied());
+    leaders.retain(|pc| text.contains(pc) && pc % 4 == 0);
+
+    let mut s = String::new();
+    writeln!(s, "// translated from `{name}`; do not edit.")?;
+    writeln!(
+        s,
+        "#![allow(unused_imports, unused_mut, unused_variables, unused_assignments, unreachable_code, clippy::all)]"
+    )?;
+    writeln!(s)?;
+    writeln!(s, "use anyhow::{{bail, Result}};")?;
+    writeln!(
+        s,
+        "use core_sim::{{aot::{{fpu, Machine}}, instr::AInstr, io::{{BinaryInput, BinaryOutput, Input, Output}}}};"
+    )?;
+    writeln!(s)?;
+    writeln!(s, "static IMAGE: [u32; {}] = [", image.len())?;
+    for chunk in image.chunks(8) {
+        let row: Vec<_> = chunk.iter().map(|w| format!("{w:#010x}")).collect();
+        writeln!(s, "    {},", row.join(", "))?;
+    }
+    writeln!(s, "];")?;
+    writeln!(s)?;
+    let regs = |p: &str| {
+        let names: Vec<_> = (1..32).map(|i| format!("mut {p}{i}")).collect();
+        format!("[_, {}]", names.join(", "))
+    };
+    let reg_list = |p: &str, zero: &str| {
+        let names: Vec<_> = (1..32).map(|i| format!("{p}{i}")).collect();
+        format!("[{zero}, {}]", names.join(", "))
+    };
+    writeln!(
+        s,
+        "pub fn run<I: Input, O: Output>(m: &mut Machine, input: &mut I, output: &mut O) -> Result<()> {{"
+    )?;
+    writeln!(s, "    let {} = m.x;", regs("x"))?;
+    writeln!(s, "    let {} = m.f;", regs("f"))?;
+    writeln!(s, "    let mut pc: u32 = {:#010x};", text.start)?;
+    writeln!(s, "    loop {{")?;
+    writeln!(s, "        match pc {{")?;
+    let mut open = false;
+    let mut ended = false;
+    for (i, instr) in decoded.iter().enumerate() {
+        let pc = text.start + (i as u32) * 4;
+        if leaders.contains(&pc) {
+            if open {
+                if !ended {
+                    writeln!(s, "                pc = {pc:#010x};")?;
+                }
+                writeln!(s, "            }}")?;
+            }
+            writeln!(s, "            {pc:#010x} => {{")?;
+            open = true;
+            ended = false;
+        }
+        if !open || ended {
+            // unreachable: not a leader and after the end of a block
+            continue;
+        }
+        match instr {
+            Ok(instr) => {
+                let (code, end) = emit(instr, pc)?;
+                writeln!(s, "                // {instr}")?;
+                if !code.is_empty() {
+                    writeln!(s, "                {code}")?;
+                }
+                ended = end;
+            }
+            Err(_) => {
+                let bin = image[data_len + i];
+                writeln!(
+                    s,
+                    "                bail!(\"invalid instruction {bin:#010x} at pc {pc:#010x}\");"
+                )?;
+                ended = true;
+            }
+        }
+    }
+    if open {
+        if !ended {
+            writeln!(s, "                pc = {:#010x};", text.end)?;
+        }
+        writeln!(s, "            }}")?;
+    }
+    writeln!(
+        s,
+        "            _ => bail!(\"jump to {{pc:#010x}}, which is not a block leader; translate with --dbg\"),"
+    )?;
+    writeln!(s, "        }}")?;
+    writeln!(s, "    }}")?;
+    writeln!(s, "    m.x = {};", reg_list("x", "0"))?;
+    writeln!(s, "    m.f = {};", reg_list("f", "0.0"))?;
+    writeln!(s, "    Ok(())")?;
+    writeln!(s, "}}")?;
+    writeln!(s)?;
+    writeln!(
+        s,
+        "/// usage: <program> [stdin file]; the output goes to stdout."
+    )?;
+    writeln!(s, "fn main() -> Result<()> {{")?;
+    writeln!(s, "    let stdin = match std::env::args().nth(1) {{")?;
+    writeln!(s, "        Some(path) => std::fs::read(path)?,")?;
+    writeln!(s, "        None => vec![],")?;
+    writeln!(s, "    }};")?;
+    writeln!(s, "    let mut output = BinaryOutput::new();")?;
+    writeln!(
+        s,
+        "    run(&mut Machine::new(&IMAGE), &mut BinaryInput::new(stdin), &mut output)?;"
+    )?;
+    writeln!(
+        s,
+        "    std::io::Write::write_all(&mut std::io::stdout(), &output.into_inner())?;"
+    )?;
+    writeln!(s, "    Ok(())")?;
+    writeln!(s, "}}")?;
+    Ok(s)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::program_image;
+
+    #[test]
+    fn test_translate() {
+        // loop: addi a0, a0, -1 / bne a0, zero, loop / jal ra, f / end /
+        // f: jalr zero, 0(ra)
+        let text = [0xfff50513u32, 0xfe051ee3, 0x008000ef, 0, 0x00008067];
+        let mem = program_image(&[0xdeadbeef], &text);
+        let src = translate(&mem, &Default::default(), "t.bin").unwrap();
+        // the entry, the fall-through of the branch, the return address and
+        // the callee start blocks
+        for leader in [4, 12, 16, 20] {
+            assert!(src.contains(&format!("{leader:#010x} => {{")), "{leader}");
+        }
+        assert!(!src.contains("0x00000008 => {"));
+        assert!(src.contains("x10 = x10.wrapping_sub(1);"));
+        assert!(src.contains("if x10 != 0u32 { pc = 0x00000004; continue; }"));
+        assert!(src.contains("x1 = 0x00000010; pc = 0x00000014; continue;"));
+    }
+}
@@ -1,4 +1,6 @@
 pub const CACHE_NUM_LINES: usize = 16384usize;
+/// lines of the hypothetical instruction cache (4 KiB)
+pub const ICACHE_NUM_LINES: usize = 256usize;
 
 pub struct Cache<const NLINES: usize> {
     inner: Vec<u32>,
@@ -10,6 +12,12 @@ impl<const NLINES: usize> Cache<NLINES> {
             inner: vec![0; NLINES],
         }
     }
+    /// starts with every line invalid, so that the first accesses miss.
+    pub fn new_cold() -> Self {
+        Self {
+            inner: vec![u32::MAX; NLINES],
+        }
+    }
     pub fn access_cache(&mut self, addr: usize) -> bool {
         let line = (addr >> 2) % NLINES;
         let tag = (addr >> 2) / NLINES;
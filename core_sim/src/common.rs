@@ -20,6 +20,10 @@ impl Pc {
     pub fn incr(&mut self) {
         self.0 += 4;
     }
+    /// advances by `bytes`; 2 after a compressed instruction.
+    pub fn incr_by(&mut self, bytes: u32) {
+        self.0 += bytes;
+    }
     pub fn into_usize(self) -> usize {
         self.0 as usize
     }
@@ -159,8 +163,21 @@ pub struct SpyResult {
     pub target: SpyKind,
 }
 
+#[derive(Clone, Copy)]
 pub enum MemoryRegion {
     DataSection,
     Heap,
     Stack,
 }
+
+/// the program image of the data section `data` followed by the text
+/// section `text`, as read by the simulator.
+#[cfg(test)]
+pub(crate) fn program_image(data: &[u32], text: &[u32]) -> Vec<u8> {
+    [data.len() as u32, text.len() as u32]
+        .iter()
+        .chain(data)
+        .chain(text)
+        .flat_map(|w| w.to_le_bytes())
+        .collect()
+}
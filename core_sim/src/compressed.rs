@@ -0,0 +1,427 @@
+//! compressed 16-bit encoding of the common instructions (RVC-like).
+//!
+//! A halfword whose two low bits are not `11` is a compressed instruction.
+//! It expands to the 32-bit instruction it stands for, so that only the
+//! fetch stage knows about the format. The all-zero halfword is `end`.
+//!
+//! | quadrant | funct3 | instruction                                    |
+//! |----------|--------|------------------------------------------------|
+//! | 00       | 010    | `lw rd', uimm5(rs1')`                          |
+//! | 00       | 011    | `flw fd', uimm5(rs1')`                         |
+//! | 00       | 110    | `sw rs2', uimm5(rs1')`                         |
+//! | 00       | 111    | `fsw fs2', uimm5(rs1')`                        |
+//! | 01       | 000    | `addi rd, rd, imm6`                            |
+//! | 01       | 001    | `jal ra, off12`                                |
+//! | 01       | 010    | `addi rd, zero, imm6`                          |
+//! | 01       | 101    | `jal zero, off12`                              |
+//! | 01       | 110    | `beq rs1', zero, off9`                         |
+//! | 01       | 111    | `bne rs1', zero, off9`                         |
+//! | 10       | 000    | `slli rd, rd, uimm5`                           |
+//! | 10       | 010    | `lw rd, uimm6(sp)`                             |
+//! | 10       | 011    | `flw fd, uimm6(sp)`                            |
+//! | 10       | 100    | `add rd, zero, rs2` / `jalr zero, 0(rd)`       |
+//! |          |        | `add rd, rd, rs2` / `jalr ra, 0(rd)` (bit 12)  |
+//! | 10       | 110    | `sw rs2, uimm6(sp)`                            |
+//! | 10       | 111    | `fsw fs2, uimm6(sp)`                           |
+//!
+//! `rd'`, `rs1'` and `rs2'` are 3-bit fields naming x8-x15 (f8-f15).
+//! Memory offsets are in words, as in the 32-bit loads and stores; branch
+//! offsets are in bytes, as halfwords.
+
+use anyhow::{bail, Context, Result};
+
+use crate::instr::{
+    BInstr, DecodedInstr, FInstr, IInstr, Instr, JInstr, MiscInstr, RInstr, SInstr,
+};
+
+/// `c.nop` (`addi zero, zero, 0`), used to pad the text to whole words
+const C_NOP: u16 = 0b01;
+
+fn sext(v: u32, bits: u32) -> u32 {
+    (((v << (32 - bits)) as i32) >> (32 - bits)) as u32
+}
+
+fn r(opcode: u32, funct3: u32, funct7: u32, rd: u32, rs1: u32, rs2: u32) -> u32 {
+    funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode
+}
+
+fn i(opcode: u32, funct3: u32, rd: u32, rs1: u32, imm: u32) -> u32 {
+    (imm & 0xfff) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode
+}
+
+fn s(opcode: u32, funct3: u32, rs1: u32, rs2: u32, imm: u32) -> u32 {
+    (imm >> 5 & 0x7f) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (imm & 0x1f) << 7 | opcode
+}
+
+/// replaces the offset of a conditional branch.
+fn with_b_imm(bin: u32, imm: u32) -> u32 {
+    bin & 0x01fff07f
+        | (imm >> 12 & 1) << 31
+        | (imm >> 5 & 0x3f) << 25
+        | (imm >> 1 & 0xf) << 8
+        | (imm >> 11 & 1) << 7
+}
+
+/// replaces the offset of `jal`.
+fn with_j_imm(bin: u32, imm: u32) -> u32 {
+    bin & 0xfff
+        | (imm >> 20 & 1) << 31
+        | (imm >> 1 & 0x3ff) << 21
+        | (imm >> 11 & 1) << 20
+        | (imm >> 12 & 0xff) << 12
+}
+
+/// offset of a pc-relative instruction, and whether it is `jal`.
+fn pc_relative(instr: &DecodedInstr) -> Option<(u32, bool)> {
+    match *instr {
+        Instr::J { imm, .. } => Some((imm, true)),
+        Instr::B { imm, .. } | Instr::F(FInstr::W { imm, .. } | FInstr::V { imm, .. }) => {
+            Some((imm, false))
+        }
+        _ => None,
+    }
+}
+
+/// the 32-bit instruction `half` stands for.
+pub fn expand(half: u16) -> Option<u32> {
+    let h = half as u32;
+    if h == 0 {
+        return Some(0);
+    }
+    let f3 = h >> 13;
+    let rd = h >> 7 & 0x1f;
+    let rs2 = h >> 2 & 0x1f;
+    let rd_c = 8 + (h >> 2 & 7);
+    let rs1_c = 8 + (h >> 7 & 7);
+    let uimm5 = (h >> 10 & 7) << 2 | (h >> 5 & 3);
+    let uimm6 = (h >> 12 & 1) << 5 | rs2;
+    let imm6 = sext(uimm6, 6);
+    let off12 = sext((h >> 2 & 0x7ff) << 1, 12);
+    let off9 = sext(((h >> 12 & 1) << 7 | (h >> 10 & 3) << 5 | rs2) << 1, 9);
+    Some(match (h & 3, f3) {
+        (0b00, 0b010) => i(0b0000011, 2, rd_c, rs1_c, uimm5),
+        (0b00, 0b011) => i(0b0000111, 2, rd_c, rs1_c, uimm5),
+        (0b00, 0b110) => s(0b0100011, 2, rs1_c, rd_c, uimm5),
+        (0b00, 0b111) => s(0b0100111, 2, rs1_c, rd_c, uimm5),
+        (0b01, 0b000) => i(0b0010011, 0, rd, rd, imm6),
+        (0b01, 0b001) => with_j_imm(0b1101111 | 1 << 7, off12),
+        (0b01, 0b010) => i(0b0010011, 0, rd, 0, imm6),
+        (0b01, 0b101) => with_j_imm(0b1101111, off12),
+        (0b01, 0b110) => with_b_imm(r(0b1100011, 0, 0, 0, rs1_c, 0), off9),
+        (0b01, 0b111) => with_b_imm(r(0b1100011, 1, 0, 0, rs1_c, 0), off9),
+        (0b10, 0b000) if uimm6 < 32 => i(0b0010011, 1, rd, rd, uimm6),
+        (0b10, 0b010) => i(0b0000011, 2, rd, 2, uimm6),
+        (0b10, 0b011) => i(0b0000111, 2, rd, 2, uimm6),
+        (0b10, 0b100) => match (h >> 12 & 1, rs2) {
+            (0, 0) if rd != 0 => i(0b1100111, 0, 0, rd, 0),
+            (0, _) => r(0b0110011, 0, 0, rd, 0, rs2),
+            (_, 0) if rd != 0 => i(0b1100111, 0, 1, rd, 0),
+            (_, _) => r(0b0110011, 0, 0, rd, rd, rs2),
+        },
+        (0b10, 0b110) => s(0b0100011, 2, 2, rs2, h >> 7 & 0x3f),
+        (0b10, 0b111) => s(0b0100111, 2, 2, rs2, h >> 7 & 0x3f),
+        _ => return None,
+    })
+}
+
+fn fits(v: u32, bits: u32) -> bool {
+    sext(v, bits) == v
+}
+
+fn c_i(f3: u32, op: u32, rd: u32, imm: u32) -> u16 {
+    (f3 << 13 | (imm >> 5 & 1) << 12 | rd << 7 | (imm & 0x1f) << 2 | op) as u16
+}
+
+fn c_l(f3: u32, rd_c: u32, rs1_c: u32, uimm: u32) -> u16 {
+    (f3 << 13 | (uimm >> 2 & 7) << 10 | (rs1_c - 8) << 7 | (uimm & 3) << 5 | (rd_c - 8) << 2) as u16
+}
+
+fn c_ss(f3: u32, rs2: u32, uimm: u32) -> u16 {
+    (f3 << 13 | uimm << 7 | rs2 << 2 | 0b10) as u16
+}
+
+fn c_r(bit12: u32, rd: u32, rs2: u32) -> u16 {
+    (0b100 << 13 | bit12 << 12 | rd << 7 | rs2 << 2 | 0b10) as u16
+}
+
+/// the compressed form of `instr`, if any. `offset` is the byte offset a
+/// pc-relative instruction has at its new address.
+fn compress_instr(instr: &DecodedInstr, offset: Option<u32>) -> Option<u16> {
+    let compact = |r: usize| (8..16).contains(&r);
+    let load_store = |f3_c: u32, f3_sp: u32, r: usize, rs1: usize, imm: u32| {
+        if rs1 == 2 && imm < 64 {
+            Some(if f3_sp & 0b100 == 0 {
+                c_i(f3_sp, 0b10, r as u32, imm)
+            } else {
+                c_ss(f3_sp, r as u32, imm)
+            })
+        } else if compact(r) && compact(rs1) && imm < 32 {
+            Some(c_l(f3_c, r as u32, rs1 as u32, imm))
+        } else {
+            None
+        }
+    };
+    match *instr {
+        Instr::Misc(MiscInstr::End) => Some(0),
+        Instr::I {
+            instr,
+            rd,
+            rs1,
+            imm,
+        } => {
+            let (rd, rs1) = (rd.inner() as u32, rs1.inner() as u32);
+            match instr {
+                IInstr::Addi if rd == rs1 && fits(imm, 6) => Some(c_i(0b000, 0b01, rd, imm)),
+                IInstr::Addi if rs1 == 0 && fits(imm, 6) => Some(c_i(0b010, 0b01, rd, imm)),
+                IInstr::Slli if rd == rs1 && imm < 32 => Some(c_i(0b000, 0b10, rd, imm)),
+                IInstr::Lw => load_store(0b010, 0b010, rd as usize, rs1 as usize, imm),
+                IInstr::Jalr if imm == 0 && rs1 != 0 && rd < 2 => Some(c_r(rd, rs1, 0)),
+                _ => None,
+            }
+        }
+        Instr::S {
+            instr: SInstr::Sw,
+            rs1,
+            rs2,
+            imm,
+        } => load_store(0b110, 0b110, rs2.inner(), rs1.inner(), imm),
+        Instr::F(FInstr::Flw { rd, rs1, imm }) => {
+            load_store(0b011, 0b011, rd.inner(), rs1.inner(), imm)
+        }
+        Instr::F(FInstr::Fsw { rs2, rs1, imm }) => {
+            load_store(0b111, 0b111, rs2.inner(), rs1.inner(), imm)
+        }
+        Instr::R {
+            instr: RInstr::Add,
+            rd,
+            rs1,
+            rs2,
+        } => {
+            let (rd, rs1, rs2) = (rd.inner() as u32, rs1.inner() as u32, rs2.inner() as u32);
+            match (rs1, rs2) {
+                (0, 0) => None,
+                (0, _) => Some(c_r(0, rd, rs2)),
+                (_, 0) => Some(c_r(0, rd, rs1)),
+                _ if rd == rs1 => Some(c_r(1, rd, rs2)),
+                _ => None,
+            }
+        }
+        Instr::J {
+            instr: JInstr::Jal,
+            rd,
+            ..
+        } if rd.inner() < 2 => {
+            let off = offset?;
+            let f3 = if rd.inner() == 1 { 0b001 } else { 0b101 };
+            fits(off, 12).then(|| (f3 << 13 | (off >> 1 & 0x7ff) << 2 | 0b01) as u16)
+        }
+        Instr::B {
+            instr: instr @ (BInstr::Beq | BInstr::Bne),
+            rs1,
+            rs2,
+            ..
+        } if rs2.is_zero() && compact(rs1.inner()) => {
+            let off = offset?;
+            let f3 = if matches!(instr, BInstr::Beq) {
+                0b110
+            } else {
+                0b111
+            };
+            let o = off >> 1 & 0xff;
+            fits(off, 9).then(|| {
+                (f3 << 13
+                    | (o >> 7 & 1) << 12
+                    | (o >> 5 & 3) << 10
+                    | (rs1.inner() as u32 - 8) << 7
+                    | (o & 0x1f) << 2
+                    | 0b01) as u16
+            })
+        }
+        _ => None,
+    }
+}
+
+/// a program image whose text is rewritten with compressed instructions.
+pub struct Compressed {
+    pub image: Vec<u8>,
+    text_begin: u32,
+    /// new pc of each instruction of the original text, and of its end
+    new_pcs: Vec<u32>,
+    pub instrs: usize,
+    pub compressed_instrs: usize,
+    pub old_text_bytes: usize,
+    pub new_text_bytes: usize,
+}
+
+impl Compressed {
+    /// where the instruction at `old_pc` of the original image is now.
+    pub fn remap(&self, old_pc: u32) -> Option<u32> {
+        let i = old_pc.checked_sub(self.text_begin)?;
+        if i % 4 != 0 {
+            return None;
+        }
+        self.new_pcs.get(i as usize / 4).copied()
+    }
+}
+
+/// compresses every eligible instruction of the program image `mem` and
+/// re-encodes the offsets of branches and `jal`. Programs jumping through
+/// registers other than `ra` are rejected, as the code addresses they hold
+/// cannot be found to be relocated.
+pub fn compress(mem: &[u8]) -> Result<Compressed> {
+    let word = |i: usize| -> Result<u32> {
+        let b = mem
+            .get(i * 4..i * 4 + 4)
+            .context("the program image is truncated")?;
+        Ok(u32::from_le_bytes(b.try_into().unwrap()))
+    };
+    let (data_len, text_len) = (word(0)? as usize, word(1)? as usize);
+    let text_begin = (data_len as u32) << 2;
+    let bins = (0..text_len)
+        .map(|i| word(2 + data_len + i))
+        .collect::<Result<Vec<_>>>()?;
+    let instrs: Vec<_> = bins
+        .iter()
+        .map(|&bin| DecodedInstr::decode_from(bin).ok())
+        .collect();
+    // index of the target of each pc-relative instruction
+    let mut targets = vec![None; text_len];
+    for (i, instr) in instrs.iter().enumerate() {
+        let pc = text_begin + (i as u32) * 4;
+        let imm = match instr {
+            Some(Instr::I {
+                instr: IInstr::Jalr,
+                rd,
+                rs1,
+                imm,
+            }) if !(rd.is_zero() && rs1.inner() == 1 && *imm == 0) => {
+                bail!(
+                    "indirect jump at {pc:#010x}: code addresses in registers cannot be relocated"
+                )
+            }
+            Some(instr) => match pc_relative(instr) {
+                Some((imm, _)) => imm,
+                None => continue,
+            },
+            None => continue,
+        };
+        let target = pc.wrapping_add(imm).wrapping_sub(text_begin);
+        if target % 4 != 0 || target as usize / 4 >= text_len {
+            bail!("the branch at {pc:#010x} leaves the text");
+        }
+        targets[i] = Some(target as usize / 4);
+    }
+    // start from every candidate compressed and widen the branches whose
+    // offset does not fit until the layout settles
+    let mut short: Vec<bool> = instrs
+        .iter()
+        .enumerate()
+        .map(|(i, instr)| {
+            let offset = targets[i].map(|_| 0);
+            instr
+                .as_ref()
+                .is_some_and(|instr| compress_instr(instr, offset).is_some())
+        })
+        .collect();
+    let layout = |short: &[bool]| {
+        let mut pcs = Vec::with_capacity(short.len() + 1);
+        let mut pc = text_begin;
+        for &s in short {
+            pcs.push(pc);
+            pc += if s { 2 } else { 4 };
+        }
+        pcs.push(pc);
+        pcs
+    };
+    let new_pcs = loop {
+        let pcs = layout(&short);
+        let mut changed = false;
+        for i in 0..text_len {
+            if let (true, Some(t), Some(instr)) = (short[i], targets[i], &instrs[i]) {
+                if compress_instr(instr, Some(pcs[t].wrapping_sub(pcs[i]))).is_none() {
+                    short[i] = false;
+                    changed = true;
+                }
+            }
+        }
+        if !changed {
+            break pcs;
+        }
+    };
+    let mut text = Vec::with_capacity(text_len * 4);
+    for i in 0..text_len {
+        let offset = targets[i].map(|t| new_pcs[t].wrapping_sub(new_pcs[i]));
+        if short[i] {
+            let half = compress_instr(instrs[i].as_ref().unwrap(), offset).unwrap();
+            text.extend_from_slice(&half.to_le_bytes());
+            continue;
+        }
+        // offsets only shrink, so they still fit
+        let bin = match (instrs[i].as_ref().and_then(pc_relative), offset) {
+            (Some((_, true)), Some(off)) => with_j_imm(bins[i], off),
+            (Some((_, false)), Some(off)) => with_b_imm(bins[i], off),
+            _ => bins[i],
+        };
+        text.extend_from_slice(&bin.to_le_bytes());
+    }
+    if text.len() % 4 != 0 {
+        text.extend_from_slice(&C_NOP.to_le_bytes());
+    }
+    let mut image = Vec::with_capacity(8 + data_len * 4 + text.len());
+    image.extend_from_slice(&(data_len as u32).to_le_bytes());
+    image.extend_from_slice(&(text.len() as u32 / 4).to_le_bytes());
+    image.extend_from_slice(&mem[8..8 + data_len * 4]);
+    image.extend_from_slice(&text);
+    Ok(Compressed {
+        image,
+        text_begin,
+        new_pcs,
+        instrs: text_len,
+        compressed_instrs: short.iter().filter(|&&s| s).count(),
+        old_text_bytes: text_len * 4,
+        new_text_bytes: text.len(),
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::common::program_image;
+
+    #[test]
+    fn test_roundtrip() {
+        // addi a0, a0, -3 / lw s0, 5(sp) / sw s1, 3(s0) / add a0, a0, a1 /
+        // jalr zero, 0(ra) / slli t0, t0, 4
+        for bin in [
+            0xffd50513u32,
+            0x00512403,
+            0x009421a3,
+            0x00b50533,
+            0x00008067,
+            0x00429293,
+        ] {
+            let instr = DecodedInstr::decode_from(bin).unwrap();
+            let half = compress_instr(&instr, None).unwrap();
+            assert_eq!(expand(half), Some(bin), "{instr}");
+        }
+        // addi a0, a0, 100 does not fit
+        let instr = DecodedInstr::decode_from(0x06450513).unwrap();
+        assert!(compress_instr(&instr, None).is_none());
+    }
+
+    #[test]
+    fn test_compress() {
+        // loop: addi a0, a0, -1 / bne a0, zero, loop / end
+        let text = [0xfff50513u32, 0xfe051ee3, 0];
+        let c = compress(&program_image(&[0xdeadbeef], &text)).unwrap();
+        assert_eq!(c.compressed_instrs, 3);
+        assert_eq!(c.new_text_bytes, 8);
+        assert_eq!(c.remap(4 + 8), Some(4 + 4));
+        let half = |i: usize| u16::from_le_bytes([c.image[12 + i * 2], c.image[13 + i * 2]]);
+        assert_eq!(expand(half(0)), Some(text[0]));
+        // the branch goes back 2 bytes now
+        assert_eq!(expand(half(1)), Some(with_b_imm(text[1], (-2i32) as u32)));
+        assert_eq!(half(2), 0);
+        assert_eq!(half(3), C_NOP);
+    }
+}
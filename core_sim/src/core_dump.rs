@@ -0,0 +1,320 @@
+//! post-mortem core dump.
+//!
+//! A core file holds the registers, the pc, the pages of memory touched
+//! during the run (with their type tags), the last pcs executed and the
+//! call stack, so that a failed run can be inspected without re-running it.
+//!
+//! Layout (all integers little endian):
+//! `MAGIC`, u32 version, u64 program hash, u32 pc, u64 cycle, error
+//! message, int registers, float registers, recent pcs, call frames and
+//! pages, where every variable-length part is prefixed by its u32 count.
+//! A page is its index, its words, a type tag byte per word and a
+//! definedness bit per word packed into u64s.
+
+use std::io::{self, Read, Write};
+
+use anyhow::{bail, Result};
+
+use crate::{
+    common::Pc,
+    instr::FlowKind,
+    memory::{Page, PAGE_WORD_SIZE},
+    ty::Ty,
+};
+
+const MAGIC: &[u8; 8] = b"CSIMCORE";
+const VERSION: u32 = 2;
+/// number of pcs kept in the ring buffer
+pub const TRAIL_LEN: usize = 64;
+/// frames deeper than this are dropped from the bottom of the call stack
+const MAX_CALL_DEPTH: usize = 1 << 16;
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct CallFrame {
+    /// entry pc of the callee
+    pub target: u32,
+    /// pc of the call instruction
+    pub call_site: u32,
+}
+
+/// cheap record of the recent control flow: a ring buffer of pcs and a
+/// shadow call stack.
+pub struct Trail {
+    pcs: [u32; TRAIL_LEN],
+    next: usize,
+    len: usize,
+    calls: Vec<CallFrame>,
+}
+
+impl Default for Trail {
+    fn default() -> Self {
+        Self {
+            pcs: [0; TRAIL_LEN],
+            next: 0,
+            len: 0,
+            calls: vec![],
+        }
+    }
+}
+
+impl Trail {
+    /// records the pc of an instruction about to execute, so that the
+    /// faulting instruction is the newest entry.
+    #[inline]
+    pub fn fetched(&mut self, pc: Pc) {
+        self.pcs[self.next] = pc.into_inner();
+        self.next = (self.next + 1) % TRAIL_LEN;
+        self.len = (self.len + 1).min(TRAIL_LEN);
+    }
+    #[inline]
+    pub fn retired(&mut self, pc: Pc, flow: FlowKind, next_pc: Pc) {
+        match flow {
+            FlowKind::Call => {
+                if self.calls.len() == MAX_CALL_DEPTH {
+                    self.calls.remove(0);
+                }
+                self.calls.push(CallFrame {
+                    target: next_pc.into_inner(),
+                    call_site: pc.into_inner(),
+                });
+            }
+            FlowKind::Return => {
+                self.calls.pop();
+            }
+            _ => {}
+        }
+    }
+    /// recent pcs, oldest first.
+    pub fn recent_pcs(&self) -> Vec<u32> {
+        (0..self.len)
+            .map(|i| self.pcs[(self.next + TRAIL_LEN - self.len + i) % TRAIL_LEN])
+            .collect()
+    }
+    /// call stack, outermost first.
+    pub fn calls(&self) -> &[CallFrame] {
+        &self.calls
+    }
+    pub fn restore(&mut self, recent_pcs: &[u32], calls: &[CallFrame]) {
+        *self = Self::default();
+        for &pc in recent_pcs.iter().rev().take(TRAIL_LEN).rev() {
+            self.pcs[self.next] = pc;
+            self.next = (self.next + 1) % TRAIL_LEN;
+            self.len += 1;
+        }
+        self.calls = calls.to_vec();
+    }
+}
+
+/// 64-bit FNV-1a, used to check that a core file matches the program.
+pub fn program_hash(program: &[u8]) -> u64 {
+    program.iter().fold(0xcbf29ce484222325, |h, &b| {
+        (h ^ b as u64).wrapping_mul(0x100000001b3)
+    })
+}
+
+pub struct CoreDump {
+    pub program_hash: u64,
+    pub pc: u32,
+    pub cycle: u64,
+    pub error: String,
+    pub regs: Vec<u32>,
+    pub fregs: Vec<f32>,
+    pub recent_pcs: Vec<u32>,
+    pub calls: Vec<CallFrame>,
+    pub pages: Vec<Page>,
+}
+
+fn write_u32(w: &mut impl Write, v: u32) -> io::Result<()> {
+    w.write_all(&v.to_le_bytes())
+}
+
+fn read_u32(r: &mut (impl Read + ?Sized)) -> io::Result<u32> {
+    let mut b = [0; 4];
+    r.read_exact(&mut b)?;
+    Ok(u32::from_le_bytes(b))
+}
+
+fn read_u64(r: &mut (impl Read + ?Sized)) -> io::Result<u64> {
+    let mut b = [0; 8];
+    r.read_exact(&mut b)?;
+    Ok(u64::from_le_bytes(b))
+}
+
+fn read_vec<T>(r: &mut impl Read, mut f: impl FnMut(&mut dyn Read) -> Result<T>) -> Result<Vec<T>> {
+    let n = read_u32(r)?;
+    let mut v = Vec::with_capacity((n as usize).min(1 << 16));
+    for _ in 0..n {
+        v.push(f(r)?);
+    }
+    Ok(v)
+}
+
+impl CoreDump {
+    pub fn write_to(&self, w: &mut impl Write) -> io::Result<()> {
+        w.write_all(MAGIC)?;
+        write_u32(w, VERSION)?;
+        w.write_all(&self.program_hash.to_le_bytes())?;
+        write_u32(w, self.pc)?;
+        w.write_all(&self.cycle.to_le_bytes())?;
+        write_u32(w, self.error.len() as u32)?;
+        w.write_all(self.error.as_bytes())?;
+        write_u32(w, self.regs.len() as u32)?;
+        for &r in &self.regs {
+            write_u32(w, r)?;
+        }
+        write_u32(w, self.fregs.len() as u32)?;
+        for &r in &self.fregs {
+            write_u32(w, r.to_bits())?;
+        }
+        write_u32(w, self.recent_pcs.len() as u32)?;
+        for &pc in &self.recent_pcs {
+            write_u32(w, pc)?;
+        }
+        write_u32(w, self.calls.len() as u32)?;
+        for c in &self.calls {
+            write_u32(w, c.target)?;
+            write_u32(w, c.call_site)?;
+        }
+        write_u32(w, self.pages.len() as u32)?;
+        for p in &self.pages {
+            write_u32(w, p.index as u32)?;
+            write_u32(w, p.words.len() as u32)?;
+            for &word in &p.words {
+                write_u32(w, word)?;
+            }
+            let tys: Vec<u8> = p.tys.iter().map(|&t| t as u8).collect();
+            w.write_all(&tys)?;
+            for &d in &p.defined {
+                w.write_all(&d.to_le_bytes())?;
+            }
+        }
+        w.flush()
+    }
+    pub fn read_from(r: &mut impl Read) -> Result<Self> {
+        let mut magic = [0; 8];
+        r.read_exact(&mut magic)?;
+        if &magic != MAGIC {
+            bail!("not a core file");
+        }
+        let version = read_u32(r)?;
+        if version != VERSION {
+            bail!("unsupported core file version {version} (expected {VERSION})");
+        }
+        let program_hash = read_u64(r)?;
+        let pc = read_u32(r)?;
+        let cycle = read_u64(r)?;
+        let error = {
+            let bytes = read_vec(r, |r| {
+                let mut b = [0];
+                r.read_exact(&mut b)?;
+                Ok(b[0])
+            })?;
+            String::from_utf8_lossy(&bytes).into_owned()
+        };
+        let regs = read_vec(r, |r| Ok(read_u32(r)?))?;
+        let fregs = read_vec(r, |r| Ok(f32::from_bits(read_u32(r)?)))?;
+        let recent_pcs = read_vec(r, |r| Ok(read_u32(r)?))?;
+        let calls = read_vec(r, |r| {
+            Ok(CallFrame {
+                target: read_u32(r)?,
+                call_site: read_u32(r)?,
+            })
+        })?;
+        let pages = read_vec(r, |r| {
+            let index = read_u32(r)? as usize;
+            let len = read_u32(r)? as usize;
+            if len > PAGE_WORD_SIZE {
+                bail!("broken page of {len} words");
+            }
+            let words = (0..len)
+                .map(|_| read_u32(r))
+                .collect::<io::Result<Vec<_>>>()?;
+            let mut tys = vec![0; len];
+            r.read_exact(&mut tys)?;
+            let tys = tys
+                .into_iter()
+                .map(|t| Ty::try_from(t).map_err(|t| anyhow::anyhow!("invalid type tag {t}")))
+                .collect::<Result<_>>()?;
+            let defined = (0..len.div_ceil(64))
+                .map(|_| read_u64(r))
+                .collect::<io::Result<_>>()?;
+            Ok(Page {
+                index,
+                words,
+                tys,
+                defined,
+            })
+        })?;
+        Ok(Self {
+            program_hash,
+            pc,
+            cycle,
+            error,
+            regs,
+            fregs,
+            recent_pcs,
+            calls,
+            pages,
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_trail() {
+        let mut t = Trail::default();
+        for i in 0..(TRAIL_LEN as u32 + 3) {
+            let flow = if i == 5 {
+                FlowKind::Call
+            } else {
+                FlowKind::Other
+            };
+            t.fetched(Pc::new(i << 2));
+            t.retired(Pc::new(i << 2), flow, Pc::new(0x100));
+        }
+        let pcs = t.recent_pcs();
+        assert_eq!(pcs.len(), TRAIL_LEN);
+        assert_eq!(pcs[0], 3 << 2);
+        assert_eq!(
+            t.calls(),
+            &[CallFrame {
+                target: 0x100,
+                call_site: 5 << 2
+            }]
+        );
+        let mut u = Trail::default();
+        u.restore(&pcs, t.calls());
+        assert_eq!(u.recent_pcs(), pcs);
+    }
+
+    #[test]
+    fn test_roundtrip() {
+        let core = CoreDump {
+            program_hash: 42,
+            pc: 0x100,
+            cycle: 7,
+            error: "oops".into(),
+            regs: vec![1, 2, 3],
+            fregs: vec![1.5],
+            recent_pcs: vec![0xfc, 0x100],
+            calls: vec![],
+            pages: vec![Page {
+                index: 3,
+                words: vec![0xdeadbeef; PAGE_WORD_SIZE],
+                tys: vec![Ty::F32; PAGE_WORD_SIZE],
+                defined: vec![1; PAGE_WORD_SIZE / 64],
+            }],
+        };
+        let mut buf = vec![];
+        core.write_to(&mut buf).unwrap();
+        let read = CoreDump::read_from(&mut buf.as_slice()).unwrap();
+        assert_eq!(read.error, "oops");
+        assert_eq!(read.regs, core.regs);
+        assert_eq!(read.pages[0].index, 3);
+        assert_eq!(read.pages[0].tys[0], Ty::F32);
+        assert_eq!(read.pages[0].defined, core.pages[0].defined);
+    }
+}
@@ -0,0 +1,283 @@
+//! top-down CPI stack.
+//!
+//! Every clock predicted by the pipeline model is charged to exactly one
+//! [`CpiCategory`] and one pc, so the per-function stacks add up to the
+//! total clocks reported by the simulator.
+
+use std::{fmt, ops::Range};
+
+use crate::{common::Pc, cpu::ProducerClass, debug_symbol::DebugSymbol, interval::Event, stat::*};
+
+/// number of functions shown in the CPI stack (the rest is folded into `(others)`)
+const NUM_SHOWN_FUNCTIONS: usize = 20;
+
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum CpiCategory {
+    /// one issue slot per instruction
+    Base,
+    /// bubbles waiting for an integer result
+    StallAlu,
+    /// bubbles waiting for a loaded value
+    StallLoad,
+    /// bubbles waiting for an FPU result
+    StallFpu,
+    /// bubbles after a mispredicted branch or jalr
+    BranchFlush,
+    /// multi-cycle execution of FPU instructions
+    FpuLatency,
+    /// memory access latency on cache hit
+    CacheHit,
+    /// memory access latency on cache miss
+    DramMiss,
+    /// issue slots of I/O instructions
+    IoWait,
+}
+
+impl CpiCategory {
+    pub const COUNT: usize = std::mem::variant_count::<Self>();
+    pub const ALL: [Self; Self::COUNT] = [
+        Self::Base,
+        Self::StallAlu,
+        Self::StallLoad,
+        Self::StallFpu,
+        Self::BranchFlush,
+        Self::FpuLatency,
+        Self::CacheHit,
+        Self::DramMiss,
+        Self::IoWait,
+    ];
+    pub fn name(self) -> &'static str {
+        match self {
+            Self::Base => "base",
+            Self::StallAlu => "st.alu",
+            Self::StallLoad => "st.ld",
+            Self::StallFpu => "st.fpu",
+            Self::BranchFlush => "flush",
+            Self::FpuLatency => "fpu",
+            Self::CacheHit => "c.hit",
+            Self::DramMiss => "dram",
+            Self::IoWait => "io",
+        }
+    }
+}
+
+impl From<ProducerClass> for CpiCategory {
+    /// category of a stall caused by waiting for `p`
+    fn from(p: ProducerClass) -> Self {
+        match p {
+            ProducerClass::Alu => Self::StallAlu,
+            ProducerClass::Load => Self::StallLoad,
+            ProducerClass::Fpu => Self::StallFpu,
+        }
+    }
+}
+
+impl From<Event> for CpiCategory {
+    /// category charged for the penalty of `e` by the interval model
+    fn from(e: Event) -> Self {
+        match e {
+            Event::FpuLatency => Self::FpuLatency,
+            Event::CacheHit => Self::CacheHit,
+            Event::DramMiss => Self::DramMiss,
+            Event::Flush => Self::BranchFlush,
+            Event::LoadUse => Self::StallLoad,
+            Event::FpuUse => Self::StallFpu,
+        }
+    }
+}
+
+#[derive(Clone, Copy, Default)]
+pub struct CpiStack {
+    clocks: [usize; CpiCategory::COUNT],
+    instrs: usize,
+}
+
+impl CpiStack {
+    pub fn clocks(&self) -> usize {
+        self.clocks.iter().sum()
+    }
+    pub fn instrs(&self) -> usize {
+        self.instrs
+    }
+    pub fn get(&self, category: CpiCategory) -> usize {
+        self.clocks[category as usize]
+    }
+    fn merge(&mut self, other: &Self) {
+        for (a, b) in self.clocks.iter_mut().zip(other.clocks) {
+            *a += b;
+        }
+        self.instrs += other.instrs;
+    }
+    fn is_empty(&self) -> bool {
+        self.instrs == 0 && self.clocks() == 0
+    }
+    fn to_json(&self) -> serde_json::Value {
+        let mut map: serde_json::Map<_, _> = CpiCategory::ALL
+            .iter()
+            .map(|&c| (c.name().to_string(), self.get(c).into()))
+            .collect();
+        map.insert("instrs".into(), self.instrs.into());
+        map.into()
+    }
+}
+
+/// CPI stack of every instruction in the text section, indexed by pc.
+pub struct CpiTable {
+    text_begin: u32,
+    per_pc: Vec<CpiStack>,
+}
+
+impl CpiTable {
+    pub fn new(text: Range<u32>) -> Self {
+        Self {
+            text_begin: text.start,
+            per_pc: vec![CpiStack::default(); ((text.end - text.start) >> 2) as usize],
+        }
+    }
+    #[inline]
+    fn get_mut(&mut self, pc: Pc) -> Option<&mut CpiStack> {
+        let index = pc.into_inner().wrapping_sub(self.text_begin) >> 2;
+        self.per_pc.get_mut(index as usize)
+    }
+    #[inline]
+    pub fn charge(&mut self, pc: Pc, category: CpiCategory, clocks: usize) {
+        if let Some(s) = self.get_mut(pc) {
+            s.clocks[category as usize] += clocks;
+        }
+    }
+    #[inline]
+    pub fn retire(&mut self, pc: Pc) {
+        if let Some(s) = self.get_mut(pc) {
+            s.instrs += 1;
+        }
+    }
+    /// aggregate the table into functions.
+    pub fn by_function(&self, debug_symbol: &DebugSymbol) -> CpiStat {
+        let mut total = CpiStack::default();
+        let used = self
+            .per_pc
+            .iter()
+            .enumerate()
+            .filter(|(_, s)| !s.is_empty())
+            .map(|(i, s)| (self.text_begin + ((i as u32) << 2), s))
+            .inspect(|(_, s)| total.merge(s));
+        let mut functions = debug_symbol.fold_by_function(used, |f: &mut CpiStack, s| f.merge(s));
+        functions.sort_by_key(|(_, s)| std::cmp::Reverse(s.clocks()));
+        CpiStat { total, functions }
+    }
+}
+
+pub struct CpiStat {
+    total: CpiStack,
+    /// sorted by clocks in descending order
+    functions: Vec<(String, CpiStack)>,
+}
+
+impl Stat for CpiStat {
+    fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+        Box::new(self)
+    }
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        let functions: serde_json::Map<_, _> = self
+            .functions
+            .iter()
+            .map(|(label, s)| (label.clone(), s.to_json()))
+            .collect();
+        let mut map = serde_json::Map::new();
+        map.insert("total".into(), self.total.to_json());
+        map.insert("functions".into(), functions.into());
+        Some(("cpi", map.into()))
+    }
+    fn counters(&self) -> &'static [&'static str] {
+        &["total.*"]
+    }
+}
+
+impl StatView for &'_ CpiStat {
+    fn header(&self) -> &'static str {
+        "CPI stack by function (clocks per instruction)"
+    }
+    fn width(&self) -> usize {
+        2 + 24 + 12 + 12 + 7 + 2 + CpiCategory::COUNT * 7
+    }
+}
+
+impl fmt::Display for &'_ CpiStat {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        fn row(f: &mut fmt::Formatter<'_>, name: &str, s: &CpiStack) -> fmt::Result {
+            let instrs = s.instrs().max(1) as f64;
+            write!(
+                f,
+                "  {name:<24.24}{:>12}{:>12}{:>7.3} |",
+                s.instrs(),
+                s.clocks(),
+                s.clocks() as f64 / instrs
+            )?;
+            for c in CpiCategory::ALL {
+                write!(f, "{:>7.3}", s.get(c) as f64 / instrs)?;
+            }
+            writeln!(f)
+        }
+        write!(
+            f,
+            "  {:<24}{:>12}{:>12}{:>7} |",
+            "function", "instrs", "clocks", "CPI"
+        )?;
+        for c in CpiCategory::ALL {
+            write!(f, "{:>7}", c.name())?;
+        }
+        writeln!(f)?;
+        row(f, "(total)", &self.total)?;
+        if self.functions.is_empty() {
+            return writeln!(f, "  (debug symbol not provided)");
+        }
+        for (label, s) in self.functions.iter().take(NUM_SHOWN_FUNCTIONS) {
+            row(f, label, s)?;
+        }
+        if self.functions.len() > NUM_SHOWN_FUNCTIONS {
+            let mut others = CpiStack::default();
+            for (_, s) in &self.functions[NUM_SHOWN_FUNCTIONS..] {
+                others.merge(s);
+            }
+            row(f, "(others)", &others)?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{interval::TimingModel, sim::test_sim};
+
+    #[test]
+    fn test_clocks_add_up() {
+        // main: li x5, 100 / li x9, 500 / loop: lw x8, 0(x9) /
+        // add x8, x8, x5 / sw x8, 0(x9) / flw f1, 0(zero) / fadd f2, f1, f1 /
+        // fsw f2, 1(x9) / jal ra, f / addi x5, x5, -1 / bne x5, zero, loop /
+        // outb x8 / end / f: jalr zero, 0(ra)
+        let text = [
+            0x06400293, 0x1f400493, 0x0004a403, 0x00540433, 0x0084a023, 0x00002087, 0x00108153,
+            0x0024a0a7, 0x014000ef, 0xfff28293, 0xfe0290e3, 0x0004002b, 0, 0x00008067,
+        ];
+        let symbols = r#"{"globals": [], "labels": [
+            {"addr": 4, "label": "main"}, {"addr": 56, "label": "f"}]}"#;
+        for timing in [TimingModel::Detailed, TimingModel::Interval] {
+            let mut sim = test_sim(&[1.5f32.to_bits()], &text, &[]);
+            sim.provide_dbg_symb(DebugSymbol::deser(symbols.as_bytes()).unwrap());
+            sim.set_timing(timing);
+            sim.run_to_end();
+            let stat = sim.cpu().cpi.by_function(sim.debug_symbol());
+            assert_eq!(stat.total.clocks(), sim.elapsed_clocks(), "{timing:?}");
+            let functions: usize = stat.functions.iter().map(|(_, s)| s.clocks()).sum();
+            assert_eq!(functions, stat.total.clocks(), "{timing:?}");
+            for c in [
+                CpiCategory::StallLoad,
+                CpiCategory::BranchFlush,
+                CpiCategory::FpuLatency,
+            ] {
+                assert!(stat.total.get(c) > 0, "{timing:?} {c:?}");
+            }
+        }
+    }
+}
@@ -10,10 +10,12 @@ use thiserror::Error;
 
 use crate::{
     common::{Pc, SpyResult, SpyWatchKind},
+    core_dump::{CoreDump, Trail},
     fpu_wrapper::fpu,
+    fuse::{FusedKind, Fusions, Predecoded},
     instr::*,
     io::{Input, Output},
-    memory::{Addr, Memory, MemoryAccessError, SpyUnit, RAM_BYTE_SIZE},
+    memory::{Addr, Memory, MemoryAccessError, Page, SpyUnit, RAM_BYTE_SIZE},
     reg_file::{RegFile, RegFileView, ShowRegFileKind},
     register::{FRegId, RegId},
     ty::TypedU32,
@@ -21,17 +23,52 @@ use crate::{
 
 #[cfg(feature = "time_predict")]
 use crate::branch_predictor::{BranchPredictor, NUM_COUNTERS};
+#[cfg(all(feature = "stat", feature = "compressed"))]
+use crate::cache::ICACHE_NUM_LINES;
 #[cfg(feature = "stat")]
 use crate::cache::{Cache, CACHE_NUM_LINES};
+#[cfg(all(feature = "stat", feature = "time_predict"))]
+use crate::cpi::{CpiCategory, CpiTable};
+#[cfg(all(feature = "stat", feature = "time_predict"))]
+use crate::energy::{EnergyEvent, EnergyTable};
+#[cfg(feature = "stat")]
+use crate::fuse::FusionStat;
+#[cfg(feature = "coverage")]
+use crate::fuzz::Coverage;
+#[cfg(feature = "time_predict")]
+use crate::interval::{Event, IntervalModel, Penalties, Retired, TimingModel, EVENTS};
+#[cfg(feature = "stat")]
+use crate::loops::{LoopProfiler, LoopStack};
+#[cfg(feature = "stat")]
+use crate::memory::MemoryStat;
+#[cfg(feature = "time_predict")]
+use crate::multicore::Ddr2Bus;
+#[cfg(all(feature = "stat", feature = "time_predict"))]
+use crate::placement::PlacementProfile;
+#[cfg(feature = "stat")]
+use crate::redundancy::{Access, Redundancy};
+#[cfg(feature = "stat")]
+use crate::roi::{self, Regions};
+#[cfg(feature = "stat")]
+use crate::sampler::Sampler;
 #[cfg(feature = "stat")]
 use crate::stat::{AddStats, Stat, Stats};
+#[cfg(feature = "typed_memory")]
+use crate::type_elision;
+#[cfg(feature = "uninit_check")]
+use crate::uninit::UninitReads;
+#[cfg(feature = "simd")]
+use crate::{
+    register::VRegId,
+    simd::{self, Lanes, LANES, NUM_VREGS},
+};
 
 #[cfg(feature = "time_predict")]
-const DDR2_ACCESS_CYCLES: usize = 90;
+pub(crate) const DDR2_ACCESS_CYCLES: usize = 90;
 #[cfg(feature = "time_predict")]
-const BRAM_WORD_SIZE: usize = 16384;
+pub(crate) const BRAM_WORD_SIZE: usize = 16384;
 #[cfg(feature = "time_predict")]
-const STACK_WORD_SIZE: usize = 256;
+pub(crate) const STACK_WORD_SIZE: usize = 256;
 
 #[cfg(feature = "time_predict")]
 pub enum PipelineStage {
@@ -42,6 +79,15 @@ pub enum PipelineStage {
     WriteBack,
 }
 
+/// which kind of unit produces the result of an instruction
+#[cfg(feature = "time_predict")]
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum ProducerClass {
+    Alu,
+    Load,
+    Fpu,
+}
+
 #[cfg(feature = "time_predict")]
 pub struct PipelineStat {
     ex_cycles: usize,
@@ -49,6 +95,53 @@ pub struct PipelineStat {
     result_ready_stage: Option<PipelineStage>,
     write_back_id: Option<RegId>,
     float_write_back_id: Option<FRegId>,
+    #[cfg(feature = "simd")]
+    vector_write_back_id: Option<VRegId>,
+    producer: ProducerClass,
+    #[cfg(feature = "stat")]
+    pc: Pc,
+    /// category charged for the memory access latency beyond the first cycle
+    #[cfg(feature = "stat")]
+    ma_category: CpiCategory,
+}
+
+/// the result of the last instruction, which the next one may wait for in
+/// the interval model
+#[cfg(feature = "time_predict")]
+#[derive(Clone, Copy)]
+struct PendingResult {
+    write_back_id: Option<RegId>,
+    float_write_back_id: Option<FRegId>,
+    #[cfg(feature = "simd")]
+    vector_write_back_id: Option<VRegId>,
+    event: Event,
+    bubbles: usize,
+}
+
+#[cfg(feature = "time_predict")]
+impl PendingResult {
+    fn waited_by(&self, instr: &Instr<RegId, RegId, FRegId, FRegId>) -> bool {
+        let hazard = self
+            .write_back_id
+            .is_some_and(|id| regid_is_included_in_srcs(instr, &id))
+            || self
+                .float_write_back_id
+                .is_some_and(|id| fregid_is_included_in_srcs(instr, &id));
+        #[cfg(feature = "simd")]
+        let hazard = hazard
+            || self
+                .vector_write_back_id
+                .is_some_and(|id| vregid_is_included_in_srcs(instr, &id));
+        hazard
+    }
+}
+
+/// the counters of a core read by `csrr`, besides its clocks
+#[derive(Clone, Copy, Default)]
+pub(crate) struct Counters {
+    instret: u64,
+    cache_misses: u64,
+    mispredicts: u64,
 }
 
 pub struct InstrFetchOutput {
@@ -88,16 +181,71 @@ pub struct ExecuteOutput {
 }
 
 pub enum MemoryAccessInput {
-    I { addr: usize, val: u32 },
-    F { addr: usize, val: f32 },
-    IMem { id: RegId, addr: usize },
-    FMem { id: FRegId, addr: usize },
+    I {
+        addr: usize,
+        val: u32,
+    },
+    F {
+        addr: usize,
+        val: f32,
+    },
+    IMem {
+        id: RegId,
+        addr: usize,
+    },
+    FMem {
+        id: FRegId,
+        addr: usize,
+    },
+    /// loads into `id` and stores `op` of the loaded value and `val`
+    Amo {
+        id: RegId,
+        addr: usize,
+        op: AInstr,
+        val: u32,
+    },
+    /// `LANES` consecutive words from `addr`
+    #[cfg(feature = "simd")]
+    V {
+        addr: usize,
+        val: Lanes,
+    },
+    #[cfg(feature = "simd")]
+    VMem {
+        id: VRegId,
+        addr: usize,
+    },
+}
+
+impl MemoryAccessInput {
+    pub fn addr(&self) -> usize {
+        match *self {
+            Self::I { addr, .. }
+            | Self::F { addr, .. }
+            | Self::IMem { addr, .. }
+            | Self::FMem { addr, .. }
+            | Self::Amo { addr, .. } => addr,
+            #[cfg(feature = "simd")]
+            Self::V { addr, .. } | Self::VMem { addr, .. } => addr,
+        }
+    }
 }
 
 #[derive(Clone, Copy)]
 pub enum WriteBackInput {
-    I { id: RegId, val: u32 },
-    F { id: FRegId, val: f32 },
+    I {
+        id: RegId,
+        val: u32,
+    },
+    F {
+        id: FRegId,
+        val: f32,
+    },
+    #[cfg(feature = "simd")]
+    V {
+        id: VRegId,
+        val: Lanes,
+    },
 }
 
 #[derive(Default)]
@@ -113,9 +261,16 @@ pub struct MemoryAccessOutput {
 
 pub struct Cpu<I, O> {
     reg_file: RegFile,
+    #[cfg(feature = "simd")]
+    vreg_file: [Lanes; NUM_VREGS],
     memory: Memory<RAM_BYTE_SIZE>,
+    /// loads and stores by region, as told by the current registers
+    #[cfg(feature = "stat")]
+    mem_stat: MemoryStat,
     #[cfg(feature = "stat")]
     cache: Cache<CACHE_NUM_LINES>,
+    #[cfg(all(feature = "stat", feature = "compressed"))]
+    icache: Cache<ICACHE_NUM_LINES>,
     pc: Pc,
     input: I,
     output: O,
@@ -127,8 +282,88 @@ pub struct Cpu<I, O> {
     pub i_stat: stat::InstrStat,
     #[cfg(feature = "stat")]
     pub c_stat: stat::CacheStat,
+    #[cfg(all(feature = "stat", feature = "compressed"))]
+    pub ic_stat: stat::ICacheStat,
     #[cfg(feature = "stat")]
     pub b_stat: stat::BranchStat,
+    #[cfg(all(feature = "stat", feature = "time_predict"))]
+    pub cpi: CpiTable,
+    #[cfg(all(feature = "stat", feature = "time_predict"))]
+    pub energy: EnergyTable,
+    #[cfg(all(feature = "stat", feature = "time_predict"))]
+    pub placement: PlacementProfile,
+    #[cfg(feature = "stat")]
+    pub loops: LoopProfiler,
+    #[cfg(feature = "stat")]
+    pub f_stat: FusionStat,
+    #[cfg(feature = "stat")]
+    pub regions: Regions,
+    #[cfg(feature = "stat")]
+    pub sampler: Sampler,
+    #[cfg(feature = "stat")]
+    pub redundancy: Redundancy,
+    trail: Trail,
+    predecoded: Predecoded,
+    #[cfg(feature = "coverage")]
+    pub coverage: Coverage,
+    #[cfg(feature = "uninit_check")]
+    pub uninit: UninitReads,
+    /// index of the core running now; see [`CoreState`]
+    core_id: usize,
+    /// clocks spent by the running core
+    #[cfg(feature = "time_predict")]
+    clock: usize,
+    counters: Counters,
+    #[cfg(feature = "time_predict")]
+    ddr2: Ddr2Bus,
+    #[cfg(feature = "time_predict")]
+    pub interval: IntervalModel,
+    #[cfg(feature = "time_predict")]
+    pending: Option<PendingResult>,
+}
+
+/// the part of [`Cpu`] private to a core. Other cores are parked in this
+/// form and swapped in to run, sharing the memory, the I/O and the
+/// statistics.
+pub struct CoreState {
+    core_id: usize,
+    reg_file: RegFile,
+    #[cfg(feature = "simd")]
+    vreg_file: [Lanes; NUM_VREGS],
+    pc: Pc,
+    #[cfg(feature = "stat")]
+    cache: Cache<CACHE_NUM_LINES>,
+    #[cfg(all(feature = "stat", feature = "compressed"))]
+    icache: Cache<ICACHE_NUM_LINES>,
+    #[cfg(feature = "time_predict")]
+    branch_predictor: BranchPredictor<NUM_COUNTERS>,
+    #[cfg(feature = "time_predict")]
+    pipeline_state: VecDeque<Option<PipelineStat>>,
+    trail: Trail,
+    #[cfg(feature = "stat")]
+    loops: LoopStack,
+    #[cfg(feature = "time_predict")]
+    clock: usize,
+    counters: Counters,
+    #[cfg(feature = "time_predict")]
+    pending: Option<PendingResult>,
+}
+
+impl CoreState {
+    #[cfg(feature = "time_predict")]
+    pub fn clock(&self) -> usize {
+        self.clock
+    }
+}
+
+pub struct CpuSnapshot {
+    regs: Vec<u32>,
+    fregs: Vec<f32>,
+    pc: Pc,
+    pages: Vec<Page>,
+    #[cfg(feature = "time_predict")]
+    clock: usize,
+    counters: Counters,
 }
 
 pub struct CpuOutput<O> {
@@ -178,6 +413,158 @@ impl From<nom::Err<nom::error::Error<&str>>> for InputError {
 
 type Result<T, E = RuntimeError> = std::result::Result<T, E>;
 
+#[cfg(feature = "time_predict")]
+fn regid_is_included_in_srcs(instr: &Instr<RegId, RegId, FRegId, FRegId>, regid: &RegId) -> bool {
+    match instr {
+        Instr::R {
+            instr: _,
+            rd: _,
+            rs1,
+            rs2,
+        } => rs1 == regid || rs2 == regid,
+        Instr::I {
+            instr: _,
+            rd: _,
+            rs1,
+            imm: _,
+        } => rs1 == regid,
+        Instr::S {
+            instr: _,
+            rs1,
+            rs2,
+            imm: _,
+        } => rs1 == regid || rs2 == regid,
+        Instr::B {
+            instr: _,
+            rs1,
+            rs2,
+            imm: _,
+        } => rs1 == regid || rs2 == regid,
+        Instr::P {
+            instr: _,
+            rs1,
+            imm: _,
+            imm2: _,
+        } => rs1 == regid,
+        Instr::J {
+            instr: _,
+            rd: _,
+            imm: _,
+        } => false,
+        Instr::IO(ioinstr) => match ioinstr {
+            IOInstr::Outb { rs } => rs == regid,
+            IOInstr::Inw { rd: _ } => false,
+            IOInstr::Finw { rd: _ } => false,
+            IOInstr::Csrr { rd: _, csr: _ } => false,
+        },
+        Instr::F(finstr) => match finstr {
+            FInstr::X {
+                instr: _,
+                rd: _,
+                rs1,
+            } => rs1 == regid,
+            FInstr::Flw { rd: _, rs1, imm: _ } => rs1 == regid,
+            FInstr::Fsw {
+                rs2: _,
+                rs1,
+                imm: _,
+            } => rs1 == regid,
+            _ => false,
+        },
+        Instr::A {
+            instr: _,
+            rd: _,
+            rs1,
+            rs2,
+        } => rs1 == regid || rs2 == regid,
+        #[cfg(feature = "simd")]
+        Instr::Q(QInstr::Vlw { rs1, .. } | QInstr::Vsw { rs1, .. }) => rs1 == regid,
+        #[cfg(feature = "simd")]
+        Instr::Q(_) => false,
+        Instr::Misc(_) => false,
+    }
+}
+
+#[cfg(feature = "time_predict")]
+fn fregid_is_included_in_srcs(
+    instr: &Instr<RegId, RegId, FRegId, FRegId>,
+    fregid: &FRegId,
+) -> bool {
+    match instr {
+        Instr::F(finstr) => match finstr {
+            FInstr::E {
+                instr: _,
+                rd: _,
+                rs1,
+                rs2,
+            } => rs1 == fregid || rs2 == fregid,
+            FInstr::G {
+                instr: _,
+                rd: _,
+                rs1,
+                rs2,
+                rs3,
+            } => rs1 == fregid || rs2 == fregid || rs3 == fregid,
+            FInstr::H {
+                instr: _,
+                rd: _,
+                rs1,
+            } => rs1 == fregid,
+            FInstr::K {
+                instr: _,
+                rd: _,
+                rs1,
+                rs2,
+            } => rs1 == fregid || rs2 == fregid,
+            FInstr::X {
+                instr: _,
+                rd: _,
+                rs1: _,
+            } => false,
+            FInstr::Y {
+                instr: _,
+                rd: _,
+                rs1,
+            } => rs1 == fregid,
+            FInstr::W {
+                instr: _,
+                rs1,
+                rs2,
+                imm: _,
+            } => rs1 == fregid || rs2 == fregid,
+            FInstr::V {
+                instr: _,
+                rs1,
+                imm: _,
+            } => rs1 == fregid,
+            FInstr::Flw {
+                rd: _,
+                rs1: _,
+                imm: _,
+            } => false,
+            FInstr::Fsw {
+                rs2,
+                rs1: _,
+                imm: _,
+            } => rs2 == fregid,
+        },
+        #[cfg(feature = "simd")]
+        Instr::Q(QInstr::Vsplat { rs1, .. }) => rs1 == fregid,
+        _ => false,
+    }
+}
+
+#[cfg(all(feature = "time_predict", feature = "simd"))]
+fn vregid_is_included_in_srcs(
+    instr: &Instr<RegId, RegId, FRegId, FRegId>,
+    vregid: &VRegId,
+) -> bool {
+    match instr {
+        Instr::Q(q) => q.vsrcs().any(|vs| &vs == vregid),
+        _ => false,
+    }
+}
+
 impl<I: Input, O: Output> Cpu<I, O> {
     pub fn new(mem: &[u8], input: I, output: O) -> Result<Self, InputError> {
         let (data_len, text_len) = Cpu::<I, O>::get_data_and_text_len(mem);
@@ -189,10 +576,16 @@ impl<I: Input, O: Output> Cpu<I, O> {
         reg_file.set_f(FRegId::try_from(1).unwrap(), 1.0);
         reg_file.end_init();
         let mut s = Self {
-            memory: Memory::<RAM_BYTE_SIZE>::new(reg_file.mem_region()),
+            memory: Memory::<RAM_BYTE_SIZE>::new(),
+            #[cfg(feature = "stat")]
+            mem_stat: Default::default(),
             #[cfg(feature = "stat")]
             cache: Cache::<CACHE_NUM_LINES>::new(),
+            #[cfg(all(feature = "stat", feature = "compressed"))]
+            icache: Cache::<ICACHE_NUM_LINES>::new_cold(),
             reg_file,
+            #[cfg(feature = "simd")]
+            vreg_file: [[0.0; LANES]; NUM_VREGS],
             pc: Pc::new(data_len << 2),
             input,
             output,
@@ -204,12 +597,58 @@ impl<I: Input, O: Output> Cpu<I, O> {
             b_stat: Default::default(),
             #[cfg(feature = "stat")]
             c_stat: Default::default(),
+            #[cfg(all(feature = "stat", feature = "compressed"))]
+            ic_stat: stat::ICacheStat::new(text_len << 2),
             #[cfg(feature = "time_predict")]
             pipeline_state: VecDeque::from([None, None, None, None, None]),
+            #[cfg(all(feature = "stat", feature = "time_predict"))]
+            cpi: CpiTable::new((data_len << 2)..((data_len + text_len) << 2)),
+            #[cfg(all(feature = "stat", feature = "time_predict"))]
+            energy: EnergyTable::new((data_len << 2)..((data_len + text_len) << 2)),
+            #[cfg(all(feature = "stat", feature = "time_predict"))]
+            placement: PlacementProfile::new(data_len, text_len),
+            #[cfg(feature = "stat")]
+            loops: LoopProfiler::new((data_len << 2)..((data_len + text_len) << 2)),
+            #[cfg(feature = "stat")]
+            f_stat: FusionStat::new(Fusions::builtin()),
+            #[cfg(feature = "stat")]
+            regions: Default::default(),
+            #[cfg(feature = "stat")]
+            sampler: Default::default(),
+            #[cfg(feature = "stat")]
+            redundancy: Default::default(),
+            trail: Trail::default(),
+            predecoded: Default::default(),
+            #[cfg(feature = "coverage")]
+            coverage: Coverage::new(),
+            #[cfg(feature = "uninit_check")]
+            uninit: Default::default(),
+            core_id: 0,
+            #[cfg(feature = "time_predict")]
+            clock: 0,
+            counters: Default::default(),
+            #[cfg(feature = "time_predict")]
+            ddr2: Ddr2Bus::new(1),
+            #[cfg(feature = "time_predict")]
+            interval: Default::default(),
+            #[cfg(feature = "time_predict")]
+            pending: None,
         };
         let text_begin = data_len << 2;
         let text_end = text_begin + (text_len << 2);
         s.init_memory(&mem[8..], text_begin..text_end);
+        s.predecoded = Predecoded::new(&s.memory, text_begin..text_end);
+        s.set_fusions(Fusions::builtin());
+        #[cfg(feature = "typed_memory")]
+        {
+            let data: Vec<u32> = mem[8..]
+                .chunks_exact(4)
+                .take(data_len as usize)
+                .map(|w| u32::from_le_bytes([w[0], w[1], w[2], w[3]]))
+                .collect();
+            let (proven, loads) = type_elision::prove(&mut s.predecoded, &data, text_begin);
+            log::info!("type checks: {proven} of {loads} loads proven statically");
+        }
         Ok(s)
     }
     pub fn get_data_and_text_len(mem: &[u8]) -> (u32, u32) {
@@ -233,18 +672,33 @@ impl<I: Input, O: Output> Cpu<I, O> {
 #[cfg(feature = "stat")]
 impl<I, O> AddStats for Cpu<I, O> {
     fn add_stats(&self, buf: &mut Stats) {
-        self.memory.add_stats(buf);
+        buf.push(Box::new(self.mem_stat));
         self.reg_file.add_stats(buf);
         buf.push(Box::new(self.i_stat));
         buf.push(Box::new(self.b_stat));
         buf.push(Box::new(self.c_stat));
+        #[cfg(feature = "compressed")]
+        buf.push(Box::new(self.ic_stat));
+        buf.push(Box::new(self.f_stat));
+        #[cfg(feature = "time_predict")]
+        if self.interval.is_active() {
+            buf.push(Box::new(self.interval));
+        }
+        if !self.regions.is_empty() {
+            buf.push(Box::new(self.regions.report(&self.roi_counts())));
+        }
     }
 }
 
+#[cfg(feature = "stat")]
+pub use stat::{BranchStat, CacheStat, InstrStat};
+
 #[cfg(feature = "stat")]
 mod stat {
     use std::fmt;
 
+    use serde::Serialize;
+
     use super::*;
     use crate::{instr::InstrId, stat::*};
 
@@ -260,6 +714,18 @@ mod stat {
         fn view(&self, max_width: usize) -> Box<dyn StatView + '_> {
             Box::new(InstrStatView::new(self, max_width))
         }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            let map: serde_json::Map<_, _> = (0..MAX_INSTR_ID)
+                .filter_map(|index| {
+                    let id = InstrId::try_from(index as u8).ok()?;
+                    Some((id.to_string(), self.instr_executed[index].into()))
+                })
+                .collect();
+            Some(("instr", map.into()))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["*"]
+        }
     }
 
     pub struct InstrStatView<'a> {
@@ -326,6 +792,23 @@ mod stat {
         pub fn encounter_instr(&mut self, d: &DecodedInstr) {
             self.instr_executed[d.id().inner() as usize] += 1;
         }
+        /// executed counts indexed by [`InstrId`].
+        pub fn counts(&self) -> &[usize] {
+            &self.instr_executed
+        }
+        /// the counts added after `earlier`
+        pub fn since(&self, earlier: &Self) -> Self {
+            let mut d = *self;
+            for (d, e) in d.instr_executed.iter_mut().zip(&earlier.instr_executed) {
+                *d -= e;
+            }
+            d
+        }
+        pub fn add(&mut self, other: &Self) {
+            for (c, o) in self.instr_executed.iter_mut().zip(&other.instr_executed) {
+                *c += o;
+            }
+        }
     }
 
     impl Default for InstrStat {
@@ -334,7 +817,7 @@ mod stat {
         }
     }
 
-    #[derive(Clone, Copy, Default)]
+    #[derive(Clone, Copy, Default, Serialize)]
     pub struct BranchStat {
         taken_pred_taken_count: usize,
         taken_pred_untaken_count: usize,
@@ -343,6 +826,39 @@ mod stat {
     }
 
     impl BranchStat {
+        fn zip_with(&self, other: &Self, f: impl Fn(usize, usize) -> usize) -> Self {
+            Self {
+                taken_pred_taken_count: f(
+                    self.taken_pred_taken_count,
+                    other.taken_pred_taken_count,
+                ),
+                taken_pred_untaken_count: f(
+                    self.taken_pred_untaken_count,
+                    other.taken_pred_untaken_count,
+                ),
+                untaken_pred_taken_count: f(
+                    self.untaken_pred_taken_count,
+                    other.untaken_pred_taken_count,
+                ),
+                untaken_pred_untaken_count: f(
+                    self.untaken_pred_untaken_count,
+                    other.untaken_pred_untaken_count,
+                ),
+            }
+        }
+        /// the counts added after `earlier`
+        pub fn since(&self, earlier: &Self) -> Self {
+            self.zip_with(earlier, |a, b| a - b)
+        }
+        pub fn add(&mut self, other: &Self) {
+            *self = self.zip_with(other, |a, b| a + b);
+        }
+        /// rate of correct predictions (%)
+        pub fn accuracy(&self) -> f64 {
+            let correct = self.taken_pred_taken_count + self.untaken_pred_untaken_count;
+            let total = correct + self.taken_pred_untaken_count + self.untaken_pred_taken_count;
+            100. * correct as f64 / total as f64
+        }
         pub fn update_stat(&mut self, predicted: bool, actual: bool) {
             if predicted {
                 if actual {
@@ -362,6 +878,12 @@ mod stat {
         fn view(&self, _: usize) -> Box<dyn StatView + '_> {
             Box::new(BranchStatView::new(self))
         }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            Some(("branch", serde_json::to_value(self).ok()?))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["*"]
+        }
     }
 
     pub struct BranchStatView<'a> {
@@ -402,13 +924,28 @@ mod stat {
         }
     }
 
-    #[derive(Default, Clone, Copy)]
+    #[derive(Default, Clone, Copy, Serialize)]
     pub struct CacheStat {
         hit_count: usize,
         miss_count: usize,
     }
 
     impl CacheStat {
+        /// the counts added after `earlier`
+        pub fn since(&self, earlier: &Self) -> Self {
+            Self {
+                hit_count: self.hit_count - earlier.hit_count,
+                miss_count: self.miss_count - earlier.miss_count,
+            }
+        }
+        pub fn add(&mut self, other: &Self) {
+            self.hit_count += other.hit_count;
+            self.miss_count += other.miss_count;
+        }
+        /// rate of hits (%)
+        pub fn hit_rate(&self) -> f64 {
+            100. * self.hit_count as f64 / (self.hit_count + self.miss_count) as f64
+        }
         pub fn update_stat(&mut self, result: bool) {
             if result {
                 self.hit_count += 1;
@@ -422,6 +959,12 @@ mod stat {
         fn view(&self, _: usize) -> Box<dyn StatView + '_> {
             Box::new(CacheStatView::new(self))
         }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            Some(("cache", serde_json::to_value(self).ok()?))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["*"]
+        }
     }
 
     pub struct CacheStatView<'a> {
@@ -454,6 +997,87 @@ mod stat {
             writeln!(f, "     miss: {miss:>10} ({miss_pct:>8}%)")
         }
     }
+
+    /// what-if instruction cache: the board fetches from BRAM, so misses
+    /// are counted but not charged to the elapsed clocks.
+    #[cfg(feature = "compressed")]
+    #[derive(Default, Clone, Copy, Serialize)]
+    pub struct ICacheStat {
+        text_bytes: usize,
+        hit_count: usize,
+        miss_count: usize,
+        /// clocks the misses would cost if the text were fetched from DDR2
+        #[cfg(feature = "time_predict")]
+        miss_clocks: usize,
+    }
+
+    #[cfg(feature = "compressed")]
+    impl ICacheStat {
+        pub fn new(text_bytes: u32) -> Self {
+            Self {
+                text_bytes: text_bytes as usize,
+                ..Default::default()
+            }
+        }
+        pub fn update_stat(&mut self, result: bool) {
+            if result {
+                self.hit_count += 1;
+            } else {
+                self.miss_count += 1;
+                #[cfg(feature = "time_predict")]
+                {
+                    self.miss_clocks += DDR2_ACCESS_CYCLES;
+                }
+            }
+        }
+    }
+
+    #[cfg(feature = "compressed")]
+    impl Stat for ICacheStat {
+        fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+            Box::new(ICacheStatView { stat: self })
+        }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            Some(("icache", serde_json::to_value(self).ok()?))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["hit_count", "miss_count", "miss_clocks"]
+        }
+    }
+
+    #[cfg(feature = "compressed")]
+    pub struct ICacheStatView<'a> {
+        stat: &'a ICacheStat,
+    }
+
+    #[cfg(feature = "compressed")]
+    impl StatView for ICacheStatView<'_> {
+        fn header(&self) -> &'static str {
+            "icache stat"
+        }
+        fn width(&self) -> usize {
+            33
+        }
+    }
+
+    #[cfg(feature = "compressed")]
+    impl fmt::Display for ICacheStatView<'_> {
+        fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+            writeln!(f, "     text: {:>10} bytes", self.stat.text_bytes)?;
+            CacheStatView::new(&CacheStat {
+                hit_count: self.stat.hit_count,
+                miss_count: self.stat.miss_count,
+            })
+            .fmt(f)?;
+            #[cfg(feature = "time_predict")]
+            writeln!(
+                f,
+                "   clocks: {:>10} (if missed to DDR2)",
+                self.stat.miss_clocks
+            )?;
+            Ok(())
+        }
+    }
 }
 
 impl<I: Input, O: Output> Cpu<I, O> {
@@ -469,7 +1093,28 @@ impl<I: Input, O: Output> Cpu<I, O> {
     fn instr_fetch(&mut self) -> Result<InstrFetchOutput> {
         let old_pc = self.pc;
         let bin = self.memory.get_from_pc(old_pc)?;
+        #[cfg(feature = "compressed")]
+        let bin = if bin & 0b11 != 0b11 {
+            self.pc.incr_by(2);
+            // an invalid halfword is left to fail in decoding
+            crate::compressed::expand(bin as u16).unwrap_or(bin & 0xffff)
+        } else {
+            self.pc.incr();
+            bin
+        };
+        #[cfg(not(feature = "compressed"))]
         self.pc.incr();
+        // what-if cache to weigh the compressed encoding
+        #[cfg(all(feature = "stat", feature = "compressed"))]
+        {
+            // 16-byte lines; an instruction may straddle two
+            let first = old_pc.into_usize() >> 2;
+            let last = (self.pc.into_usize() - 1) >> 2;
+            self.ic_stat.update_stat(self.icache.access_cache(first));
+            if last >> 2 != first >> 2 {
+                self.ic_stat.update_stat(self.icache.access_cache(last));
+            }
+        }
         let pc_plus4 = self.pc;
         Ok(InstrFetchOutput {
             id_in: InstrDecodeInput { bin },
@@ -477,11 +1122,28 @@ impl<I: Input, O: Output> Cpu<I, O> {
             pc_plus4,
         })
     }
+    /// the fetched instruction from the predecoded text, unless rewritten
+    /// since loaded, and the kind of the pair to fuse it heads.
+    #[inline]
+    fn predecoded(
+        &mut self,
+        fetched: &InstrFetchOutput,
+    ) -> Option<(Instr<RegId, RegId, FRegId, FRegId>, Option<FusedKind>)> {
+        let slot = self.predecoded.get(fetched.old_pc, fetched.id_in.bin)?;
+        #[cfg(feature = "stat")]
+        if let Some(k) = slot.pair {
+            self.f_stat.encounter(k);
+        }
+        Some((slot.instr.clone(), slot.pair.filter(|_| slot.fused)))
+    }
     fn instr_decode(
-        &self,
-        InstrDecodeInput { bin }: &InstrDecodeInput,
-    ) -> Result<Instr<RegId, RegId, FRegId, FRegId>> {
-        Ok(Instr::decode_from(*bin)?)
+        &mut self,
+        fetched: &InstrFetchOutput,
+    ) -> Result<(Instr<RegId, RegId, FRegId, FRegId>, Option<FusedKind>)> {
+        match self.predecoded(fetched) {
+            Some(d) => Ok(d),
+            None => Ok((Instr::decode_from(fetched.id_in.bin)?, None)),
+        }
     }
     fn reg_fetch(
         &self,
@@ -555,6 +1217,7 @@ impl<I: Input, O: Output> Cpu<I, O> {
             }),
             IO(Inw { rd }) => IO(Inw { rd }),
             IO(Finw { rd }) => IO(Finw { rd }),
+            IO(Csrr { rd, csr }) => IO(Csrr { rd, csr }),
             F(f) => {
                 use FInstr::*;
                 F(match f {
@@ -636,6 +1299,42 @@ impl<I: Input, O: Output> Cpu<I, O> {
                     },
                 })
             }
+            A {
+                instr,
+                rd,
+                rs1,
+                rs2,
+            } => A {
+                instr,
+                rd,
+                rs1: self.reg_file.get(rs1),
+                rs2: self.reg_file.get(rs2),
+            },
+            // vector registers are read in execute
+            #[cfg(feature = "simd")]
+            Q(q) => {
+                use QInstr::*;
+                Q(match q {
+                    Vlw { vd, rs1, imm } => Vlw {
+                        vd,
+                        rs1: self.reg_file.get(rs1),
+                        imm,
+                    },
+                    Vsw { vs, rs1, imm } => Vsw {
+                        vs,
+                        rs1: self.reg_file.get(rs1),
+                        imm,
+                    },
+                    Vadd { vd, vs1, vs2 } => Vadd { vd, vs1, vs2 },
+                    Vmul { vd, vs1, vs2 } => Vmul { vd, vs1, vs2 },
+                    Vfma { vd, vs1, vs2, vs3 } => Vfma { vd, vs1, vs2, vs3 },
+                    Vdot { rd, vs1, vs2 } => Vdot { rd, vs1, vs2 },
+                    Vsplat { vd, rs1 } => Vsplat {
+                        vd,
+                        rs1: self.reg_file.get_f(rs1),
+                    },
+                })
+            }
             Misc(MiscInstr::End) => Misc(MiscInstr::End),
         };
         ExecuteInput {
@@ -644,94 +1343,274 @@ impl<I: Input, O: Output> Cpu<I, O> {
             pc_plus4,
         }
     }
-    fn execute(&mut self, ex_in: ExecuteInput) -> Result<ExecuteOutput> {
-        use Instr::*;
-        let ExecuteInput {
-            instr,
-            old_pc,
-            pc_plus4,
-        } = ex_in;
-        Ok(match instr {
-            R {
-                instr,
-                rd,
-                rs1,
-                rs2,
-            } => {
-                use RInstr::*;
-                cfg_if::cfg_if! {
-                    if #[cfg(feature = "isa_2nd")] {
-                        let val = match instr {
-                            Add => rs1.wrapping_add(rs2),
-                            Xor => rs1 ^ rs2,
-                            Min => cmp::min(rs1 as i32, rs2 as i32) as u32,
-                            Max => cmp::max(rs1 as i32, rs2 as i32) as u32,
-                        };
-                    }
-                    else {
-                        let val = match instr {
-                            Add => rs1.wrapping_add(rs2),
-                            Sub => rs1.wrapping_sub(rs2),
-                            Xor => rs1 ^ rs2,
-                            Or => rs1 | rs2,
-                            And => rs1 & rs2,
-                            Sll => rs1 << rs2,
-                            Sra => rs1 >> rs2,
-                            Slt => u32::from((rs1 as i32) < (rs2 as i32)),
-                        };
-                    }
-                }
-
-                ExecuteOutput {
-                    wb_in: Some(WriteBackInput::I { id: rd, val }),
-                    #[cfg(feature = "time_predict")]
-                    cycles: 1,
-                    ..Default::default()
-                }
-            }
-            I {
-                instr,
-                rd,
-                rs1,
-                imm,
-            } => {
-                let mut ret = ExecuteOutput {
-                    ..Default::default()
+    fn execute_r(instr: RInstr, rd: RegId, rs1: u32, rs2: u32) -> ExecuteOutput {
+        use RInstr::*;
+        cfg_if::cfg_if! {
+            if #[cfg(feature = "isa_2nd")] {
+                let val = match instr {
+                    Add => rs1.wrapping_add(rs2),
+                    Xor => rs1 ^ rs2,
+                    Min => cmp::min(rs1 as i32, rs2 as i32) as u32,
+                    Max => cmp::max(rs1 as i32, rs2 as i32) as u32,
                 };
-                use IInstr::*;
+            }
+            else {
                 let val = match instr {
-                    Addi => rs1.wrapping_add(imm),
-                    Xori => rs1 ^ imm,
-                    #[cfg(not(feature = "isa_2nd"))]
-                    Ori => rs1 | imm,
-                    #[cfg(not(feature = "isa_2nd"))]
-                    Andi => rs1 & imm,
-                    Slli => rs1 << imm,
-                    #[cfg(not(feature = "isa_2nd"))]
-                    Slti => u32::from((rs1 as i32) < (imm as i32)),
-                    Lw => {
-                        ret.ma_in = Some(MemoryAccessInput::IMem {
-                            id: rd,
-                            addr: rs1.wrapping_add(imm) as usize,
-                        });
-                        return Ok(ret);
-                    }
-                    Jalr => {
-                        #[cfg(feature = "time_predict")]
-                        {
-                            ret.flush = true;
-                        }
-                        ret.new_pc = Some(rs1.wrapping_add(imm) as usize);
-                        pc_plus4
-                    }
+                    Add => rs1.wrapping_add(rs2),
+                    Sub => rs1.wrapping_sub(rs2),
+                    Xor => rs1 ^ rs2,
+                    Or => rs1 | rs2,
+                    And => rs1 & rs2,
+                    Sll => rs1 << rs2,
+                    Sra => rs1 >> rs2,
+                    Slt => u32::from((rs1 as i32) < (rs2 as i32)),
                 };
-                ret.wb_in = Some(WriteBackInput::I { id: rd, val });
-                ret
             }
-            S {
-                instr,
-                rs1,
-                rs2,
+        }
+
+        ExecuteOutput {
+            wb_in: Some(WriteBackInput::I { id: rd, val }),
+            #[cfg(feature = "time_predict")]
+            cycles: 1,
+            ..Default::default()
+        }
+    }
+    #[cfg_attr(not(feature = "coverage"), allow(unused_variables))]
+    fn execute_i(
+        &mut self,
+        instr: IInstr,
+        rd: RegId,
+        rs1: u32,
+        imm: u32,
+        old_pc: u32,
+        pc_plus4: u32,
+    ) -> ExecuteOutput {
+        let mut ret = ExecuteOutput {
+            ..Default::default()
+        };
+        use IInstr::*;
+        let val = match instr {
+            Addi => rs1.wrapping_add(imm),
+            Xori => rs1 ^ imm,
+            #[cfg(not(feature = "isa_2nd"))]
+            Ori => rs1 | imm,
+            #[cfg(not(feature = "isa_2nd"))]
+            Andi => rs1 & imm,
+            Slli => rs1 << imm,
+            #[cfg(not(feature = "isa_2nd"))]
+            Slti => u32::from((rs1 as i32) < (imm as i32)),
+            Lw => {
+                ret.ma_in = Some(MemoryAccessInput::IMem {
+                    id: rd,
+                    addr: rs1.wrapping_add(imm) as usize,
+                });
+                return ret;
+            }
+            Jalr => {
+                #[cfg(feature = "time_predict")]
+                {
+                    ret.flush = true;
+                }
+                ret.new_pc = Some(rs1.wrapping_add(imm) as usize);
+                #[cfg(feature = "coverage")]
+                self.coverage.edge(old_pc, rs1.wrapping_add(imm));
+                pc_plus4
+            }
+        };
+        ret.wb_in = Some(WriteBackInput::I { id: rd, val });
+        ret
+    }
+    #[cfg_attr(not(feature = "coverage"), allow(unused_variables))]
+    fn execute_b(
+        &mut self,
+        instr: BInstr,
+        rs1: u32,
+        rs2: u32,
+        imm: u32,
+        old_pc: u32,
+        pc_plus4: u32,
+    ) -> ExecuteOutput {
+        use BInstr::*;
+        let cond = match instr {
+            Beq => rs1 == rs2,
+            Bne => rs1 != rs2,
+            Blt => (rs1 as i32) < (rs2 as i32),
+            Bge => (rs1 as i32) >= (rs2 as i32),
+            #[cfg(feature = "isa_2nd")]
+            Bxor => (rs1 ^ rs2) != 0,
+            #[cfg(feature = "isa_2nd")]
+            Bxnor => (rs1 ^ rs2) == 0,
+        };
+        let new_pc = if cond {
+            Some(old_pc.wrapping_add(imm) as usize)
+        } else {
+            None
+        };
+        #[cfg(feature = "coverage")]
+        self.coverage
+            .edge(old_pc, new_pc.map_or(pc_plus4, |p| p as u32));
+        #[cfg(feature = "stat")]
+        let prediction_result = self.branch_predictor.predict(self.pc.into_usize());
+        #[cfg(feature = "stat")]
+        self.branch_predictor
+            .update_state(self.pc.into_usize(), cond);
+        #[cfg(feature = "stat")]
+        self.b_stat.update_stat(prediction_result, cond);
+        ExecuteOutput {
+            new_pc,
+            #[cfg(feature = "time_predict")]
+            flush: prediction_result != cond,
+            #[cfg(feature = "time_predict")]
+            cycles: 1,
+            ..Default::default()
+        }
+    }
+    fn execute_e(instr: EInstr, rd: FRegId, rs1: f32, rs2: f32) -> ExecuteOutput {
+        use EInstr::*;
+        let val = match instr {
+            Fadd => fpu::fadd(rs1, rs2),
+            Fsub => fpu::fsub(rs1, rs2),
+            Fmul => fpu::fmul(rs1, rs2),
+            Fdiv => fpu::fdiv(rs1, rs2),
+            Fsgnj => rs1.copysign(rs2),
+            Fsgnjn => rs1.copysign(-rs2),
+            Fsgnjx => rs1.copysign(rs1.signum() * rs2.signum()),
+        };
+
+        ExecuteOutput {
+            wb_in: Some(WriteBackInput::F { id: rd, val }),
+            #[cfg(feature = "time_predict")]
+            use_fpu: true,
+            #[cfg(feature = "time_predict")]
+            cycles: match instr {
+                Fadd => 5,
+                Fsub => 5,
+                Fmul => 2,
+                Fdiv => 11,
+                Fsgnj => 1,
+                Fsgnjn => 1,
+                Fsgnjx => 1,
+            },
+            ..Default::default()
+        }
+    }
+    fn execute_k(instr: KInstr, rd: RegId, rs1: f32, rs2: f32) -> ExecuteOutput {
+        use KInstr::*;
+        let val = match instr {
+            Flt => u32::from(rs1 < rs2),
+        };
+        ExecuteOutput {
+            wb_in: Some(WriteBackInput::I { id: rd, val }),
+            #[cfg(feature = "time_predict")]
+            cycles: 1,
+            ..Default::default()
+        }
+    }
+    /// [`Cpu::reg_fetch`] and [`Cpu::execute`] of an instruction of a fused
+    /// pair, none of which fails.
+    fn execute_fused(
+        &mut self,
+        instr: &Instr<RegId, RegId, FRegId, FRegId>,
+        old_pc: u32,
+        pc_plus4: u32,
+    ) -> ExecuteOutput {
+        use FInstr::*;
+        use Instr::*;
+        let reg = &self.reg_file;
+        match *instr {
+            R {
+                instr,
+                rd,
+                rs1,
+                rs2,
+            } => Self::execute_r(instr, rd, reg.get(rs1), reg.get(rs2)),
+            I {
+                instr,
+                rd,
+                rs1,
+                imm,
+            } => {
+                let rs1 = reg.get(rs1);
+                self.execute_i(instr, rd, rs1, imm, old_pc, pc_plus4)
+            }
+            B {
+                instr,
+                rs1,
+                rs2,
+                imm,
+            } => {
+                let (rs1, rs2) = (reg.get(rs1), reg.get(rs2));
+                self.execute_b(instr, rs1, rs2, imm, old_pc, pc_plus4)
+            }
+            F(E {
+                instr,
+                rd,
+                rs1,
+                rs2,
+            }) => Self::execute_e(instr, rd, reg.get_f(rs1), reg.get_f(rs2)),
+            F(K {
+                instr,
+                rd,
+                rs1,
+                rs2,
+            }) => Self::execute_k(instr, rd, reg.get_f(rs1), reg.get_f(rs2)),
+            F(Flw { rd, rs1, imm }) => ExecuteOutput {
+                ma_in: Some(MemoryAccessInput::FMem {
+                    id: rd,
+                    addr: reg.get(rs1).wrapping_add(imm) as usize,
+                }),
+                ..Default::default()
+            },
+            _ => unreachable!("{instr} is not fused"),
+        }
+    }
+    /// the tail of a fused pair of `kind` whose head resulted in `val`: the
+    /// branch on a comparison and the constant built are taken from `val`
+    /// rather than the register file.
+    fn execute_tail(
+        &mut self,
+        kind: FusedKind,
+        tail: &Instr<RegId, RegId, FRegId, FRegId>,
+        val: u32,
+        old_pc: u32,
+        pc_plus4: u32,
+    ) -> ExecuteOutput {
+        match (kind, tail) {
+            // the other operand is zero, and equality is symmetric
+            (FusedKind::CmpBranch, &Instr::B { instr, imm, .. }) => {
+                self.execute_b(instr, val, 0, imm, old_pc, pc_plus4)
+            }
+            (FusedKind::ConstBuild, &Instr::I { instr, rd, imm, .. }) => {
+                self.execute_i(instr, rd, val, imm, old_pc, pc_plus4)
+            }
+            // the loaded value is only known once the head completed
+            _ => self.execute_fused(tail, old_pc, pc_plus4),
+        }
+    }
+    fn execute(&mut self, ex_in: ExecuteInput) -> Result<ExecuteOutput> {
+        use Instr::*;
+        let ExecuteInput {
+            instr,
+            old_pc,
+            pc_plus4,
+        } = ex_in;
+        Ok(match instr {
+            R {
+                instr,
+                rd,
+                rs1,
+                rs2,
+            } => Self::execute_r(instr, rd, rs1, rs2),
+            I {
+                instr,
+                rd,
+                rs1,
+                imm,
+            } => self.execute_i(instr, rd, rs1, imm, old_pc, pc_plus4),
+            S {
+                instr,
+                rs1,
+                rs2,
                 imm,
             } => {
                 use SInstr::*;
@@ -751,39 +1630,7 @@ impl<I: Input, O: Output> Cpu<I, O> {
                 rs1,
                 rs2,
                 imm,
-            } => {
-                use BInstr::*;
-                let cond = match instr {
-                    Beq => rs1 == rs2,
-                    Bne => rs1 != rs2,
-                    Blt => (rs1 as i32) < (rs2 as i32),
-                    Bge => (rs1 as i32) >= (rs2 as i32),
-                    #[cfg(feature = "isa_2nd")]
-                    Bxor => (rs1 ^ rs2) != 0,
-                    #[cfg(feature = "isa_2nd")]
-                    Bxnor => (rs1 ^ rs2) == 0,
-                };
-                let new_pc = if cond {
-                    Some(old_pc.wrapping_add(imm) as usize)
-                } else {
-                    None
-                };
-                #[cfg(feature = "stat")]
-                let prediction_result = self.branch_predictor.predict(self.pc.into_usize());
-                #[cfg(feature = "stat")]
-                self.branch_predictor
-                    .update_state(self.pc.into_usize(), cond);
-                #[cfg(feature = "stat")]
-                self.b_stat.update_stat(prediction_result, cond);
-                ExecuteOutput {
-                    new_pc,
-                    #[cfg(feature = "time_predict")]
-                    flush: prediction_result != cond,
-                    #[cfg(feature = "time_predict")]
-                    cycles: 1,
-                    ..Default::default()
-                }
-            }
+            } => self.execute_b(instr, rs1, rs2, imm, old_pc, pc_plus4),
             #[cfg(feature = "isa_2nd")]
             P {
                 instr,
@@ -805,6 +1652,9 @@ impl<I: Input, O: Output> Cpu<I, O> {
                 } else {
                     None
                 };
+                #[cfg(feature = "coverage")]
+                self.coverage
+                    .edge(old_pc, new_pc.map_or(pc_plus4, |p| p as u32));
                 #[cfg(feature = "stat")]
                 let prediction_result = self.branch_predictor.predict(self.pc.into_usize());
                 #[cfg(feature = "stat")]
@@ -830,6 +1680,8 @@ impl<I: Input, O: Output> Cpu<I, O> {
                 match instr {
                     Jal => {
                         let new_pc = Some(old_pc.wrapping_add(imm) as usize);
+                        #[cfg(feature = "coverage")]
+                        self.coverage.edge(old_pc, old_pc.wrapping_add(imm));
                         ExecuteOutput {
                             wb_in: Some(WriteBackInput::I {
                                 id: rd,
@@ -872,6 +1724,15 @@ impl<I: Input, O: Output> Cpu<I, O> {
                             ..Default::default()
                         }
                     }
+                    Csrr { rd, csr } => {
+                        let val = csr.read(self.counter(csr.counter));
+                        ExecuteOutput {
+                            wb_in: Some(WriteBackInput::I { id: rd, val }),
+                            #[cfg(feature = "time_predict")]
+                            cycles: 1,
+                            ..Default::default()
+                        }
+                    }
                 }
             }
             F(f) => {
@@ -882,35 +1743,7 @@ impl<I: Input, O: Output> Cpu<I, O> {
                         rd,
                         rs1,
                         rs2,
-                    } => {
-                        use EInstr::*;
-                        let val = match instr {
-                            Fadd => rs1 + rs2,
-                            Fsub => rs1 - rs2,
-                            Fmul => fpu::fmul(rs1, rs2),
-                            Fdiv => fpu::fdiv(rs1, rs2),
-                            Fsgnj => rs1.copysign(rs2),
-                            Fsgnjn => rs1.copysign(-rs2),
-                            Fsgnjx => rs1.copysign(rs1.signum() * rs2.signum()),
-                        };
-
-                        ExecuteOutput {
-                            wb_in: Some(WriteBackInput::F { id: rd, val }),
-                            #[cfg(feature = "time_predict")]
-                            use_fpu: true,
-                            #[cfg(feature = "time_predict")]
-                            cycles: match instr {
-                                Fadd => 5,
-                                Fsub => 5,
-                                Fmul => 2,
-                                Fdiv => 11,
-                                Fsgnj => 1,
-                                Fsgnjn => 1,
-                                Fsgnjx => 1,
-                            },
-                            ..Default::default()
-                        }
-                    }
+                    } => Self::execute_e(instr, rd, rs1, rs2),
                     #[cfg(feature = "isa_2nd")]
                     G {
                         instr,
@@ -973,18 +1806,7 @@ impl<I: Input, O: Output> Cpu<I, O> {
                         rd,
                         rs1,
                         rs2,
-                    } => {
-                        use KInstr::*;
-                        let val = match instr {
-                            Flt => u32::from(rs1 < rs2),
-                        };
-                        ExecuteOutput {
-                            wb_in: Some(WriteBackInput::I { id: rd, val }),
-                            #[cfg(feature = "time_predict")]
-                            cycles: 1,
-                            ..Default::default()
-                        }
-                    }
+                    } => Self::execute_k(instr, rd, rs1, rs2),
                     X { instr, rd, rs1 } => {
                         use XInstr::*;
                         let val = match instr {
@@ -1037,6 +1859,9 @@ impl<I: Input, O: Output> Cpu<I, O> {
                         } else {
                             None
                         };
+                        #[cfg(feature = "coverage")]
+                        self.coverage
+                            .edge(old_pc, new_pc.map_or(pc_plus4, |p| p as u32));
                         #[cfg(feature = "stat")]
                         let prediction_result = self.branch_predictor.predict(self.pc.into_usize());
                         #[cfg(feature = "stat")]
@@ -1064,6 +1889,9 @@ impl<I: Input, O: Output> Cpu<I, O> {
                         } else {
                             None
                         };
+                        #[cfg(feature = "coverage")]
+                        self.coverage
+                            .edge(old_pc, new_pc.map_or(pc_plus4, |p| p as u32));
                         #[cfg(feature = "stat")]
                         let prediction_result = self.branch_predictor.predict(self.pc.into_usize());
                         #[cfg(feature = "stat")]
@@ -1099,6 +1927,102 @@ impl<I: Input, O: Output> Cpu<I, O> {
                     }
                 }
             }
+            A {
+                instr: AInstr::Fence,
+                ..
+            } => ExecuteOutput {
+                #[cfg(feature = "time_predict")]
+                cycles: 1,
+                ..Default::default()
+            },
+            A {
+                instr,
+                rd,
+                rs1,
+                rs2,
+            } => ExecuteOutput {
+                ma_in: Some(MemoryAccessInput::Amo {
+                    id: rd,
+                    addr: rs1 as usize,
+                    op: instr,
+                    val: rs2,
+                }),
+                #[cfg(feature = "time_predict")]
+                cycles: 1,
+                ..Default::default()
+            },
+            #[cfg(feature = "simd")]
+            Q(q) => {
+                use QInstr::*;
+                let v = |id: VRegId| self.vreg_file[id.inner()];
+                let (wb_in, ma_in) = match q {
+                    Vlw { vd, rs1, imm } => (
+                        None,
+                        Some(MemoryAccessInput::VMem {
+                            id: vd,
+                            addr: rs1.wrapping_add(imm) as usize,
+                        }),
+                    ),
+                    Vsw { vs, rs1, imm } => (
+                        None,
+                        Some(MemoryAccessInput::V {
+                            addr: rs1.wrapping_add(imm) as usize,
+                            val: v(vs),
+                        }),
+                    ),
+                    Vadd { vd, vs1, vs2 } => (
+                        Some(WriteBackInput::V {
+                            id: vd,
+                            val: simd::add(v(vs1), v(vs2)),
+                        }),
+                        None,
+                    ),
+                    Vmul { vd, vs1, vs2 } => (
+                        Some(WriteBackInput::V {
+                            id: vd,
+                            val: simd::mul(v(vs1), v(vs2)),
+                        }),
+                        None,
+                    ),
+                    Vfma { vd, vs1, vs2, vs3 } => (
+                        Some(WriteBackInput::V {
+                            id: vd,
+                            val: simd::fma(v(vs1), v(vs2), v(vs3)),
+                        }),
+                        None,
+                    ),
+                    Vdot { rd, vs1, vs2 } => (
+                        Some(WriteBackInput::F {
+                            id: rd,
+                            val: simd::dot(v(vs1), v(vs2)),
+                        }),
+                        None,
+                    ),
+                    Vsplat { vd, rs1 } => (
+                        Some(WriteBackInput::V {
+                            id: vd,
+                            val: [rs1; LANES],
+                        }),
+                        None,
+                    ),
+                };
+                ExecuteOutput {
+                    ma_in,
+                    wb_in,
+                    #[cfg(feature = "time_predict")]
+                    use_fpu: !matches!(q, Vlw { .. } | Vsw { .. } | Vsplat { .. }),
+                    // a lane per FPU: as long as the scalar operations they replace
+                    #[cfg(feature = "time_predict")]
+                    cycles: match q {
+                        Vlw { .. } | Vsw { .. } | Vsplat { .. } => 1,
+                        Vadd { .. } => 5,
+                        Vmul { .. } => 2,
+                        Vfma { .. } => 7,
+                        Vdot { .. } => 2 + 5 + 5,
+                    },
+                    ..Default::default()
+                }
+            }
             Misc(MiscInstr::End) => ExecuteOutput {
                 #[cfg(feature = "time_predict")]
                 cycles: 1,
@@ -1110,6 +2034,7 @@ impl<I: Input, O: Output> Cpu<I, O> {
     fn memory_access(
         &mut self,
         ma_in: MemoryAccessInput,
+        checked: bool,
         spied: &mut Option<SpyResult>,
     ) -> Result<MemoryAccessOutput> {
         #[cfg(feature = "time_predict")]
@@ -1119,6 +2044,31 @@ impl<I: Input, O: Output> Cpu<I, O> {
         let mut res = MemoryAccessOutput {
             ..Default::default()
         };
+        #[cfg(all(feature = "stat", feature = "time_predict"))]
+        if self.placement.is_enabled() {
+            self.placement.record(ma_in.addr());
+        }
+        #[cfg(feature = "stat")]
+        {
+            let (load, store, words) = match ma_in {
+                MemoryAccessInput::I { .. } | MemoryAccessInput::F { .. } => (false, true, 1),
+                MemoryAccessInput::IMem { .. } | MemoryAccessInput::FMem { .. } => (true, false, 1),
+                MemoryAccessInput::Amo { .. } => (true, true, 1),
+                #[cfg(feature = "simd")]
+                MemoryAccessInput::V { .. } => (false, true, LANES),
+                #[cfg(feature = "simd")]
+                MemoryAccessInput::VMem { .. } => (true, false, LANES),
+            };
+            for addr in ma_in.addr()..ma_in.addr() + words {
+                let region = self.reg_file.get_region(addr as u32);
+                if load {
+                    self.mem_stat.on_read(region);
+                }
+                if store {
+                    self.mem_stat.on_write(region);
+                }
+            }
+        }
         match ma_in {
             MemoryAccessInput::I { addr, val } => {
                 #[cfg(feature = "time_predict")]
@@ -1163,7 +2113,11 @@ impl<I: Input, O: Output> Cpu<I, O> {
                 {
                     res.cache_hit = self.cache.access_cache(addr);
                 }
-                let val = self.memory.get_i(addr, spied)?.get_unchecked();
+                let val = if checked {
+                    self.memory.get_i(addr, spied)?.get_unchecked()
+                } else {
+                    self.memory.get_i_proven(addr, spied)?
+                };
                 res.wb_in = Some(WriteBackInput::I { id, val });
             }
             MemoryAccessInput::FMem { id, addr } => {
@@ -1179,9 +2133,73 @@ impl<I: Input, O: Output> Cpu<I, O> {
                 {
                     res.cache_hit = self.cache.access_cache(addr);
                 }
-                let val = self.memory.get_f(addr, spied)?;
+                let val = if checked {
+                    self.memory.get_f(addr, spied)?
+                } else {
+                    self.memory.get_f_proven(addr, spied)?
+                };
                 res.wb_in = Some(WriteBackInput::F { id, val });
             }
+            MemoryAccessInput::Amo { id, addr, op, val } => {
+                #[cfg(feature = "time_predict")]
+                {
+                    res.use_bram = use_bram(addr);
+                    if !res.use_bram {
+                        res.cache_hit = self.cache.access_cache(addr)
+                    };
+                }
+                #[cfg(not(feature = "time_predict"))]
+                #[cfg(feature = "stat")]
+                {
+                    res.cache_hit = self.cache.access_cache(addr);
+                }
+                // cores switch only between instructions, so this is atomic
+                let old = self.memory.get_i(addr, spied)?.get_unchecked();
+                self.memory.set(addr, op.apply(old, val), spied)?;
+                res.wb_in = Some(WriteBackInput::I { id, val: old });
+            }
+            #[cfg(feature = "simd")]
+            MemoryAccessInput::V { addr, val } => {
+                #[cfg(feature = "time_predict")]
+                {
+                    res.use_bram = use_bram(addr);
+                    if !res.use_bram {
+                        res.cache_hit = self.access_cache_lanes(addr)
+                    };
+                }
+                #[cfg(not(feature = "time_predict"))]
+                #[cfg(feature = "stat")]
+                {
+                    res.cache_hit = self.access_cache_lanes(addr);
+                }
+                for (i, val) in val.into_iter().enumerate() {
+                    self.memory.set_f(addr + i, val, spied)?;
+                }
+            }
+            #[cfg(feature = "simd")]
+            MemoryAccessInput::VMem { id, addr } => {
+                #[cfg(feature = "time_predict")]
+                {
+                    res.use_bram = use_bram(addr);
+                    if !res.use_bram {
+                        res.cache_hit = self.access_cache_lanes(addr)
+                    };
+                }
+                #[cfg(not(feature = "time_predict"))]
+                #[cfg(feature = "stat")]
+                {
+                    res.cache_hit = self.access_cache_lanes(addr);
+                }
+                let mut val = [0.0; LANES];
+                for (i, v) in val.iter_mut().enumerate() {
+                    *v = if checked {
+                        self.memory.get_f(addr + i, spied)?
+                    } else {
+                        self.memory.get_f_proven(addr + i, spied)?
+                    };
+                }
+                res.wb_in = Some(WriteBackInput::V { id, val });
+            }
         }
         #[cfg(feature = "time_predict")]
         if !res.use_bram {
@@ -1194,7 +2212,7 @@ impl<I: Input, O: Output> Cpu<I, O> {
             } else if res.cache_hit {
                 2
             } else {
-                DDR2_ACCESS_CYCLES
+                DDR2_ACCESS_CYCLES + self.ddr2.access(self.core_id, self.clock)
             };
         }
 
@@ -1204,144 +2222,26 @@ impl<I: Input, O: Output> Cpu<I, O> {
 
         Ok(res)
     }
+    /// accesses the words of a vector; hits if all of them hit.
+    #[cfg(all(feature = "simd", feature = "stat"))]
+    fn access_cache_lanes(&mut self, addr: usize) -> bool {
+        (addr..addr + LANES).fold(true, |hit, addr| self.cache.access_cache(addr) & hit)
+    }
     fn write_back(&mut self, wb_in: WriteBackInput) {
         use WriteBackInput::*;
         match wb_in {
             I { id, val } => self.reg_file.set(id, val),
             F { id, val } => self.reg_file.set_f(id, val),
+            #[cfg(feature = "simd")]
+            V { id, val } => self.vreg_file[id.inner()] = val,
         }
     }
+    /// returns stall cycles and the class of the instruction waited for.
     #[cfg(feature = "time_predict")]
-    fn calc_stall_cycles(&self, instr: &Instr<RegId, RegId, FRegId, FRegId>) -> usize {
-        fn regid_is_included_in_srcs(
-            instr: &Instr<RegId, RegId, FRegId, FRegId>,
-            regid: &RegId,
-        ) -> bool {
-            match instr {
-                Instr::R {
-                    instr: _,
-                    rd: _,
-                    rs1,
-                    rs2,
-                } => rs1 == regid || rs2 == regid,
-                Instr::I {
-                    instr: _,
-                    rd: _,
-                    rs1,
-                    imm: _,
-                } => rs1 == regid,
-                Instr::S {
-                    instr: _,
-                    rs1,
-                    rs2,
-                    imm: _,
-                } => rs1 == regid || rs2 == regid,
-                Instr::B {
-                    instr: _,
-                    rs1,
-                    rs2,
-                    imm: _,
-                } => rs1 == regid || rs2 == regid,
-                Instr::P {
-                    instr: _,
-                    rs1,
-                    imm: _,
-                    imm2: _,
-                } => rs1 == regid,
-                Instr::J {
-                    instr: _,
-                    rd: _,
-                    imm: _,
-                } => false,
-                Instr::IO(ioinstr) => match ioinstr {
-                    IOInstr::Outb { rs } => rs == regid,
-                    IOInstr::Inw { rd: _ } => false,
-                    IOInstr::Finw { rd: _ } => false,
-                },
-                Instr::F(finstr) => match finstr {
-                    FInstr::X {
-                        instr: _,
-                        rd: _,
-                        rs1,
-                    } => rs1 == regid,
-                    FInstr::Flw { rd: _, rs1, imm: _ } => rs1 == regid,
-                    FInstr::Fsw {
-                        rs2: _,
-                        rs1,
-                        imm: _,
-                    } => rs1 == regid,
-                    _ => false,
-                },
-                Instr::Misc(_) => false,
-            }
-        }
-
-        fn fregid_is_included_in_srcs(
-            instr: &Instr<RegId, RegId, FRegId, FRegId>,
-            fregid: &FRegId,
-        ) -> bool {
-            match instr {
-                Instr::F(finstr) => match finstr {
-                    FInstr::E {
-                        instr: _,
-                        rd: _,
-                        rs1,
-                        rs2,
-                    } => rs1 == fregid || rs2 == fregid,
-                    FInstr::G {
-                        instr: _,
-                        rd: _,
-                        rs1,
-                        rs2,
-                        rs3,
-                    } => rs1 == fregid || rs2 == fregid || rs3 == fregid,
-                    FInstr::H {
-                        instr: _,
-                        rd: _,
-                        rs1,
-                    } => rs1 == fregid,
-                    FInstr::K {
-                        instr: _,
-                        rd: _,
-                        rs1,
-                        rs2,
-                    } => rs1 == fregid || rs2 == fregid,
-                    FInstr::X {
-                        instr: _,
-                        rd: _,
-                        rs1: _,
-                    } => false,
-                    FInstr::Y {
-                        instr: _,
-                        rd: _,
-                        rs1,
-                    } => rs1 == fregid,
-                    FInstr::W {
-                        instr: _,
-                        rs1,
-                        rs2,
-                        imm: _,
-                    } => rs1 == fregid || rs2 == fregid,
-                    FInstr::V {
-                        instr: _,
-                        rs1,
-                        imm: _,
-                    } => rs1 == fregid,
-                    FInstr::Flw {
-                        rd: _,
-                        rs1: _,
-                        imm: _,
-                    } => false,
-                    FInstr::Fsw {
-                        rs2,
-                        rs1: _,
-                        imm: _,
-                    } => rs2 == fregid,
-                },
-                _ => false,
-            }
-        }
-
+    fn calc_stall_cycles(
+        &self,
+        instr: &Instr<RegId, RegId, FRegId, FRegId>,
+    ) -> (usize, ProducerClass) {
         let ex_pipeline_stat = self.pipeline_state.index(0);
         let stall_cycles_with_ex: usize = if let Some(ex_pipeline_stat) = ex_pipeline_stat {
             if let Some(result_ready_stage) = &ex_pipeline_stat.result_ready_stage {
@@ -1352,6 +2252,11 @@ impl<I: Input, O: Output> Cpu<I, O> {
                             instr,
                             &ex_pipeline_stat.float_write_back_id.unwrap(),
                         ));
+                #[cfg(feature = "simd")]
+                let hazard = hazard
+                    || ex_pipeline_stat
+                        .vector_write_back_id
+                        .is_some_and(|id| vregid_is_included_in_srcs(instr, &id));
 
                 if hazard {
                     match result_ready_stage {
@@ -1379,6 +2284,11 @@ impl<I: Input, O: Output> Cpu<I, O> {
                             instr,
                             &ma_pipeline_stat.float_write_back_id.unwrap(),
                         ));
+                #[cfg(feature = "simd")]
+                let hazard = hazard
+                    || ma_pipeline_stat
+                        .vector_write_back_id
+                        .is_some_and(|id| vregid_is_included_in_srcs(instr, &id));
 
                 if hazard {
                     match result_ready_stage {
@@ -1395,10 +2305,21 @@ impl<I: Input, O: Output> Cpu<I, O> {
             0
         };
 
-        usize::max(stall_cycles_with_ex, stall_cycles_with_ma)
+        if stall_cycles_with_ex >= stall_cycles_with_ma {
+            let producer = ex_pipeline_stat.as_ref().map(|s| s.producer);
+            (stall_cycles_with_ex, producer.unwrap_or(ProducerClass::Alu))
+        } else {
+            let producer = ma_pipeline_stat.as_ref().map(|s| s.producer);
+            (stall_cycles_with_ma, producer.unwrap_or(ProducerClass::Alu))
+        }
     }
+    /// `slot` is the pc and the category charged for the issue slot itself.
     #[cfg(feature = "time_predict")]
-    fn push_instr_to_pipeline_and_get_cycles(&mut self, instr: Option<PipelineStat>) -> usize {
+    fn push_instr_to_pipeline_and_get_cycles(
+        &mut self,
+        instr: Option<PipelineStat>,
+        #[cfg(feature = "stat")] slot: (Pc, CpiCategory),
+    ) -> usize {
         let ex_cycles_of_first_instr = if let Some(instr_inner) = &instr {
             instr_inner.ex_cycles
         } else {
@@ -1409,18 +2330,32 @@ impl<I: Input, O: Output> Cpu<I, O> {
         } else {
             1
         };
+        let cycles = usize::max(ex_cycles_of_first_instr, ma_cycles_of_first_instr);
+        #[cfg(feature = "stat")]
+        {
+            let (pc, category) = slot;
+            self.cpi.charge(pc, category, 1);
+            if cycles > 1 {
+                match self.pipeline_state.index(0) {
+                    Some(ma) if ma_cycles_of_first_instr >= ex_cycles_of_first_instr => {
+                        self.cpi.charge(ma.pc, ma.ma_category, cycles - 1)
+                    }
+                    _ => self.cpi.charge(pc, CpiCategory::FpuLatency, cycles - 1),
+                }
+            }
+        }
         self.pipeline_state.pop_back();
         self.pipeline_state.push_front(instr);
         assert_eq!(5, self.pipeline_state.len(), "Pipeline is not filled");
-        usize::max(ex_cycles_of_first_instr, ma_cycles_of_first_instr)
+        cycles
     }
     pub fn cycle_one_full(&mut self, do_trace: bool) -> Result<CycleResult> {
         let mut res = CycleResult {
             ..Default::default()
         };
-        let mut spied = None;
+        self.trail.fetched(self.pc);
         let id_rf_in = self.instr_fetch()?;
-        let instr = self.instr_decode(&id_rf_in.id_in)?;
+        let (instr, _) = self.instr_decode(&id_rf_in)?;
         if do_trace {
             res.trace = Some(ExecutionTrace {
                 pc: id_rf_in.old_pc,
@@ -1428,15 +2363,91 @@ impl<I: Input, O: Output> Cpu<I, O> {
                 decoded_instr: instr.clone(),
             })
         }
+        self.run_instr(id_rf_in, instr, &mut res)?;
+        Ok(res)
+    }
 
+    /// [`Cpu::cycle_one_full`] which executes the instruction and the next
+    /// one by a single handler if they make a pair to fuse (see
+    /// [`crate::fuse`]); `fused` of the result tells whether both retired.
+    pub fn cycle_fused(&mut self) -> Result<CycleResult> {
+        let mut res = CycleResult {
+            ..Default::default()
+        };
+        self.trail.fetched(self.pc);
+        let head_in = self.instr_fetch()?;
+        let (head, kind) = self.instr_decode(&head_in)?;
+        let Some(kind) = kind else {
+            self.run_instr(head_in, head, &mut res)?;
+            return Ok(res);
+        };
+        #[cfg(feature = "stat")]
+        self.i_stat.encounter_instr(&head);
+        let ex_out = self.execute_fused(
+            &head,
+            head_in.old_pc.into_inner(),
+            head_in.pc_plus4.into_inner(),
+        );
+        let val = match ex_out.wb_in {
+            Some(WriteBackInput::I { val, .. }) => val,
+            _ => 0,
+        };
+        self.complete(&head_in, &head, ex_out, &mut res)?;
+        if !matches!(res.flow, ControlFlow::Continue) {
+            // stopped by a spy on the load
+            return Ok(res);
+        }
+        res.fused = true;
+        self.trail.fetched(self.pc);
+        let tail_in = self.instr_fetch()?;
+        let Some((tail, _)) = self.predecoded(&tail_in) else {
+            // rewritten since loaded
+            let (tail, _) = self.instr_decode(&tail_in)?;
+            self.run_instr(tail_in, tail, &mut res)?;
+            return Ok(res);
+        };
+        #[cfg(feature = "stat")]
+        self.i_stat.encounter_instr(&tail);
+        let ex_out = self.execute_tail(
+            kind,
+            &tail,
+            val,
+            tail_in.old_pc.into_inner(),
+            tail_in.pc_plus4.into_inner(),
+        );
+        self.complete(&tail_in, &tail, ex_out, &mut res)?;
+        Ok(res)
+    }
+
+    /// executes a decoded instruction to its retirement.
+    fn run_instr(
+        &mut self,
+        fetched: InstrFetchOutput,
+        instr: Instr<RegId, RegId, FRegId, FRegId>,
+        res: &mut CycleResult,
+    ) -> Result<()> {
         #[cfg(feature = "stat")]
         self.i_stat.encounter_instr(&instr);
 
         let ex_in = self.reg_fetch(RegFetchInput {
             instr: instr.clone(),
-            old_pc: id_rf_in.old_pc.into_inner(),
-            pc_plus4: id_rf_in.pc_plus4.into_inner(),
+            old_pc: fetched.old_pc.into_inner(),
+            pc_plus4: fetched.pc_plus4.into_inner(),
         });
+        let ex_out = self.execute(ex_in)?;
+        self.complete(&fetched, &instr, ex_out, res)
+    }
+
+    /// the memory access, the write back and the retirement of an executed
+    /// instruction.
+    fn complete(
+        &mut self,
+        fetched: &InstrFetchOutput,
+        instr: &Instr<RegId, RegId, FRegId, FRegId>,
+        ex_out: ExecuteOutput,
+        res: &mut CycleResult,
+    ) -> Result<()> {
+        let old_pc = fetched.old_pc;
         let ExecuteOutput {
             ma_in,
             mut wb_in,
@@ -1448,10 +2459,13 @@ impl<I: Input, O: Output> Cpu<I, O> {
                 cycles: ex_cycles,
             #[cfg(feature = "time_predict")]
             use_fpu,
-        } = self.execute(ex_in)?;
+        } = ex_out;
+        let mut spied = None;
+        #[allow(unused_mut)]
+        let mut cycles = 0;
         if end {
             res.flow = ControlFlow::Exit;
-            return Ok(res);
+            return Ok(());
         }
         if let Some(val) = new_pc {
             self.pc = Pc::new(val as u32);
@@ -1464,12 +2478,65 @@ impl<I: Input, O: Output> Cpu<I, O> {
         };
         #[cfg(feature = "time_predict")]
         let mut ma_cycles: usize = 1;
+        #[cfg(all(feature = "stat", feature = "time_predict"))]
+        let mut ma_category = CpiCategory::CacheHit;
+        #[cfg(all(feature = "stat", feature = "time_predict"))]
+        let mut access = None;
         if let Some(ma_in) = ma_in {
-            let ma_out = self.memory_access(ma_in, &mut spied)?;
+            #[cfg(feature = "uninit_check")]
+            if let MemoryAccessInput::IMem { addr, .. }
+            | MemoryAccessInput::FMem { addr, .. }
+            | MemoryAccessInput::Amo { addr, .. } = &ma_in
+            {
+                if !self.memory.is_defined(*addr) {
+                    self.uninit.record(old_pc, *addr);
+                }
+            }
+            #[cfg(all(feature = "uninit_check", feature = "simd"))]
+            if let MemoryAccessInput::VMem { addr, .. } = &ma_in {
+                if let Some(addr) = (*addr..*addr + LANES).find(|&a| !self.memory.is_defined(a)) {
+                    self.uninit.record(old_pc, addr);
+                }
+            }
+            let checked = !self.predecoded.ty_proven(old_pc, fetched.id_in.bin);
+            #[cfg(feature = "stat")]
+            let shadowed = self
+                .redundancy
+                .is_enabled()
+                .then(|| Access::of(&ma_in, instr));
+            let ma_out = self.memory_access(ma_in, checked, &mut spied)?;
+            #[cfg(feature = "stat")]
+            if let Some(shadowed) = shadowed {
+                self.redundancy.access(
+                    old_pc,
+                    shadowed,
+                    ma_out.wb_in.as_ref(),
+                    self.reg_file.as_slices(),
+                );
+            }
             #[cfg(feature = "time_predict")]
             {
                 ma_cycles = ma_out.cycles;
             }
+            #[cfg(all(feature = "stat", feature = "time_predict"))]
+            if !ma_out.use_bram && !ma_out.cache_hit {
+                ma_category = CpiCategory::DramMiss;
+                self.counters.cache_misses += 1;
+            }
+            #[cfg(all(feature = "stat", not(feature = "time_predict")))]
+            if !ma_out.cache_hit {
+                self.counters.cache_misses += 1;
+            }
+            #[cfg(all(feature = "stat", feature = "time_predict"))]
+            {
+                access = Some(if ma_out.use_bram {
+                    EnergyEvent::Bram
+                } else if ma_out.cache_hit {
+                    EnergyEvent::CacheHit
+                } else {
+                    EnergyEvent::Ddr2
+                });
+            }
             if let Some(spied) = spied {
                 res.flow = ControlFlow::Break(BreakReason::Spy(spied));
             }
@@ -1491,32 +2558,272 @@ impl<I: Input, O: Output> Cpu<I, O> {
 
         #[cfg(feature = "time_predict")]
         {
-            // Update pipeline state
-            let stall_cycles = self.calc_stall_cycles(&instr);
-            for _ in 0..stall_cycles {
-                res.cycles += self.push_instr_to_pipeline_and_get_cycles(None);
+            #[cfg(feature = "stat")]
+            let pc = old_pc;
+            #[cfg(feature = "stat")]
+            self.cpi.retire(pc);
+            let producer = if use_fpu {
+                ProducerClass::Fpu
+            } else if matches!(result_ready_stage, PipelineStage::Execute) {
+                ProducerClass::Alu
+            } else {
+                ProducerClass::Load
+            };
+            let write_back_id = if let Some(WriteBackInput::I { id, val: _ }) = wb_in {
+                Some(id)
+            } else {
+                None
+            };
+            let float_write_back_id = if let Some(WriteBackInput::F { id, val: _ }) = wb_in {
+                Some(id)
+            } else {
+                None
+            };
+            #[cfg(feature = "simd")]
+            let vector_write_back_id = if let Some(WriteBackInput::V { id, val: _ }) = wb_in {
+                Some(id)
+            } else {
+                None
+            };
+            #[cfg(feature = "stat")]
+            let issue = if matches!(instr, Instr::IO(_)) {
+                CpiCategory::IoWait
+            } else {
+                CpiCategory::Base
+            };
+            #[allow(unused_variables)]
+            let penalties = if self.interval.is_active() {
+                let waited = self
+                    .pending
+                    .filter(|p| p.waited_by(instr))
+                    .map(|p| (p.event, p.bubbles));
+                self.interval.retire(&Retired {
+                    ex_cycles,
+                    ma_cycles,
+                    flush,
+                    waited,
+                })
+            } else {
+                Penalties::default()
+            };
+            // bubbles of the next instruction if it reads the result
+            let bubbles = match result_ready_stage {
+                PipelineStage::WriteBack => 2,
+                PipelineStage::MemoryAccess => 1,
+                _ => 0,
+            };
+            match self.interval.timing() {
+                TimingModel::Detailed => {
+                    // Update pipeline state
+                    #[allow(unused_variables)]
+                    let (stall_cycles, waited_for) = self.calc_stall_cycles(instr);
+                    for _ in 0..stall_cycles {
+                        cycles += self.push_instr_to_pipeline_and_get_cycles(
+                            None,
+                            #[cfg(feature = "stat")]
+                            (pc, waited_for.into()),
+                        );
+                    }
+                    cycles += self.push_instr_to_pipeline_and_get_cycles(
+                        Some(PipelineStat {
+                            ex_cycles,
+                            ma_cycles,
+                            result_ready_stage: Some(result_ready_stage),
+                            write_back_id,
+                            float_write_back_id,
+                            #[cfg(feature = "simd")]
+                            vector_write_back_id,
+                            producer,
+                            #[cfg(feature = "stat")]
+                            pc,
+                            #[cfg(feature = "stat")]
+                            ma_category,
+                        }),
+                        #[cfg(feature = "stat")]
+                        (pc, issue),
+                    );
+                    if flush {
+                        for _ in 0..2 {
+                            cycles += self.push_instr_to_pipeline_and_get_cycles(
+                                None,
+                                #[cfg(feature = "stat")]
+                                (pc, CpiCategory::BranchFlush),
+                            );
+                        }
+                    }
+                    if self.interval.is_active() {
+                        self.interval.calibrate(cycles);
+                    }
+                }
+                TimingModel::Interval => {
+                    cycles += 1 + penalties.iter().sum::<usize>();
+                    #[cfg(feature = "stat")]
+                    {
+                        self.cpi.charge(pc, issue, 1);
+                        for (&e, &c) in EVENTS.iter().zip(&penalties) {
+                            if c > 0 {
+                                self.cpi.charge(pc, e.into(), c);
+                            }
+                        }
+                    }
+                }
             }
-            res.cycles += self.push_instr_to_pipeline_and_get_cycles(Some(PipelineStat {
-                ex_cycles,
-                ma_cycles,
-                result_ready_stage: Some(result_ready_stage),
-                write_back_id: if let Some(WriteBackInput::I { id, val: _ }) = wb_in {
-                    Some(id)
+            self.pending = (bubbles > 0).then_some(PendingResult {
+                write_back_id,
+                float_write_back_id,
+                #[cfg(feature = "simd")]
+                vector_write_back_id,
+                event: if producer == ProducerClass::Fpu {
+                    Event::FpuUse
                 } else {
-                    None
+                    Event::LoadUse
                 },
-                float_write_back_id: if let Some(WriteBackInput::F { id, val: _ }) = wb_in {
-                    Some(id)
-                } else {
-                    None
-                },
-            }));
-            if flush {
-                res.cycles += self.push_instr_to_pipeline_and_get_cycles(None);
-                res.cycles += self.push_instr_to_pipeline_and_get_cycles(None);
-            }
+                bubbles,
+            });
         }
-        Ok(res)
+        let flow = instr.flow_kind();
+        #[cfg(feature = "time_predict")]
+        {
+            self.clock += cycles;
+            // `jalr` always flushes but is not predicted
+            self.counters.mispredicts += u64::from(flush && flow == FlowKind::Branch);
+        }
+        #[cfg(all(feature = "stat", feature = "time_predict"))]
+        self.energy.retire(old_pc, instr, access, cycles);
+        #[cfg(feature = "stat")]
+        if self.redundancy.is_enabled() {
+            self.redundancy.retire(cycles);
+        }
+        self.counters.instret += 1;
+        res.cycles += cycles;
+        // sampled in the frame of the caller on calls and of the callee on returns
+        #[cfg(feature = "stat")]
+        if self.sampler.tick(cycles, flow) {
+            self.sampler.sample(old_pc, self.trail.calls());
+        }
+        self.trail.retired(old_pc, flow, self.pc);
+        #[cfg(feature = "stat")]
+        if self.loops.is_enabled() {
+            self.loops.retire(old_pc, self.pc, flow, cycles);
+        }
+        #[cfg(feature = "stat")]
+        if let Some(marker) = roi::marker(instr) {
+            let now = self.roi_counts();
+            self.regions.mark(marker, now);
+        }
+        Ok(())
+    }
+
+    pub fn trail(&self) -> &Trail {
+        &self.trail
+    }
+
+    /// snapshot of the architectural state and the touched memory.
+    pub fn core_dump(&self, error: String, cycle: u64, program_hash: u64) -> CoreDump {
+        let (regs, fregs) = self.reg_file.dump();
+        let recent_pcs = self.trail.recent_pcs();
+        CoreDump {
+            program_hash,
+            pc: recent_pcs.last().copied().unwrap_or(self.pc.into_inner()),
+            cycle,
+            error,
+            regs,
+            fregs,
+            calls: self.trail.calls().to_vec(),
+            recent_pcs,
+            pages: self
+                .memory
+                .dirty_pages()
+                .into_iter()
+                .map(|i| self.memory.page(i))
+                .collect(),
+        }
+    }
+
+    /// restores the state saved by [`Cpu::core_dump`]; the pipeline and the
+    /// cache are left as they are.
+    pub fn restore_core(&mut self, core: &CoreDump) {
+        self.reg_file.restore(&core.regs, &core.fregs);
+        self.pc = Pc::new(core.pc);
+        for p in &core.pages {
+            self.memory.restore_page(p);
+        }
+        self.trail.restore(&core.recent_pcs, &core.calls);
+    }
+
+    /// snapshot to [`Cpu::reset`] to; memory written after this call is
+    /// tracked as dirty.
+    pub fn snapshot(&mut self) -> CpuSnapshot {
+        let (regs, fregs) = self.reg_file.dump();
+        self.memory.clear_dirty();
+        CpuSnapshot {
+            regs,
+            fregs,
+            pc: self.pc,
+            pages: self.memory.all_pages(),
+            #[cfg(feature = "time_predict")]
+            clock: self.clock,
+            counters: self.counters,
+        }
+    }
+
+    /// rolls the architectural state and the counters back to `snapshot`,
+    /// copying only the pages written since. The pipeline, cache and
+    /// statistics are kept.
+    pub fn reset(&mut self, snapshot: &CpuSnapshot) {
+        self.reg_file.restore(&snapshot.regs, &snapshot.fregs);
+        self.pc = snapshot.pc;
+        self.memory.rollback(&snapshot.pages);
+        self.trail = Trail::default();
+        #[cfg(feature = "time_predict")]
+        {
+            self.clock = snapshot.clock;
+        }
+        self.counters = snapshot.counters;
+    }
+
+    /// pages written since the last call (or [`Cpu::snapshot`]), clearing
+    /// their dirty flags.
+    pub(crate) fn take_written_pages(&mut self) -> Vec<Page> {
+        let pages = self
+            .memory
+            .dirty_pages()
+            .into_iter()
+            .map(|i| self.memory.page(i))
+            .collect();
+        self.memory.clear_dirty();
+        pages
+    }
+
+    /// the clocks and counters of the running core
+    #[cfg(feature = "time_predict")]
+    pub(crate) fn counters(&self) -> (usize, Counters) {
+        (self.clock, self.counters)
+    }
+
+    /// loads the architectural state and the counters taken from another
+    /// run of the same program; the pipeline, cache and predictors are left
+    /// as they are.
+    #[cfg(feature = "time_predict")]
+    pub(crate) fn restore_arch<'a>(
+        &mut self,
+        regs: &[u32],
+        fregs: &[f32],
+        pc: Pc,
+        (clock, counters): (usize, Counters),
+        pages: impl IntoIterator<Item = &'a Page>,
+    ) {
+        self.reg_file.restore(regs, fregs);
+        self.pc = pc;
+        self.clock = clock;
+        self.counters = counters;
+        for p in pages {
+            self.memory.restore_page(p);
+        }
+    }
+
+    pub fn io_mut(&mut self) -> (&mut I, &mut O) {
+        (&mut self.input, &mut self.output)
     }
 
     pub fn get_freg(&self, id: FRegId) -> f32 {
@@ -1548,6 +2855,154 @@ impl<I: Input, O: Output> Cpu<I, O> {
     }
 }
 
+impl<I, O> Cpu<I, O> {
+    /// the counters accumulated by regions of interest
+    #[cfg(feature = "stat")]
+    fn roi_counts(&self) -> roi::Counts {
+        roi::Counts {
+            instrs: self.i_stat,
+            cache: self.c_stat,
+            branch: self.b_stat,
+            #[cfg(feature = "time_predict")]
+            clocks: self.clock,
+            #[cfg(feature = "time_predict")]
+            energy: self.energy.total_pj(),
+        }
+    }
+
+    /// a core starting at the current pc with the current registers, except
+    /// that `sp` is `stack_words` lower per core and `a0` holds `core_id`.
+    pub fn new_core(&self, core_id: usize, stack_words: u32) -> CoreState {
+        let (mut regs, fregs) = self.reg_file.dump();
+        regs[2] -= core_id as u32 * stack_words;
+        regs[10] = core_id as u32;
+        let mut reg_file = RegFile::new();
+        reg_file.restore(&regs, &fregs);
+        reg_file.end_init();
+        CoreState {
+            core_id,
+            reg_file,
+            #[cfg(feature = "simd")]
+            vreg_file: [[0.0; LANES]; NUM_VREGS],
+            pc: self.pc,
+            #[cfg(feature = "stat")]
+            cache: Cache::<CACHE_NUM_LINES>::new(),
+            #[cfg(all(feature = "stat", feature = "compressed"))]
+            icache: Cache::<ICACHE_NUM_LINES>::new_cold(),
+            #[cfg(feature = "time_predict")]
+            branch_predictor: BranchPredictor::<NUM_COUNTERS>::new(),
+            #[cfg(feature = "time_predict")]
+            pipeline_state: VecDeque::from([None, None, None, None, None]),
+            trail: Trail::default(),
+            #[cfg(feature = "stat")]
+            loops: LoopStack::default(),
+            #[cfg(feature = "time_predict")]
+            clock: 0,
+            counters: Default::default(),
+            #[cfg(feature = "time_predict")]
+            pending: None,
+        }
+    }
+
+    /// parks the running core into `core` and runs the one parked there.
+    pub fn swap_core(&mut self, core: &mut CoreState) {
+        use std::mem::swap;
+        swap(&mut self.core_id, &mut core.core_id);
+        swap(&mut self.reg_file, &mut core.reg_file);
+        #[cfg(feature = "simd")]
+        swap(&mut self.vreg_file, &mut core.vreg_file);
+        swap(&mut self.pc, &mut core.pc);
+        #[cfg(feature = "stat")]
+        {
+            swap(&mut self.cache, &mut core.cache);
+            #[cfg(feature = "compressed")]
+            swap(&mut self.icache, &mut core.icache);
+            self.loops.swap_core(&mut core.loops);
+        }
+        #[cfg(feature = "time_predict")]
+        {
+            swap(&mut self.branch_predictor, &mut core.branch_predictor);
+            swap(&mut self.pipeline_state, &mut core.pipeline_state);
+            swap(&mut self.clock, &mut core.clock);
+            swap(&mut self.pending, &mut core.pending);
+        }
+        swap(&mut self.counters, &mut core.counters);
+        swap(&mut self.trail, &mut core.trail);
+    }
+
+    /// makes the DDR2 shared by `cores` cores.
+    #[cfg(feature = "time_predict")]
+    pub fn share_ddr2(&mut self, cores: usize) {
+        self.ddr2 = Ddr2Bus::new(cores);
+    }
+
+    #[cfg(feature = "time_predict")]
+    pub fn ddr2(&self) -> &Ddr2Bus {
+        &self.ddr2
+    }
+
+    pub fn core_id(&self) -> usize {
+        self.core_id
+    }
+
+    /// pairs [`Cpu::cycle_fused`] executes by one handler
+    pub fn set_fusions(&mut self, fusions: Fusions) {
+        self.predecoded.set_fusions(fusions);
+        #[cfg(feature = "stat")]
+        self.f_stat.set_fusions(fusions);
+    }
+
+    /// the model predicting the clocks; see [`crate::interval`]
+    #[cfg(feature = "time_predict")]
+    pub fn set_timing(&mut self, timing: TimingModel) {
+        self.interval.set_timing(timing);
+    }
+
+    /// estimates the clocks by the interval model alongside the detailed
+    /// one to report its error
+    #[cfg(feature = "time_predict")]
+    pub fn calibrate_interval(&mut self) {
+        self.interval.enable_calibration();
+    }
+
+    /// the value of `counter` of the running core; the counters not
+    /// modeled by this build read 0
+    fn counter(&self, counter: Counter) -> u64 {
+        match counter {
+            #[cfg(feature = "time_predict")]
+            Counter::Cycle => self.clock as u64,
+            Counter::Instret => self.counters.instret,
+            Counter::CacheMiss => self.counters.cache_misses,
+            Counter::Mispredict => self.counters.mispredicts,
+            #[allow(unreachable_patterns)]
+            _ => 0,
+        }
+    }
+
+    /// type checks every load again, as when other cores may store to the
+    /// stack between two instructions of this one
+    pub fn check_all_types(&mut self) {
+        self.predecoded.check_all_types();
+    }
+
+    pub fn reg_file(&self) -> &RegFile {
+        &self.reg_file
+    }
+
+    pub fn memory_bytes(&self) -> &[u8] {
+        self.memory.as_bytes()
+    }
+
+    pub fn output(&self) -> &O {
+        &self.output
+    }
+
+    #[cfg(feature = "time_predict")]
+    pub fn clock(&self) -> usize {
+        self.clock
+    }
+}
+
 pub struct ExecutionTrace {
     pub pc: Pc,
     pub undecoded_instr: u32,
@@ -1557,6 +3012,8 @@ pub struct ExecutionTrace {
 #[derive(Default)]
 pub struct CycleResult {
     pub cycles: usize,
+    /// two instructions retired by [`Cpu::cycle_fused`]
+    pub fused: bool,
     pub trace: Option<ExecutionTrace>,
     pub flow: ControlFlow,
 }
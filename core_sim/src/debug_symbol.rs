@@ -35,18 +35,14 @@ impl DebugSymbol {
         Ok(
             match self.sorted.binary_search_by_key(&addr, SymbolDefRaw::addr) {
                 Ok(index) => SymbolTableIndex(index),
-                Err(index) => {
-                    if addr < self.sorted[index].addr {
-                        if index == 0 {
-                            return Err(anyhow::anyhow!(
-                                "address {addr:#010} do not have any debug information"
-                            ));
-                        }
-                        SymbolTableIndex(index - 1)
-                    } else {
-                        SymbolTableIndex(index)
-                    }
+                // `index` is where `addr` would be inserted, so the nearest
+                // preceding symbol (if any) is just before it.
+                Err(0) => {
+                    return Err(anyhow::anyhow!(
+                        "address {addr:#010} do not have any debug information"
+                    ));
                 }
+                Err(index) => SymbolTableIndex(index - 1),
             },
         )
     }
@@ -64,6 +60,29 @@ impl DebugSymbol {
         let size = self.sorted.get(index.0 + 1).map(|a| a.addr - raw.addr);
         SymbolDef { raw, size }
     }
+    /// the label of the function containing `pc`, i.e. the nearest label
+    /// preceding it
+    pub fn function_of(&self, pc: u32) -> Option<&str> {
+        let index = self.get_nearest_symbol_addr(pc).ok()?;
+        Some(&self.sorted[index.0].label)
+    }
+    /// folds values keyed by pc into the functions containing them (see
+    /// [`Self::function_of`]); pcs before any label are left out.
+    pub fn fold_by_function<T, A: Default>(
+        &self,
+        per_pc: impl IntoIterator<Item = (u32, T)>,
+        mut fold: impl FnMut(&mut A, T),
+    ) -> Vec<(String, A)> {
+        let mut map: HashMap<&str, A> = HashMap::new();
+        for (pc, v) in per_pc {
+            if let Some(label) = self.function_of(pc) {
+                fold(map.entry(label).or_default(), v);
+            }
+        }
+        map.into_iter()
+            .map(|(label, a)| (label.to_string(), a))
+            .collect()
+    }
 
     pub(crate) fn merge(&mut self, other: Self) {
         self.globals.extend(other.globals);
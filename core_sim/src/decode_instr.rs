@@ -166,6 +166,16 @@ impl DecodedInstr {
                 let rd = rd.try_into()?;
                 IO(IOInstr::Finw { rd })
             }
+            // SYSTEM: counters read by `csrrs rd, csr, zero` only
+            0b1110011 => {
+                let csr = match (funct3, rs1) {
+                    (0b010, 0) => Csr::from_number(imm),
+                    _ => None,
+                };
+                let csr = csr.ok_or(DecodeError::Invalid(bin))?;
+                let rd = rd.try_into()?;
+                IO(IOInstr::Csrr { rd, csr })
+            }
             // F
             0b1010011 => {
                 if funct3 == 0 {
@@ -292,6 +302,73 @@ impl DecodedInstr {
                 let imm = s_imm(bin, sign);
                 F(FInstr::Fsw { rs1, rs2, imm })
             }
+            // A (funct3 = 0x2 as RV32A; `fence` takes funct3 = 0x0 as its
+            // standard opcode is used by `finw`)
+            0b0101111 => {
+                use AInstr::*;
+                let instr = match (funct3, funct7 >> 2) {
+                    (0x2, 0b00001) => Amoswap,
+                    (0x2, 0b00000) => Amoadd,
+                    (0x2, 0b01100) => Amoand,
+                    (0x2, 0b01000) => Amoor,
+                    (0x2, 0b10000) => Amomin,
+                    (0x2, 0b10100) => Amomax,
+                    (0x0, _) => Fence,
+                    _ => Err(DecodeError::Invalid(bin))?,
+                };
+                let rd = rd.try_into()?;
+                let rs1 = rs1.try_into()?;
+                let rs2 = rs2.try_into()?;
+                A {
+                    instr,
+                    rd,
+                    rs1,
+                    rs2,
+                }
+            }
+            // Q (custom-2)
+            #[cfg(feature = "simd")]
+            0b1011011 => {
+                use QInstr::*;
+                Q(match funct3 {
+                    0b000 => Vlw {
+                        vd: rd.try_into()?,
+                        rs1: rs1.try_into()?,
+                        imm: i_imm(sign, imm),
+                    },
+                    0b001 => Vsw {
+                        vs: rs2.try_into()?,
+                        rs1: rs1.try_into()?,
+                        imm: s_imm(bin, sign),
+                    },
+                    0b010 => Vadd {
+                        vd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                    },
+                    0b011 => Vmul {
+                        vd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                    },
+                    0b100 => Vfma {
+                        vd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                        vs3: extract(bin, 27..31).try_into()?,
+                    },
+                    0b101 => Vdot {
+                        rd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                    },
+                    0b110 => Vsplat {
+                        vd: rd.try_into()?,
+                        rs1: rs1.try_into()?,
+                    },
+                    _ => Err(DecodeError::Invalid(bin))?,
+                })
+            }
             _ => Err(DecodeError::Invalid(bin))?,
         })
     }
@@ -330,5 +407,9 @@ mod tests {
     #[test]
     fn test_decode() {
         dbg!(Instr::decode_from(0x7d008113).unwrap());
+        // rdcycle a0; csrrw is not a counter read
+        let csrr = Instr::decode_from(0xc0002573).unwrap();
+        assert_eq!(csrr.to_string(), "csrr a0, cycle");
+        assert!(Instr::decode_from(0xc0001573).is_err());
     }
 }
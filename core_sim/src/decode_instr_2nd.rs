@@ -172,6 +172,13 @@ impl DecodedInstr {
                     let rd = rd.try_into()?;
                     IO(IOInstr::Finw { rd })
                 }
+                // the counter by its number of the standard
+                0b011 => {
+                    let csr = Csr::from_number(extract(bin, 19..30));
+                    let csr = csr.ok_or(DecodeError::Invalid(bin))?;
+                    let rd = rd.try_into()?;
+                    IO(IOInstr::Csrr { rd, csr })
+                }
                 _ => Err(DecodeError::Invalid(bin))?,
             },
             // F
@@ -316,6 +323,71 @@ impl DecodedInstr {
                 let imm = compose_3(sign, imm_11_6, rd);
                 F(FInstr::Fsw { rs1, rs2, imm })
             }
+            // A
+            0b1011 => {
+                use AInstr::*;
+                let instr = match funct3 {
+                    0b000 => Amoswap,
+                    0b001 => Amoadd,
+                    0b010 => Amoand,
+                    0b011 => Amoor,
+                    0b100 => Amomin,
+                    0b101 => Amomax,
+                    0b111 => Fence,
+                    _ => Err(DecodeError::Invalid(bin))?,
+                };
+                let rd = rd.try_into()?;
+                let rs1 = rs1.try_into()?;
+                let rs2 = rs2.try_into()?;
+                A {
+                    instr,
+                    rd,
+                    rs1,
+                    rs2,
+                }
+            }
+            #[cfg(feature = "simd")]
+            0b1101 => {
+                use QInstr::*;
+                Q(match funct3 {
+                    0b000 => Vlw {
+                        vd: rd.try_into()?,
+                        rs1: rs1.try_into()?,
+                        imm: compose_3(sign, imm_11_6, rs2),
+                    },
+                    0b001 => Vsw {
+                        vs: rs2.try_into()?,
+                        rs1: rs1.try_into()?,
+                        imm: compose_3(sign, imm_11_6, rd),
+                    },
+                    0b010 => Vadd {
+                        vd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                    },
+                    0b011 => Vmul {
+                        vd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                    },
+                    0b100 => Vfma {
+                        vd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                        vs3: imm_11_6.try_into()?,
+                    },
+                    0b101 => Vdot {
+                        rd: rd.try_into()?,
+                        vs1: rs1.try_into()?,
+                        vs2: rs2.try_into()?,
+                    },
+                    0b110 => Vsplat {
+                        vd: rd.try_into()?,
+                        rs1: rs1.try_into()?,
+                    },
+                    _ => Err(DecodeError::Invalid(bin))?,
+                })
+            }
             _ => Err(DecodeError::Invalid(bin))?,
         })
     }
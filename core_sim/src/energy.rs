@@ -0,0 +1,366 @@
+//! energy and power estimation.
+//!
+//! Every retired instruction is broken into events: its operation on the
+//! ALU, on one of the FPU units or on the UART (per byte), its access to
+//! BRAM, to the cache (hit) or to DDR2 (miss), and the clocks it stalls
+//! beyond its issue clock. The events are counted per pc and weighted by an
+//! [`EnergyModel`], a json object of picojoules per event such as
+//!
+//! ```json
+//! { "alu": 1.2, "fadd": 4.0, "fmul": 5.5, "fma": 9.0, "fdiv": 14.0,
+//!   "fsqrt": 14.0, "fmisc": 1.5, "uart_byte": 30.0, "bram": 2.5,
+//!   "cache_hit": 6.0, "ddr2": 250.0, "stall": 0.8 }
+//! ```
+//!
+//! into the energy per function and in total; regions of interest add up
+//! the energy spent in them. With the predicted clocks this also gives the
+//! average power at the clock frequency of the board.
+
+use std::{fmt, ops::Range};
+
+use anyhow::{anyhow, bail, Result};
+
+use crate::{
+    common::Pc,
+    debug_symbol::DebugSymbol,
+    instr::{EInstr, FInstr, HInstr, IOInstr, Instr},
+    register::{FRegId, RegId},
+    sim::CPU_CLOCK_FREQ,
+    stat::*,
+};
+
+/// number of functions shown in the stat
+const NUM_SHOWN_FUNCTIONS: usize = 20;
+
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum EnergyEvent {
+    /// integer, branch and address computation
+    Alu,
+    /// `fadd`, `fsub`
+    Fadd,
+    Fmul,
+    /// `fmadd` and the like
+    Fma,
+    Fdiv,
+    Fsqrt,
+    /// sign injection, comparison, conversion and the other FPU operations
+    Fmisc,
+    /// a byte sent or received
+    UartByte,
+    Bram,
+    CacheHit,
+    /// an access missing the cache
+    Ddr2,
+    /// a clock beyond the issue clock of an instruction
+    Stall,
+}
+
+impl EnergyEvent {
+    pub const COUNT: usize = std::mem::variant_count::<Self>();
+    pub const ALL: [Self; Self::COUNT] = [
+        Self::Alu,
+        Self::Fadd,
+        Self::Fmul,
+        Self::Fma,
+        Self::Fdiv,
+        Self::Fsqrt,
+        Self::Fmisc,
+        Self::UartByte,
+        Self::Bram,
+        Self::CacheHit,
+        Self::Ddr2,
+        Self::Stall,
+    ];
+    pub fn name(self) -> &'static str {
+        match self {
+            Self::Alu => "alu",
+            Self::Fadd => "fadd",
+            Self::Fmul => "fmul",
+            Self::Fma => "fma",
+            Self::Fdiv => "fdiv",
+            Self::Fsqrt => "fsqrt",
+            Self::Fmisc => "fmisc",
+            Self::UartByte => "uart_byte",
+            Self::Bram => "bram",
+            Self::CacheHit => "cache_hit",
+            Self::Ddr2 => "ddr2",
+            Self::Stall => "stall",
+        }
+    }
+    /// the operation of `instr` and how many times it is done.
+    #[inline]
+    fn of(instr: &Instr<RegId, RegId, FRegId, FRegId>) -> (Self, u64) {
+        match instr {
+            Instr::F(f) => match f {
+                FInstr::E { instr, .. } => match instr {
+                    EInstr::Fadd | EInstr::Fsub => (Self::Fadd, 1),
+                    EInstr::Fmul => (Self::Fmul, 1),
+                    EInstr::Fdiv => (Self::Fdiv, 1),
+                    _ => (Self::Fmisc, 1),
+                },
+                FInstr::G { .. } => (Self::Fma, 1),
+                FInstr::H {
+                    instr: HInstr::Fsqrt,
+                    ..
+                } => (Self::Fsqrt, 1),
+                FInstr::Flw { .. } | FInstr::Fsw { .. } => (Self::Alu, 1),
+                _ => (Self::Fmisc, 1),
+            },
+            Instr::IO(IOInstr::Outb { .. }) => (Self::UartByte, 1),
+            Instr::IO(IOInstr::Inw { .. } | IOInstr::Finw { .. }) => (Self::UartByte, 4),
+            #[cfg(feature = "simd")]
+            Instr::Q(q) => {
+                use crate::{instr::QInstr, simd::LANES};
+                let lanes = LANES as u64;
+                match q {
+                    QInstr::Vadd { .. } => (Self::Fadd, lanes),
+                    QInstr::Vmul { .. } => (Self::Fmul, lanes),
+                    QInstr::Vfma { .. } | QInstr::Vdot { .. } => (Self::Fma, lanes),
+                    _ => (Self::Alu, 1),
+                }
+            }
+            _ => (Self::Alu, 1),
+        }
+    }
+}
+
+type EventCounts = [u64; EnergyEvent::COUNT];
+
+/// picojoules per event
+#[derive(Clone, Copy, PartialEq, Debug)]
+pub struct EnergyModel {
+    coefficients: [f64; EnergyEvent::COUNT],
+}
+
+impl EnergyModel {
+    /// reads an object giving the picojoules of every event by its name.
+    pub fn from_json(config: &serde_json::Value) -> Result<Self> {
+        let map = config
+            .as_object()
+            .ok_or_else(|| anyhow!("the energy model must be an object"))?;
+        if let Some(k) = map
+            .keys()
+            .find(|k| EnergyEvent::ALL.iter().all(|e| e.name() != *k))
+        {
+            bail!("unknown event `{k}` in the energy model");
+        }
+        let mut coefficients = [0.0; EnergyEvent::COUNT];
+        for e in EnergyEvent::ALL {
+            let v = map
+                .get(e.name())
+                .ok_or_else(|| anyhow!("the energy model has no coefficient of `{}`", e.name()))?;
+            coefficients[e as usize] = v
+                .as_f64()
+                .filter(|v| *v >= 0.0)
+                .ok_or_else(|| anyhow!("`{}` must be a non-negative number", e.name()))?;
+        }
+        Ok(Self { coefficients })
+    }
+    /// in picojoules
+    fn energy(&self, counts: &EventCounts) -> f64 {
+        counts
+            .iter()
+            .zip(self.coefficients)
+            .map(|(&n, c)| n as f64 * c)
+            .sum()
+    }
+}
+
+/// events of every instruction in the text section, indexed by pc; counted
+/// only once a model is set.
+pub struct EnergyTable {
+    model: Option<EnergyModel>,
+    text_begin: u32,
+    /// in words
+    text_len: usize,
+    per_pc: Vec<EventCounts>,
+    total: EventCounts,
+}
+
+impl EnergyTable {
+    pub fn new(text: Range<u32>) -> Self {
+        Self {
+            model: None,
+            text_begin: text.start,
+            text_len: ((text.end - text.start) >> 2) as usize,
+            per_pc: vec![],
+            total: [0; EnergyEvent::COUNT],
+        }
+    }
+    pub fn set_model(&mut self, model: EnergyModel) {
+        self.per_pc.resize(self.text_len, [0; EnergyEvent::COUNT]);
+        self.model = Some(model);
+    }
+    pub fn is_enabled(&self) -> bool {
+        self.model.is_some()
+    }
+    /// counts the events of `instr` retired at `pc` in `clocks`, accessing
+    /// the memory by `access` if any.
+    #[inline]
+    pub fn retire(
+        &mut self,
+        pc: Pc,
+        instr: &Instr<RegId, RegId, FRegId, FRegId>,
+        access: Option<EnergyEvent>,
+        clocks: usize,
+    ) {
+        if self.model.is_none() {
+            return;
+        }
+        let index = (pc.into_inner().wrapping_sub(self.text_begin) >> 2) as usize;
+        let Some(s) = self.per_pc.get_mut(index) else {
+            return;
+        };
+        let (op, n) = EnergyEvent::of(instr);
+        let stall = clocks.saturating_sub(1) as u64;
+        for (e, n) in [
+            (Some(op), n),
+            (access, 1),
+            (Some(EnergyEvent::Stall), stall),
+        ] {
+            if let Some(e) = e {
+                s[e as usize] += n;
+                self.total[e as usize] += n;
+            }
+        }
+    }
+    /// picojoules spent so far; 0 without a model.
+    pub fn total_pj(&self) -> f64 {
+        self.model.map_or(0.0, |m| m.energy(&self.total))
+    }
+    /// the energy of the table by function.
+    pub fn by_function(&self, debug_symbol: &DebugSymbol, clocks: usize) -> EnergyStat {
+        let model = self.model.unwrap_or(EnergyModel {
+            coefficients: [0.0; EnergyEvent::COUNT],
+        });
+        let used = self
+            .per_pc
+            .iter()
+            .enumerate()
+            .map(|(i, s)| (self.text_begin + ((i as u32) << 2), model.energy(s)))
+            .filter(|&(_, pj)| pj != 0.0);
+        let mut functions = debug_symbol.fold_by_function(used, |f: &mut f64, pj| *f += pj);
+        functions.sort_by(|a, b| b.1.total_cmp(&a.1));
+        EnergyStat {
+            model,
+            total: self.total,
+            clocks,
+            functions,
+        }
+    }
+}
+
+pub struct EnergyStat {
+    model: EnergyModel,
+    total: EventCounts,
+    clocks: usize,
+    /// picojoules by function, in descending order
+    functions: Vec<(String, f64)>,
+}
+
+impl EnergyStat {
+    fn total_pj(&self) -> f64 {
+        self.model.energy(&self.total)
+    }
+    /// average power in milliwatts over the predicted clocks
+    fn power_mw(&self) -> f64 {
+        let seconds = self.clocks as f64 / CPU_CLOCK_FREQ as f64;
+        if seconds == 0.0 {
+            return 0.0;
+        }
+        self.total_pj() * 1e-9 / seconds
+    }
+}
+
+impl Stat for EnergyStat {
+    fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+        Box::new(self)
+    }
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        let events: serde_json::Map<_, _> = EnergyEvent::ALL
+            .iter()
+            .map(|&e| {
+                let n = self.total[e as usize];
+                let v = serde_json::json!({
+                    "count": n,
+                    "pj": n as f64 * self.model.coefficients[e as usize],
+                });
+                (e.name().to_string(), v)
+            })
+            .collect();
+        let functions: serde_json::Map<_, _> = self
+            .functions
+            .iter()
+            .map(|(label, pj)| (label.clone(), (*pj).into()))
+            .collect();
+        Some((
+            "energy",
+            serde_json::json!({
+                "total_pj": self.total_pj(),
+                "power_mw": self.power_mw(),
+                "events": events,
+                "functions": functions,
+            }),
+        ))
+    }
+    fn counters(&self) -> &'static [&'static str] {
+        &["total_pj", "events.*.*"]
+    }
+}
+
+impl StatView for &'_ EnergyStat {
+    fn header(&self) -> &'static str {
+        "energy"
+    }
+    fn width(&self) -> usize {
+        2 + 24 + 14 + 14
+    }
+}
+
+impl fmt::Display for &'_ EnergyStat {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        let total = self.total_pj();
+        writeln!(f, "  total: {:>15.3} nJ", total * 1e-3)?;
+        writeln!(f, "  average power: {:>7.3} mW", self.power_mw())?;
+        writeln!(f, "  {:<24}{:>14}{:>14}", "event", "count", "nJ")?;
+        for e in EnergyEvent::ALL {
+            let n = self.total[e as usize];
+            let nj = n as f64 * self.model.coefficients[e as usize] * 1e-3;
+            writeln!(f, "  {:<24}{n:>14}{nj:>14.3}", e.name())?;
+        }
+        if self.functions.is_empty() {
+            return writeln!(f, "  (debug symbol not provided)");
+        }
+        writeln!(f, "  {:<24}{:>14}{:>14}", "function", "nJ", "%")?;
+        for (label, pj) in self.functions.iter().take(NUM_SHOWN_FUNCTIONS) {
+            let percent = pj / total.max(f64::MIN_POSITIVE) * 100.0;
+            writeln!(f, "  {label:<24.24}{:>14.3}{percent:>14.2}", pj * 1e-3)?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_from_json() {
+        let mut config: serde_json::Value = EnergyEvent::ALL
+            .iter()
+            .map(|e| (e.name().to_string(), 1.0.into()))
+            .collect::<serde_json::Map<_, _>>()
+            .into();
+        config["ddr2"] = 100.0.into();
+        let model = EnergyModel::from_json(&config).unwrap();
+        let mut counts = [0; EnergyEvent::COUNT];
+        counts[EnergyEvent::Alu as usize] = 3;
+        counts[EnergyEvent::Ddr2 as usize] = 2;
+        assert_eq!(model.energy(&counts), 203.0);
+        config["fpu"] = 1.0.into();
+        assert!(EnergyModel::from_json(&config).is_err());
+        config.as_object_mut().unwrap().remove("fpu");
+        config.as_object_mut().unwrap().remove("stall");
+        assert!(EnergyModel::from_json(&config).is_err());
+    }
+}
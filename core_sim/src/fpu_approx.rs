@@ -0,0 +1,191 @@
+//! runtime parameters of the table-based approximations in fdiv and fsqrt.
+//!
+//! Both units look up a table by the upper bits of the mantissa and
+//! approximate the function on the segment by a polynomial. The key width,
+//! the order of the polynomial and the mantissa width of the stored
+//! coefficients trade FPGA resources against accuracy. The parameters are
+//! per thread, so that differently configured simulations can run side by
+//! side.
+
+use std::{fmt, str::FromStr};
+
+use anyhow::{bail, Result};
+use serde::Serialize;
+
+use crate::fpu_wrapper::fpu;
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Serialize)]
+pub struct Approx {
+    /// number of bits of the table key
+    pub key_bits: u32,
+    /// 0: table only, 1: linear, 2: quadratic
+    pub order: u32,
+    /// mantissa bits of the table coefficients (23: single precision)
+    pub coef_bits: u32,
+}
+
+impl Approx {
+    /// the parameters of the hardware
+    pub const HARDWARE: Self = Self {
+        key_bits: 10,
+        order: 1,
+        coef_bits: 23,
+    };
+}
+
+impl Default for Approx {
+    fn default() -> Self {
+        Self::HARDWARE
+    }
+}
+
+impl fmt::Display for Approx {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(
+            f,
+            "key {} bits, order {}, coef {} bits",
+            self.key_bits, self.order, self.coef_bits
+        )
+    }
+}
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Serialize)]
+#[serde(rename_all = "lowercase")]
+pub enum Unit {
+    Fdiv,
+    Fsqrt,
+}
+
+impl Unit {
+    pub const ALL: [Unit; 2] = [Unit::Fdiv, Unit::Fsqrt];
+}
+
+impl fmt::Display for Unit {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.write_str(match self {
+            Unit::Fdiv => "fdiv",
+            Unit::Fsqrt => "fsqrt",
+        })
+    }
+}
+
+impl FromStr for Unit {
+    type Err = String;
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s {
+            "fdiv" => Ok(Unit::Fdiv),
+            "fsqrt" => Ok(Unit::Fsqrt),
+            _ => Err(format!("unknown unit `{s}` (expected fdiv or fsqrt)")),
+        }
+    }
+}
+
+/// sets the parameters of `unit` for the calling thread.
+pub fn configure(unit: Unit, approx: Approx) -> Result<()> {
+    if !cfg!(feature = "fpu_sim") {
+        bail!("built without fpu_sim; the host FPU has no approximation to configure");
+    }
+    let Approx {
+        key_bits,
+        order,
+        coef_bits,
+    } = approx;
+    let set = match unit {
+        Unit::Fdiv => fpu::fdiv_set_approx,
+        Unit::Fsqrt => fpu::fsqrt_set_approx,
+    };
+    if !set(key_bits as i32, order as i32, coef_bits as i32) {
+        bail!("unsupported {unit} approximation ({approx})");
+    }
+    Ok(())
+}
+
+#[derive(Clone, Copy, Debug, Default, PartialEq, Serialize)]
+pub struct UlpError {
+    pub max: u32,
+    pub mean: f64,
+}
+
+/// distance in units in the last place; signs differing count as infinite.
+fn ulp_distance(x: f32, y: f32) -> u32 {
+    if x.is_sign_negative() != y.is_sign_negative() {
+        return u32::MAX;
+    }
+    x.to_bits().abs_diff(y.to_bits())
+}
+
+/// error of `unit` with the current parameters against the correctly
+/// rounded result, over `samples` random normal operands. Operands whose
+/// result is out of the normal range (or of the largest binade, where the
+/// hardware may overflow) are skipped.
+pub fn ulp_error(unit: Unit, samples: usize, seed: u64) -> UlpError {
+    // splitmix64
+    let mut state = seed;
+    let mut next = move || {
+        state = state.wrapping_add(0x9e3779b97f4a7c15);
+        let mut z = state;
+        z = (z ^ (z >> 30)).wrapping_mul(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94d049bb133111eb);
+        z ^ (z >> 31)
+    };
+    let mut normal = |sign: bool| {
+        let r = next();
+        let exp = 1 + (r >> 32) % 253;
+        let sign = if sign { r >> 63 } else { 0 };
+        f32::from_bits((sign << 31 | exp << 23 | (r & 0x7f_ffff)) as u32)
+    };
+    let (mut max, mut sum, mut n) = (0, 0u64, 0);
+    for _ in 0..samples {
+        let (expected, actual) = match unit {
+            Unit::Fdiv => {
+                let (x1, x2) = (normal(true), normal(true));
+                (x1 / x2, fpu::fdiv(x1, x2))
+            }
+            Unit::Fsqrt => {
+                let x = normal(false);
+                (x.sqrt(), fpu::fsqrt(x))
+            }
+        };
+        if !matches!(expected.to_bits() >> 23 & 0xff, 1..=253) {
+            continue;
+        }
+        let d = ulp_distance(expected, actual);
+        max = max.max(d);
+        sum += d as u64;
+        n += 1;
+    }
+    UlpError {
+        max,
+        mean: if n == 0 { 0.0 } else { sum as f64 / n as f64 },
+    }
+}
+
+#[cfg(all(test, feature = "fpu_sim"))]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_approx() {
+        let hw = ulp_error(Unit::Fdiv, 1 << 14, 1);
+        assert!(hw.max > 0 && hw.max < 64, "{hw:?}");
+        let coarse = Approx {
+            key_bits: 6,
+            ..Approx::HARDWARE
+        };
+        configure(Unit::Fdiv, coarse).unwrap();
+        assert!(ulp_error(Unit::Fdiv, 1 << 14, 1).max > hw.max);
+        let quad = Approx { order: 2, ..coarse };
+        configure(Unit::Fdiv, quad).unwrap();
+        assert!(ulp_error(Unit::Fdiv, 1 << 14, 1).max < hw.max * 4);
+        configure(Unit::Fdiv, Approx::HARDWARE).unwrap();
+        assert_eq!(ulp_error(Unit::Fdiv, 1 << 14, 1), hw);
+        assert!(configure(
+            Unit::Fsqrt,
+            Approx {
+                key_bits: 1,
+                ..coarse
+            }
+        )
+        .is_err());
+    }
+}
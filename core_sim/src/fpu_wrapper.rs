@@ -9,6 +9,16 @@ mod binding {
 #[allow(unused)]
 pub mod fpu {
     use super::*;
+    #[inline]
+    pub fn fadd(arg1: f32, arg2: f32) -> f32 {
+        unsafe { binding::fadd(arg1, arg2) }
+    }
+
+    #[inline]
+    pub fn fsub(arg1: f32, arg2: f32) -> f32 {
+        unsafe { binding::fsub(arg1, arg2) }
+    }
+
     #[inline]
     pub fn fmul(arg1: f32, arg2: f32) -> f32 {
         unsafe { binding::fmul(arg1, arg2) }
@@ -53,11 +63,31 @@ pub mod fpu {
     pub fn finv(arg1: f32) -> f32 {
         unsafe { binding::fdiv(1.0, arg1) }
     }
+
+    /// returns false if the parameters are out of range.
+    pub fn fdiv_set_approx(key_bits: i32, order: i32, coef_bits: i32) -> bool {
+        unsafe { binding::fdiv_set_approx(key_bits, order, coef_bits) == 0 }
+    }
+
+    /// returns false if the parameters are out of range.
+    pub fn fsqrt_set_approx(key_bits: i32, order: i32, coef_bits: i32) -> bool {
+        unsafe { binding::fsqrt_set_approx(key_bits, order, coef_bits) == 0 }
+    }
 }
 
 #[cfg(not(feature = "fpu_sim"))]
 #[allow(unused)]
 pub mod fpu {
+    #[inline]
+    pub fn fadd(arg1: f32, arg2: f32) -> f32 {
+        arg1 + arg2
+    }
+
+    #[inline]
+    pub fn fsub(arg1: f32, arg2: f32) -> f32 {
+        arg1 - arg2
+    }
+
     #[inline]
     pub fn fmul(arg1: f32, arg2: f32) -> f32 {
         arg1 * arg2
@@ -92,4 +122,62 @@ pub mod fpu {
     pub fn fhalf(arg1: f32) -> f32 {
         arg1 * 0.5
     }
+
+    /// the host FPU has nothing to configure.
+    pub fn fdiv_set_approx(_: i32, _: i32, _: i32) -> bool {
+        false
+    }
+
+    /// the host FPU has nothing to configure.
+    pub fn fsqrt_set_approx(_: i32, _: i32, _: i32) -> bool {
+        false
+    }
+}
+
+#[cfg(all(test, feature = "fpu_sim"))]
+mod tests {
+    use super::fpu::{fadd, fsub};
+
+    /// flushes a denormal to zero of the same sign.
+    fn ftz(x: f32) -> f32 {
+        if x.is_subnormal() {
+            0.0f32.copysign(x)
+        } else {
+            x
+        }
+    }
+
+    #[test]
+    fn test_fadd() {
+        let min = f32::MIN_POSITIVE;
+        // denormal inputs and results are flushed to zero
+        assert_eq!(fadd(f32::from_bits(1), 1.0), 1.0);
+        assert_eq!(fadd(f32::from_bits(1), f32::from_bits(1)).to_bits(), 0);
+        assert_eq!(fadd(1.5 * min, -min).to_bits(), 0);
+        // results of exponent 1 and 255 leave the fast path, 2 does not
+        assert_eq!(fadd(3.0 * min, -2.0 * min), min);
+        assert_eq!(fadd(min, min), 2.0 * min);
+        let half_ulp = f32::from_bits(230 << 23);
+        assert_eq!(fadd(f32::MAX, half_ulp / 2.0), f32::MAX);
+        assert_eq!(fadd(f32::MAX, half_ulp), f32::INFINITY);
+        assert_eq!(fsub(-f32::MAX, f32::MAX), f32::NEG_INFINITY);
+        // otherwise rounding to nearest even, as the host does
+        let mut x = 0x2545f491u32;
+        let mut next = || {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            x
+        };
+        for _ in 0..100000 {
+            let a = f32::from_bits(next());
+            // exponents close to that of `a` cancel or round the most
+            let b = f32::from_bits((next() & 0x83ffffff) | (a.to_bits() & 0x7c000000));
+            let (want, got) = (ftz(ftz(a) + ftz(b)), fadd(a, b));
+            assert!(
+                want.to_bits() == got.to_bits() || want.is_nan() && got.is_nan(),
+                "{a:e} + {b:e}: {want:e} != {got:e}"
+            );
+        }
+    }
 }
@@ -0,0 +1,497 @@
+//! superinstructions: predecoded text and fused instruction pairs.
+//!
+//! The text is decoded once when the program is loaded, and an instruction
+//! making one of the [`FusedKind`] pairs with the next one is marked. In
+//! [`ExecuteMode::Run`](crate::common::ExecuteMode::Run) the CPU executes a
+//! marked pair by one handler, without decoding nor a round trip through
+//! the simulator loop between the two. Both instructions still retire one
+//! by one, so the statistics and the predicted clocks do not change.
+//!
+//! The pairs to fuse are the built-in set or those which were hot in a
+//! profiling run, whose stats dump (`--stat-json`) counts every pair.
+
+use std::ops::Range;
+
+use anyhow::{anyhow, Result};
+use bitmask_enum::bitmask;
+
+use crate::{common::Pc, instr::*, memory::Memory, register::RegId};
+
+/// share of the executed instructions the pairs of a kind should take in
+/// a profiling run to be fused
+pub const MIN_PROFILED_SHARE: f64 = 0.01;
+
+/// pc granularity of [`Predecoded`]
+const SHIFT: u32 = if cfg!(feature = "compressed") { 1 } else { 2 };
+
+/// an instruction and the next one executed by one handler
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum FusedKind {
+    /// `slt`, `slti` or `flt`, then `beq`/`bne` of the result against zero
+    CmpBranch,
+    /// `addi`/`ori` from zero, then `slli`, `addi` or `ori` of the result
+    ConstBuild,
+    /// `lw`, then an integer ALU instruction reading the loaded value
+    LoadUse,
+    /// `flw`, then `fmul` reading the loaded value
+    FlwFmul,
+}
+
+pub const FUSED_KINDS: [FusedKind; 4] = [
+    FusedKind::CmpBranch,
+    FusedKind::ConstBuild,
+    FusedKind::LoadUse,
+    FusedKind::FlwFmul,
+];
+
+impl FusedKind {
+    pub fn name(self) -> &'static str {
+        match self {
+            FusedKind::CmpBranch => "cmp_branch",
+            FusedKind::ConstBuild => "const_build",
+            FusedKind::LoadUse => "load_use",
+            FusedKind::FlwFmul => "flw_fmul",
+        }
+    }
+    fn flag(self) -> Fusions {
+        match self {
+            FusedKind::CmpBranch => Fusions::CmpBranch,
+            FusedKind::ConstBuild => Fusions::ConstBuild,
+            FusedKind::LoadUse => Fusions::LoadUse,
+            FusedKind::FlwFmul => Fusions::FlwFmul,
+        }
+    }
+    fn index(self) -> usize {
+        self as usize
+    }
+}
+
+/// set of [`FusedKind`]s to fuse
+#[bitmask(u8)]
+pub enum Fusions {
+    CmpBranch,
+    ConstBuild,
+    LoadUse,
+    FlwFmul,
+}
+
+impl Fusions {
+    /// every kind
+    pub fn builtin() -> Self {
+        FUSED_KINDS.iter().fold(Self::none(), |s, k| s | k.flag())
+    }
+    /// kinds whose pairs took at least [`MIN_PROFILED_SHARE`] of the
+    /// instructions in the run dumped to `stats`.
+    pub fn from_profile(stats: &serde_json::Value) -> Result<Self> {
+        let instrs = stats["sim"]["cycles"]
+            .as_u64()
+            .ok_or_else(|| anyhow!("the stats dump has no executed instruction count"))?;
+        let pairs = &stats["fusion"]["pairs"];
+        if !pairs.is_object() {
+            return Err(anyhow!("the stats dump has no fusion profile"));
+        }
+        let mut s = Self::none();
+        for k in FUSED_KINDS {
+            let n = pairs[k.name()].as_u64().unwrap_or(0);
+            if (2 * n) as f64 >= MIN_PROFILED_SHARE * instrs as f64 && n > 0 {
+                s |= k.flag();
+            }
+        }
+        Ok(s)
+    }
+    pub fn fuses(&self, k: FusedKind) -> bool {
+        self.contains(k.flag())
+    }
+}
+
+/// the kind of the pair `a` makes with `b` following it, if any
+pub fn classify(a: &DecodedInstr, b: &DecodedInstr) -> Option<FusedKind> {
+    use FusedKind::*;
+    use Instr::*;
+    let reads = |rd: &RegId| match b {
+        R { rs1, rs2, .. } => rs1 == rd || rs2 == rd,
+        I { instr, rs1, .. } => !matches!(instr, IInstr::Lw | IInstr::Jalr) && rs1 == rd,
+        _ => false,
+    };
+    match (a, b) {
+        (
+            _,
+            B {
+                instr: BInstr::Beq | BInstr::Bne,
+                rs1,
+                rs2,
+                ..
+            },
+        ) => {
+            let rd = compared(a)?;
+            (!rd.is_zero() && ((*rs1 == rd && rs2.is_zero()) || (*rs2 == rd && rs1.is_zero())))
+                .then_some(CmpBranch)
+        }
+        (
+            I {
+                instr: head,
+                rd,
+                rs1,
+                ..
+            },
+            I {
+                instr: tail,
+                rd: rd2,
+                rs1: rs2,
+                ..
+            },
+        ) if is_const_head(*head)
+            && is_const_tail(*tail)
+            && rs1.is_zero()
+            && !rd.is_zero()
+            && rd2 == rd
+            && rs2 == rd =>
+        {
+            Some(ConstBuild)
+        }
+        (
+            I {
+                instr: IInstr::Lw,
+                rd,
+                ..
+            },
+            _,
+        ) if !rd.is_zero() && reads(rd) => Some(LoadUse),
+        (
+            F(FInstr::Flw { rd, .. }),
+            F(FInstr::E {
+                instr: EInstr::Fmul,
+                rs1,
+                rs2,
+                ..
+            }),
+        ) if rs1 == rd || rs2 == rd => Some(FlwFmul),
+        _ => None,
+    }
+}
+
+/// the destination of a comparison
+fn compared(a: &DecodedInstr) -> Option<RegId> {
+    match a {
+        #[cfg(not(feature = "isa_2nd"))]
+        Instr::R {
+            instr: RInstr::Slt,
+            rd,
+            ..
+        }
+        | Instr::I {
+            instr: IInstr::Slti,
+            rd,
+            ..
+        } => Some(*rd),
+        Instr::F(FInstr::K {
+            instr: KInstr::Flt,
+            rd,
+            ..
+        }) => Some(*rd),
+        _ => None,
+    }
+}
+
+fn is_const_head(i: IInstr) -> bool {
+    match i {
+        IInstr::Addi => true,
+        #[cfg(not(feature = "isa_2nd"))]
+        IInstr::Ori => true,
+        _ => false,
+    }
+}
+
+fn is_const_tail(i: IInstr) -> bool {
+    is_const_head(i) || matches!(i, IInstr::Slli)
+}
+
+pub struct Slot {
+    pub bin: u32,
+    pub instr: DecodedInstr,
+    /// length in bytes
+    pub len: u32,
+    /// the kind of the pair made with the next instruction
+    pub pair: Option<FusedKind>,
+    /// whether the pair is executed fused
+    pub fused: bool,
+    /// whether the load needs no type check; see `type_elision`
+    pub ty_proven: bool,
+}
+
+/// the text decoded at load time, indexed by pc
+#[derive(Default)]
+pub struct Predecoded {
+    begin: usize,
+    slots: Vec<Option<Slot>>,
+}
+
+impl Predecoded {
+    pub fn new<const SIZE: usize>(memory: &Memory<SIZE>, text: Range<u32>) -> Self {
+        let mut s = Self {
+            begin: text.start as usize,
+            slots: (0..(text.end - text.start) >> SHIFT)
+                .map(|_| None)
+                .collect(),
+        };
+        let mut pc = Pc::new(text.start);
+        let mut prev: Option<usize> = None;
+        while pc.into_inner() < text.end {
+            let Ok(bin) = memory.get_from_pc(pc) else {
+                break;
+            };
+            let i = s.index(pc);
+            let start = pc.into_inner();
+            #[cfg(feature = "compressed")]
+            let bin = if bin & 0b11 != 0b11 {
+                pc.incr_by(2);
+                crate::compressed::expand(bin as u16).unwrap_or(bin & 0xffff)
+            } else {
+                pc.incr();
+                bin
+            };
+            #[cfg(not(feature = "compressed"))]
+            pc.incr();
+            s.slots[i] = Instr::decode_from(bin).ok().map(|instr| Slot {
+                bin,
+                instr,
+                len: pc.into_inner() - start,
+                pair: None,
+                fused: false,
+                ty_proven: false,
+            });
+            if let (Some(p), Some(slot)) = (prev, &s.slots[i]) {
+                let pair = classify(&s.slots[p].as_ref().unwrap().instr, &slot.instr);
+                s.slots[p].as_mut().unwrap().pair = pair;
+            }
+            prev = s.slots[i].is_some().then_some(i);
+        }
+        s
+    }
+    fn index(&self, pc: Pc) -> usize {
+        pc.into_usize().wrapping_sub(self.begin) >> SHIFT
+    }
+    /// the slot at `pc` if the instruction there is still `bin`
+    #[inline]
+    pub fn get(&self, pc: Pc, bin: u32) -> Option<&Slot> {
+        self.slots
+            .get(self.index(pc))?
+            .as_ref()
+            .filter(|s| s.bin == bin)
+    }
+    /// the slot starting at `pc`
+    pub fn slot(&self, pc: u32) -> Option<&Slot> {
+        if pc % (1 << SHIFT) != 0 {
+            return None;
+        }
+        self.slots.get(self.index(Pc::new(pc)))?.as_ref()
+    }
+    pub fn slot_mut(&mut self, pc: u32) -> Option<&mut Slot> {
+        if pc % (1 << SHIFT) != 0 {
+            return None;
+        }
+        let i = self.index(Pc::new(pc));
+        self.slots.get_mut(i)?.as_mut()
+    }
+    /// the decoded instructions with their pcs
+    pub fn iter(&self) -> impl Iterator<Item = (u32, &Slot)> {
+        let begin = self.begin as u32;
+        self.slots
+            .iter()
+            .enumerate()
+            .filter_map(move |(i, s)| Some((begin + ((i as u32) << SHIFT), s.as_ref()?)))
+    }
+    pub fn set_fusions(&mut self, fusions: Fusions) {
+        for s in self.slots.iter_mut().flatten() {
+            s.fused = s.pair.is_some_and(|k| fusions.fuses(k));
+        }
+    }
+    /// whether the type of the load at `pc` is proven, if the instruction
+    /// there is still `bin`
+    #[inline]
+    pub fn ty_proven(&self, pc: Pc, bin: u32) -> bool {
+        self.get(pc, bin).is_some_and(|s| s.ty_proven)
+    }
+    /// makes every load check the type again
+    pub fn check_all_types(&mut self) {
+        for s in self.slots.iter_mut().flatten() {
+            s.ty_proven = false;
+        }
+    }
+}
+
+#[cfg(feature = "stat")]
+pub use stat::FusionStat;
+
+#[cfg(feature = "stat")]
+mod stat {
+    use std::fmt;
+
+    use super::*;
+    use crate::stat::*;
+
+    /// executed pairs of each [`FusedKind`], fused or not
+    #[derive(Clone, Copy)]
+    pub struct FusionStat {
+        pairs: [usize; FUSED_KINDS.len()],
+        fusions: Fusions,
+    }
+
+    impl FusionStat {
+        pub fn new(fusions: Fusions) -> Self {
+            Self {
+                pairs: [0; FUSED_KINDS.len()],
+                fusions,
+            }
+        }
+        #[inline]
+        pub fn encounter(&mut self, k: FusedKind) {
+            self.pairs[k.index()] += 1;
+        }
+        pub fn set_fusions(&mut self, fusions: Fusions) {
+            self.fusions = fusions;
+        }
+    }
+
+    impl Stat for FusionStat {
+        fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+            Box::new(self)
+        }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            let pairs: serde_json::Map<_, _> = FUSED_KINDS
+                .iter()
+                .map(|k| (k.name().to_string(), self.pairs[k.index()].into()))
+                .collect();
+            let fused: Vec<_> = FUSED_KINDS
+                .iter()
+                .filter(|k| self.fusions.fuses(**k))
+                .map(|k| k.name())
+                .collect();
+            Some((
+                "fusion",
+                serde_json::json!({ "pairs": pairs, "fused": fused }),
+            ))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["pairs.*"]
+        }
+    }
+
+    impl StatView for &'_ FusionStat {
+        fn header(&self) -> &'static str {
+            "instruction pairs"
+        }
+        fn width(&self) -> usize {
+            33
+        }
+    }
+
+    impl fmt::Display for &'_ FusionStat {
+        fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+            for k in FUSED_KINDS {
+                let fused = if self.fusions.fuses(k) { "fused" } else { "" };
+                writeln!(
+                    f,
+                    "  {:<12}{:>12}  {fused}",
+                    k.name(),
+                    self.pairs[k.index()]
+                )?;
+            }
+            Ok(())
+        }
+    }
+}
+
+#[cfg(all(test, not(feature = "isa_2nd")))]
+mod tests {
+    use super::*;
+
+    fn decode(bin: u32) -> DecodedInstr {
+        Instr::decode_from(bin).unwrap()
+    }
+
+    #[test]
+    fn test_classify() {
+        // slt t0, a0, a1; bne t0, zero, 8
+        let slt = decode(0x00b522b3);
+        let bne = decode(0x00029463);
+        assert_eq!(classify(&slt, &bne), Some(FusedKind::CmpBranch));
+        // addi t0, zero, 3; slli t0, t0, 4
+        let li = decode(0x00300293);
+        let slli = decode(0x00429293);
+        assert_eq!(classify(&li, &slli), Some(FusedKind::ConstBuild));
+        // lw t0, 0(a0); add a1, a1, t0
+        let lw = decode(0x00052283);
+        let add = decode(0x005585b3);
+        assert_eq!(classify(&lw, &add), Some(FusedKind::LoadUse));
+        // the branch does not read the loaded value
+        assert_eq!(classify(&lw, &bne), None);
+        assert_eq!(classify(&slli, &li), None);
+    }
+
+    #[test]
+    fn test_from_profile() {
+        let stats = serde_json::json!({
+            "sim": { "cycles": 1000 },
+            "fusion": { "pairs": { "cmp_branch": 100, "load_use": 4, "flw_fmul": 0 } },
+        });
+        let f = Fusions::from_profile(&stats).unwrap();
+        assert!(f.fuses(FusedKind::CmpBranch));
+        assert!(!f.fuses(FusedKind::ConstBuild));
+        assert!(!f.fuses(FusedKind::LoadUse));
+        assert!(Fusions::builtin().fuses(FusedKind::FlwFmul));
+        assert!(Fusions::from_profile(&serde_json::json!({})).is_err());
+    }
+
+    #[test]
+    fn test_fused_run() {
+        // a loop over 8 words and 8 floats of every kind of pair, stored and
+        // output at the end
+        let data: Vec<u32> = (1..=8)
+            .chain((0..8).map(|i| (i as f32 + 1.5).to_bits()))
+            .chain([0, 0])
+            .collect();
+        let text = [
+            0x00000293, // addi t0, zero, 0
+            0x00000313, // addi t1, zero, 0
+            0x00000413, // addi s0, zero, 0
+            0x00902087, // flw f1, 9(zero)
+            0x01400613, // addi a2, zero, 20
+            0x00100393, // loop: addi t2, zero, 1
+            0x00339393, // slli t2, t2, 3
+            0x00042483, // lw s1, 0(s0)
+            0x00930333, // add t1, t1, s1
+            0x00842107, // flw f2, 8(s0)
+            0x101101d3, // fmul f3, f2, f1
+            0x00320253, // fadd f4, f4, f3
+            0x00140413, // addi s0, s0, 1
+            0x00742533, // slt a0, s0, t2
+            0xfc051ee3, // bne a0, zero, loop
+            0x00000413, // addi s0, zero, 0
+            0x00128293, // addi t0, t0, 1
+            0x00c2a5b3, // slt a1, t0, a2
+            0xfc0596e3, // bne a1, zero, loop
+            0x00602823, // sw t1, 16(zero)
+            0x004028a7, // fsw f4, 17(zero)
+            0x0003002b, // outb t1
+            0,
+        ];
+        let run = |fusions| {
+            let mut sim = crate::sim::test_sim(&data, &text, &[]);
+            sim.set_fusions(fusions);
+            sim.run_to_end();
+            sim
+        };
+        let fused = run(Fusions::builtin());
+        let plain = run(Fusions::none());
+        let (fused, plain) = (fused.cpu(), plain.cpu());
+        assert_eq!(fused.reg_file().dump(), plain.reg_file().dump());
+        assert_eq!(fused.memory_bytes(), plain.memory_bytes());
+        assert_eq!(fused.output().as_bytes(), plain.output().as_bytes());
+        assert_eq!(fused.output().as_bytes(), [(20 * 36) as u8]);
+        #[cfg(feature = "stat")]
+        assert_eq!(fused.i_stat.counts(), plain.i_stat.counts());
+        #[cfg(feature = "time_predict")]
+        assert_eq!(fused.clock(), plain.clock());
+    }
+}
@@ -0,0 +1,294 @@
+//! coverage-guided fuzzing of programs on their input.
+//!
+//! Branches and jumps record an edge `(pc, target)` into a hit-count map.
+//! Between runs the simulator is rolled back in-process to a pristine
+//! snapshot, copying only the pages written by the previous run. Inputs
+//! reaching a new edge (or a new hit-count bucket of one) join the corpus,
+//! and the next input is mutated from a corpus entry by the mutation hooks.
+
+use crate::{
+    common::{ExecuteMode, RunStep, SimulationOption},
+    io::{BinaryInput, BinaryOutput},
+    sim::{BreakReason, ControlFlow, OnBreak, Simulator, Snapshot},
+};
+
+pub const COVERAGE_MAP_SIZE: usize = 1 << 16;
+
+/// hit counts of control-flow edges, indexed by a hash of the edge.
+pub struct Coverage {
+    hits: Vec<u8>,
+}
+
+impl Coverage {
+    pub fn new() -> Self {
+        Self {
+            hits: vec![0; COVERAGE_MAP_SIZE],
+        }
+    }
+    #[inline]
+    pub fn edge(&mut self, from: u32, to: u32) {
+        let i = ((from >> 2) ^ (to >> 2).rotate_left(8)) as usize & (COVERAGE_MAP_SIZE - 1);
+        self.hits[i] = self.hits[i].saturating_add(1);
+    }
+    pub fn clear(&mut self) {
+        self.hits.fill(0);
+    }
+}
+
+impl Default for Coverage {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// coarse hit count, so that only a change of magnitude counts as new.
+fn bucket(hits: u8) -> u8 {
+    match hits {
+        0 => 0,
+        1 => 1,
+        2 => 2,
+        3 => 4,
+        4..=7 => 8,
+        8..=15 => 16,
+        16..=31 => 32,
+        32..=127 => 64,
+        _ => 128,
+    }
+}
+
+/// xorshift64*
+pub struct Rng(u64);
+
+impl Rng {
+    pub fn new(seed: u64) -> Self {
+        Self(seed.max(1))
+    }
+    pub fn next_u64(&mut self) -> u64 {
+        self.0 ^= self.0 >> 12;
+        self.0 ^= self.0 << 25;
+        self.0 ^= self.0 >> 27;
+        self.0.wrapping_mul(0x2545f4914f6cdd1d)
+    }
+    /// uniform in `0..n` (`n > 0`)
+    pub fn below(&mut self, n: usize) -> usize {
+        (self.next_u64() % n as u64) as usize
+    }
+}
+
+/// mutates an input in place.
+pub type MutationHook = Box<dyn FnMut(&mut Vec<u8>, &mut Rng)>;
+
+const INTERESTING_WORDS: [u32; 8] = [
+    0,
+    1,
+    u32::MAX,
+    0x7fff_ffff,
+    0x8000_0000,
+    0x3f80_0000, // 1.0
+    0xbf80_0000, // -1.0
+    0x7f80_0000, // inf
+];
+
+/// word-oriented mutations, as programs read their input by `inw`/`finw`.
+pub fn builtin_mutation(input: &mut Vec<u8>, rng: &mut Rng) {
+    let words = input.len() / 4;
+    match rng.below(6) {
+        0 | 1 if !input.is_empty() => {
+            let i = rng.below(input.len());
+            input[i] ^= 1 << rng.below(8);
+        }
+        2 if words > 0 => {
+            let i = rng.below(words) * 4;
+            let w = u32::from_le_bytes(input[i..i + 4].try_into().unwrap());
+            let delta = rng.below(35) as u32;
+            let w = if rng.below(2) == 0 {
+                w.wrapping_add(delta + 1)
+            } else {
+                w.wrapping_sub(delta + 1)
+            };
+            input[i..i + 4].copy_from_slice(&w.to_le_bytes());
+        }
+        3 if words > 0 => {
+            let i = rng.below(words) * 4;
+            let w = INTERESTING_WORDS[rng.below(INTERESTING_WORDS.len())];
+            input[i..i + 4].copy_from_slice(&w.to_le_bytes());
+        }
+        4 if words > 1 => {
+            let i = rng.below(words) * 4;
+            input.drain(i..i + 4);
+        }
+        _ => {
+            let i = rng.below(words + 1) * 4;
+            let w = rng.next_u64() as u32;
+            input.splice(i..i, w.to_le_bytes());
+        }
+    }
+}
+
+#[derive(Clone, PartialEq, Eq, Debug)]
+pub enum Outcome {
+    Exit,
+    Failed(String),
+    /// did not finish within the cycle budget
+    Timeout,
+}
+
+pub struct Execution {
+    pub outcome: Outcome,
+    /// bytes written by `outb`
+    pub output: Vec<u8>,
+    /// set if the input reached new coverage and joined the corpus
+    pub new_coverage: bool,
+    /// set if the reference program behaved differently
+    pub diverged: bool,
+}
+
+/// a program ready to run repeatedly from the same initial state.
+struct Runner {
+    sim: Simulator<BinaryInput, BinaryOutput>,
+    pristine: Snapshot,
+}
+
+impl Runner {
+    fn new(program: &[u8]) -> anyhow::Result<Self> {
+        let mut sim = Simulator::new(program, BinaryInput::new(vec![]), BinaryOutput::new())?;
+        let pristine = sim.snapshot();
+        Ok(Self { sim, pristine })
+    }
+    fn run(&mut self, input: &[u8], max_cycles: usize) -> (Outcome, Vec<u8>) {
+        self.sim.reset(&self.pristine);
+        let (i, o) = self.sim.cpu_mut().io_mut();
+        *i = BinaryInput::new(input.to_vec());
+        *o = BinaryOutput::new();
+        self.sim.cpu_mut().coverage.clear();
+        let opt = SimulationOption {
+            mode: ExecuteMode::RunStep(RunStep::new(Some(max_cycles))),
+            ..Default::default()
+        };
+        let outcome = match self.sim.single_cycle(&opt) {
+            Ok(ControlFlow::Exit) => Outcome::Exit,
+            Ok(ControlFlow::Break(OnBreak {
+                reason: BreakReason::StepEnded,
+                ..
+            })) => Outcome::Timeout,
+            Ok(ControlFlow::Break(_)) => {
+                Outcome::Failed(self.sim.get_error_msg().unwrap_or_default())
+            }
+            Err(e) => Outcome::Failed(e.to_string()),
+        };
+        let output = std::mem::take(self.sim.cpu_mut().io_mut().1).into_inner();
+        (outcome, output)
+    }
+}
+
+pub struct Fuzzer {
+    target: Runner,
+    /// program whose outcome and output the target must agree with
+    reference: Option<Runner>,
+    /// hit-count buckets seen so far, per edge
+    virgin: Vec<u8>,
+    corpus: Vec<Vec<u8>>,
+    hooks: Vec<MutationHook>,
+    rng: Rng,
+    max_cycles: usize,
+    pub execs: u64,
+}
+
+impl Fuzzer {
+    pub fn new(program: &[u8], max_cycles: usize, seed: u64) -> anyhow::Result<Self> {
+        Ok(Self {
+            target: Runner::new(program)?,
+            reference: None,
+            virgin: vec![0; COVERAGE_MAP_SIZE],
+            corpus: vec![],
+            hooks: vec![Box::new(builtin_mutation)],
+            rng: Rng::new(seed),
+            max_cycles,
+            execs: 0,
+        })
+    }
+    pub fn set_reference(&mut self, program: &[u8]) -> anyhow::Result<()> {
+        self.reference = Some(Runner::new(program)?);
+        Ok(())
+    }
+    /// adds a hook to the builtin mutation; each mutation picks one hook.
+    pub fn add_hook(&mut self, hook: MutationHook) {
+        self.hooks.push(hook);
+    }
+    pub fn clear_hooks(&mut self) {
+        self.hooks.clear();
+    }
+    pub fn corpus(&self) -> &[Vec<u8>] {
+        &self.corpus
+    }
+    /// number of distinct edges seen
+    pub fn edges(&self) -> usize {
+        self.virgin.iter().filter(|&&b| b != 0).count()
+    }
+    /// runs `input`, keeping it in the corpus if it reaches new coverage.
+    pub fn run(&mut self, input: Vec<u8>) -> Execution {
+        self.execs += 1;
+        let (outcome, output) = self.target.run(&input, self.max_cycles);
+        let mut new_coverage = false;
+        let hits = &self.target.sim.cpu_mut().coverage.hits;
+        // most of the map is untouched; skip it a word at a time
+        for (v, h) in self.virgin.chunks_exact_mut(8).zip(hits.chunks_exact(8)) {
+            if u64::from_ne_bytes(h.try_into().unwrap()) == 0 {
+                continue;
+            }
+            for (v, &h) in v.iter_mut().zip(h) {
+                let b = bucket(h);
+                if *v & b != b {
+                    *v |= b;
+                    new_coverage = true;
+                }
+            }
+        }
+        let diverged = match &mut self.reference {
+            Some(r) => r.run(&input, self.max_cycles) != (outcome.clone(), output.clone()),
+            None => false,
+        };
+        if new_coverage {
+            self.corpus.push(input);
+        }
+        Execution {
+            outcome,
+            output,
+            new_coverage,
+            diverged,
+        }
+    }
+    /// mutates a corpus entry (an empty input if none) and runs it.
+    pub fn fuzz_one(&mut self) -> (Vec<u8>, Execution) {
+        let mut input = if self.corpus.is_empty() {
+            vec![]
+        } else {
+            self.corpus[self.rng.below(self.corpus.len())].clone()
+        };
+        if !self.hooks.is_empty() {
+            for _ in 0..=self.rng.below(4) {
+                let h = self.rng.below(self.hooks.len());
+                self.hooks[h](&mut input, &mut self.rng);
+            }
+        }
+        let exec = self.run(input.clone());
+        (input, exec)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_builtin_mutation() {
+        let mut rng = Rng::new(1);
+        let mut input = vec![0; 8];
+        for _ in 0..1000 {
+            builtin_mutation(&mut input, &mut rng);
+            assert!(!input.is_empty());
+        }
+        assert_ne!(bucket(3), bucket(4));
+        assert_eq!(bucket(5), bucket(6));
+    }
+}
@@ -1,8 +1,10 @@
 use core::fmt;
-use std::{fmt::Display, mem};
+use std::{cmp, fmt::Display, mem};
 
 use num_enum::UnsafeFromPrimitive;
 
+#[cfg(feature = "simd")]
+use crate::register::VRegId;
 use crate::register::{FRegId, RegId};
 
 /// represents instruction. immediates are sign-extended.
@@ -45,6 +47,15 @@ pub enum Instr<IR, IW, FR, FW> {
     },
     IO(IOInstr<IR, IW, FW>),
     F(FInstr<IR, IW, FR, FW>),
+    /// atomic read-modify-write of the word at `rs1`; `rd` gets the old value
+    A {
+        instr: AInstr,
+        rd: IW,
+        rs1: IR,
+        rs2: IR,
+    },
+    #[cfg(feature = "simd")]
+    Q(QInstr<IR, FR, FW>),
     Misc(MiscInstr),
 }
 
@@ -52,7 +63,7 @@ pub struct InstrId(u8);
 
 impl InstrId {
     /// upper bound
-    pub const MAX: usize = (15 << 3) + 3;
+    pub const MAX: usize = (17 << 3) + 7;
     pub fn inner(&self) -> u8 {
         self.0
     }
@@ -86,6 +97,9 @@ impl TryFrom<u8> for InstrId {
             13 => lower < variant_count!(WInstr),
             14 => lower < variant_count!(VInstr),
             15 => lower < 3,
+            16 => lower < variant_count!(AInstr),
+            #[cfg(feature = "simd")]
+            17 => (lower as usize) < QInstr::<(), (), ()>::NAMES.len(),
             _ => false,
         };
         if b {
@@ -113,6 +127,7 @@ impl fmt::Display for InstrId {
                     0 => write!(f, "outb"),
                     1 => write!(f, "inw"),
                     2 => write!(f, "finw"),
+                    3 => write!(f, "csrr"),
                     _ => unreachable!("lower == {lower}"),
                 },
                 7 => write!(f, "{}", EInstr::unchecked_transmute_from(lower)),
@@ -129,6 +144,9 @@ impl fmt::Display for InstrId {
                     2 => write!(f, "end"),
                     _ => unreachable!("lower == {lower}"),
                 },
+                16 => write!(f, "{}", AInstr::unchecked_transmute_from(lower)),
+                #[cfg(feature = "simd")]
+                17 => f.write_str(QInstr::<(), (), ()>::NAMES[lower as usize]),
                 _ => unreachable!("upper == {upper}"),
             }
         }
@@ -155,6 +173,7 @@ impl<IR, IW, FR, FW> Instr<IR, IW, FR, FW> {
                     Outb { .. } => 0,
                     Inw { .. } => 1,
                     Finw { .. } => 2,
+                    Csrr { .. } => 3,
                 }
             } as u8),
             F(f) => match f {
@@ -169,6 +188,9 @@ impl<IR, IW, FR, FW> Instr<IR, IW, FR, FW> {
                 Flw { .. } => id(15, 0),
                 Fsw { .. } => id(15, 1),
             },
+            A { instr, .. } => id(16, *instr as u8),
+            #[cfg(feature = "simd")]
+            Q(q) => id(17, q.index()),
             Misc(MiscInstr::End) => id(15, 2),
         }
     }
@@ -176,6 +198,43 @@ impl<IR, IW, FR, FW> Instr<IR, IW, FR, FW> {
 
 pub type DecodedInstr = Instr<RegId, RegId, FRegId, FRegId>;
 
+/// how an instruction transfers control.
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum FlowKind {
+    /// conditional branch
+    Branch,
+    /// `jal`/`jalr` linking `ra`
+    Call,
+    /// `jalr zero, 0(ra)`
+    Return,
+    Other,
+}
+
+impl DecodedInstr {
+    pub fn flow_kind(&self) -> FlowKind {
+        use Instr::*;
+        match self {
+            B { .. } | P { .. } | F(FInstr::W { .. } | FInstr::V { .. }) => FlowKind::Branch,
+            J { rd, .. } if rd.inner() == 1 => FlowKind::Call,
+            I {
+                instr: IInstr::Jalr,
+                rd,
+                rs1,
+                ..
+            } => {
+                if rd.inner() == 1 {
+                    FlowKind::Call
+                } else if rd.is_zero() && rs1.inner() == 1 {
+                    FlowKind::Return
+                } else {
+                    FlowKind::Other
+                }
+            }
+            _ => FlowKind::Other,
+        }
+    }
+}
+
 impl<IR: Display, IW: Display, FR: Display, FW: Display> Display for Instr<IR, IW, FR, FW> {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         use Instr::*;
@@ -264,6 +323,18 @@ impl<IR: Display, IW: Display, FR: Display, FW: Display> Display for Instr<IR, I
                     Fsw { rs2, rs1, imm } => write!(f, "fsw {rs2}, {imm}({rs1})"),
                 }
             }
+            A {
+                instr: AInstr::Fence,
+                ..
+            } => write!(f, "fence"),
+            A {
+                instr,
+                rd,
+                rs1,
+                rs2,
+            } => write!(f, "{instr} {rd}, {rs2}, ({rs1})"),
+            #[cfg(feature = "simd")]
+            Q(q) => write!(f, "{q}"),
             Misc(MiscInstr::End) => write!(f, "end"),
         }
     }
@@ -335,6 +406,156 @@ pub enum MiscInstr {
     End,
 }
 
+#[derive(Debug, Clone, Copy, PartialEq, Eq, UnsafeFromPrimitive)]
+#[repr(u8)]
+pub enum AInstr {
+    Amoswap,
+    Amoadd,
+    Amoand,
+    Amoor,
+    Amomin,
+    Amomax,
+    /// orders memory accesses of the core; a no-op as the simulated memory
+    /// is sequentially consistent
+    Fence,
+}
+
+impl AInstr {
+    /// new value of the word from the old one and `rs2`.
+    pub fn apply(self, old: u32, rs2: u32) -> u32 {
+        use AInstr::*;
+        match self {
+            Amoswap => rs2,
+            Amoadd => old.wrapping_add(rs2),
+            Amoand => old & rs2,
+            Amoor => old | rs2,
+            Amomin => cmp::min(old as i32, rs2 as i32) as u32,
+            Amomax => cmp::max(old as i32, rs2 as i32) as u32,
+            Fence => old,
+        }
+    }
+}
+
+impl Display for AInstr {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        use AInstr::*;
+        let s = match self {
+            Amoswap => "amoswap",
+            Amoadd => "amoadd",
+            Amoand => "amoand",
+            Amoor => "amoor",
+            Amomin => "amomin",
+            Amomax => "amomax",
+            Fence => "fence",
+        };
+        f.write_str(s)
+    }
+}
+
+/// packed 4-lane float instructions of the simd extension. Loads and
+/// stores move `LANES` consecutive words.
+#[cfg(feature = "simd")]
+#[derive(Debug, Clone)]
+pub enum QInstr<IR, FR, FW> {
+    Vlw {
+        vd: VRegId,
+        rs1: IR,
+        imm: u32,
+    },
+    Vsw {
+        vs: VRegId,
+        rs1: IR,
+        imm: u32,
+    },
+    Vadd {
+        vd: VRegId,
+        vs1: VRegId,
+        vs2: VRegId,
+    },
+    Vmul {
+        vd: VRegId,
+        vs1: VRegId,
+        vs2: VRegId,
+    },
+    /// `vd = vs1 * vs2 + vs3`
+    Vfma {
+        vd: VRegId,
+        vs1: VRegId,
+        vs2: VRegId,
+        vs3: VRegId,
+    },
+    /// horizontal sum of the products into a float register
+    Vdot {
+        rd: FW,
+        vs1: VRegId,
+        vs2: VRegId,
+    },
+    /// copies `rs1` to every lane
+    Vsplat {
+        vd: VRegId,
+        rs1: FR,
+    },
+}
+
+#[cfg(feature = "simd")]
+impl<IR, FR, FW> QInstr<IR, FR, FW> {
+    /// mnemonics in the order of [`Self::index`]
+    pub const NAMES: [&'static str; 7] = ["vlw", "vsw", "vadd", "vmul", "vfma", "vdot", "vsplat"];
+    pub fn index(&self) -> u8 {
+        use QInstr::*;
+        match self {
+            Vlw { .. } => 0,
+            Vsw { .. } => 1,
+            Vadd { .. } => 2,
+            Vmul { .. } => 3,
+            Vfma { .. } => 4,
+            Vdot { .. } => 5,
+            Vsplat { .. } => 6,
+        }
+    }
+    /// vector register written, if any.
+    pub fn vd(&self) -> Option<VRegId> {
+        use QInstr::*;
+        match *self {
+            Vlw { vd, .. }
+            | Vadd { vd, .. }
+            | Vmul { vd, .. }
+            | Vfma { vd, .. }
+            | Vsplat { vd, .. } => Some(vd),
+            Vsw { .. } | Vdot { .. } => None,
+        }
+    }
+    /// vector registers read.
+    pub fn vsrcs(&self) -> impl Iterator<Item = VRegId> {
+        use QInstr::*;
+        let srcs = match *self {
+            Vsw { vs, .. } => [Some(vs), None, None],
+            Vadd { vs1, vs2, .. } | Vmul { vs1, vs2, .. } | Vdot { vs1, vs2, .. } => {
+                [Some(vs1), Some(vs2), None]
+            }
+            Vfma { vs1, vs2, vs3, .. } => [Some(vs1), Some(vs2), Some(vs3)],
+            Vlw { .. } | Vsplat { .. } => [None; 3],
+        };
+        srcs.into_iter().flatten()
+    }
+}
+
+#[cfg(feature = "simd")]
+impl<IR: Display, FR: Display, FW: Display> Display for QInstr<IR, FR, FW> {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        use QInstr::*;
+        let name = Self::NAMES[self.index() as usize];
+        match self {
+            Vlw { vd, rs1, imm } => write!(f, "{name} {vd}, {imm}({rs1})", imm = *imm as i32),
+            Vsw { vs, rs1, imm } => write!(f, "{name} {vs}, {imm}({rs1})", imm = *imm as i32),
+            Vadd { vd, vs1, vs2 } | Vmul { vd, vs1, vs2 } => write!(f, "{name} {vd}, {vs1}, {vs2}"),
+            Vfma { vd, vs1, vs2, vs3 } => write!(f, "{name} {vd}, {vs1}, {vs2}, {vs3}"),
+            Vdot { rd, vs1, vs2 } => write!(f, "{name} {rd}, {vs1}, {vs2}"),
+            Vsplat { vd, rs1 } => write!(f, "{name} {vd}, {rs1}"),
+        }
+    }
+}
+
 cfg_if::cfg_if! {
     if #[cfg(feature = "isa_2nd")] {
         #[derive(Debug, Clone, Copy, UnsafeFromPrimitive)]
@@ -538,9 +759,86 @@ impl Display for JInstr {
 
 #[derive(Debug, Clone, Copy)]
 pub enum IOInstr<IR, IW, FW> {
-    Outb { rs: IR },
-    Inw { rd: IW },
-    Finw { rd: FW },
+    Outb {
+        rs: IR,
+    },
+    Inw {
+        rd: IW,
+    },
+    Finw {
+        rd: FW,
+    },
+    /// `csrrs rd, csr, zero`, reading a counter of the core
+    Csrr {
+        rd: IW,
+        csr: Csr,
+    },
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Counter {
+    /// clocks elapsed; 0 without `time_predict`
+    Cycle,
+    /// instructions retired
+    Instret,
+    /// data accesses missing the cache; 0 without `stat`
+    CacheMiss,
+    /// conditional branches mispredicted; 0 without `time_predict`
+    Mispredict,
+}
+
+/// a read-only counter register: the lower or upper half of a 64-bit
+/// counter, numbered as `cycle`, `instret`, `hpmcounter3` and `hpmcounter4`
+/// and their upper halves of the standard.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Csr {
+    pub counter: Counter,
+    pub high: bool,
+}
+
+impl Csr {
+    pub fn from_number(n: u32) -> Option<Self> {
+        let counter = match n & !0x80 {
+            0xC00 => Counter::Cycle,
+            0xC02 => Counter::Instret,
+            0xC03 => Counter::CacheMiss,
+            0xC04 => Counter::Mispredict,
+            _ => return None,
+        };
+        Some(Self {
+            counter,
+            high: n & 0x80 != 0,
+        })
+    }
+    pub fn number(self) -> u32 {
+        let n = match self.counter {
+            Counter::Cycle => 0xC00,
+            Counter::Instret => 0xC02,
+            Counter::CacheMiss => 0xC03,
+            Counter::Mispredict => 0xC04,
+        };
+        n | u32::from(self.high) << 7
+    }
+    /// the half of `v` this register reads
+    pub fn read(self, v: u64) -> u32 {
+        if self.high {
+            (v >> 32) as u32
+        } else {
+            v as u32
+        }
+    }
+}
+
+impl Display for Csr {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        let s = match self.counter {
+            Counter::Cycle => "cycle",
+            Counter::Instret => "instret",
+            Counter::CacheMiss => "hpmcounter3",
+            Counter::Mispredict => "hpmcounter4",
+        };
+        write!(f, "{s}{}", if self.high { "h" } else { "" })
+    }
 }
 
 impl<IR: Display, IW: Display, FW: Display> Display for IOInstr<IR, IW, FW> {
@@ -550,6 +848,7 @@ impl<IR: Display, IW: Display, FW: Display> Display for IOInstr<IR, IW, FW> {
             Outb { rs } => write!(f, "outb {rs}"),
             Inw { rd } => write!(f, "inw {rd}"),
             Finw { rd } => write!(f, "finw {rd}"),
+            Csrr { rd, csr } => write!(f, "csrr {rd}, {csr}"),
         }
     }
 }
@@ -0,0 +1,274 @@
+//! interval timing model.
+//!
+//! A mechanistic alternative to the pipeline model: every instruction takes
+//! one issue clock and the miss events of its execution add their
+//! penalties on top, with no pipeline state kept between instructions. The
+//! events are those a functional run yields anyway: the latency of FPU
+//! instructions, of cache hits and of DRAM misses, the flush after a
+//! mispredicted branch, and the bubbles of an instruction reading the load
+//! or FPU result of the one right before it.
+//!
+//! Runs with the detailed model may compute the interval estimate
+//! alongside when asked, and the stats report its error as a calibration.
+
+use std::str::FromStr;
+
+/// how the clocks are predicted
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Default)]
+pub enum TimingModel {
+    /// the five-stage pipeline, stall by stall
+    #[default]
+    Detailed,
+    /// one clock per instruction plus the penalties of miss events
+    Interval,
+}
+
+impl TimingModel {
+    pub fn name(self) -> &'static str {
+        match self {
+            Self::Detailed => "detailed",
+            Self::Interval => "interval",
+        }
+    }
+}
+
+impl FromStr for TimingModel {
+    type Err = String;
+    fn from_str(s: &str) -> Result<Self, String> {
+        match s {
+            "detailed" => Ok(Self::Detailed),
+            "interval" => Ok(Self::Interval),
+            _ => Err(format!(
+                "unknown timing model `{s}`; expected `detailed` or `interval`"
+            )),
+        }
+    }
+}
+
+/// clocks of the flush after a mispredicted branch or `jalr`
+pub const FLUSH_PENALTY: usize = 2;
+
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum Event {
+    /// multi-cycle execution of FPU instructions
+    FpuLatency,
+    /// memory access on cache hit
+    CacheHit,
+    /// memory access on cache miss
+    DramMiss,
+    /// mispredicted branch or `jalr`
+    Flush,
+    /// reading the loaded value right after the load
+    LoadUse,
+    /// reading an FPU result right after it was computed
+    FpuUse,
+}
+
+pub const EVENTS: [Event; 6] = [
+    Event::FpuLatency,
+    Event::CacheHit,
+    Event::DramMiss,
+    Event::Flush,
+    Event::LoadUse,
+    Event::FpuUse,
+];
+
+impl Event {
+    pub fn name(self) -> &'static str {
+        match self {
+            Self::FpuLatency => "fpu",
+            Self::CacheHit => "c.hit",
+            Self::DramMiss => "dram",
+            Self::Flush => "flush",
+            Self::LoadUse => "ld.use",
+            Self::FpuUse => "fpu.use",
+        }
+    }
+}
+
+/// what the interval model needs to know of a retired instruction
+pub struct Retired {
+    /// clocks in the execute stage
+    pub ex_cycles: usize,
+    /// clocks of the memory access: 1 for BRAM, 2 on cache hit, more on miss
+    pub ma_cycles: usize,
+    pub flush: bool,
+    /// the result of the previous instruction it waited for, and how long
+    pub waited: Option<(Event, usize)>,
+}
+
+/// clocks charged to each of [`EVENTS`]
+pub type Penalties = [usize; EVENTS.len()];
+
+#[derive(Clone, Copy, Default)]
+pub struct IntervalModel {
+    timing: TimingModel,
+    /// estimate alongside the detailed model
+    calibrating: bool,
+    instrs: usize,
+    counts: [usize; EVENTS.len()],
+    penalties: Penalties,
+    /// clocks of the detailed model over the same instructions
+    detailed: usize,
+}
+
+impl IntervalModel {
+    pub fn timing(&self) -> TimingModel {
+        self.timing
+    }
+    pub fn set_timing(&mut self, timing: TimingModel) {
+        self.timing = timing;
+    }
+    pub fn enable_calibration(&mut self) {
+        self.calibrating = true;
+    }
+    /// whether the instructions are to be [`Self::retire`]d: when the model
+    /// predicts the clocks or is calibrated against the detailed one
+    #[inline]
+    pub fn is_active(&self) -> bool {
+        self.timing == TimingModel::Interval || self.calibrating
+    }
+    /// the penalties of `r`, on top of its issue clock.
+    #[inline]
+    pub fn retire(&mut self, r: &Retired) -> Penalties {
+        let mut p = [0; EVENTS.len()];
+        p[Event::FpuLatency as usize] = r.ex_cycles.saturating_sub(1);
+        match r.ma_cycles {
+            0 | 1 => {}
+            2 => p[Event::CacheHit as usize] = 1,
+            n => p[Event::DramMiss as usize] = n - 1,
+        }
+        if r.flush {
+            p[Event::Flush as usize] = FLUSH_PENALTY;
+        }
+        if let Some((e, bubbles)) = r.waited {
+            p[e as usize] = bubbles;
+        }
+        self.instrs += 1;
+        for (i, &c) in p.iter().enumerate() {
+            self.counts[i] += usize::from(c > 0);
+            self.penalties[i] += c;
+        }
+        p
+    }
+    /// adds the clocks the detailed model predicted for the last instruction.
+    #[inline]
+    pub fn calibrate(&mut self, clocks: usize) {
+        self.detailed += clocks;
+    }
+    pub fn clocks(&self) -> usize {
+        self.instrs + self.penalties.iter().sum::<usize>()
+    }
+    /// relative error (%) of the interval estimate against the detailed
+    /// model, if it ran
+    pub fn error(&self) -> Option<f64> {
+        (self.timing == TimingModel::Detailed && self.detailed > 0)
+            .then(|| (self.clocks() as f64 - self.detailed as f64) / self.detailed as f64 * 100.0)
+    }
+}
+
+#[cfg(feature = "stat")]
+mod stat {
+    use std::fmt;
+
+    use super::*;
+    use crate::stat::*;
+
+    impl Stat for IntervalModel {
+        fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+            Box::new(self)
+        }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            let events: serde_json::Map<_, _> = EVENTS
+                .iter()
+                .map(|&e| {
+                    let v = serde_json::json!({
+                        "count": self.counts[e as usize],
+                        "clocks": self.penalties[e as usize],
+                    });
+                    (e.name().to_string(), v)
+                })
+                .collect();
+            let mut v = serde_json::json!({
+                "model": self.timing.name(),
+                "instrs": self.instrs,
+                "clocks": self.clocks(),
+                "events": events,
+            });
+            if let Some(error) = self.error() {
+                v["detailed_clocks"] = self.detailed.into();
+                v["error_percent"] = error.into();
+            }
+            Some(("interval", v))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["instrs", "clocks", "detailed_clocks", "events.*.*"]
+        }
+    }
+
+    impl StatView for &'_ IntervalModel {
+        fn header(&self) -> &'static str {
+            "interval model"
+        }
+        fn width(&self) -> usize {
+            33
+        }
+    }
+
+    impl fmt::Display for &'_ IntervalModel {
+        fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+            writeln!(f, "  {:<8}{:>12}{:>12}", "event", "count", "clocks")?;
+            writeln!(f, "  {:<8}{:>12}{:>12}", "issue", self.instrs, self.instrs)?;
+            for e in EVENTS {
+                let i = e as usize;
+                writeln!(
+                    f,
+                    "  {:<8}{:>12}{:>12}",
+                    e.name(),
+                    self.counts[i],
+                    self.penalties[i]
+                )?;
+            }
+            writeln!(f, "  clocks: {:>10}", self.clocks())?;
+            if let Some(error) = self.error() {
+                writeln!(f, "  detailed: {:>8}  ({error:+.2}%)", self.detailed)?;
+            }
+            Ok(())
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_retire() {
+        let mut m = IntervalModel::default();
+        // fdiv waiting for the flw right before it
+        let p = m.retire(&Retired {
+            ex_cycles: 11,
+            ma_cycles: 1,
+            flush: false,
+            waited: Some((Event::LoadUse, 1)),
+        });
+        assert_eq!(p.iter().sum::<usize>(), 11);
+        // a mispredicted branch, then a load missing the cache
+        m.retire(&Retired {
+            ex_cycles: 1,
+            ma_cycles: 1,
+            flush: true,
+            waited: None,
+        });
+        m.retire(&Retired {
+            ex_cycles: 1,
+            ma_cycles: 90,
+            flush: false,
+            waited: None,
+        });
+        assert_eq!(m.clocks(), 3 + 11 + FLUSH_PENALTY + 89);
+        m.calibrate(m.clocks() * 2);
+        assert_eq!(m.error(), Some(-50.0));
+        assert_eq!("interval".parse(), Ok(TimingModel::Interval));
+    }
+}
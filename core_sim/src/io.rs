@@ -1,3 +1,5 @@
+use std::sync::Arc;
+
 use anyhow::{anyhow, Result};
 
 pub trait Input {
@@ -9,6 +11,7 @@ pub trait Output {
     fn outb(&mut self, c: u8) -> Result<()>;
 }
 
+#[derive(Clone)]
 pub struct EmptyIO {}
 
 impl EmptyIO {
@@ -39,34 +42,39 @@ impl Output for EmptyIO {
     }
 }
 
+/// cloned cheaply, sharing the content
+#[derive(Clone)]
 pub struct BinaryInput {
-    content: Vec<u8>,
+    content: Arc<[u8]>,
     read_index: usize,
 }
 
 impl Input for BinaryInput {
     fn inw(&mut self) -> Result<u32> {
-        let mut v: [u8; 4] = [0; 4];
-        let addr = self.read_index;
-        v[..4].copy_from_slice(&self.content[addr..(4 + addr)]);
-        Ok(u32::from_le_bytes(v))
+        self.read_word().map(u32::from_le_bytes)
     }
 
     fn finw(&mut self) -> Result<f32> {
-        let mut v: [u8; 4] = [0; 4];
-        let addr = self.read_index;
-        v[..4].copy_from_slice(&self.content[addr..(4 + addr)]);
-        Ok(f32::from_le_bytes(v))
+        self.read_word().map(f32::from_le_bytes)
     }
 }
 
 impl BinaryInput {
     pub fn new(content: Vec<u8>) -> Self {
         Self {
-            content,
+            content: content.into(),
             read_index: 0,
         }
     }
+    fn read_word(&mut self) -> Result<[u8; 4]> {
+        let addr = self.read_index;
+        let v = self
+            .content
+            .get(addr..addr + 4)
+            .ok_or_else(|| anyhow!("input exhausted at byte {addr}"))?;
+        self.read_index += 4;
+        Ok(v.try_into().unwrap())
+    }
 }
 
 pub struct BinaryOutput {
@@ -77,6 +85,9 @@ impl BinaryOutput {
     pub fn into_inner(self) -> Vec<u8> {
         self.content
     }
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.content
+    }
     pub fn new() -> Self {
         Self {
             content: Vec::new(),
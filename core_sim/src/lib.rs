@@ -1,13 +1,45 @@
 #![feature(variant_count)]
+#![cfg_attr(
+    all(feature = "simd", not(feature = "fpu_sim")),
+    feature(portable_simd)
+)]
+
+/// cargo features the simulator is built with.
+pub const FEATURES: &[&str] = &[
+    #[cfg(feature = "typed_memory")]
+    "typed_memory",
+    #[cfg(feature = "stat")]
+    "stat",
+    #[cfg(feature = "fpu_sim")]
+    "fpu_sim",
+    #[cfg(feature = "isa_2nd")]
+    "isa_2nd",
+    #[cfg(feature = "time_predict")]
+    "time_predict",
+    #[cfg(feature = "coverage")]
+    "coverage",
+    #[cfg(feature = "uninit_check")]
+    "uninit_check",
+    #[cfg(feature = "simd")]
+    "simd",
+    #[cfg(feature = "compressed")]
+    "compressed",
+];
+
+#[cfg(all(feature = "compressed", feature = "isa_2nd"))]
+compile_error!("the compressed encoding is defined for the first ISA only");
 
 mod bin;
 pub mod breakpoint;
 pub mod common;
+pub mod core_dump;
 pub mod cpu;
 pub mod debug_symbol;
+pub mod fuse;
 pub mod instr;
 pub mod io;
 pub mod memory;
+pub mod multicore;
 pub mod ppm;
 pub mod reg_file;
 pub mod register;
@@ -15,6 +47,7 @@ pub mod sim;
 pub mod sld;
 pub mod ty;
 
+pub mod fpu_approx;
 mod fpu_wrapper;
 #[cfg(feature = "stat")]
 pub mod stat;
@@ -22,11 +55,56 @@ pub mod stat;
 #[cfg(feature = "stat")]
 pub mod cache;
 
+#[cfg(feature = "stat")]
+pub mod loops;
+
+#[cfg(feature = "stat")]
+pub mod redundancy;
+
+#[cfg(feature = "stat")]
+pub mod roi;
+
+#[cfg(feature = "stat")]
+pub mod sampler;
+
 #[cfg(not(feature = "isa_2nd"))]
 mod decode_instr;
 
 #[cfg(feature = "isa_2nd")]
 mod decode_instr_2nd;
 
+#[cfg(not(feature = "isa_2nd"))]
+pub mod compressed;
+
+#[cfg(not(feature = "isa_2nd"))]
+pub mod aot;
+
+#[cfg(feature = "time_predict")]
+pub mod branch_predictor;
+
 #[cfg(feature = "time_predict")]
-pub mod branch_predictor;
\ No newline at end of file
+pub mod interval;
+
+#[cfg(feature = "time_predict")]
+pub mod resim;
+
+#[cfg(all(feature = "stat", feature = "time_predict"))]
+pub mod cpi;
+
+#[cfg(all(feature = "stat", feature = "time_predict"))]
+pub mod energy;
+
+#[cfg(all(feature = "stat", feature = "time_predict"))]
+pub mod placement;
+
+#[cfg(feature = "coverage")]
+pub mod fuzz;
+
+#[cfg(feature = "uninit_check")]
+pub mod uninit;
+
+#[cfg(feature = "simd")]
+pub mod simd;
+
+#[cfg(feature = "typed_memory")]
+pub mod type_elision;
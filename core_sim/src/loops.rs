@@ -0,0 +1,423 @@
+//! dynamic loop-nest profiler.
+//!
+//! A loop is identified by a taken backward conditional branch (`B`, `P`,
+//! `W` or `V` format); its body is the pc range from the branch target (the
+//! head) to the branch itself. Each dynamic entry of a loop is tracked until
+//! the control leaves the body within the same call frame, and its trip
+//! count and the instructions/clocks spent in it are folded into a record
+//! per branch pc. Loops are grouped by the function they were first seen in
+//! and nested by containment of their bodies. Nothing is tracked unless
+//! enabled.
+
+use std::{collections::HashMap, fmt, ops::Range};
+
+use serde::Serialize;
+
+use crate::{common::Pc, debug_symbol::DebugSymbol, instr::FlowKind, stat::*};
+
+/// number of log2 buckets of trip counts (the last one is open-ended)
+const TRIP_BUCKETS: usize = 16;
+/// number of functions shown in the stat
+const NUM_SHOWN_FUNCTIONS: usize = 10;
+const NO_LOOP: u32 = u32::MAX;
+
+#[derive(Clone, Serialize)]
+pub struct LoopRecord {
+    /// entry pc of the function the loop was first seen in
+    function: u32,
+    head: u32,
+    branch: u32,
+    /// branch pc of the enclosing loop
+    parent: Option<u32>,
+    entries: u64,
+    /// sum of trip counts over all entries
+    trips: u64,
+    /// iterations covered by `instrs` and `clocks`
+    measured_iters: u64,
+    instrs: u64,
+    clocks: u64,
+    /// `trip_histogram[i]` counts entries with trip count in `[2^i, 2^(i+1))`
+    trip_histogram: [u64; TRIP_BUCKETS],
+}
+
+impl LoopRecord {
+    fn body(&self) -> Range<u32> {
+        self.head..self.branch + 4
+    }
+}
+
+struct Activation {
+    slot: u32,
+    /// call depth the loop runs at
+    depth: usize,
+    backedges: u64,
+    /// whether the activation started at the loop head (i.e. the first
+    /// iteration is covered)
+    from_head: bool,
+    instrs_at_entry: u64,
+    clocks_at_entry: u64,
+}
+
+/// the loops running on a core and its call frames. Each core has its own,
+/// swapped in by [`LoopProfiler::swap_core`] with the core.
+#[derive(Default)]
+pub struct LoopStack {
+    active: Vec<Activation>,
+    /// entry pcs of the called functions
+    frames: Vec<u32>,
+}
+
+pub struct LoopProfiler {
+    text_begin: u32,
+    text_len: usize,
+    enabled: bool,
+    /// loop slot of each backward branch, indexed by text word
+    slot_by_branch: Vec<u32>,
+    /// loop slot of each loop head, indexed by text word
+    slot_by_head: Vec<u32>,
+    loops: Vec<LoopRecord>,
+    /// of the running core
+    stack: LoopStack,
+    instrs: u64,
+    clocks: u64,
+}
+
+impl LoopProfiler {
+    pub fn new(text: Range<u32>) -> Self {
+        Self {
+            text_begin: text.start,
+            text_len: ((text.end - text.start) >> 2) as usize,
+            enabled: false,
+            slot_by_branch: vec![],
+            slot_by_head: vec![],
+            loops: vec![],
+            stack: LoopStack::default(),
+            instrs: 0,
+            clocks: 0,
+        }
+    }
+    pub fn enable(&mut self) {
+        self.enabled = true;
+        self.slot_by_branch = vec![NO_LOOP; self.text_len];
+        self.slot_by_head = vec![NO_LOOP; self.text_len];
+    }
+    #[inline]
+    pub fn is_enabled(&self) -> bool {
+        self.enabled
+    }
+    /// parks the loops of the running core into `stack` and resumes the
+    /// ones parked there.
+    pub fn swap_core(&mut self, stack: &mut LoopStack) {
+        std::mem::swap(&mut self.stack, stack);
+    }
+    #[inline]
+    fn index(&self, pc: u32) -> usize {
+        (pc.wrapping_sub(self.text_begin) >> 2) as usize
+    }
+    /// account an activation that ended (or is still running) into its record.
+    fn close(record: &mut LoopRecord, a: &Activation, instrs: u64, clocks: u64) {
+        let trips = a.backedges + 1;
+        record.entries += 1;
+        record.trips += trips;
+        record.measured_iters += a.backedges + u64::from(a.from_head);
+        record.instrs += instrs - a.instrs_at_entry;
+        record.clocks += clocks - a.clocks_at_entry;
+        let bucket = (63 - trips.leading_zeros() as usize).min(TRIP_BUCKETS - 1);
+        record.trip_histogram[bucket] += 1;
+    }
+    /// called for every retired instruction with the pc executed next.
+    #[inline]
+    pub fn retire(&mut self, pc: Pc, next_pc: Pc, flow: FlowKind, clocks: usize) {
+        let pc = pc.into_inner();
+        let next_pc = next_pc.into_inner();
+        let depth = self.stack.frames.len();
+
+        // leave loops whose body does not contain `pc` anymore
+        while let Some(a) = self.stack.active.last() {
+            let record = &self.loops[a.slot as usize];
+            if a.depth < depth || (a.depth == depth && record.body().contains(&pc)) {
+                break;
+            }
+            let a = self.stack.active.pop().unwrap();
+            Self::close(
+                &mut self.loops[a.slot as usize],
+                &a,
+                self.instrs,
+                self.clocks,
+            );
+        }
+
+        // enter a known loop at its head
+        if let Some(&slot) = self.slot_by_head.get(self.index(pc)) {
+            let running = self
+                .stack
+                .active
+                .last()
+                .is_some_and(|a| a.slot == slot && a.depth == depth);
+            if slot != NO_LOOP && !running {
+                self.stack.active.push(Activation {
+                    slot,
+                    depth,
+                    backedges: 0,
+                    from_head: true,
+                    instrs_at_entry: self.instrs,
+                    clocks_at_entry: self.clocks,
+                });
+            }
+        }
+
+        self.instrs += 1;
+        self.clocks += clocks as u64;
+
+        match flow {
+            FlowKind::Call => self.stack.frames.push(next_pc),
+            FlowKind::Return => {
+                self.stack.frames.pop();
+            }
+            FlowKind::Branch if next_pc <= pc && next_pc != pc.wrapping_add(4) => {
+                self.backedge(pc, next_pc, depth)
+            }
+            _ => {}
+        }
+    }
+    fn backedge(&mut self, pc: u32, head: u32, depth: usize) {
+        if let Some(a) = self.stack.active.last_mut() {
+            if a.depth == depth && self.loops[a.slot as usize].branch == pc {
+                a.backedges += 1;
+                return;
+            }
+        }
+        let index = self.index(pc);
+        if index >= self.slot_by_branch.len() {
+            return;
+        }
+        let slot = match self.slot_by_branch[index] {
+            NO_LOOP => {
+                let slot = self.loops.len() as u32;
+                self.loops.push(LoopRecord {
+                    function: self.stack.frames.last().copied().unwrap_or(self.text_begin),
+                    head,
+                    branch: pc,
+                    parent: None,
+                    entries: 0,
+                    trips: 0,
+                    measured_iters: 0,
+                    instrs: 0,
+                    clocks: 0,
+                    trip_histogram: [0; TRIP_BUCKETS],
+                });
+                self.slot_by_branch[index] = slot;
+                let head_index = self.index(head);
+                if let Some(s) = self.slot_by_head.get_mut(head_index) {
+                    if *s == NO_LOOP {
+                        *s = slot;
+                    }
+                }
+                slot
+            }
+            slot => slot,
+        };
+        // the first iteration of this entry was missed
+        self.stack.active.push(Activation {
+            slot,
+            depth,
+            backedges: 1,
+            from_head: false,
+            instrs_at_entry: self.instrs,
+            clocks_at_entry: self.clocks,
+        });
+    }
+    /// snapshot of the records including the loops still running.
+    pub fn report(&self, debug_symbol: &DebugSymbol) -> LoopStat {
+        let mut loops = self.loops.clone();
+        for a in &self.stack.active {
+            Self::close(&mut loops[a.slot as usize], a, self.instrs, self.clocks);
+        }
+        let label = |pc: u32| {
+            debug_symbol
+                .get_exact_symbol_addr(pc)
+                .or_else(|_| debug_symbol.get_nearest_symbol_addr(pc))
+                .map(|i| debug_symbol.get_symbol(i).label.clone())
+                .unwrap_or_else(|_| format!("{pc:#010x}"))
+        };
+        let mut functions: HashMap<u32, FunctionLoops> = HashMap::new();
+        for l in loops {
+            functions
+                .entry(l.function)
+                .or_insert_with(|| FunctionLoops {
+                    label: label(l.function),
+                    clocks: 0,
+                    loops: vec![],
+                })
+                .loops
+                .push(l);
+        }
+        let mut functions: Vec<_> = functions.into_values().collect();
+        for f in &mut functions {
+            // the innermost loop enclosing the body
+            let parents: Vec<_> = f
+                .loops
+                .iter()
+                .map(|l| {
+                    f.loops
+                        .iter()
+                        .filter(|o| o.branch != l.branch)
+                        .filter(|o| o.head <= l.head && l.branch <= o.branch)
+                        .min_by_key(|o| o.branch - o.head)
+                        .map(|o| o.branch)
+                })
+                .collect();
+            for (l, parent) in f.loops.iter_mut().zip(parents) {
+                l.parent = parent;
+            }
+            f.clocks = f
+                .loops
+                .iter()
+                .filter(|l| l.parent.is_none())
+                .map(|l| l.clocks)
+                .sum();
+            f.loops.sort_by_key(|l| l.head);
+        }
+        functions.sort_by_key(|f| std::cmp::Reverse(f.clocks));
+        LoopStat { functions }
+    }
+}
+
+#[derive(Serialize)]
+struct FunctionLoops {
+    label: String,
+    /// clocks spent in the outermost loops
+    clocks: u64,
+    /// sorted by head pc
+    loops: Vec<LoopRecord>,
+}
+
+pub struct LoopStat {
+    /// sorted by clocks in descending order
+    functions: Vec<FunctionLoops>,
+}
+
+impl Stat for LoopStat {
+    fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+        Box::new(self)
+    }
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        serde_json::to_value(&self.functions)
+            .ok()
+            .map(|v| ("loops", v))
+    }
+}
+
+impl StatView for &'_ LoopStat {
+    fn header(&self) -> &'static str {
+        "loops by function"
+    }
+    fn width(&self) -> usize {
+        2 + 26 + 10 + 12 + 10 + 10 + 2 + 30
+    }
+}
+
+impl fmt::Display for &'_ LoopStat {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        fn nest_level(loops: &[LoopRecord], l: &LoopRecord) -> usize {
+            let mut level = 0;
+            let mut parent = l.parent;
+            while let Some(p) = parent {
+                level += 1;
+                parent = loops.iter().find(|l| l.branch == p).and_then(|l| l.parent);
+            }
+            level
+        }
+        if self.functions.is_empty() {
+            return writeln!(f, "  (no loop found)");
+        }
+        writeln!(
+            f,
+            "  {:<26}{:>10}{:>12}{:>10}{:>10}  trip counts (log2 bucket:entries)",
+            "loop (head-branch)", "entries", "avg trips", "instrs/it", "clocks/it"
+        )?;
+        for func in self.functions.iter().take(NUM_SHOWN_FUNCTIONS) {
+            writeln!(f, "  {} ({} clocks)", func.label, func.clocks)?;
+            for l in &func.loops {
+                let level = nest_level(&func.loops, l).min(8);
+                let name = format!(
+                    "{:indent$}{:#x}-{:#x}",
+                    "",
+                    l.head,
+                    l.branch,
+                    indent = 2 + level * 2
+                );
+                let iters = l.measured_iters.max(1) as f64;
+                write!(
+                    f,
+                    "  {:<26}{:>10}{:>12.1}{:>10.1}{:>10.1} ",
+                    name,
+                    l.entries,
+                    l.trips as f64 / l.entries.max(1) as f64,
+                    l.instrs as f64 / iters,
+                    l.clocks as f64 / iters,
+                )?;
+                for (i, n) in l.trip_histogram.iter().enumerate() {
+                    if *n > 0 {
+                        write!(f, " {i}:{n}")?;
+                    }
+                }
+                writeln!(f)?;
+            }
+        }
+        if self.functions.len() > NUM_SHOWN_FUNCTIONS {
+            writeln!(
+                f,
+                "  ({} more functions)",
+                self.functions.len() - NUM_SHOWN_FUNCTIONS
+            )?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_nested_loops() {
+        // 0x10: outer head, 0x14: inner head, 0x18: inner branch, 0x1c: outer branch
+        let mut p = LoopProfiler::new(0x10..0x24);
+        p.enable();
+        let mut step = |pc: u32, next: u32| {
+            let flow = if pc >= 0x18 {
+                FlowKind::Branch
+            } else {
+                FlowKind::Other
+            };
+            p.retire(Pc::new(pc), Pc::new(next), flow, 1);
+        };
+        for _ in 0..3 {
+            step(0x10, 0x14);
+            for _ in 0..4 {
+                step(0x14, 0x18);
+                step(0x18, 0x14);
+            }
+            step(0x14, 0x18);
+            step(0x18, 0x1c);
+            step(0x1c, 0x10);
+        }
+        step(0x10, 0x20);
+        step(0x20, 0x24);
+        let stat = p.report(&DebugSymbol::default());
+        let loops = &stat.functions[0].loops;
+        let outer = loops.iter().find(|l| l.branch == 0x1c).unwrap();
+        let inner = loops.iter().find(|l| l.branch == 0x18).unwrap();
+        assert_eq!(inner.parent, Some(0x1c));
+        assert_eq!(outer.entries, 1);
+        assert_eq!(outer.trips, 4);
+        // the last outer iteration leaves at its head
+        assert_eq!(inner.entries, 3);
+        assert_eq!(inner.trips, 15);
+        assert_eq!(inner.trip_histogram[2], 3);
+        // the first iteration of the first entry is not measured
+        assert_eq!(inner.measured_iters, 14);
+        assert_eq!(inner.instrs, 8 + 10 + 10);
+    }
+}
@@ -1,20 +1,16 @@
 use std::{collections::HashMap, fmt::Display, io::Write, ops::Range};
 
-#[cfg(feature = "stat")]
-use std::{cell::RefCell, rc::Rc};
-
 use crate::{
     common::{self, Pc, SpyWatchKind, SpyWatchResultKind},
     ty::{Ty, Typed, TypedU32},
 };
 
 #[cfg(feature = "stat")]
-use crate::stat::{AddStats, Stats};
-
-#[cfg(feature = "stat")]
-use crate::reg_file::MemoryRegionStatBuilder;
+pub use stat::MemoryStat;
 
 pub const RAM_BYTE_SIZE: usize = 1000000usize;
+/// granularity of dirty tracking (words)
+pub const PAGE_WORD_SIZE: usize = 256;
 
 #[derive(Clone, Copy, PartialEq, Eq, Hash, PartialOrd, Ord)]
 pub struct Addr(usize);
@@ -52,13 +48,15 @@ struct Spy {
 pub struct Memory<const SIZE: usize> {
     inner: Vec<u8>,
     instr_mem_range: Range<usize>,
-    #[cfg(feature = "stat")]
-    stat_region: Rc<RefCell<MemoryRegionStatBuilder>>,
-    #[cfg(feature = "stat")]
-    stat_mem: RefCell<stat::MemoryStat>,
     #[cfg(feature = "typed_memory")]
     ty: std::cell::RefCell<Vec<Ty>>,
     spy: Spy,
+    /// pages written (or whose types are refined) since the last
+    /// [`Memory::clear_dirty`]
+    dirty: std::cell::RefCell<Vec<bool>>,
+    /// one bit per word, set once the word is written
+    #[cfg(feature = "uninit_check")]
+    defined: Vec<u64>,
 }
 
 use thiserror::Error;
@@ -113,23 +111,126 @@ macro_rules! reset_type {
     };
 }
 
+/// a page of memory with the type of each word.
+#[derive(Clone)]
+pub struct Page {
+    pub index: usize,
+    pub words: Vec<u32>,
+    pub tys: Vec<Ty>,
+    /// definedness bits of the words (all set unless `uninit_check`)
+    pub defined: Vec<u64>,
+}
+
 impl<const SIZE: usize> Memory<SIZE> {
-    pub fn new(#[cfg(feature = "stat")] stat_region: Rc<RefCell<MemoryRegionStatBuilder>>) -> Self {
+    pub fn new() -> Self {
         Self {
             inner: vec![0xCC; SIZE],
             instr_mem_range: 0..0,
-            #[cfg(feature = "stat")]
-            stat_region,
-            #[cfg(feature = "stat")]
-            stat_mem: RefCell::default(),
             #[cfg(feature = "typed_memory")]
             ty: std::cell::RefCell::new(vec![Ty::Unknown; SIZE >> 2]),
             spy: Default::default(),
+            dirty: std::cell::RefCell::new(vec![false; (SIZE >> 2).div_ceil(PAGE_WORD_SIZE)]),
+            #[cfg(feature = "uninit_check")]
+            defined: vec![0; (SIZE >> 2).div_ceil(64)],
+        }
+    }
+    #[inline]
+    fn mark_dirty(&mut self, addr: usize) {
+        self.dirty.get_mut()[addr / PAGE_WORD_SIZE] = true;
+    }
+    /// [`Memory::mark_dirty`] for the type refinements of loads.
+    #[cfg(feature = "typed_memory")]
+    #[inline]
+    fn mark_dirty_shared(&self, addr: usize) {
+        self.dirty.borrow_mut()[addr / PAGE_WORD_SIZE] = true;
+    }
+    /// indices of pages touched since the last [`Memory::clear_dirty`].
+    pub fn dirty_pages(&self) -> Vec<usize> {
+        let dirty = self.dirty.borrow();
+        (0..dirty.len()).filter(|&i| dirty[i]).collect()
+    }
+    /// the whole memory, little endian; its address never changes.
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.inner
+    }
+    pub fn clear_dirty(&mut self) {
+        self.dirty.get_mut().fill(false);
+    }
+    pub fn page(&self, index: usize) -> Page {
+        let words = index * PAGE_WORD_SIZE..((index + 1) * PAGE_WORD_SIZE).min(SIZE >> 2);
+        #[cfg(feature = "typed_memory")]
+        let tys = self.ty.borrow()[words.clone()].to_vec();
+        #[cfg(not(feature = "typed_memory"))]
+        let tys = vec![Ty::Unknown; words.len()];
+        #[cfg(feature = "uninit_check")]
+        let defined =
+            self.defined[index * PAGE_WORD_SIZE / 64..][..words.len().div_ceil(64)].to_vec();
+        #[cfg(not(feature = "uninit_check"))]
+        let defined = vec![u64::MAX; words.len().div_ceil(64)];
+        Page {
+            index,
+            tys,
+            defined,
+            words: words.map(|addr| self.get_raw_addr(addr << 2)).collect(),
+        }
+    }
+    #[cfg(feature = "uninit_check")]
+    #[inline]
+    fn define(&mut self, addr: usize) {
+        self.defined[addr / 64] |= 1 << (addr % 64);
+    }
+    /// whether the word at `addr` has been written (`true` if out of range).
+    #[cfg(feature = "uninit_check")]
+    #[inline]
+    pub fn is_defined(&self, addr: usize) -> bool {
+        self.defined
+            .get(addr / 64)
+            .map_or(true, |w| w & (1 << (addr % 64)) != 0)
+    }
+    pub fn all_pages(&self) -> Vec<Page> {
+        (0..self.dirty.borrow().len())
+            .map(|i| self.page(i))
+            .collect()
+    }
+    /// restores the pages touched since the last [`Memory::clear_dirty`]
+    /// from `pristine`, indexed by page, and clears the dirty flags.
+    pub fn rollback(&mut self, pristine: &[Page]) {
+        for i in self.dirty_pages() {
+            self.restore_page(&pristine[i]);
+        }
+        self.clear_dirty();
+    }
+    /// overwrites a page (bypassing spies and statistics) and marks it dirty.
+    pub fn restore_page(&mut self, page: &Page) {
+        let begin = page.index * PAGE_WORD_SIZE;
+        for (i, (w, ty)) in page.words.iter().zip(&page.tys).enumerate() {
+            let addr = begin + i;
+            if addr >= SIZE >> 2 {
+                break;
+            }
+            self.inner[addr << 2..(addr << 2) + 4].copy_from_slice(&w.to_le_bytes());
+            #[cfg(feature = "typed_memory")]
+            {
+                self.ty.get_mut()[addr] = *ty;
+            }
+            #[cfg(not(feature = "typed_memory"))]
+            let _ = ty;
+        }
+        #[cfg(feature = "uninit_check")]
+        {
+            let begin = page.index * PAGE_WORD_SIZE / 64;
+            let n = page.defined.len().min(self.defined.len() - begin);
+            self.defined[begin..begin + n].copy_from_slice(&page.defined[..n]);
         }
+        self.dirty.get_mut()[page.index] = true;
     }
     pub fn init_from_slice(&mut self, mem: &[u8], instr_mem_range: Range<u32>) {
         let mut buf = self.inner.as_mut_slice();
         buf.write_all(mem).unwrap();
+        #[cfg(feature = "uninit_check")]
+        for addr in 0..mem.len().div_ceil(4) {
+            self.define(addr);
+        }
         self.instr_mem_range = instr_mem_range.start as usize..instr_mem_range.end as usize;
     }
     pub fn add_spy(&mut self, k: SpyWatchKind, u: SpyUnit) {
@@ -149,10 +250,6 @@ impl<const SIZE: usize> Memory<SIZE> {
         }
     }
     fn on_read(&self, addr: usize, spied: &mut Option<common::SpyResult>) {
-        #[cfg(feature = "stat")]
-        self.stat_mem
-            .borrow_mut()
-            .on_read(self.stat_region.borrow().get_region(addr as u32));
         if let Some(spy) = self.spy.on_read.get(&addr) {
             *spied = Some(common::SpyResult {
                 kind: SpyWatchResultKind::Read,
@@ -161,10 +258,6 @@ impl<const SIZE: usize> Memory<SIZE> {
         }
     }
     fn on_write(&self, addr: usize, val: TypedU32, spied: &mut Option<common::SpyResult>) {
-        #[cfg(feature = "stat")]
-        self.stat_mem
-            .borrow_mut()
-            .on_write(self.stat_region.borrow().get_region(addr as u32));
         if let Some(spy) = self.spy.on_write.get(&addr) {
             *spied = Some(common::SpyResult {
                 kind: SpyWatchResultKind::Write {
@@ -192,6 +285,7 @@ impl<const SIZE: usize> Memory<SIZE> {
         let ty = self.ty.borrow()[addr];
         if ty < attempt {
             self.ty.borrow_mut()[addr] = attempt;
+            self.mark_dirty_shared(addr);
             Ok(attempt)
         } else if ty >= attempt {
             Ok(ty)
@@ -231,6 +325,25 @@ impl<const SIZE: usize> Memory<SIZE> {
         v[..4].copy_from_slice(&self.inner[addr..(4 + addr)]);
         Ok(f32::from_le_bytes(v))
     }
+    /// [`Memory::get_i`] for a load whose type is proven ahead of time.
+    pub fn get_i_proven(&self, addr: usize, spied: &mut Option<common::SpyResult>) -> Result<u32> {
+        bounds_check!(addr < self.SIZE);
+        #[cfg(feature = "typed_memory")]
+        debug_assert!(
+            self.ty.borrow()[addr] >= I32OrUsize,
+            "unproven load of {addr}"
+        );
+        self.on_read(addr, spied);
+        Ok(self.get_raw_addr(addr << 2))
+    }
+    /// [`Memory::get_f`] for a load whose type is proven ahead of time.
+    pub fn get_f_proven(&self, addr: usize, spied: &mut Option<common::SpyResult>) -> Result<f32> {
+        bounds_check!(addr < self.SIZE);
+        #[cfg(feature = "typed_memory")]
+        debug_assert!(self.ty.borrow()[addr] >= F32, "unproven load of {addr}");
+        self.on_read(addr, spied);
+        Ok(f32::from_bits(self.get_raw_addr(addr << 2)))
+    }
     pub fn set(
         &mut self,
         addr: usize,
@@ -240,6 +353,9 @@ impl<const SIZE: usize> Memory<SIZE> {
         bounds_check!(addr < self.SIZE);
         self.on_write(addr, val.typed(I32OrUsize), spied);
         reset_type!(self[addr]: I32OrUsize);
+        self.mark_dirty(addr);
+        #[cfg(feature = "uninit_check")]
+        self.define(addr);
         let v = val.to_le_bytes();
         let addr = addr << 2;
         self.inner[addr..(4 + addr)].copy_from_slice(&v[..4]);
@@ -254,6 +370,9 @@ impl<const SIZE: usize> Memory<SIZE> {
         bounds_check!(addr < self.SIZE);
         self.on_write(addr, val.to_bits().typed(F32), spied);
         reset_type!(self[addr]: F32);
+        self.mark_dirty(addr);
+        #[cfg(feature = "uninit_check")]
+        self.define(addr);
         let v = val.to_le_bytes();
         let addr = addr << 2;
         self.inner[addr..(4 + addr)].copy_from_slice(&v[..4]);
@@ -261,20 +380,15 @@ impl<const SIZE: usize> Memory<SIZE> {
     }
 }
 
-#[cfg(feature = "stat")]
-impl<const SIZE: usize> AddStats for Memory<SIZE> {
-    fn add_stats(&self, buf: &mut Stats) {
-        buf.push(Box::new(self.stat_mem.borrow().to_owned()));
-    }
-}
-
 #[cfg(feature = "stat")]
 mod stat {
     use std::fmt;
 
+    use serde::Serialize;
+
     use crate::{common::MemoryRegion, stat::*};
 
-    #[derive(Clone, Copy, Default)]
+    #[derive(Clone, Copy, Default, Serialize)]
     pub struct MemoryStat {
         write: MemoryRegionCount,
         read: MemoryRegionCount,
@@ -289,7 +403,7 @@ mod stat {
         }
     }
 
-    #[derive(Clone, Copy, Default)]
+    #[derive(Clone, Copy, Default, Serialize)]
     struct MemoryRegionCount {
         data_section: usize,
         heap: usize,
@@ -310,6 +424,12 @@ mod stat {
         fn view(&self, _: usize) -> Box<dyn StatView + '_> {
             Box::new(MemoryStatView::new(self))
         }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            Some(("memory", serde_json::to_value(self).ok()?))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["*.*"]
+        }
     }
 
     pub struct MemoryStatView<'a> {
@@ -352,11 +472,36 @@ mod tests {
 
     #[test]
     fn test_memory() {
-        let mut m = Memory::<4>::new(Default::default());
+        let mut m = Memory::<4>::new();
         m.set(0, 0xDEADBEEF, &mut None).unwrap();
         assert_eq!(
             0xDEADBEEFu32,
             m.get_i(0, &mut None).unwrap().get_unchecked()
         );
     }
+
+    #[cfg(feature = "uninit_check")]
+    #[test]
+    fn test_uninit() {
+        use crate::{debug_symbol::DebugSymbol, uninit::UninitReads};
+
+        let mut m = Memory::<64>::new();
+        m.init_from_slice(&[0; 8], 0..0);
+        let mut reads = UninitReads::default();
+        // the same load runs twice, then another one
+        for (pc, addr) in [(0x40, 2), (0x40, 3), (0x44, 5)] {
+            if !m.is_defined(addr) {
+                reads.record(Pc::new(pc), addr);
+            }
+        }
+        let report = reads.report(&DebugSymbol::default()).to_string();
+        let rows: Vec<_> = report.lines().skip(1).collect();
+        assert_eq!(rows.len(), 2, "{report}");
+        assert!(rows[0].starts_with("  0x00000040") && rows[0].ends_with(" 2"));
+        assert!(rows[1].starts_with("  0x00000044") && rows[1].ends_with(" 1"));
+        assert!(m.is_defined(0) && m.is_defined(1));
+        m.set(2, 1, &mut None).unwrap();
+        m.set_f(3, 1.0, &mut None).unwrap();
+        assert!(m.is_defined(2) && m.is_defined(3) && !m.is_defined(4));
+    }
 }
@@ -0,0 +1,284 @@
+//! several cores sharing the memory.
+//!
+//! Every core has its own registers, pc, cache and branch predictor, kept in
+//! a [`CoreState`] while it is parked. The cores run one at a time in
+//! round-robin order, switching after a fixed number of instructions, so a
+//! run is deterministic. A secondary core starts at the entry point with its
+//! id in `a0` and its own stack below the one of the previous core.
+//! Cores never run in parallel, so memory is sequentially consistent and
+//! `fence` is a no-op.
+
+use std::fmt;
+#[cfg(feature = "time_predict")]
+use std::ops::Range;
+
+use serde::Serialize;
+
+#[cfg(feature = "time_predict")]
+use crate::cpu::DDR2_ACCESS_CYCLES;
+use crate::cpu::{CoreState, Cpu};
+
+#[derive(Clone, Copy, Debug)]
+pub struct MulticoreConfig {
+    pub cores: usize,
+    /// instructions executed before switching to the next core
+    pub quantum: usize,
+    /// words of stack reserved for each core
+    pub stack_words: u32,
+}
+
+impl Default for MulticoreConfig {
+    fn default() -> Self {
+        Self {
+            cores: 1,
+            quantum: 64,
+            stack_words: 1 << 14,
+        }
+    }
+}
+
+/// the DDR2 controller shared by the cores. It serves one access at a time;
+/// an access arriving while another core's is in flight waits for it.
+/// Only the last access of each core is remembered, which suffices as long
+/// as the quantum keeps the clocks of the cores close.
+#[cfg(feature = "time_predict")]
+pub struct Ddr2Bus {
+    last: Vec<Range<usize>>,
+    /// clocks each core has waited for the others
+    waited: Vec<usize>,
+}
+
+#[cfg(feature = "time_predict")]
+impl Ddr2Bus {
+    pub fn new(cores: usize) -> Self {
+        Self {
+            last: vec![0..0; cores],
+            waited: vec![0; cores],
+        }
+    }
+    /// starts an access of `core` at its clock `now` and returns the clocks
+    /// it waits before being served.
+    pub fn access(&mut self, core: usize, now: usize) -> usize {
+        let mut start = now;
+        while let Some(r) = self
+            .last
+            .iter()
+            .enumerate()
+            .find(|&(c, r)| c != core && r.contains(&start))
+        {
+            start = r.1.end;
+        }
+        self.last[core] = start..start + DDR2_ACCESS_CYCLES;
+        self.waited[core] += start - now;
+        start - now
+    }
+    pub fn waited(&self, core: usize) -> usize {
+        self.waited[core]
+    }
+}
+
+pub struct Scheduler {
+    config: MulticoreConfig,
+    /// indexed by core id; `None` for the running core
+    parked: Vec<Option<CoreState>>,
+    halted: Vec<bool>,
+    instrs: Vec<usize>,
+    left: usize,
+}
+
+impl Scheduler {
+    /// parks the secondary cores, created from the state of `cpu`.
+    pub fn new<I, O>(cpu: &mut Cpu<I, O>, config: MulticoreConfig) -> Self {
+        let cores = config.cores.max(1);
+        #[cfg(feature = "time_predict")]
+        cpu.share_ddr2(cores);
+        cpu.check_all_types();
+        let parked = (0..cores)
+            .map(|id| (id != 0).then(|| cpu.new_core(id, config.stack_words)))
+            .collect();
+        Self {
+            config,
+            parked,
+            halted: vec![false; cores],
+            instrs: vec![0; cores],
+            left: config.quantum.max(1),
+        }
+    }
+    pub fn config(&self) -> MulticoreConfig {
+        self.config
+    }
+    fn switch_to<I, O>(&mut self, cpu: &mut Cpu<I, O>, core: usize) {
+        let active = cpu.core_id();
+        if core != active {
+            let mut state = self.parked[core].take().unwrap();
+            cpu.swap_core(&mut state);
+            self.parked[active] = Some(state);
+        }
+        self.left = self.config.quantum.max(1);
+    }
+    fn next_live(&self, active: usize) -> Option<usize> {
+        let n = self.halted.len();
+        (1..=n).map(|i| (active + i) % n).find(|&c| !self.halted[c])
+    }
+    /// counts an instruction retired by the running core and switches to
+    /// the next core at the end of the quantum.
+    #[inline]
+    pub fn tick<I, O>(&mut self, cpu: &mut Cpu<I, O>) {
+        self.instrs[cpu.core_id()] += 1;
+        self.left -= 1;
+        if self.left == 0 {
+            let next = self.next_live(cpu.core_id()).unwrap();
+            self.switch_to(cpu, next);
+        }
+    }
+    /// halts the running core. Returns `false` once every core has halted,
+    /// leaving core 0 in `cpu`.
+    pub fn halt<I, O>(&mut self, cpu: &mut Cpu<I, O>) -> bool {
+        let active = cpu.core_id();
+        self.instrs[active] += 1;
+        self.halted[active] = true;
+        match self.next_live(active) {
+            Some(next) => {
+                self.switch_to(cpu, next);
+                true
+            }
+            None => {
+                self.switch_to(cpu, 0);
+                false
+            }
+        }
+    }
+    /// puts core 0 back into `cpu`.
+    pub fn park_all<I, O>(&mut self, cpu: &mut Cpu<I, O>) {
+        self.switch_to(cpu, 0);
+    }
+    pub fn report<I, O>(&self, cpu: &Cpu<I, O>) -> CoreReport {
+        let cores = (0..self.parked.len())
+            .map(|id| CoreStat {
+                id,
+                halted: self.halted[id],
+                instrs: self.instrs[id],
+                #[cfg(feature = "time_predict")]
+                clocks: match &self.parked[id] {
+                    Some(state) => state.clock(),
+                    None => cpu.clock(),
+                },
+                #[cfg(feature = "time_predict")]
+                ddr2_wait: cpu.ddr2().waited(id),
+            })
+            .collect();
+        CoreReport { cores }
+    }
+    /// clocks until the last core halts.
+    #[cfg(feature = "time_predict")]
+    pub fn elapsed_clocks<I, O>(&self, cpu: &Cpu<I, O>) -> usize {
+        self.report(cpu)
+            .cores
+            .iter()
+            .map(|c| c.clocks)
+            .max()
+            .unwrap_or(0)
+    }
+}
+
+#[derive(Serialize)]
+pub struct CoreStat {
+    pub id: usize,
+    pub halted: bool,
+    pub instrs: usize,
+    #[cfg(feature = "time_predict")]
+    pub clocks: usize,
+    /// clocks spent waiting for the DDR2 used by the other cores
+    #[cfg(feature = "time_predict")]
+    pub ddr2_wait: usize,
+}
+
+pub struct CoreReport {
+    cores: Vec<CoreStat>,
+}
+
+impl fmt::Display for CoreReport {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "  {:<6}{:>8}{:>16}", "core", "halted", "instrs")?;
+        #[cfg(feature = "time_predict")]
+        write!(f, "{:>16}{:>16}", "clocks", "ddr2 wait")?;
+        writeln!(f)?;
+        for c in &self.cores {
+            write!(f, "  {:<6}{:>8}{:>16}", c.id, c.halted, c.instrs)?;
+            #[cfg(feature = "time_predict")]
+            write!(f, "{:>16}{:>16}", c.clocks, c.ddr2_wait)?;
+            writeln!(f)?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(feature = "stat")]
+mod stat {
+    use super::*;
+    use crate::stat::*;
+
+    impl Stat for CoreReport {
+        fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+            Box::new(self)
+        }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            serde_json::to_value(&self.cores).ok().map(|v| ("cores", v))
+        }
+    }
+
+    impl StatView for &'_ CoreReport {
+        fn header(&self) -> &'static str {
+            "cores"
+        }
+        fn width(&self) -> usize {
+            if cfg!(feature = "time_predict") {
+                2 + 6 + 8 + 16 * 3
+            } else {
+                2 + 6 + 8 + 16
+            }
+        }
+    }
+}
+
+#[cfg(all(test, feature = "time_predict"))]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_ddr2_bus() {
+        let mut bus = Ddr2Bus::new(2);
+        assert_eq!(bus.access(0, 100), 0);
+        assert_eq!(bus.access(1, 110), DDR2_ACCESS_CYCLES - 10);
+        assert_eq!(bus.access(0, 200), 2 * DDR2_ACCESS_CYCLES - 100);
+        assert_eq!(bus.access(1, 1000), 0);
+        assert_eq!(bus.waited(0), 2 * DDR2_ACCESS_CYCLES - 100);
+        let mut single = Ddr2Bus::new(1);
+        assert_eq!(single.access(0, 0), 0);
+        assert_eq!(single.access(0, 1), 0);
+    }
+
+    #[test]
+    fn test_amo() {
+        // li x6, 1 / li x7, 100 / loop: amoadd x0, x6, (x5) /
+        // addi x7, x7, -1 / bne x7, zero, loop / end
+        let text = [
+            0x00100313, 0x06400393, 0x0062a02f, 0xfff38393, 0xfe039ce3, 0,
+        ];
+        let run = || {
+            let mut sim = crate::sim::test_sim(&[0], &text, &[]);
+            sim.set_multicore(MulticoreConfig {
+                cores: 2,
+                quantum: 7,
+                ..Default::default()
+            });
+            sim.run_to_end();
+            let sum = sim.get_mem(crate::memory::Addr::new(0)).unwrap();
+            (sum.get_unchecked(), sim.cycle(), sim.elapsed_clocks())
+        };
+        let (sum, instrs, clocks) = run();
+        assert_eq!(sum, 200);
+        assert_eq!(instrs, 2 * (2 + 3 * 100 + 1));
+        assert_eq!(run(), (sum, instrs, clocks));
+    }
+}
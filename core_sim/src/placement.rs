@@ -0,0 +1,305 @@
+//! BRAM/DDR2 data placement advisor.
+//!
+//! Every data access is replayed on a shadow cache as if the whole memory
+//! were behind DDR2, which gives each word an access count and a miss count
+//! independent of the current placement. Globals and hot heap chunks are
+//! then packed into the BRAM capacity by 0/1 knapsack on the memory access
+//! clocks they would save. Nothing is recorded unless enabled.
+
+use std::fmt;
+
+use serde::Serialize;
+
+use crate::{
+    cache::{Cache, CACHE_NUM_LINES},
+    cpu::{BRAM_WORD_SIZE, DDR2_ACCESS_CYCLES, STACK_WORD_SIZE},
+    debug_symbol::DebugSymbol,
+    memory::RAM_BYTE_SIZE,
+    stat::*,
+};
+
+/// granularity of heap objects (words)
+const HEAP_CHUNK_WORDS: usize = 512;
+/// number of objects listed in the stat
+const NUM_SHOWN_OBJECTS: usize = 20;
+
+#[derive(Clone, Copy, Default)]
+struct WordCount {
+    accesses: u32,
+    misses: u32,
+}
+
+pub struct PlacementProfile {
+    shadow: Cache<CACHE_NUM_LINES>,
+    /// indexed by word address; empty while disabled
+    counts: Vec<WordCount>,
+    data_len: usize,
+    text_len: usize,
+}
+
+impl PlacementProfile {
+    pub fn new(data_len: u32, text_len: u32) -> Self {
+        Self {
+            shadow: Cache::new(),
+            counts: vec![],
+            data_len: data_len as usize,
+            text_len: text_len as usize,
+        }
+    }
+    pub fn enable(&mut self) {
+        self.counts = vec![WordCount::default(); RAM_BYTE_SIZE >> 2];
+    }
+    #[inline]
+    pub fn is_enabled(&self) -> bool {
+        !self.counts.is_empty()
+    }
+    #[inline]
+    pub fn record(&mut self, addr: usize) {
+        let hit = self.shadow.access_cache(addr);
+        if let Some(c) = self.counts.get_mut(addr) {
+            c.accesses += 1;
+            c.misses += u32::from(!hit);
+        }
+    }
+    /// memory access clocks saved by moving `range` from DDR2 into BRAM.
+    fn saving(&self, range: std::ops::Range<usize>) -> (usize, usize, usize) {
+        let (accesses, misses) = self.counts[range].iter().fold((0, 0), |(a, m), c| {
+            (a + c.accesses as usize, m + c.misses as usize)
+        });
+        let hits = accesses - misses;
+        // BRAM takes 1 clock, cache hit 2 and miss `DDR2_ACCESS_CYCLES`.
+        (accesses, misses, hits + misses * (DDR2_ACCESS_CYCLES - 1))
+    }
+    fn objects(&self, debug_symbol: &DebugSymbol) -> Vec<PlacedObject> {
+        let mut objects = vec![];
+        let mut push = |label: String, addr: usize, size: usize| {
+            if size == 0 {
+                return;
+            }
+            let (accesses, misses, saving) = self.saving(addr..addr + size);
+            objects.push(PlacedObject {
+                label,
+                addr: addr as u32,
+                size: size as u32,
+                accesses,
+                misses,
+                saving,
+                region: Region::Ddr2,
+            });
+        };
+
+        // globals, sized up to the next global
+        let mut globals: Vec<_> = debug_symbol
+            .globals
+            .values()
+            .filter(|g| (g.addr as usize) < self.data_len)
+            .collect();
+        globals.sort_by_key(|g| g.addr);
+        match globals.first() {
+            Some(first) => push("(data section)".into(), 0, first.addr as usize),
+            None => push("(data section)".into(), 0, self.data_len),
+        }
+        for (i, g) in globals.iter().enumerate() {
+            let end = globals
+                .get(i + 1)
+                .map_or(self.data_len, |n| n.addr as usize);
+            push(g.label.clone(), g.addr as usize, end - g.addr as usize);
+        }
+
+        // heap chunks actually touched
+        let heap_begin = self.data_len + self.text_len;
+        let heap_end = (RAM_BYTE_SIZE >> 2) - STACK_WORD_SIZE;
+        for begin in (heap_begin..heap_end).step_by(HEAP_CHUNK_WORDS) {
+            let end = (begin + HEAP_CHUNK_WORDS).min(heap_end);
+            if self.counts[begin..end].iter().any(|c| c.accesses > 0) {
+                push(
+                    format!("heap+{:#x}", begin - heap_begin),
+                    begin,
+                    end - begin,
+                );
+            }
+        }
+        objects
+    }
+    pub fn advise(&self, debug_symbol: &DebugSymbol) -> PlacementAdvice {
+        // the text section shares the BRAM address range
+        let capacity = BRAM_WORD_SIZE.saturating_sub(self.text_len);
+        let current_saving = self.saving(0..BRAM_WORD_SIZE).2;
+        let mut objects = self.objects(debug_symbol);
+        let chosen = knapsack(&objects, capacity);
+        for i in chosen {
+            objects[i].region = Region::Bram;
+        }
+        objects.sort_by_key(|o| std::cmp::Reverse(o.saving));
+        let advised_saving = objects
+            .iter()
+            .filter(|o| o.region == Region::Bram)
+            .map(|o| o.saving)
+            .sum();
+        PlacementAdvice {
+            capacity,
+            current_saving,
+            advised_saving,
+            objects,
+        }
+    }
+}
+
+/// returns indices of objects maximizing total saving within `capacity` words.
+fn knapsack(objects: &[PlacedObject], capacity: usize) -> Vec<usize> {
+    let mut best = vec![0usize; capacity + 1];
+    // taken[i][w]: whether objects[i] is taken for the best of weight `w` over objects[..=i]
+    let mut taken = vec![vec![false; capacity + 1]; objects.len()];
+    for (i, o) in objects.iter().enumerate() {
+        let size = o.size as usize;
+        if o.saving == 0 || size > capacity {
+            continue;
+        }
+        for w in (size..=capacity).rev() {
+            let v = best[w - size] + o.saving;
+            if v > best[w] {
+                best[w] = v;
+                taken[i][w] = true;
+            }
+        }
+    }
+    let mut chosen = vec![];
+    let mut w = capacity;
+    for i in (0..objects.len()).rev() {
+        if taken[i][w] {
+            chosen.push(i);
+            w -= objects[i].size as usize;
+        }
+    }
+    chosen
+}
+
+#[derive(Clone, Copy, PartialEq, Eq, Serialize)]
+#[serde(rename_all = "lowercase")]
+pub enum Region {
+    Bram,
+    Ddr2,
+}
+
+#[derive(Serialize)]
+pub struct PlacedObject {
+    label: String,
+    /// word address
+    addr: u32,
+    /// in words
+    size: u32,
+    accesses: usize,
+    misses: usize,
+    /// clocks saved when placed in BRAM
+    saving: usize,
+    region: Region,
+}
+
+#[derive(Serialize)]
+pub struct PlacementAdvice {
+    /// in words
+    capacity: usize,
+    /// clocks saved by the current placement
+    current_saving: usize,
+    /// clocks saved by the advised placement
+    advised_saving: usize,
+    /// sorted by saving in descending order
+    objects: Vec<PlacedObject>,
+}
+
+impl PlacementAdvice {
+    /// placement map for the linker
+    pub fn to_map_json(&self) -> serde_json::Result<String> {
+        serde_json::to_string_pretty(self)
+    }
+    /// predicted reduction of clocks compared with the current placement
+    pub fn predicted_reduction(&self) -> isize {
+        self.advised_saving as isize - self.current_saving as isize
+    }
+}
+
+impl Stat for PlacementAdvice {
+    fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+        Box::new(self)
+    }
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        let mut map = serde_json::Map::new();
+        map.insert("capacity".into(), self.capacity.into());
+        map.insert("current_saving".into(), self.current_saving.into());
+        map.insert("advised_saving".into(), self.advised_saving.into());
+        Some(("placement", map.into()))
+    }
+    fn counters(&self) -> &'static [&'static str] {
+        &["current_saving", "advised_saving"]
+    }
+}
+
+impl StatView for &'_ PlacementAdvice {
+    fn header(&self) -> &'static str {
+        "BRAM placement advice"
+    }
+    fn width(&self) -> usize {
+        2 + 24 + 10 + 12 + 12 + 12 + 7
+    }
+}
+
+impl fmt::Display for &'_ PlacementAdvice {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        let used: u32 = self
+            .objects
+            .iter()
+            .filter(|o| o.region == Region::Bram)
+            .map(|o| o.size)
+            .sum();
+        writeln!(f, "  capacity: {} / {} words", used, self.capacity)?;
+        writeln!(f, "  saving (current): {:>12} clocks", self.current_saving)?;
+        writeln!(f, "  saving (advised): {:>12} clocks", self.advised_saving)?;
+        writeln!(
+            f,
+            "  predicted reduction: {:>9} clocks",
+            self.predicted_reduction()
+        )?;
+        writeln!(
+            f,
+            "  {:<24}{:>10}{:>12}{:>12}{:>12}{:>7}",
+            "object", "words", "accesses", "misses", "saving", "place"
+        )?;
+        for o in self.objects.iter().take(NUM_SHOWN_OBJECTS) {
+            let place = match o.region {
+                Region::Bram => "bram",
+                Region::Ddr2 => "ddr2",
+            };
+            writeln!(
+                f,
+                "  {:<24.24}{:>10}{:>12}{:>12}{:>12}{:>7}",
+                o.label, o.size, o.accesses, o.misses, o.saving, place
+            )?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn object(size: u32, saving: usize) -> PlacedObject {
+        PlacedObject {
+            label: String::new(),
+            addr: 0,
+            size,
+            accesses: 0,
+            misses: 0,
+            saving,
+            region: Region::Ddr2,
+        }
+    }
+
+    #[test]
+    fn test_knapsack() {
+        let objects = [object(6, 30), object(3, 14), object(4, 16), object(2, 9)];
+        let mut chosen = knapsack(&objects, 10);
+        chosen.sort();
+        assert_eq!(chosen, vec![0, 2]);
+    }
+}
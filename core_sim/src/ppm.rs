@@ -68,8 +68,74 @@ impl PPMDataV6 {
     }
 }
 
+/// per-channel difference of two images of the same size.
+#[derive(Clone, Copy, Debug, Default, PartialEq, serde::Serialize)]
+pub struct ImageDiff {
+    pub max_abs: u8,
+    pub mean_abs: f64,
+    /// number of pixels with any channel differing
+    pub differing_pixels: usize,
+    /// peak signal-to-noise ratio in dB (infinite if identical)
+    pub psnr: f64,
+}
+
+/// compares two P6 images, which must have the same header.
+pub fn compare(a: &[u8], b: &[u8]) -> Result<ImageDiff> {
+    let parse = |data| {
+        PPMDataV6::parse_ppmv6_header(data)
+            .map_err(|e| anyhow::anyhow!("failed to parse PPM header: {e}"))
+    };
+    let (pa, ha) = parse(a)?;
+    let (pb, hb) = parse(b)?;
+    if (ha.width, ha.height, ha.color) != (hb.width, hb.height, hb.color) {
+        anyhow::bail!("images differ in header: {ha:?} and {hb:?}");
+    }
+    let len = ha.width as usize * ha.height as usize * 3;
+    if pa.len() < len || pb.len() < len {
+        anyhow::bail!("image data is shorter than the header says");
+    }
+    let mut diff = ImageDiff::default();
+    let mut sum = 0u64;
+    let mut sum_sq = 0u64;
+    for (pa, pb) in pa[..len].chunks_exact(3).zip(pb[..len].chunks_exact(3)) {
+        let mut differs = false;
+        for (&x, &y) in pa.iter().zip(pb) {
+            let d = x.abs_diff(y);
+            diff.max_abs = diff.max_abs.max(d);
+            sum += d as u64;
+            sum_sq += d as u64 * d as u64;
+            differs |= d != 0;
+        }
+        diff.differing_pixels += differs as usize;
+    }
+    if len > 0 {
+        diff.mean_abs = sum as f64 / len as f64;
+        let mse = sum_sq as f64 / len as f64;
+        let peak = ha.color as f64;
+        diff.psnr = 10.0 * (peak * peak / mse).log10();
+    }
+    Ok(diff)
+}
+
 impl Default for PPMDataV6 {
     fn default() -> Self {
         Self::new()
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_compare() {
+        let a = b"P6\n2 1\n255\n\x00\x00\x00\x10\x10\x10";
+        let b = b"P6\n2 1\n255\n\x00\x00\x00\x10\x10\x14";
+        let same = compare(a, a).unwrap();
+        assert_eq!(same.differing_pixels, 0);
+        assert!(same.psnr.is_infinite());
+        let d = compare(a, b).unwrap();
+        assert_eq!((d.max_abs, d.differing_pixels), (4, 1));
+        assert!(compare(a, b"P6\n1 1\n255\n\x00\x00\x00").is_err());
+    }
+}
@@ -0,0 +1,433 @@
+//! detector of redundant loads and dead stores.
+//!
+//! A shadow of every word keeps the pc of its last store, the value stored
+//! or loaded last, the register carrying that value and whether the word
+//! was read since the store. A load is redundant if that register still
+//! holds the value: either the value was just stored from it (the load
+//! could be forwarded) or it was loaded into it before (the load repeats).
+//! A store is dead if it overwrites a store never read. The findings are
+//! reported by pc and function with the clocks the timing model charged to
+//! the wasted instructions.
+
+use std::{collections::HashMap, fmt};
+
+use serde::Serialize;
+
+use crate::{
+    common::Pc,
+    cpu::{MemoryAccessInput, WriteBackInput},
+    debug_symbol::DebugSymbol,
+    instr::{FInstr, Instr},
+    memory::RAM_BYTE_SIZE,
+    register::{FRegId, RegId},
+    stat::*,
+};
+
+/// number of pcs shown in the stat
+const NUM_SHOWN_PCS: usize = 20;
+/// no register known to carry the value of a word
+const NO_REG: u8 = u8::MAX;
+/// float registers are numbered from here
+const FREG_BASE: u8 = 32;
+
+#[derive(Clone, Copy)]
+struct Word {
+    store_pc: u32,
+    /// clocks of the last store
+    store_clocks: u32,
+    value: u32,
+    reg: u8,
+    /// stored and not read since
+    unread: bool,
+}
+
+impl Default for Word {
+    fn default() -> Self {
+        Self {
+            store_pc: 0,
+            store_clocks: 0,
+            value: 0,
+            reg: NO_REG,
+            unread: false,
+        }
+    }
+}
+
+/// a memory access seen before it is done
+pub enum Access {
+    Load {
+        addr: usize,
+    },
+    Store {
+        addr: usize,
+        val: u32,
+        reg: u8,
+    },
+    /// atomic and vector accesses, whose values are not tracked
+    Other {
+        addr: usize,
+        words: usize,
+        load: bool,
+        store: bool,
+    },
+}
+
+impl Access {
+    #[inline]
+    pub fn of(ma_in: &MemoryAccessInput, instr: &Instr<RegId, RegId, FRegId, FRegId>) -> Self {
+        let src = match instr {
+            Instr::S { rs2, .. } => rs2.inner() as u8,
+            Instr::F(FInstr::Fsw { rs2, .. }) => FREG_BASE + rs2.inner() as u8,
+            _ => NO_REG,
+        };
+        match *ma_in {
+            MemoryAccessInput::I { addr, val } => Self::Store {
+                addr,
+                val,
+                reg: src,
+            },
+            MemoryAccessInput::F { addr, val } => Self::Store {
+                addr,
+                val: val.to_bits(),
+                reg: src,
+            },
+            MemoryAccessInput::IMem { addr, .. } | MemoryAccessInput::FMem { addr, .. } => {
+                Self::Load { addr }
+            }
+            MemoryAccessInput::Amo { addr, .. } => Self::Other {
+                addr,
+                words: 1,
+                load: true,
+                store: true,
+            },
+            #[cfg(feature = "simd")]
+            MemoryAccessInput::V { addr, .. } => Self::Other {
+                addr,
+                words: crate::simd::LANES,
+                load: false,
+                store: true,
+            },
+            #[cfg(feature = "simd")]
+            MemoryAccessInput::VMem { addr, .. } => Self::Other {
+                addr,
+                words: crate::simd::LANES,
+                load: true,
+                store: false,
+            },
+        }
+    }
+}
+
+#[derive(Clone, Default, Serialize)]
+pub struct PcRecord {
+    pub pc: u32,
+    /// function of `pc`; see [`DebugSymbol::function_of`]
+    pub label: Option<String>,
+    pub loads: u64,
+    pub stores: u64,
+    /// loads of a value just stored from a register still holding it
+    pub forwardable: u64,
+    /// loads of a value loaded before into a register still holding it
+    pub reloads: u64,
+    /// stores overwritten before any read
+    pub dead_stores: u64,
+    /// clocks of the redundant loads and dead stores
+    pub wasted_clocks: u64,
+}
+
+impl PcRecord {
+    fn findings(&self) -> u64 {
+        self.forwardable + self.reloads + self.dead_stores
+    }
+}
+
+enum Pending {
+    /// a redundant load at the pc
+    Load(u32),
+    /// a store to the word, whose clocks a later dead store charges
+    Store(usize),
+}
+
+#[derive(Default)]
+pub struct Redundancy {
+    /// empty while disabled
+    words: Vec<Word>,
+    by_pc: HashMap<u32, PcRecord>,
+    pending: Option<Pending>,
+}
+
+impl Redundancy {
+    pub fn enable(&mut self) {
+        self.words = vec![Word::default(); RAM_BYTE_SIZE >> 2];
+    }
+    #[inline]
+    pub fn is_enabled(&self) -> bool {
+        !self.words.is_empty()
+    }
+    /// checks `access` of the instruction at `pc` loading `loaded`, with the
+    /// registers before its write back.
+    pub fn access(
+        &mut self,
+        pc: Pc,
+        access: Access,
+        loaded: Option<&WriteBackInput>,
+        (regs, fregs): (&[u32], &[f32]),
+    ) {
+        let pc = pc.into_inner();
+        let reg_value = |reg: u8| match reg {
+            NO_REG => None,
+            r if r >= FREG_BASE => Some(fregs[(r - FREG_BASE) as usize].to_bits()),
+            r => Some(regs[r as usize]),
+        };
+        match access {
+            Access::Load { addr } => {
+                let (val, reg) = match loaded {
+                    Some(WriteBackInput::I { id, val }) => (*val, id.inner() as u8),
+                    Some(WriteBackInput::F { id, val }) => {
+                        (val.to_bits(), FREG_BASE + id.inner() as u8)
+                    }
+                    _ => return,
+                };
+                let Some(w) = self.words.get_mut(addr) else {
+                    return;
+                };
+                let rec = record(&mut self.by_pc, pc);
+                rec.loads += 1;
+                if w.value == val && reg_value(w.reg) == Some(val) {
+                    if w.unread {
+                        rec.forwardable += 1;
+                    } else {
+                        rec.reloads += 1;
+                    }
+                    self.pending = Some(Pending::Load(pc));
+                }
+                w.value = val;
+                w.reg = reg;
+                w.unread = false;
+            }
+            Access::Store { addr, val, reg } => {
+                self.store(pc, addr, val, reg);
+                self.pending = Some(Pending::Store(addr));
+            }
+            Access::Other {
+                addr,
+                words,
+                load,
+                store,
+            } => {
+                for addr in addr..addr + words {
+                    if let Some(w) = self.words.get_mut(addr).filter(|_| load) {
+                        w.reg = NO_REG;
+                        w.unread = false;
+                    }
+                    if store {
+                        self.store(pc, addr, 0, NO_REG);
+                    }
+                }
+            }
+        }
+    }
+    fn store(&mut self, pc: u32, addr: usize, val: u32, reg: u8) {
+        let Some(w) = self.words.get_mut(addr) else {
+            return;
+        };
+        if w.unread {
+            let dead = record(&mut self.by_pc, w.store_pc);
+            dead.dead_stores += 1;
+            dead.wasted_clocks += w.store_clocks as u64;
+        }
+        *w = Word {
+            store_pc: pc,
+            store_clocks: 0,
+            value: val,
+            reg,
+            unread: true,
+        };
+        record(&mut self.by_pc, pc).stores += 1;
+    }
+    /// charges the clocks of the instruction accessing the memory last.
+    #[inline]
+    pub fn retire(&mut self, clocks: usize) {
+        match self.pending.take() {
+            Some(Pending::Load(pc)) => record(&mut self.by_pc, pc).wasted_clocks += clocks as u64,
+            Some(Pending::Store(addr)) => {
+                if let Some(w) = self.words.get_mut(addr) {
+                    w.store_clocks = clocks as u32;
+                }
+            }
+            None => {}
+        }
+    }
+    pub fn report(&self, debug_symbol: &DebugSymbol) -> RedundancyReport {
+        let label = |pc| debug_symbol.function_of(pc).map(str::to_string);
+        let mut pcs: Vec<_> = self
+            .by_pc
+            .values()
+            .filter(|r| r.findings() > 0)
+            .map(|r| PcRecord {
+                label: label(r.pc),
+                ..r.clone()
+            })
+            .collect();
+        pcs.sort_by(|a, b| {
+            (b.wasted_clocks, b.findings(), a.pc).cmp(&(a.wasted_clocks, a.findings(), b.pc))
+        });
+        let records = self.by_pc.values().map(|r| (r.pc, r));
+        let mut functions: Vec<_> = debug_symbol
+            .fold_by_function(records, |f: &mut PcRecord, r| {
+                f.loads += r.loads;
+                f.stores += r.stores;
+                f.forwardable += r.forwardable;
+                f.reloads += r.reloads;
+                f.dead_stores += r.dead_stores;
+                f.wasted_clocks += r.wasted_clocks;
+            })
+            .into_iter()
+            .filter(|(_, f)| f.findings() > 0)
+            .collect();
+        functions.sort_by(|a, b| {
+            b.1.wasted_clocks
+                .cmp(&a.1.wasted_clocks)
+                .then(a.0.cmp(&b.0))
+        });
+        RedundancyReport { pcs, functions }
+    }
+}
+
+fn record(by_pc: &mut HashMap<u32, PcRecord>, pc: u32) -> &mut PcRecord {
+    by_pc.entry(pc).or_insert_with(|| PcRecord {
+        pc,
+        ..Default::default()
+    })
+}
+
+pub struct RedundancyReport {
+    /// with any finding, sorted by wasted clocks in descending order
+    pcs: Vec<PcRecord>,
+    /// the same by function
+    functions: Vec<(String, PcRecord)>,
+}
+
+impl Stat for RedundancyReport {
+    fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+        Box::new(self)
+    }
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        let functions: serde_json::Map<_, _> = self
+            .functions
+            .iter()
+            .map(|(label, f)| {
+                let v = serde_json::json!({
+                    "loads": f.loads,
+                    "stores": f.stores,
+                    "forwardable": f.forwardable,
+                    "reloads": f.reloads,
+                    "dead_stores": f.dead_stores,
+                    "wasted_clocks": f.wasted_clocks,
+                });
+                (label.clone(), v)
+            })
+            .collect();
+        Some((
+            "redundancy",
+            serde_json::json!({
+                "pcs": serde_json::to_value(&self.pcs).ok()?,
+                "functions": functions,
+            }),
+        ))
+    }
+}
+
+impl StatView for &'_ RedundancyReport {
+    fn header(&self) -> &'static str {
+        "redundant loads and dead stores"
+    }
+    fn width(&self) -> usize {
+        2 + 12 + 24 + 5 * 11
+    }
+}
+
+impl fmt::Display for &'_ RedundancyReport {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        if self.pcs.is_empty() {
+            return writeln!(f, "  (no redundant load or dead store)");
+        }
+        let header = |f: &mut fmt::Formatter<'_>, first: &str| {
+            writeln!(
+                f,
+                "  {first:<36}{:>11}{:>11}{:>11}{:>11}{:>11}",
+                "accesses", "forward", "reload", "dead st", "clocks"
+            )
+        };
+        let row = |f: &mut fmt::Formatter<'_>, first: &str, r: &PcRecord| {
+            writeln!(
+                f,
+                "  {first:<36.36}{:>11}{:>11}{:>11}{:>11}{:>11}",
+                r.loads + r.stores,
+                r.forwardable,
+                r.reloads,
+                r.dead_stores,
+                r.wasted_clocks
+            )
+        };
+        header(f, "function")?;
+        for (label, r) in &self.functions {
+            row(f, if label.is_empty() { "?" } else { label }, r)?;
+        }
+        header(f, "pc")?;
+        for r in self.pcs.iter().take(NUM_SHOWN_PCS) {
+            let first = format!("{:#010x}  {}", r.pc, r.label.as_deref().unwrap_or("?"));
+            row(f, &first, r)?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_access() {
+        let mut r = Redundancy::default();
+        r.enable();
+        let mut regs = [0; 32];
+        let fregs = [0.0; 32];
+        let a0 = RegId::try_from(10).unwrap();
+        // sw a0, 0(100); lw a0, 0(100): forwardable
+        regs[10] = 7;
+        let store = |val| Access::Store {
+            addr: 100,
+            val,
+            reg: 10,
+        };
+        let loaded = WriteBackInput::I { id: a0, val: 7 };
+        r.access(Pc::new(0x10), store(7), None, (&regs, &fregs));
+        r.retire(3);
+        r.access(
+            Pc::new(0x14),
+            Access::Load { addr: 100 },
+            Some(&loaded),
+            (&regs, &fregs),
+        );
+        r.retire(2);
+        // lw a0 again: a reload; then two stores, the first one dead
+        r.access(
+            Pc::new(0x18),
+            Access::Load { addr: 100 },
+            Some(&loaded),
+            (&regs, &fregs),
+        );
+        r.retire(2);
+        r.access(Pc::new(0x1c), store(1), None, (&regs, &fregs));
+        r.retire(5);
+        r.access(Pc::new(0x20), store(2), None, (&regs, &fregs));
+        r.retire(1);
+        let get = |pc| r.by_pc[&pc].clone();
+        assert_eq!((get(0x14).forwardable, get(0x14).wasted_clocks), (1, 2));
+        assert_eq!(get(0x18).reloads, 1);
+        assert_eq!((get(0x1c).dead_stores, get(0x1c).wasted_clocks), (1, 5));
+        assert_eq!(get(0x10).dead_stores, 0);
+        assert_eq!(r.report(&DebugSymbol::default()).pcs.len(), 3);
+    }
+}
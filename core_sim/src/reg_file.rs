@@ -2,9 +2,6 @@ use std::fmt::Display;
 
 use crate::register::{FRegId, RegId, ABINAME_TABLE, F_ABINAME_TABLE, MAX_REG_ID};
 
-#[cfg(feature = "stat")]
-use std::{cell::RefCell, rc::Rc};
-
 #[cfg(feature = "stat")]
 use crate::stat::{AddStats, Stats};
 
@@ -23,7 +20,7 @@ pub struct RegFile {
     inner: [u32; MAX_REG_ID],
     inner_f: [f32; MAX_REG_ID],
     #[cfg(feature = "stat")]
-    stat_memregion: Rc<RefCell<MemoryRegionStatBuilder>>,
+    stat_memregion: MemoryRegionStatBuilder,
     #[cfg(feature = "stat")]
     stat_i: RegFileStat,
     #[cfg(feature = "stat")]
@@ -64,7 +61,7 @@ impl RegFile {
         {
             self.stat_i.encounter_write(id.inner());
             if id.inner() == 2 {
-                self.stat_memregion.borrow_mut().update_sp(val);
+                self.stat_memregion.update_sp(val);
             }
         }
         if id.inner() != 0 {
@@ -78,26 +75,37 @@ impl RegFile {
             self.inner_f[id.inner()] = val;
         }
     }
+    /// raw values of the integer and float registers.
+    pub fn dump(&self) -> (Vec<u32>, Vec<f32>) {
+        (self.inner.to_vec(), self.inner_f.to_vec())
+    }
+    /// same as [`RegFile::dump`] without copying.
+    pub fn as_slices(&self) -> (&[u32], &[f32]) {
+        (&self.inner, &self.inner_f)
+    }
+    /// overwrites the registers without touching statistics.
+    pub fn restore(&mut self, regs: &[u32], fregs: &[f32]) {
+        for (d, s) in self.inner.iter_mut().zip(regs).skip(1) {
+            *d = *s;
+        }
+        for (d, s) in self.inner_f.iter_mut().zip(fregs).skip(1) {
+            *d = *s;
+        }
+    }
     pub fn end_init(&mut self) {
         #[cfg(feature = "stat")]
-        self.stat_memregion
-            .borrow_mut()
-            .init(self.inner[4], self.inner[2])
+        self.stat_memregion.init(self.inner[4], self.inner[2])
     }
     #[cfg(feature = "stat")]
     pub fn get_region(&self, addr: u32) -> crate::common::MemoryRegion {
-        self.stat_memregion.borrow().get_region(addr)
-    }
-
-    pub fn mem_region(&self) -> Rc<RefCell<MemoryRegionStatBuilder>> {
-        self.stat_memregion.clone()
+        self.stat_memregion.get_region(addr)
     }
 }
 
 #[cfg(feature = "stat")]
 impl AddStats for RegFile {
     fn add_stats(&self, buf: &mut Stats) {
-        buf.push(Box::new(self.stat_memregion.borrow().finish(self.inner[4])));
+        buf.push(Box::new(self.stat_memregion.finish(self.inner[4])));
         buf.push(Box::new(RegFileAllStat::new(
             self.stat_i.to_owned(),
             self.stat_f.to_owned(),
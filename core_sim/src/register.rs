@@ -141,3 +141,36 @@ impl TryFrom<&str> for FRegId {
         F_ABINAME_LOOKUP.get(rs).cloned().ok_or(())
     }
 }
+
+/// vector register of the simd extension
+#[cfg(feature = "simd")]
+#[derive(Debug, PartialEq, Eq, Hash, Clone, Copy)]
+pub struct VRegId(u8);
+
+#[cfg(feature = "simd")]
+impl VRegId {
+    pub fn inner(&self) -> usize {
+        self.0 as usize
+    }
+}
+
+#[cfg(feature = "simd")]
+impl Display for VRegId {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "v{}", self.0)
+    }
+}
+
+#[cfg(feature = "simd")]
+impl TryFrom<u32> for VRegId {
+    type Error = anyhow::Error;
+    fn try_from(vs: u32) -> Result<Self, Self::Error> {
+        if vs as usize >= crate::simd::NUM_VREGS {
+            return Err(anyhow::anyhow!(
+                "there are {} vector registers, found v{vs}",
+                crate::simd::NUM_VREGS
+            ));
+        }
+        Ok(Self(vs as u8))
+    }
+}
@@ -0,0 +1,314 @@
+//! parallel detailed re-simulation from functional checkpoints.
+//!
+//! A first run with the interval model saves the architectural state every
+//! `interval` instructions: the registers, the pages written so far and the
+//! input position. Pages unchanged since the previous checkpoint are shared
+//! with it, so a checkpoint costs about the pages written in between. Then
+//! each interval is timed by the detailed model on a pool of threads, in a
+//! fresh simulator starting `warmup` instructions before the interval to
+//! warm up the pipeline, cache and branch predictor; only the clocks of the
+//! interval itself are counted, and the clocks of all intervals add up to
+//! the total.
+
+use std::{
+    collections::BTreeMap,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Arc, Mutex,
+    },
+    thread,
+    time::{Duration, Instant},
+};
+
+use anyhow::{anyhow, ensure, Context, Result};
+
+use crate::{
+    common::{ExecuteMode, Pc, RunStep, SimulationOption},
+    cpu::Counters,
+    interval::TimingModel,
+    io::{BinaryOutput, Input, Output},
+    memory::Page,
+    sim::{BreakReason, ControlFlow, OnBreak, Simulator},
+};
+
+#[derive(Clone, Copy, Debug)]
+pub struct ResimOptions {
+    /// instructions timed from each checkpoint
+    pub interval: usize,
+    /// instructions run before each interval without being timed
+    pub warmup: usize,
+    /// threads of the detailed runs
+    pub jobs: usize,
+}
+
+pub struct Checkpoint<I> {
+    /// instructions executed before it
+    instrs: usize,
+    regs: Vec<u32>,
+    fregs: Vec<f32>,
+    pc: Pc,
+    /// clocks and `csrr` counters of the core
+    counters: (usize, Counters),
+    /// every page written since the program was loaded
+    pages: Vec<Arc<Page>>,
+    input: I,
+}
+
+/// the checkpoints of a functional run, the one of interval `k` taken
+/// `warmup` instructions before it starts
+pub struct Recording<I> {
+    checkpoints: Vec<Checkpoint<I>>,
+    instrs: usize,
+    elapsed: Duration,
+}
+
+impl<I> Recording<I> {
+    pub fn instrs(&self) -> usize {
+        self.instrs
+    }
+    pub fn intervals(&self) -> usize {
+        self.checkpoints.len()
+    }
+}
+
+/// runs `steps` instructions; `false` once the program exited.
+fn run<I: Input, O: Output>(sim: &mut Simulator<I, O>, steps: usize) -> Result<bool> {
+    let opt = SimulationOption {
+        mode: ExecuteMode::RunStep(RunStep::new(Some(steps))),
+        ..Default::default()
+    };
+    match sim.single_cycle(&opt)? {
+        ControlFlow::Exit => Ok(false),
+        ControlFlow::Break(OnBreak {
+            reason: BreakReason::StepEnded,
+            ..
+        }) => Ok(true),
+        ControlFlow::Break(_) => Err(anyhow!(
+            "simulator returns an error: {}",
+            sim.get_error_msg().unwrap_or_default()
+        )),
+    }
+}
+
+fn checkpoint<I: Input + Clone, O: Output>(
+    sim: &mut Simulator<I, O>,
+    written: &mut BTreeMap<usize, Arc<Page>>,
+) -> Checkpoint<I> {
+    let cpu = sim.cpu_mut();
+    for p in cpu.take_written_pages() {
+        written.insert(p.index, Arc::new(p));
+    }
+    let (regs, fregs) = cpu.reg_file().dump();
+    let counters = cpu.counters();
+    Checkpoint {
+        instrs: sim.cycle(),
+        regs,
+        fregs,
+        pc: sim.get_pc(),
+        counters,
+        pages: written.values().cloned().collect(),
+        input: sim.cpu_mut().io_mut().0.clone(),
+    }
+}
+
+/// runs the program to the end with the interval model, saving the
+/// checkpoints to [`replay`] from.
+pub fn record<I: Input + Clone, O: Output>(
+    sim: &mut Simulator<I, O>,
+    opt: &ResimOptions,
+) -> Result<Recording<I>> {
+    ensure!(opt.interval > 0, "the interval must not be empty");
+    let begin = Instant::now();
+    sim.set_timing(TimingModel::Interval);
+    let mut written = BTreeMap::new();
+    let mut checkpoints = vec![checkpoint(sim, &mut written)];
+    loop {
+        let at = (checkpoints.len() * opt.interval).saturating_sub(opt.warmup);
+        if !run(sim, at - sim.cycle())? {
+            break;
+        }
+        checkpoints.push(checkpoint(sim, &mut written));
+    }
+    let instrs = sim.cycle();
+    // intervals starting after the exit
+    checkpoints.truncate(instrs.div_ceil(opt.interval).max(1));
+    Ok(Recording {
+        checkpoints,
+        instrs,
+        elapsed: begin.elapsed(),
+    })
+}
+
+/// the clocks of interval `k` predicted by the detailed model.
+fn time_interval<I: Input + Clone>(
+    mem: &[u8],
+    rec: &Recording<I>,
+    k: usize,
+    opt: &ResimOptions,
+) -> Result<usize> {
+    let cp = &rec.checkpoints[k];
+    let begin = k * opt.interval;
+    let end = (begin + opt.interval).min(rec.instrs);
+    let mut sim = Simulator::new(mem, cp.input.clone(), BinaryOutput::new())?;
+    sim.cpu_mut().restore_arch(
+        &cp.regs,
+        &cp.fregs,
+        cp.pc,
+        cp.counters,
+        cp.pages.iter().map(|p| &**p),
+    );
+    run(&mut sim, begin - cp.instrs)?;
+    let warm = sim.elapsed_clocks();
+    run(&mut sim, end - begin)?;
+    Ok(sim.elapsed_clocks() - warm)
+}
+
+/// times every interval of `rec` with the detailed model on `opt.jobs`
+/// threads; `mem` is the program `rec` was recorded from.
+pub fn replay<I: Input + Clone + Send + Sync>(
+    mem: &[u8],
+    rec: &Recording<I>,
+    opt: &ResimOptions,
+) -> Result<Resim> {
+    let begin = Instant::now();
+    let n = rec.checkpoints.len();
+    let jobs = opt.jobs.clamp(1, n);
+    let next = AtomicUsize::new(0);
+    let results = Mutex::new((0..n).map(|_| None).collect::<Vec<_>>());
+    thread::scope(|s| {
+        for _ in 0..jobs {
+            s.spawn(|| loop {
+                let k = next.fetch_add(1, Ordering::Relaxed);
+                if k >= n {
+                    break;
+                }
+                let r = time_interval(mem, rec, k, opt);
+                results.lock().unwrap()[k] = Some(r);
+            });
+        }
+    });
+    let clocks = results
+        .into_inner()
+        .unwrap()
+        .into_iter()
+        .enumerate()
+        .map(|(k, r)| r.unwrap().with_context(|| format!("timing interval {k}")))
+        .collect::<Result<_>>()?;
+    Ok(Resim {
+        opt: ResimOptions { jobs, ..*opt },
+        instrs: rec.instrs,
+        clocks,
+        functional: rec.elapsed,
+        detailed: begin.elapsed(),
+    })
+}
+
+/// the clocks stitched from the intervals.
+#[derive(Clone)]
+pub struct Resim {
+    opt: ResimOptions,
+    instrs: usize,
+    /// clocks of each interval
+    clocks: Vec<usize>,
+    functional: Duration,
+    detailed: Duration,
+}
+
+impl Resim {
+    pub fn clocks(&self) -> usize {
+        self.clocks.iter().sum()
+    }
+}
+
+#[cfg(feature = "stat")]
+mod stat {
+    use std::fmt;
+
+    use super::*;
+    use crate::stat::*;
+
+    impl Stat for Resim {
+        fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+            Box::new(self)
+        }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            Some((
+                "resim",
+                serde_json::json!({
+                    "interval": self.opt.interval,
+                    "warmup": self.opt.warmup,
+                    "jobs": self.opt.jobs,
+                    "instrs": self.instrs,
+                    "clocks": self.clocks(),
+                    "intervals": self.clocks,
+                    "functional_ms": self.functional.as_millis() as u64,
+                    "detailed_ms": self.detailed.as_millis() as u64,
+                }),
+            ))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["instrs", "clocks"]
+        }
+    }
+
+    impl StatView for &'_ Resim {
+        fn header(&self) -> &'static str {
+            "re-simulation"
+        }
+        fn width(&self) -> usize {
+            33
+        }
+    }
+
+    impl fmt::Display for &'_ Resim {
+        fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+            let intervals = format!("{} x {}", self.clocks.len(), self.opt.interval);
+            writeln!(f, "  intervals: {intervals:>13}")?;
+            writeln!(f, "  warm-up: {:>15}", self.opt.warmup)?;
+            writeln!(f, "  jobs: {:>18}", self.opt.jobs)?;
+            writeln!(f, "  clocks total: {:>10}", format!("#{}", self.clocks()))?;
+            let ms = format!("{} ms", self.functional.as_millis());
+            writeln!(f, "  functional: {ms:>12}")?;
+            let ms = format!("{} ms", self.detailed.as_millis());
+            writeln!(f, "  detailed: {ms:>14}")
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{common::program_image, sim::test_sim};
+
+    #[test]
+    fn test_resim() {
+        // li x5, 0 / li x7, 40 / li x9, 500 / loop: inw x8 /
+        // blt x8, zero, neg / add x5, x5, x8 / j next / neg: sub x5, x5, x8 /
+        // next: sw x5, 0(x9) / addi x7, x7, -1 / bne x7, zero, loop /
+        // outb x5 / end
+        let text = [
+            0x00000293, 0x02800393, 0x1f400493, 0x0000040b, 0x00044663, 0x008282b3, 0x0080006f,
+            0x408282b3, 0x0054a023, 0xfff38393, 0xfe0392e3, 0x0002802b, 0,
+        ];
+        let input: Vec<u8> = (0..40i32)
+            .flat_map(|i| (i * 37 % 19 - 9).to_le_bytes())
+            .collect();
+        let mut full = test_sim(&[], &text, &input);
+        full.run_to_end();
+        let opt = ResimOptions {
+            interval: 50,
+            warmup: 80,
+            jobs: 2,
+        };
+        let mut functional = test_sim(&[], &text, &input);
+        let rec = record(&mut functional, &opt).unwrap();
+        assert_eq!(rec.instrs(), full.cycle());
+        assert!(rec.intervals() > 2);
+        let resim = replay(&program_image(&[], &text), &rec, &opt).unwrap();
+        assert_eq!(resim.clocks(), full.elapsed_clocks());
+        assert_eq!(
+            functional.into_output().cpu_output.as_bytes(),
+            full.into_output().cpu_output.as_bytes()
+        );
+    }
+}
@@ -0,0 +1,244 @@
+//! regions of interest scoping the statistics.
+//!
+//! `addi zero, zero, n` opens region `n` if `n > 0` and closes region `-n`
+//! if `n < 0`; the plain `nop` marks nothing. Over every entry of a region
+//! the instruction mix, the data cache and branch counts, the clocks and
+//! the energy (with a model set) are accumulated, so that e.g. only the
+//! rendering kernel is measured apart from reading the input and the
+//! setup. Regions may nest or overlap;
+//! opening a region already open only deepens it, so markers around a
+//! recursive function count its outermost calls.
+
+use std::{collections::BTreeMap, fmt};
+
+use crate::{
+    cpu::{BranchStat, CacheStat, InstrStat},
+    instr::{DecodedInstr, IInstr, Instr, InstrId},
+    stat::*,
+};
+
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum Marker {
+    Begin(u32),
+    End(u32),
+}
+
+#[inline]
+pub fn marker(instr: &DecodedInstr) -> Option<Marker> {
+    match instr {
+        Instr::I {
+            instr: IInstr::Addi,
+            rd,
+            rs1,
+            imm,
+        } if rd.is_zero() && rs1.is_zero() && *imm != 0 => {
+            let n = *imm as i32;
+            Some(if n > 0 {
+                Marker::Begin(n as u32)
+            } else {
+                Marker::End(n.unsigned_abs())
+            })
+        }
+        _ => None,
+    }
+}
+
+/// the counters a region accumulates
+#[derive(Clone, Copy, Default)]
+pub struct Counts {
+    pub instrs: InstrStat,
+    pub cache: CacheStat,
+    pub branch: BranchStat,
+    #[cfg(feature = "time_predict")]
+    pub clocks: usize,
+    /// picojoules; 0 without an energy model
+    #[cfg(feature = "time_predict")]
+    pub energy: f64,
+}
+
+impl Counts {
+    fn since(&self, earlier: &Self) -> Self {
+        Self {
+            instrs: self.instrs.since(&earlier.instrs),
+            cache: self.cache.since(&earlier.cache),
+            branch: self.branch.since(&earlier.branch),
+            #[cfg(feature = "time_predict")]
+            clocks: self.clocks - earlier.clocks,
+            #[cfg(feature = "time_predict")]
+            energy: self.energy - earlier.energy,
+        }
+    }
+    fn add(&mut self, other: &Self) {
+        self.instrs.add(&other.instrs);
+        self.cache.add(&other.cache);
+        self.branch.add(&other.branch);
+        #[cfg(feature = "time_predict")]
+        {
+            self.clocks += other.clocks;
+            self.energy += other.energy;
+        }
+    }
+    fn instrs(&self) -> usize {
+        self.instrs.counts().iter().sum()
+    }
+}
+
+#[derive(Clone, Copy, Default)]
+struct Region {
+    entries: usize,
+    total: Counts,
+    /// nesting depth and the counts at the entry, while open
+    open: Option<(usize, Counts)>,
+}
+
+#[derive(Default)]
+pub struct Regions {
+    regions: BTreeMap<u32, Region>,
+}
+
+impl Regions {
+    pub fn is_empty(&self) -> bool {
+        self.regions.is_empty()
+    }
+    /// applies `marker` retired with the counters at `now`.
+    pub fn mark(&mut self, marker: Marker, now: Counts) {
+        match marker {
+            Marker::Begin(label) => {
+                let r = self.regions.entry(label).or_default();
+                match &mut r.open {
+                    Some((depth, _)) => *depth += 1,
+                    None => r.open = Some((1, now)),
+                }
+            }
+            Marker::End(label) => {
+                let Some(r) = self.regions.get_mut(&label) else {
+                    log::warn!("region {label} closed before opened; ignored.");
+                    return;
+                };
+                match r.open {
+                    Some((1, begin)) => {
+                        r.total.add(&now.since(&begin));
+                        r.entries += 1;
+                        r.open = None;
+                    }
+                    Some((ref mut depth, _)) => *depth -= 1,
+                    None => log::warn!("region {label} closed twice; ignored."),
+                }
+            }
+        }
+    }
+    /// the regions, closing those still open at `now`.
+    pub fn report(&self, now: &Counts) -> RegionReport {
+        let regions = self
+            .regions
+            .iter()
+            .map(|(&label, r)| {
+                let mut r = *r;
+                if let Some((_, begin)) = r.open {
+                    r.total.add(&now.since(&begin));
+                    r.entries += 1;
+                }
+                (label, r.entries, r.total)
+            })
+            .collect();
+        RegionReport { regions }
+    }
+}
+
+pub struct RegionReport {
+    /// label, entries and accumulated counts
+    regions: Vec<(u32, usize, Counts)>,
+}
+
+impl Stat for RegionReport {
+    fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+        Box::new(self)
+    }
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        let map: serde_json::Map<_, _> = self
+            .regions
+            .iter()
+            .map(|(label, entries, c)| {
+                let mix: serde_json::Map<_, _> = c
+                    .instrs
+                    .counts()
+                    .iter()
+                    .enumerate()
+                    .filter(|(_, &n)| n > 0)
+                    .filter_map(|(i, &n)| {
+                        Some((InstrId::try_from(i as u8).ok()?.to_string(), n.into()))
+                    })
+                    .collect();
+                #[allow(unused_mut)]
+                let mut v = serde_json::json!({
+                    "entries": entries,
+                    "instrs": c.instrs(),
+                    "instr": mix,
+                    "cache": serde_json::to_value(c.cache).ok()?,
+                    "branch": serde_json::to_value(c.branch).ok()?,
+                });
+                #[cfg(feature = "time_predict")]
+                {
+                    v["clocks"] = c.clocks.into();
+                    if c.energy > 0.0 {
+                        v["energy_pj"] = c.energy.into();
+                    }
+                }
+                Some((label.to_string(), v))
+            })
+            .collect::<Option<_>>()?;
+        Some(("regions", map.into()))
+    }
+}
+
+impl StatView for &'_ RegionReport {
+    fn header(&self) -> &'static str {
+        "regions of interest"
+    }
+    fn width(&self) -> usize {
+        33
+    }
+}
+
+impl fmt::Display for &'_ RegionReport {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        for (label, entries, c) in &self.regions {
+            writeln!(f, "  region {label}: {entries} entries")?;
+            writeln!(f, "    instrs: {:>14}", c.instrs())?;
+            #[cfg(feature = "time_predict")]
+            {
+                let cpi = c.clocks as f64 / c.instrs().max(1) as f64;
+                writeln!(f, "    clocks: {:>14} (CPI {cpi:.3})", c.clocks)?;
+                if c.energy > 0.0 {
+                    writeln!(f, "    energy: {:>11.3} nJ", c.energy * 1e-3)?;
+                }
+            }
+            writeln!(f, "    cache hit: {:>10.3}%", c.cache.hit_rate())?;
+            writeln!(f, "    branch pred: {:>8.3}%", c.branch.accuracy())?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(all(test, feature = "time_predict"))]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_mark() {
+        let at = |clocks| Counts {
+            clocks,
+            ..Default::default()
+        };
+        let mut r = Regions::default();
+        r.mark(Marker::Begin(1), at(10));
+        r.mark(Marker::Begin(1), at(12));
+        r.mark(Marker::End(1), at(15));
+        r.mark(Marker::End(1), at(20));
+        // still open at the exit
+        r.mark(Marker::Begin(1), at(30));
+        let report = r.report(&at(35));
+        let (label, entries, c) = &report.regions[0];
+        assert_eq!((*label, *entries, c.clocks), (1, 2, 15));
+    }
+}
@@ -0,0 +1,279 @@
+//! statistical sampling profiler.
+//!
+//! Unlike the CPI stack and the loop profiler, which account for every
+//! instruction, the sampler only decrements a countdown of retired
+//! instructions (or predicted clocks) per instruction and checks it at the
+//! end of basic blocks, i.e. at branches, calls and returns. Once it has run
+//! out, the pc of the instruction ending the block is recorded, with the
+//! shadow call stack if asked, and the countdown is re-armed by the period.
+//! Samples are therefore attributed at the granularity of basic blocks,
+//! which is enough to rank functions, for a subtraction per instruction.
+//!
+//! The samples are reported flat, by the function of the sampled pc, and
+//! as collapsed stacks (`outer;inner;leaf count` per line) read by flame
+//! graph tools.
+
+use std::{collections::HashMap, fmt, str::FromStr};
+
+use crate::{
+    common::Pc, core_dump::CallFrame, debug_symbol::DebugSymbol, instr::FlowKind, stat::*,
+};
+
+/// number of functions shown in the flat profile
+const NUM_SHOWN_FUNCTIONS: usize = 20;
+
+/// what the sampling period counts
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Default)]
+pub enum SampleOn {
+    #[default]
+    Instrs,
+    #[cfg(feature = "time_predict")]
+    Clocks,
+}
+
+impl SampleOn {
+    pub fn name(self) -> &'static str {
+        match self {
+            Self::Instrs => "instrs",
+            #[cfg(feature = "time_predict")]
+            Self::Clocks => "clocks",
+        }
+    }
+}
+
+impl FromStr for SampleOn {
+    type Err = String;
+    fn from_str(s: &str) -> Result<Self, String> {
+        match s {
+            "instrs" => Ok(Self::Instrs),
+            #[cfg(feature = "time_predict")]
+            "clocks" => Ok(Self::Clocks),
+            _ => Err(format!(
+                "unknown sampling event `{s}`; expected `instrs` or `clocks`"
+            )),
+        }
+    }
+}
+
+#[derive(Clone, Copy, Debug)]
+pub struct SampleOptions {
+    /// instructions or clocks between samples
+    pub period: usize,
+    pub on: SampleOn,
+    /// record the call stack of each sample
+    pub stacks: bool,
+}
+
+pub struct Sampler {
+    opt: Option<SampleOptions>,
+    on: SampleOn,
+    /// instructions or clocks left until the next sample; never runs out
+    /// while disabled
+    countdown: isize,
+    /// call sites outermost first, then the sampled pc
+    samples: HashMap<Vec<u32>, usize>,
+}
+
+impl Default for Sampler {
+    fn default() -> Self {
+        Self {
+            opt: None,
+            on: SampleOn::Instrs,
+            countdown: isize::MAX,
+            samples: HashMap::new(),
+        }
+    }
+}
+
+impl Sampler {
+    pub fn new(opt: SampleOptions) -> Self {
+        Self {
+            opt: Some(opt),
+            on: opt.on,
+            countdown: opt.period.max(1) as isize,
+            samples: HashMap::new(),
+        }
+    }
+    pub fn is_enabled(&self) -> bool {
+        self.opt.is_some()
+    }
+    /// counts down a retired instruction taking `clocks`; whether to call
+    /// [`Self::sample`] for it.
+    #[inline]
+    pub fn tick(&mut self, #[allow(unused_variables)] clocks: usize, flow: FlowKind) -> bool {
+        self.countdown -= match self.on {
+            SampleOn::Instrs => 1,
+            #[cfg(feature = "time_predict")]
+            SampleOn::Clocks => clocks as isize,
+        };
+        self.countdown <= 0 && flow != FlowKind::Other
+    }
+    #[cold]
+    pub fn sample(&mut self, pc: Pc, calls: &[CallFrame]) {
+        let Some(opt) = self.opt else {
+            return;
+        };
+        let mut stack = vec![];
+        if opt.stacks {
+            stack.extend(calls.iter().map(|c| c.call_site));
+        }
+        stack.push(pc.into_inner());
+        *self.samples.entry(stack).or_default() += 1;
+        let period = opt.period.max(1) as isize;
+        // the overshoot is kept so that the rate matches the period on average
+        self.countdown += period;
+        if self.countdown <= 0 {
+            self.countdown = period;
+        }
+    }
+    /// names the sampled pcs by the functions containing them.
+    pub fn report(&self, debug_symbol: &DebugSymbol) -> SampleProfile {
+        let name = |pc: u32| match debug_symbol.function_of(pc) {
+            Some(label) => label.to_string(),
+            None => format!("{pc:#010x}"),
+        };
+        let mut stacks: HashMap<Vec<String>, usize> = HashMap::new();
+        for (pcs, &n) in &self.samples {
+            *stacks
+                .entry(pcs.iter().map(|&pc| name(pc)).collect())
+                .or_default() += n;
+        }
+        let mut flat: HashMap<&str, usize> = HashMap::new();
+        for (frames, &n) in &stacks {
+            *flat.entry(frames.last().unwrap()).or_default() += n;
+        }
+        let mut functions: Vec<_> = flat
+            .into_iter()
+            .map(|(name, n)| (name.to_string(), n))
+            .collect();
+        functions.sort_by(|a, b| b.1.cmp(&a.1).then_with(|| a.0.cmp(&b.0)));
+        let mut stacks: Vec<_> = stacks.into_iter().collect();
+        stacks.sort();
+        SampleProfile {
+            opt: self.opt.unwrap_or(SampleOptions {
+                period: 0,
+                on: SampleOn::Instrs,
+                stacks: false,
+            }),
+            samples: self.samples.values().sum(),
+            functions,
+            stacks,
+        }
+    }
+}
+
+pub struct SampleProfile {
+    opt: SampleOptions,
+    samples: usize,
+    /// samples by function, in descending order
+    functions: Vec<(String, usize)>,
+    /// samples by stack of functions, outermost first
+    stacks: Vec<(Vec<String>, usize)>,
+}
+
+impl SampleProfile {
+    /// one `outer;inner;leaf count` line per stack.
+    pub fn collapsed(&self) -> String {
+        self.stacks
+            .iter()
+            .map(|(frames, n)| format!("{} {n}\n", frames.join(";")))
+            .collect()
+    }
+}
+
+impl Stat for SampleProfile {
+    fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+        Box::new(self)
+    }
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        let functions: serde_json::Map<_, _> = self
+            .functions
+            .iter()
+            .map(|(name, n)| (name.clone(), (*n).into()))
+            .collect();
+        Some((
+            "samples",
+            serde_json::json!({
+                "period": self.opt.period,
+                "on": self.opt.on.name(),
+                "samples": self.samples,
+                "functions": functions,
+            }),
+        ))
+    }
+    fn counters(&self) -> &'static [&'static str] {
+        &["samples"]
+    }
+}
+
+impl StatView for &'_ SampleProfile {
+    fn header(&self) -> &'static str {
+        "sampled profile"
+    }
+    fn width(&self) -> usize {
+        2 + 24 + 10 + 9
+    }
+}
+
+impl fmt::Display for &'_ SampleProfile {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        writeln!(
+            f,
+            "  {} samples, every {} {}",
+            self.samples,
+            self.opt.period,
+            self.opt.on.name()
+        )?;
+        writeln!(f, "  {:<24}{:>10}{:>9}", "function", "samples", "%")?;
+        let total = self.samples.max(1) as f64;
+        for (name, n) in self.functions.iter().take(NUM_SHOWN_FUNCTIONS) {
+            let percent = *n as f64 / total * 100.0;
+            writeln!(f, "  {name:<24.24}{n:>10}{percent:>9.2}")?;
+        }
+        if self.functions.len() > NUM_SHOWN_FUNCTIONS {
+            let n: usize = self.functions[NUM_SHOWN_FUNCTIONS..]
+                .iter()
+                .map(|(_, n)| n)
+                .sum();
+            let percent = n as f64 / total * 100.0;
+            writeln!(f, "  {:<24}{n:>10}{percent:>9.2}", "(others)")?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_sample() {
+        let mut s = Sampler::new(SampleOptions {
+            period: 3,
+            on: SampleOn::Instrs,
+            stacks: true,
+        });
+        let calls = [CallFrame {
+            target: 0x100,
+            call_site: 0x20,
+        }];
+        let mut taken = 0;
+        for i in 0..30 {
+            // a block of 4 instructions
+            let flow = if i % 4 == 3 {
+                FlowKind::Branch
+            } else {
+                FlowKind::Other
+            };
+            if s.tick(1, flow) {
+                s.sample(Pc::new(0x104), &calls);
+                taken += 1;
+            }
+        }
+        // 30 instructions at a period of 3, checked at 7 block ends
+        assert_eq!(taken, 7);
+        let report = s.report(&DebugSymbol::default());
+        assert_eq!(report.collapsed(), "0x00000020;0x00000104 7\n");
+        assert!(!Sampler::default().tick(usize::MAX, FlowKind::Return));
+    }
+}
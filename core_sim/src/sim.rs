@@ -1,25 +1,35 @@
 use std::{collections::HashMap, fmt};
 
-use anyhow::Result;
+use anyhow::{anyhow, bail, Result};
 
 use crate::{
     breakpoint::BreakPoint,
     common::{ExecuteMode, Pc, SimulationOption, SpyResult, Watchings},
+    core_dump::{self, CallFrame, CoreDump},
     cpu::{self, Cpu, CycleResult, ExecutionTrace, RuntimeError},
     debug_symbol::DebugSymbol,
+    fuse::Fusions,
     instr::{self, DecodedInstr, Instr},
     io::{Input, Output},
     memory::Addr,
+    multicore::{MulticoreConfig, Scheduler},
     reg_file::{RegFileView, ShowRegFileKind},
     register::{FRegId, RegId},
     ty::{Typed, TypedU32},
 };
 
+#[cfg(all(feature = "stat", feature = "time_predict"))]
+use crate::energy::EnergyModel;
+#[cfg(feature = "time_predict")]
+use crate::interval::TimingModel;
 #[cfg(feature = "stat")]
-use crate::stat::{AddStats, Stats};
+use crate::{
+    sampler::{SampleOptions, Sampler},
+    stat::{AddStats, Stats},
+};
 
 #[cfg(feature = "time_predict")]
-const CPU_CLOCK_FREQ: usize = 183_333_333;
+pub(crate) const CPU_CLOCK_FREQ: usize = 183_333_333;
 #[cfg(feature = "time_predict")]
 const CPU_BAUDRATE: usize = 2_304_000;
 
@@ -30,10 +40,21 @@ pub struct Simulator<I, O> {
     cycle: usize,
     debug_symbol: DebugSymbol,
     fatal_error: Option<RuntimeError>,
+    /// identifies the program in core files
+    program_hash: u64,
+    multicore: Option<Scheduler>,
     #[cfg(feature = "stat")]
     stat_builder: stat::SimStatBuilder,
 }
 
+/// state to roll back to between runs of the same program.
+pub struct Snapshot {
+    cpu: cpu::CpuSnapshot,
+    cycle: usize,
+    #[cfg(feature = "time_predict")]
+    elapsed_clocks: usize,
+}
+
 pub struct SimOutput<O> {
     pub cpu_output: O,
 }
@@ -56,6 +77,8 @@ impl<I: Input, O: Output> Simulator<I, O> {
             cycle: 0,
             debug_symbol: Default::default(),
             fatal_error: None,
+            program_hash: core_dump::program_hash(mem),
+            multicore: None,
             #[cfg(feature = "stat")]
             stat_builder,
         })
@@ -66,6 +89,59 @@ impl<I: Input, O: Output> Simulator<I, O> {
             self.debug_symbol.merge(debug_symbol)
         }
     }
+    /// runs `config.cores` cores from the current state; see
+    /// [`crate::multicore`].
+    pub fn set_multicore(&mut self, config: MulticoreConfig) {
+        if let Some(mut s) = self.multicore.take() {
+            s.park_all(&mut self.cpu);
+        }
+        if config.cores > 1 {
+            self.multicore = Some(Scheduler::new(&mut self.cpu, config));
+        }
+    }
+    /// pairs of instructions executed by one handler in
+    /// [`ExecuteMode::Run`]; see [`crate::fuse`].
+    pub fn set_fusions(&mut self, fusions: Fusions) {
+        self.cpu.set_fusions(fusions);
+    }
+    /// the model predicting the clocks; see [`crate::interval`].
+    #[cfg(feature = "time_predict")]
+    pub fn set_timing(&mut self, timing: TimingModel) {
+        self.cpu.set_timing(timing);
+    }
+    /// reports the error of the interval model against the detailed one.
+    #[cfg(feature = "time_predict")]
+    pub fn calibrate_interval(&mut self) {
+        self.cpu.calibrate_interval();
+    }
+    /// weights the events of the run into energy; see [`crate::energy`].
+    #[cfg(all(feature = "stat", feature = "time_predict"))]
+    pub fn set_energy_model(&mut self, model: EnergyModel) {
+        self.cpu.energy.set_model(model);
+    }
+    /// looks for redundant loads and dead stores; see
+    /// [`crate::redundancy`].
+    #[cfg(feature = "stat")]
+    pub fn check_redundancy(&mut self) {
+        self.cpu.redundancy.enable();
+    }
+    /// profiles the trip counts and costs of loops; see [`crate::loops`].
+    #[cfg(feature = "stat")]
+    pub fn profile_loops(&mut self) {
+        self.cpu.loops.enable();
+    }
+    /// profiles the data accesses to advise a BRAM placement; see
+    /// [`crate::placement`].
+    #[cfg(all(feature = "stat", feature = "time_predict"))]
+    pub fn advise_placement(&mut self) {
+        self.cpu.placement.enable();
+    }
+    /// samples the pc every `opt.period` instructions or clocks; see
+    /// [`crate::sampler`].
+    #[cfg(feature = "stat")]
+    pub fn set_sampling(&mut self, opt: SampleOptions) {
+        self.cpu.sampler = Sampler::new(opt);
+    }
     pub fn into_output(self) -> SimOutput<O> {
         let cpu_output = self.cpu.into_output();
         SimOutput {
@@ -81,6 +157,18 @@ impl<I, O> Simulator<I, O> {
         self.add_stats(&mut ss);
         ss
     }
+    #[cfg(feature = "stat")]
+    pub fn sample_profile(&self) -> crate::sampler::SampleProfile {
+        self.cpu.sampler.report(&self.debug_symbol)
+    }
+    /// the advice if enabled by [`Self::advise_placement`]
+    #[cfg(all(feature = "stat", feature = "time_predict"))]
+    pub fn placement_advice(&self) -> Option<crate::placement::PlacementAdvice> {
+        self.cpu
+            .placement
+            .is_enabled()
+            .then(|| self.cpu.placement.advise(&self.debug_symbol))
+    }
 }
 
 #[cfg(feature = "stat")]
@@ -88,6 +176,34 @@ impl<I, O> AddStats for Simulator<I, O> {
     fn add_stats(&self, buf: &mut Stats) {
         buf.push(Box::new(self.stat_builder.finish()));
         self.cpu.add_stats(buf);
+        #[cfg(feature = "time_predict")]
+        buf.push(Box::new(self.cpu.cpi.by_function(&self.debug_symbol)));
+        #[cfg(feature = "time_predict")]
+        if let Some(advice) = self.placement_advice() {
+            buf.push(Box::new(advice));
+        }
+        #[cfg(feature = "time_predict")]
+        if self.cpu.energy.is_enabled() {
+            buf.push(Box::new(
+                self.cpu
+                    .energy
+                    .by_function(&self.debug_symbol, self.elapsed_clocks),
+            ));
+        }
+        if self.cpu.loops.is_enabled() {
+            buf.push(Box::new(self.cpu.loops.report(&self.debug_symbol)));
+        }
+        if self.cpu.redundancy.is_enabled() {
+            buf.push(Box::new(self.cpu.redundancy.report(&self.debug_symbol)));
+        }
+        if self.cpu.sampler.is_enabled() {
+            buf.push(Box::new(self.sample_profile()));
+        }
+        #[cfg(feature = "uninit_check")]
+        buf.push(Box::new(self.cpu.uninit.report(&self.debug_symbol)));
+        if let Some(s) = &self.multicore {
+            buf.push(Box::new(s.report(&self.cpu)));
+        }
     }
 }
 
@@ -165,6 +281,20 @@ mod stat {
         fn view(&self, _: usize) -> Box<dyn StatView + '_> {
             Box::new(self)
         }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            let mut map = serde_json::Map::new();
+            map.insert(
+                "elapsed_ms".into(),
+                (self.elapsed.as_millis() as u64).into(),
+            );
+            map.insert("cycles".into(), self.cycle.into());
+            #[cfg(feature = "time_predict")]
+            map.insert("clocks".into(), self.elapsed_clocks.into());
+            Some(("sim", map.into()))
+        }
+        fn counters(&self) -> &'static [&'static str] {
+            &["cycles", "clocks"]
+        }
     }
 
     impl StatView for &'_ SimStat {
@@ -238,6 +368,11 @@ impl<I: Input, O: Output> Simulator<I, O> {
             break_sim!(BreakReason::CannotRestart)
         }
         let mut is_enter = true;
+        // a fused pair runs through with no chance to stop between the two
+        let fuse = matches!(opt.mode, ExecuteMode::Run)
+            && opt.breakpoints.is_empty()
+            && !opt.do_trace
+            && self.multicore.is_none();
         macro_rules! execute {
             () => {
                 if is_enter {
@@ -249,7 +384,11 @@ impl<I: Input, O: Output> Simulator<I, O> {
                         }
                     }
                 }
-                let r = self.cpu.cycle_one_full(opt.do_trace);
+                let r = if fuse {
+                    self.cpu.cycle_fused()
+                } else {
+                    self.cpu.cycle_one_full(opt.do_trace)
+                };
                 let r = match r {
                     Ok(r) => r,
                     Err(e) => {
@@ -263,14 +402,30 @@ impl<I: Input, O: Output> Simulator<I, O> {
                 {
                     self.elapsed_clocks += r.cycles as usize;
                 }
-                self.cycle += 1;
+                self.cycle += 1 + usize::from(r.fused);
                 match r.flow {
-                    cpu::ControlFlow::Continue => print_trace(self.cycle, &r),
+                    cpu::ControlFlow::Continue => {
+                        print_trace(self.cycle, &r);
+                        if let Some(s) = &mut self.multicore {
+                            s.tick(&mut self.cpu);
+                        }
+                    }
                     cpu::ControlFlow::Break(reason) => break_sim!(reason.into()),
                     cpu::ControlFlow::Exit => {
-                        #[cfg(feature = "stat")]
-                        self.exit_sim();
-                        return Ok(ControlFlow::Exit);
+                        // other cores may still be running
+                        let running = match &mut self.multicore {
+                            Some(s) => s.halt(&mut self.cpu),
+                            None => false,
+                        };
+                        if !running {
+                            #[cfg(feature = "time_predict")]
+                            if let Some(s) = &self.multicore {
+                                self.elapsed_clocks = s.elapsed_clocks(&self.cpu);
+                            }
+                            #[cfg(feature = "stat")]
+                            self.exit_sim();
+                            return Ok(ControlFlow::Exit);
+                        }
                     }
                 }
             };
@@ -336,10 +491,19 @@ impl<I: Input, O: Output> Simulator<I, O> {
         self.cycle
     }
 
+    #[cfg(feature = "time_predict")]
+    pub fn elapsed_clocks(&self) -> usize {
+        self.elapsed_clocks
+    }
+
     pub fn debug_symbol(&self) -> &DebugSymbol {
         &self.debug_symbol
     }
 
+    pub fn cpu(&self) -> &Cpu<I, O> {
+        &self.cpu
+    }
+
     pub fn cpu_mut(&mut self) -> &mut Cpu<I, O> {
         &mut self.cpu
     }
@@ -347,6 +511,94 @@ impl<I: Input, O: Output> Simulator<I, O> {
     pub fn get_error_msg(&self) -> Option<String> {
         self.fatal_error.as_ref().map(|e| format!("{e}"))
     }
+
+    pub fn snapshot(&mut self) -> Snapshot {
+        Snapshot {
+            cpu: self.cpu.snapshot(),
+            cycle: self.cycle,
+            #[cfg(feature = "time_predict")]
+            elapsed_clocks: self.elapsed_clocks,
+        }
+    }
+
+    /// rolls back to `snapshot`, recovering from a fatal error if any.
+    pub fn reset(&mut self, snapshot: &Snapshot) {
+        let multicore = self.multicore.take().map(|mut s| {
+            s.park_all(&mut self.cpu);
+            s.config()
+        });
+        self.cpu.reset(&snapshot.cpu);
+        if let Some(config) = multicore {
+            self.set_multicore(config);
+        }
+        self.cycle = snapshot.cycle;
+        #[cfg(feature = "time_predict")]
+        {
+            self.elapsed_clocks = snapshot.elapsed_clocks;
+        }
+        self.fatal_error = None;
+    }
+
+    /// call stack, outermost first.
+    pub fn call_stack(&self) -> &[CallFrame] {
+        self.cpu.trail().calls()
+    }
+
+    /// pcs of the last executed instructions, oldest first.
+    pub fn recent_pcs(&self) -> Vec<u32> {
+        self.cpu.trail().recent_pcs()
+    }
+
+    /// returns `None` unless the simulation has failed.
+    pub fn core_dump(&self) -> Option<CoreDump> {
+        let error = self.get_error_msg()?;
+        Some(
+            self.cpu
+                .core_dump(error, self.cycle as u64, self.program_hash),
+        )
+    }
+
+    /// loads the state of a failed run of the same program; the simulation
+    /// cannot be resumed afterward.
+    pub fn restore_core(&mut self, core: &CoreDump) -> Result<()> {
+        if core.program_hash != self.program_hash {
+            bail!("the core file was not dumped from this program");
+        }
+        self.cpu.restore_core(core);
+        self.cycle = core.cycle as usize;
+        self.fatal_error = Some(RuntimeError::Anyhow(anyhow!("{}", core.error)));
+        Ok(())
+    }
+}
+
+/// a simulator of the program image of `data` and `text` reading `input`.
+#[cfg(test)]
+pub(crate) fn test_sim(
+    data: &[u32],
+    text: &[u32],
+    input: &[u8],
+) -> Simulator<crate::io::BinaryInput, crate::io::BinaryOutput> {
+    use crate::io::{BinaryInput, BinaryOutput};
+    let image = crate::common::program_image(data, text);
+    Simulator::new(
+        &image,
+        BinaryInput::new(input.to_vec()),
+        BinaryOutput::new(),
+    )
+    .unwrap()
+}
+
+#[cfg(test)]
+impl<I: Input, O: Output> Simulator<I, O> {
+    /// runs to the end of the program, which must succeed.
+    pub(crate) fn run_to_end(&mut self) {
+        let flow = self.single_cycle(&SimulationOption::default()).unwrap();
+        assert!(
+            flow.exit_code().is_some_and(|c| c.is_success()),
+            "{:?}",
+            self.get_error_msg()
+        );
+    }
 }
 
 pub enum ControlFlow {
@@ -0,0 +1,73 @@
+//! lane operations of the experimental packed-float extension.
+//!
+//! A vector register holds [`LANES`] floats. Every lane goes through the
+//! same FPU model as the scalar instructions, so a vector instruction gives
+//! bit for bit the result of the scalar sequence it replaces. Without
+//! `fpu_sim` the lanes are computed with host SIMD.
+
+use crate::fpu_wrapper::fpu;
+
+pub const LANES: usize = 4;
+/// kept small, as every register costs `LANES` words of LUT RAM
+pub const NUM_VREGS: usize = 8;
+
+pub type Lanes = [f32; LANES];
+
+cfg_if::cfg_if! {
+    if #[cfg(feature = "fpu_sim")] {
+        #[inline]
+        fn zip(a: Lanes, b: Lanes, f: fn(f32, f32) -> f32) -> Lanes {
+            std::array::from_fn(|i| f(a[i], b[i]))
+        }
+        #[inline]
+        pub fn add(a: Lanes, b: Lanes) -> Lanes {
+            zip(a, b, fpu::fadd)
+        }
+        #[inline]
+        pub fn mul(a: Lanes, b: Lanes) -> Lanes {
+            zip(a, b, fpu::fmul)
+        }
+    } else {
+        use std::simd::f32x4;
+
+        #[inline]
+        pub fn add(a: Lanes, b: Lanes) -> Lanes {
+            (f32x4::from_array(a) + f32x4::from_array(b)).to_array()
+        }
+        #[inline]
+        pub fn mul(a: Lanes, b: Lanes) -> Lanes {
+            (f32x4::from_array(a) * f32x4::from_array(b)).to_array()
+        }
+    }
+}
+
+/// `a * b + c`, rounded after the multiplication as `fmul` then `fadd`.
+#[inline]
+pub fn fma(a: Lanes, b: Lanes, c: Lanes) -> Lanes {
+    add(mul(a, b), c)
+}
+
+/// sum of the products by an adder tree: `(p0 + p1) + (p2 + p3)`.
+#[inline]
+pub fn dot(a: Lanes, b: Lanes) -> f32 {
+    let [p0, p1, p2, p3] = mul(a, b);
+    fpu::fadd(fpu::fadd(p0, p1), fpu::fadd(p2, p3))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_lanes() {
+        let a = [1.5, -2.0, 3.25, 0.1];
+        let b = [2.0, 0.5, -1.0, 0.3];
+        let scalar: Lanes = std::array::from_fn(|i| fpu::fadd(fpu::fmul(a[i], b[i]), a[i]));
+        assert_eq!(fma(a, b, a).map(f32::to_bits), scalar.map(f32::to_bits));
+        let expected = fpu::fadd(
+            fpu::fadd(fpu::fmul(a[0], b[0]), fpu::fmul(a[1], b[1])),
+            fpu::fadd(fpu::fmul(a[2], b[2]), fpu::fmul(a[3], b[3])),
+        );
+        assert_eq!(dot(a, b).to_bits(), expected.to_bits());
+    }
+}
@@ -12,6 +12,7 @@ use crate::{
     ty::{Ty::*, Typed, TypedU32},
 };
 
+#[derive(Clone)]
 pub struct SldData {
     seq: Vec<TypedU32>,
     read_index: usize,
@@ -72,6 +73,7 @@ impl SldData {
     }
 }
 
+#[derive(Clone)]
 pub struct SldInfo {
     pub num_objects: usize,
 }
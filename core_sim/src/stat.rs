@@ -15,6 +15,17 @@ pub trait Width {
 
 pub trait Stat {
     fn view(&self, max_width: usize) -> Box<dyn StatView + '_>;
+    /// key and machine-readable form of the stat for stats dump.
+    /// stats returning `None` are omitted from the dump.
+    fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+        None
+    }
+    /// fields of [`Stat::to_json`] which add up over runs, as dotted paths
+    /// below its key where `*` stands for any key. The dump lists them in
+    /// `counters` for merging the dumps of several runs.
+    fn counters(&self) -> &'static [&'static str] {
+        &[]
+    }
 }
 
 pub trait StatView: fmt::Display {
@@ -50,10 +61,28 @@ impl Extend<Box<dyn Stat>> for Stats {
     }
 }
 
+/// version of the stats dump format
+pub const STATS_DUMP_FORMAT: u64 = 1;
+
 impl Stats {
     pub fn push(&mut self, stat: Box<dyn Stat>) {
         self.stats.push(stat)
     }
+    /// machine-readable dump of all stats, keyed by [`Stat::to_json`].
+    pub fn to_json(&self) -> serde_json::Value {
+        let mut map = serde_json::Map::new();
+        map.insert("format".to_string(), STATS_DUMP_FORMAT.into());
+        let mut counters = vec![];
+        for s in &self.stats {
+            let Some((k, v)) = s.to_json() else {
+                continue;
+            };
+            counters.extend(s.counters().iter().map(|c| format!("{k}.{c}")));
+            map.insert(k.to_string(), v);
+        }
+        map.insert("counters".to_string(), counters.into());
+        serde_json::Value::Object(map)
+    }
 }
 
 pub struct StatAllView<'s> {
@@ -16,6 +16,16 @@ pub enum Ty {
 
 use Ty::*;
 
+impl TryFrom<u8> for Ty {
+    type Error = u8;
+    fn try_from(v: u8) -> Result<Self, u8> {
+        [I32, Usize, I32OrUsize, F32, Unknown]
+            .get(v as usize)
+            .copied()
+            .ok_or(v)
+    }
+}
+
 impl fmt::Display for Ty {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
         match self {
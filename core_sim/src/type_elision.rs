@@ -0,0 +1,271 @@
+//! static elision of the type checks of `typed_memory`.
+//!
+//! A load from the stack needs no check when on every path to it the word
+//! was last written with the type it reads: a `lw` reloading what a `sw`
+//! spilled, a `flw` reloading what a `fsw` spilled. The kind of each word
+//! is tracked by its offset from `sp` over the control flow graph of the
+//! predecoded text, and the facts of joining paths are intersected. Loads
+//! proven this way skip the check; all the others keep it. Stores never
+//! check the type, so there is nothing to elide for them.
+//!
+//! Beyond the text itself, the analysis assumes that
+//! - a callee stores to the stack only below the `sp` of its caller and
+//!   returns with `sp` restored, and
+//! - an indirect jump lands on the program entry, a `jal` target, a text
+//!   address in the data section or one built by an immediate from `zero`,
+//!   or on a pc no other instruction falls through or branches to.
+
+use std::collections::{BTreeMap, VecDeque};
+
+use crate::{fuse::Predecoded, instr::*, register::RegId};
+
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+enum Kind {
+    Int,
+    Float,
+}
+
+/// the kinds of the words at offsets from `sp`
+type Facts = BTreeMap<i32, Kind>;
+
+/// the words an instruction accesses
+enum Access {
+    /// `words` from `sp + off`
+    Stack {
+        load: bool,
+        off: i32,
+        words: i32,
+        kind: Kind,
+    },
+    /// a store through another pointer, which may alias any stack word
+    Elsewhere(Kind),
+    None,
+}
+
+fn is_sp(r: &RegId) -> bool {
+    r.inner() == 2
+}
+
+fn access(instr: &DecodedInstr) -> Access {
+    use Instr::*;
+    let at = |rs1: &RegId, imm: u32, load: bool, words: usize, kind: Kind| {
+        if is_sp(rs1) {
+            Access::Stack {
+                load,
+                off: imm as i32,
+                words: words as i32,
+                kind,
+            }
+        } else if load {
+            Access::None
+        } else {
+            Access::Elsewhere(kind)
+        }
+    };
+    match instr {
+        I {
+            instr: IInstr::Lw,
+            rs1,
+            imm,
+            ..
+        } => at(rs1, *imm, true, 1, Kind::Int),
+        S { rs1, imm, .. } => at(rs1, *imm, false, 1, Kind::Int),
+        F(FInstr::Flw { rs1, imm, .. }) => at(rs1, *imm, true, 1, Kind::Float),
+        F(FInstr::Fsw { rs1, imm, .. }) => at(rs1, *imm, false, 1, Kind::Float),
+        // reads as an integer, then stores one
+        A { instr, rs1, .. } if *instr != AInstr::Fence => at(rs1, 0, false, 1, Kind::Int),
+        #[cfg(feature = "simd")]
+        Q(QInstr::Vlw { rs1, imm, .. }) => at(rs1, *imm, true, crate::simd::LANES, Kind::Float),
+        #[cfg(feature = "simd")]
+        Q(QInstr::Vsw { rs1, imm, .. }) => at(rs1, *imm, false, crate::simd::LANES, Kind::Float),
+        _ => Access::None,
+    }
+}
+
+/// the integer register written, if any
+fn int_rd(instr: &DecodedInstr) -> Option<RegId> {
+    use Instr::*;
+    match instr {
+        R { rd, .. }
+        | I { rd, .. }
+        | J { rd, .. }
+        | A { rd, .. }
+        | IO(IOInstr::Inw { rd } | IOInstr::Csrr { rd, .. })
+        | F(FInstr::K { rd, .. } | FInstr::Y { rd, .. }) => Some(*rd),
+        _ => None,
+    }
+}
+
+fn is_load(instr: &DecodedInstr) -> bool {
+    match instr {
+        Instr::I {
+            instr: IInstr::Lw, ..
+        }
+        | Instr::F(FInstr::Flw { .. }) => true,
+        #[cfg(feature = "simd")]
+        Instr::Q(QInstr::Vlw { .. }) => true,
+        _ => false,
+    }
+}
+
+fn is_proven(instr: &DecodedInstr, facts: &Facts) -> bool {
+    match access(instr) {
+        Access::Stack {
+            load: true,
+            off,
+            words,
+            kind,
+        } => (off..off + words).all(|o| facts.get(&o) == Some(&kind)),
+        _ => false,
+    }
+}
+
+/// the facts after `instr` executed without an error
+fn transfer(instr: &DecodedInstr, facts: &mut Facts) {
+    match access(instr) {
+        // a successful load leaves the word with its type too
+        Access::Stack {
+            off, words, kind, ..
+        } => facts.extend((off..off + words).map(|o| (o, kind))),
+        Access::Elsewhere(kind) => facts.retain(|_, k| *k == kind),
+        Access::None => {}
+    }
+    if int_rd(instr).is_some_and(|rd| is_sp(&rd)) {
+        match instr {
+            Instr::I {
+                instr: IInstr::Addi,
+                rs1,
+                imm,
+                ..
+            } if is_sp(rs1) => {
+                *facts = facts
+                    .iter()
+                    .map(|(o, k)| (o.wrapping_sub(*imm as i32), *k))
+                    .collect()
+            }
+            _ => facts.clear(),
+        }
+    }
+}
+
+/// the pcs control goes to from `instr` at `pc`, and whether `next` is the
+/// return of a call
+fn successors(instr: &DecodedInstr, pc: u32, next: u32) -> (Vec<u32>, bool) {
+    use Instr::*;
+    match instr {
+        B { imm, .. } | P { imm, .. } | F(FInstr::W { imm, .. } | FInstr::V { imm, .. }) => {
+            (vec![next, pc.wrapping_add(*imm)], false)
+        }
+        J { rd, imm, .. } if rd.is_zero() => (vec![pc.wrapping_add(*imm)], false),
+        J { .. } => (vec![next], true),
+        I {
+            instr: IInstr::Jalr,
+            rd,
+            ..
+        } => {
+            if rd.is_zero() {
+                (vec![], false)
+            } else {
+                (vec![next], true)
+            }
+        }
+        Misc(MiscInstr::End) => (vec![], false),
+        _ => (vec![next], false),
+    }
+}
+
+/// the pcs reached with nothing known about the stack
+fn entries(predecoded: &Predecoded, data: &[u32], entry: u32) -> Vec<u32> {
+    let mut pcs = vec![entry];
+    pcs.extend(data);
+    for (pc, slot) in predecoded.iter() {
+        match slot.instr {
+            Instr::J { rd, imm, .. } if !rd.is_zero() => pcs.push(pc.wrapping_add(imm)),
+            Instr::I {
+                instr, rs1, imm, ..
+            } if rs1.is_zero() && !matches!(instr, IInstr::Lw | IInstr::Jalr) => pcs.push(imm),
+            _ => {}
+        }
+    }
+    pcs.retain(|&pc| predecoded.slot(pc).is_some());
+    pcs
+}
+
+/// marks the loads of `predecoded` whose type is proven, with `data` the
+/// words of the data section and `entry` the first pc. Returns the number
+/// of proven loads and of all the loads.
+pub fn prove(predecoded: &mut Predecoded, data: &[u32], entry: u32) -> (usize, usize) {
+    // what a callee may store through pointers
+    let mut elsewhere = vec![];
+    for (_, slot) in predecoded.iter() {
+        if let Access::Elsewhere(kind) = access(&slot.instr) {
+            elsewhere.push(kind);
+        }
+    }
+    let mut states: BTreeMap<u32, Facts> = BTreeMap::new();
+    let mut work = VecDeque::new();
+    for pc in entries(predecoded, data, entry) {
+        states.insert(pc, Facts::new());
+        work.push_back(pc);
+    }
+    while let Some(pc) = work.pop_front() {
+        let slot = predecoded.slot(pc).unwrap();
+        let mut facts = states[&pc].clone();
+        transfer(&slot.instr, &mut facts);
+        let (succs, call) = successors(&slot.instr, pc, pc + slot.len);
+        if call {
+            facts.retain(|&o, k| o >= 0 && !elsewhere.contains(k));
+        }
+        for s in succs {
+            if predecoded.slot(s).is_none() {
+                continue;
+            }
+            let changed = match states.get_mut(&s) {
+                None => {
+                    states.insert(s, facts.clone());
+                    true
+                }
+                Some(old) => {
+                    let len = old.len();
+                    old.retain(|o, k| facts.get(o) == Some(k));
+                    old.len() != len
+                }
+            };
+            if changed {
+                work.push_back(s);
+            }
+        }
+    }
+    let mut loads = 0;
+    let mut proven = vec![];
+    for (pc, slot) in predecoded.iter() {
+        loads += is_load(&slot.instr) as usize;
+        if states.get(&pc).is_some_and(|f| is_proven(&slot.instr, f)) {
+            proven.push(pc);
+        }
+    }
+    for &pc in &proven {
+        predecoded.slot_mut(pc).unwrap().ty_proven = true;
+    }
+    (proven.len(), loads)
+}
+
+#[cfg(all(test, not(feature = "isa_2nd")))]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_transfer() {
+        let decode = |bin| DecodedInstr::decode_from(bin).unwrap();
+        // sw x9, 0(sp); addi sp, sp, -1
+        let mut facts = Facts::new();
+        transfer(&decode(0x00912023), &mut facts);
+        transfer(&decode(0xfff10113), &mut facts);
+        // lw x9, 1(sp) reads the spilled word, flw f2, 1(sp) does not
+        assert!(is_proven(&decode(0x00112483), &facts));
+        assert!(!is_proven(&decode(0x00112107), &facts));
+        // fsw f2, 0(x8) may overwrite it
+        transfer(&decode(0x00242027), &mut facts);
+        assert!(!is_proven(&decode(0x00112483), &facts));
+    }
+}
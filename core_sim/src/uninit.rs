@@ -0,0 +1,114 @@
+//! detector of loads from memory never written.
+//!
+//! Memory keeps one definedness bit per word, set by stores and by loading
+//! the program image; a load of a clear bit is reported here once per pc.
+
+use std::{collections::HashMap, fmt};
+
+use serde::Serialize;
+
+use crate::{common::Pc, debug_symbol::DebugSymbol};
+
+#[derive(Clone, Serialize)]
+pub struct UninitRead {
+    pub pc: u32,
+    /// function of `pc`; see [`DebugSymbol::function_of`]
+    pub label: Option<String>,
+    /// word address of the first uninitialized read
+    pub first_addr: u32,
+    pub count: usize,
+}
+
+#[derive(Default)]
+pub struct UninitReads {
+    by_pc: HashMap<u32, UninitRead>,
+}
+
+impl UninitReads {
+    #[cold]
+    pub fn record(&mut self, pc: Pc, addr: usize) {
+        let pc = pc.into_inner();
+        self.by_pc
+            .entry(pc)
+            .or_insert_with(|| {
+                log::warn!("pc {pc:#010x} reads uninitialized memory at {addr:#x}");
+                UninitRead {
+                    pc,
+                    label: None,
+                    first_addr: addr as u32,
+                    count: 0,
+                }
+            })
+            .count += 1;
+    }
+    pub fn is_empty(&self) -> bool {
+        self.by_pc.is_empty()
+    }
+    pub fn report(&self, debug_symbol: &DebugSymbol) -> UninitReport {
+        let mut reads: Vec<_> = self
+            .by_pc
+            .values()
+            .map(|r| UninitRead {
+                label: debug_symbol.function_of(r.pc).map(str::to_string),
+                ..r.clone()
+            })
+            .collect();
+        reads.sort_by_key(|r| r.pc);
+        UninitReport { reads }
+    }
+}
+
+/// sorted by pc
+pub struct UninitReport {
+    reads: Vec<UninitRead>,
+}
+
+impl fmt::Display for UninitReport {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        if self.reads.is_empty() {
+            return writeln!(f, "  (no uninitialized read)");
+        }
+        writeln!(
+            f,
+            "  {:<12}{:<24}{:>12}{:>12}",
+            "pc", "function", "first addr", "count"
+        )?;
+        for r in &self.reads {
+            writeln!(
+                f,
+                "  {:<12}{:<24.24}{:>12}{:>12}",
+                format!("{:#010x}", r.pc),
+                r.label.as_deref().unwrap_or("?"),
+                format!("{:#x}", r.first_addr),
+                r.count
+            )?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(feature = "stat")]
+mod stat {
+    use super::*;
+    use crate::stat::*;
+
+    impl Stat for UninitReport {
+        fn view(&self, _: usize) -> Box<dyn StatView + '_> {
+            Box::new(self)
+        }
+        fn to_json(&self) -> Option<(&'static str, serde_json::Value)> {
+            serde_json::to_value(&self.reads)
+                .ok()
+                .map(|v| ("uninit_reads", v))
+        }
+    }
+
+    impl StatView for &'_ UninitReport {
+        fn header(&self) -> &'static str {
+            "reads of uninitialized memory"
+        }
+        fn width(&self) -> usize {
+            2 + 12 + 24 + 12 + 12
+        }
+    }
+}
@@ -0,0 +1,289 @@
+//! Python bindings of the simulator for experiment scripts.
+//!
+//! ```python
+//! import core_sim_py
+//! sim = core_sim_py.Simulator(open("a.bin", "rb").read(), stdin=b"...")
+//! sim.run()
+//! print(sim.output(), sim.regs()[10], sim.stats()["sim"]["clocks"])
+//! ```
+//!
+//! `regs`, `fregs`, `memory` and `instr_counts` return read-only numpy
+//! views of the simulator, which follow it as it runs; copy them to keep a
+//! state. `step` and `run` release the GIL, so simulators on different
+//! Python threads run in parallel, but views must not be read while their
+//! own simulator runs. `run_batch` runs its jobs in parallel as well.
+
+use std::{
+    fs::File,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Mutex,
+    },
+    thread,
+};
+
+use anyhow::Result;
+use core_sim::{
+    common::{ExecuteMode, RunStep, SimulationOption},
+    debug_symbol::DebugSymbol,
+    instr::InstrId,
+    io::{BinaryInput, BinaryOutput},
+    multicore::MulticoreConfig,
+    sim::{ControlFlow, Simulator},
+};
+use numpy::{ndarray::ArrayView1, npyffi::NPY_ARRAY_WRITEABLE, prelude::*, Element, PyArray1};
+use pyo3::{
+    prelude::*,
+    types::{PyBytes, PyDict},
+};
+
+type Sim = Simulator<BinaryInput, BinaryOutput>;
+
+fn new_sim(
+    program: &[u8],
+    stdin: Vec<u8>,
+    dbg: Option<&str>,
+    cores: usize,
+    quantum: usize,
+) -> Result<Sim> {
+    let mut sim = Sim::new(program, BinaryInput::new(stdin), BinaryOutput::new())?;
+    if let Some(path) = dbg {
+        sim.provide_dbg_symb(DebugSymbol::deser(File::open(path)?)?);
+    }
+    sim.set_multicore(MulticoreConfig {
+        cores,
+        quantum,
+        ..Default::default()
+    });
+    Ok(sim)
+}
+
+fn status(flow: &ControlFlow) -> &'static str {
+    match flow.exit_code() {
+        Some(c) if c.is_success() => "exited",
+        Some(_) => "failed",
+        None => "stopped",
+    }
+}
+
+/// runs `sim` to the end of the program, or for `max_instrs` instructions.
+fn run(sim: &mut Sim, max_instrs: Option<usize>) -> Result<&'static str> {
+    let mode = match max_instrs {
+        Some(n) => ExecuteMode::RunStep(RunStep::new(Some(n))),
+        None => ExecuteMode::Run,
+    };
+    let flow = sim.single_cycle(&SimulationOption {
+        mode,
+        ..Default::default()
+    })?;
+    Ok(status(&flow))
+}
+
+fn stats_to_py(py: Python<'_>, json: &str) -> PyResult<PyObject> {
+    Ok(py
+        .import_bound("json")?
+        .call_method1("loads", (json,))?
+        .unbind())
+}
+
+/// a read-only array over `data`, which lives in the simulator `owner`.
+fn view<'py, T: Element>(owner: &Bound<'py, PySimulator>, data: &[T]) -> Bound<'py, PyArray1<T>> {
+    // SAFETY: `data` is a field of the simulator, or a buffer it never
+    // reallocates, and `owner` is kept alive as the base of the array
+    unsafe {
+        let array =
+            PyArray1::borrow_from_array_bound(&ArrayView1::from(data), owner.clone().into_any());
+        (*array.as_array_ptr()).flags &= !NPY_ARRAY_WRITEABLE;
+        array
+    }
+}
+
+#[pyclass(name = "Simulator")]
+struct PySimulator {
+    sim: Sim,
+    status: &'static str,
+}
+
+impl PySimulator {
+    /// runs without the GIL; the borrow of `self` keeps Python from using
+    /// the simulator meanwhile.
+    fn run_for(&mut self, py: Python<'_>, max_instrs: Option<usize>) -> Result<&'static str> {
+        if matches!(self.status, "exited" | "failed") {
+            return Ok(self.status);
+        }
+        self.status = py.allow_threads(|| run(&mut self.sim, max_instrs))?;
+        Ok(self.status)
+    }
+}
+
+#[pymethods]
+impl PySimulator {
+    #[new]
+    #[pyo3(signature = (program, stdin = None, dbg = None, cores = 1, quantum = 64))]
+    fn new(
+        program: &[u8],
+        stdin: Option<&[u8]>,
+        dbg: Option<&str>,
+        cores: usize,
+        quantum: usize,
+    ) -> Result<Self> {
+        let stdin = stdin.unwrap_or_default().to_vec();
+        Ok(Self {
+            sim: new_sim(program, stdin, dbg, cores, quantum)?,
+            status: "ready",
+        })
+    }
+
+    /// executes `n` instructions (fewer if the program ends) and returns
+    /// the status: "stopped", "exited" or "failed".
+    #[pyo3(signature = (n = 1))]
+    fn step(&mut self, py: Python<'_>, n: usize) -> Result<&'static str> {
+        self.run_for(py, Some(n))
+    }
+
+    /// runs to the end of the program, or for `max_instrs` instructions.
+    #[pyo3(signature = (max_instrs = None))]
+    fn run(&mut self, py: Python<'_>, max_instrs: Option<usize>) -> Result<&'static str> {
+        self.run_for(py, max_instrs)
+    }
+
+    #[getter]
+    fn status(&self) -> &'static str {
+        self.status
+    }
+
+    #[getter]
+    fn cycle(&self) -> usize {
+        self.sim.cycle()
+    }
+
+    #[getter]
+    fn pc(&self) -> u32 {
+        self.sim.get_pc().into_inner()
+    }
+
+    /// the message of the runtime error, if the program failed
+    #[getter]
+    fn error(&self) -> Option<String> {
+        self.sim.get_error_msg()
+    }
+
+    /// bytes written by `outb` so far
+    fn output<'py>(&self, py: Python<'py>) -> Bound<'py, PyBytes> {
+        PyBytes::new_bound(py, self.sim.cpu().output().as_bytes())
+    }
+
+    /// integer registers (uint32), indexed by register number
+    fn regs<'py>(slf: &Bound<'py, Self>) -> Bound<'py, PyArray1<u32>> {
+        view(slf, slf.borrow().sim.cpu().reg_file().as_slices().0)
+    }
+
+    /// float registers (float32), indexed by register number
+    fn fregs<'py>(slf: &Bound<'py, Self>) -> Bound<'py, PyArray1<f32>> {
+        view(slf, slf.borrow().sim.cpu().reg_file().as_slices().1)
+    }
+
+    /// the memory as bytes; `.view("<u4")` gives the words
+    fn memory<'py>(slf: &Bound<'py, Self>) -> Bound<'py, PyArray1<u8>> {
+        view(slf, slf.borrow().sim.cpu().memory_bytes())
+    }
+
+    /// executed instructions indexed as `instr_names()`
+    fn instr_counts<'py>(slf: &Bound<'py, Self>) -> Bound<'py, PyArray1<usize>> {
+        view(slf, slf.borrow().sim.cpu().i_stat.counts())
+    }
+
+    /// the statistics as written by `--stat-json`
+    fn stats(&self, py: Python<'_>) -> PyResult<PyObject> {
+        stats_to_py(py, &self.sim.collect_stat().to_json().to_string())
+    }
+}
+
+/// names of the instructions counted by `Simulator.instr_counts`; `None`
+/// for unused indices.
+#[pyfunction]
+fn instr_names() -> Vec<Option<String>> {
+    (0..InstrId::MAX)
+        .map(|i| InstrId::try_from(i as u8).ok().map(|id| id.to_string()))
+        .collect()
+}
+
+struct Outcome {
+    status: &'static str,
+    output: Vec<u8>,
+    cycle: usize,
+    stats: String,
+    error: Option<String>,
+}
+
+fn run_job(program: &[u8], stdin: Vec<u8>, max_instrs: Option<usize>) -> Result<Outcome> {
+    let mut sim = new_sim(program, stdin, None, 1, 64)?;
+    let status = run(&mut sim, max_instrs)?;
+    Ok(Outcome {
+        status,
+        cycle: sim.cycle(),
+        stats: sim.collect_stat().to_json().to_string(),
+        error: sim.get_error_msg(),
+        output: sim.into_output().cpu_output.into_inner(),
+    })
+}
+
+/// runs `jobs`, pairs of a program and its input, on `threads` threads
+/// (default: number of cpus) and returns a dict per job with its status,
+/// output, cycles, stats and error.
+#[pyfunction]
+#[pyo3(signature = (jobs, threads = None, max_instrs = None))]
+fn run_batch(
+    py: Python<'_>,
+    jobs: Vec<(Vec<u8>, Vec<u8>)>,
+    threads: Option<usize>,
+    max_instrs: Option<usize>,
+) -> PyResult<Vec<PyObject>> {
+    let threads = threads.unwrap_or_else(|| thread::available_parallelism().map_or(1, |n| n.get()));
+    let outcomes = py.allow_threads(|| {
+        let next = AtomicUsize::new(0);
+        let results = Mutex::new((0..jobs.len()).map(|_| None).collect::<Vec<_>>());
+        thread::scope(|s| {
+            for _ in 0..threads.clamp(1, jobs.len().max(1)) {
+                s.spawn(|| loop {
+                    let i = next.fetch_add(1, Ordering::Relaxed);
+                    let Some((program, stdin)) = jobs.get(i) else {
+                        break;
+                    };
+                    let r = run_job(program, stdin.clone(), max_instrs);
+                    results.lock().unwrap()[i] = Some(r);
+                });
+            }
+        });
+        results.into_inner().unwrap()
+    });
+    outcomes
+        .into_iter()
+        .map(|r| {
+            let d = PyDict::new_bound(py);
+            match r.unwrap() {
+                Ok(o) => {
+                    d.set_item("status", o.status)?;
+                    d.set_item("output", PyBytes::new_bound(py, &o.output))?;
+                    d.set_item("cycles", o.cycle)?;
+                    d.set_item("stats", stats_to_py(py, &o.stats)?)?;
+                    d.set_item("error", o.error)?;
+                }
+                Err(e) => {
+                    d.set_item("status", "failed")?;
+                    d.set_item("error", format!("{e:#}"))?;
+                }
+            }
+            Ok(d.into_any().unbind())
+        })
+        .collect()
+}
+
+#[pymodule]
+fn core_sim_py(m: &Bound<'_, PyModule>) -> PyResult<()> {
+    m.add_class::<PySimulator>()?;
+    m.add_function(wrap_pyfunction!(instr_names, m)?)?;
+    m.add_function(wrap_pyfunction!(run_batch, m)?)?;
+    m.add("FEATURES", core_sim::FEATURES.to_vec())?;
+    Ok(())
+}
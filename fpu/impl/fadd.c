@@ -0,0 +1,125 @@
+#include "fpulib.h"
+#include "fadd.h"
+
+// fadd (ビット単位のモデル)
+// 非正規化数は入力・出力ともに 0 として扱い、丸めは最近接偶数丸め
+float fadd_model(float x1, float x2) {
+  union Num x1_num, x2_num, y_num;
+  x1_num.real = x1;
+  x2_num.real = x2;
+
+  // 絶対値の大きい方を x1 にする
+  if ((x1_num.nat & 0x7fffffff) < (x2_num.nat & 0x7fffffff)) {
+    uint32_t t = x1_num.nat;
+    x1_num.nat = x2_num.nat;
+    x2_num.nat = t;
+  }
+
+  // 符号部、指数部
+  uint32_t s1, s2, e1, e2;
+  s1 = x1_num.nat >> 31;
+  s2 = x2_num.nat >> 31;
+  e1 = slice(x1_num.nat, 31, 24);
+  e2 = slice(x2_num.nat, 31, 24);
+
+  // inf, nan
+  if (e1 == 255) {
+    if (slice(x1_num.nat, 23, 1) != 0 || (e2 == 255 && slice(x2_num.nat, 23, 1) != 0)) {
+      y_num.nat = 0x7fc00000;
+    } else if (e2 == 255 && s1 != s2) {
+      y_num.nat = 0x7fc00000;
+    } else {
+      y_num.nat = mkfloat(s1, 255, 0);
+    }
+    return y_num.real;
+  }
+
+  // 0 (非正規化数を含む)
+  if (e1 == 0) {
+    y_num.nat = mkfloat(s1 & s2, 0, 0);
+    return y_num.real;
+  }
+  if (e2 == 0) {
+    y_num.nat = mkfloat(s1, e1, slice(x1_num.nat, 23, 1));
+    return y_num.real;
+  }
+
+  // 仮数部 (guard, round, sticky の 3 ビットを下に付ける)
+  uint32_t m1, m2, d, sticky;
+  m1 = (slice(x1_num.nat, 23, 1) | 0x800000) << 3;
+  m2 = (slice(x2_num.nat, 23, 1) | 0x800000) << 3;
+  d = e1 - e2;
+  if (d > 26) {
+    m2 = 1;
+  } else {
+    sticky = (m2 & ((1u << d) - 1)) != 0;
+    m2 = (m2 >> d) | sticky;
+  }
+
+  uint32_t m;
+  int32_t e = e1;
+  if (s1 == s2) {
+    m = m1 + m2;
+  } else {
+    m = m1 - m2;
+  }
+  if (m == 0) {
+    return 0.0f;
+  }
+
+  // 正規化 (先頭の 1 を 26 ビット目に)
+  if (m >> 27) {
+    m = (m >> 1) | (m & 1);
+    e++;
+  } else {
+    while (!(m >> 26)) {
+      m <<= 1;
+      e--;
+    }
+  }
+
+  // 最近接偶数丸め
+  uint32_t grs = m & 7;
+  m >>= 3;
+  if (grs > 4 || (grs == 4 && (m & 1))) {
+    m++;
+    if (m >> 24) {
+      m >>= 1;
+      e++;
+    }
+  }
+
+  if (e >= 255) {
+    y_num.nat = mkfloat(s1, 255, 0);
+  } else if (e <= 0) {
+    y_num.nat = mkfloat(s1, 0, 0);
+  } else {
+    y_num.nat = mkfloat(s1, e, m & 0x7fffff);
+  }
+  return y_num.real;
+}
+
+// fadd
+// 入力と結果がともに正規化数の範囲にあるとき、モデルはホストの加算と一致する
+float fadd(float x1, float x2) {
+  union Num x1_num, x2_num, y_num;
+  x1_num.real = x1;
+  x2_num.real = x2;
+  y_num.real = x1 + x2;
+  uint32_t e1, e2, ey;
+  e1 = slice(x1_num.nat, 31, 24);
+  e2 = slice(x2_num.nat, 31, 24);
+  ey = slice(y_num.nat, 31, 24);
+  if (e1 - 1 < 254 && e2 - 1 < 254 && ey - 2 < 253) {
+    return y_num.real;
+  }
+  return fadd_model(x1, x2);
+}
+
+// fsub
+float fsub(float x1, float x2) {
+  union Num x2_num;
+  x2_num.real = x2;
+  x2_num.nat ^= 0x80000000;
+  return fadd(x1, x2_num.real);
+}
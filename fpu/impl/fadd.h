@@ -0,0 +1,8 @@
+#ifndef _FADD_H_
+#define _FADD_H_
+
+float fadd(float, float);
+float fsub(float, float);
+float fadd_model(float, float);
+
+#endif // _FADD_H_
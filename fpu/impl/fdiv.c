@@ -3,6 +3,27 @@
 #include "fmul.h"
 #include "fdiv.h"
 
+// 近似のパラメータ
+// スレッドごとに持つので、設定の異なるシミュレーションを並列に走らせられる
+static _Thread_local int32_t key_bits = 10;   // テーブルを引くキーのビット数
+static _Thread_local int32_t order = 1;       // 近似の次数 (0, 1, 2)
+static _Thread_local int32_t coef_bits = 23;  // 係数の仮数部のビット数
+
+// 近似のパラメータを設定する (範囲外なら -1 を返して何もしない)
+int32_t fdiv_set_approx(int32_t k, int32_t o, int32_t c) {
+  if (k < 1 || k > 20 || o < 0 || o > 2 || c < 1 || c > 23) {
+    return -1;
+  }
+  key_bits = k;
+  order = o;
+  coef_bits = c;
+  return 0;
+}
+
+static double recip(double x) {
+  return 1.0 / x;
+}
+
 // fdiv
 float fdiv(float x1, float x2) {
   union Num x1_num, x2_num;
@@ -24,23 +45,29 @@ float fdiv(float x1, float x2) {
   union Num m1n, m2n;
   m1 = slice(x1_num.nat, 23, 1);
   m2 = slice(x2_num.nat, 23, 1);
-  h = slice(m2, 23, 14);
+  h = slice(m2, 23, 24-key_bits);
   m1n.nat = mkfloat(0, 127, m1);
   m2n.nat = mkfloat(0, 127, m2);
 
-  // 線形近似の傾きと切片
-  // 数値誤差を抑えるために面倒な計算をしている
-  double d_grad, d_intercept;
-  d_grad = 1024.0 * (1024.0/(1024.0+(double)h) - 1024.0/(1025.0+(double)h));
-  d_intercept = 1024.0*(1.0 - (1024.0+(double)h)/(1025.0+(double)h)) + (768.0/(1024.0+(double)h) - 256/(1025.0+(double)h) + 1024/(2049+(double)(2*h)));
-  float grad, intercept;
-  grad = (float) d_grad;
-  intercept = (float) d_intercept;
-
   // 逆数計算
-  float ax, m2inv;
-  ax = fmul(grad, m2n.real);
-  m2inv = intercept - ax;
+  float m2inv;
+  double n = (double)(1 << key_bits);
+  if (order == 1) {
+    // 線形近似の傾きと切片
+    // 数値誤差を抑えるために面倒な計算をしている
+    double d_grad, d_intercept;
+    d_grad = n * (n/(n+(double)h) - n/(n+1.0+(double)h));
+    d_intercept = n*(1.0 - (n+(double)h)/(n+1.0+(double)h)) + (0.75*n/(n+(double)h) - 0.25*n/(n+1.0+(double)h) + n/(2.0*n+1.0+2.0*(double)h));
+    float grad, intercept;
+    grad = round_mantissa((float) d_grad, coef_bits);
+    intercept = round_mantissa((float) d_intercept, coef_bits);
+
+    float ax;
+    ax = fmul(grad, m2n.real);
+    m2inv = intercept - ax;
+  } else {
+    m2inv = approx_poly(recip, (n+(double)h)/n, (n+1.0+(double)h)/n, m2n.real, order, coef_bits);
+  }
 
   union Num mdiv;
   mdiv.real = fmul(m1n.real, m2inv);
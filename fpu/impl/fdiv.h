@@ -1,6 +1,9 @@
 #ifndef _FDIV_H_
 #define _FDIV_H_
 
+#include <stdint.h>
+
 float fdiv(float, float);
+int32_t fdiv_set_approx(int32_t, int32_t, int32_t);
 
 #endif // _FDIV_H_
@@ -1,4 +1,6 @@
+#include <math.h>
 #include "fpulib.h"
+#include "fmul.h"
 
 // left~rightまでの範囲を切り出して返す関数
 uint32_t slice(uint32_t x, int32_t left, int32_t right) {
@@ -9,3 +11,39 @@ uint32_t slice(uint32_t x, int32_t left, int32_t right) {
 uint32_t mkfloat(uint32_t s, uint32_t e, uint32_t m) {
   return (s<<31) + (e<<23) + m;
 }
+
+// 仮数部を上位 bits ビットに丸める (テーブルに格納する係数の幅)
+// 最近接丸め (同点は絶対値の大きい方)、bits >= 23 ならそのまま
+float round_mantissa(float x, int32_t bits) {
+  if (bits >= 23) {
+    return x;
+  }
+  union Num x_num;
+  x_num.real = x;
+  uint32_t drop = 23 - bits;
+  x_num.nat = (x_num.nat + (1u << (drop-1))) & ~((1u << drop) - 1);
+  return x_num.real;
+}
+
+// 区間 [a, b] 上で関数 f を近似した値を返す
+// order 0 は中点の値のみ、order 2 は Chebyshev 点 (中点と中点 ± 半幅*cos(pi/6)) での二次補間
+// 二次式は中点からの差 t について c0 + t*(c1 + t*c2) として評価する
+float approx_poly(double (*f)(double), double a, double b, float x, int32_t order, int32_t coef_bits) {
+  double d_mid, d_r, y0, y1, y2;
+  d_mid = (a + b) / 2.0;
+  y1 = f(d_mid);
+  if (order == 0) {
+    return round_mantissa((float) y1, coef_bits);
+  }
+  d_r = (b - a) / 2.0 * sqrt(3.0) / 2.0;
+  y0 = f(d_mid - d_r);
+  y2 = f(d_mid + d_r);
+
+  float c0, c1, c2, t;
+  c0 = round_mantissa((float) y1, coef_bits);
+  c1 = round_mantissa((float) ((y2 - y0) / (2.0*d_r)), coef_bits);
+  c2 = round_mantissa((float) ((y2 - 2.0*y1 + y0) / (2.0*d_r*d_r)), coef_bits);
+  // x と中点は同じ区間にあるので差は正確に求まる
+  t = x - (float) d_mid;
+  return c0 + fmul(t, c1 + fmul(t, c2));
+}
@@ -19,4 +19,11 @@ uint32_t slice(uint32_t, int32_t, int32_t);
 // 符号部、指数部、仮数部を受け取り、浮動小数点数を作る
 uint32_t mkfloat(uint32_t, uint32_t, uint32_t);
 
+// 仮数部を上位 bits ビットに丸める (テーブルに格納する係数の幅)
+float round_mantissa(float, int32_t);
+
+// 区間 [a, b] 上で関数を近似した値を返す
+// order 0 は中点の値のみ、order 2 は Chebyshev 点での二次補間
+float approx_poly(double (*)(double), double, double, float, int32_t, int32_t);
+
 #endif
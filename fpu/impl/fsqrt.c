@@ -4,6 +4,23 @@
 #include "fmul.h"
 #include "fsqrt.h"
 
+// 近似のパラメータ
+// スレッドごとに持つので、設定の異なるシミュレーションを並列に走らせられる
+static _Thread_local int32_t key_bits = 10;   // テーブルを引くキーのビット数 (指数部の最下位ビットを含む)
+static _Thread_local int32_t order = 1;       // 近似の次数 (0, 1, 2)
+static _Thread_local int32_t coef_bits = 23;  // 係数の仮数部のビット数
+
+// 近似のパラメータを設定する (範囲外なら -1 を返して何もしない)
+int32_t fsqrt_set_approx(int32_t k, int32_t o, int32_t c) {
+  if (k < 2 || k > 20 || o < 0 || o > 2 || c < 1 || c > 23) {
+    return -1;
+  }
+  key_bits = k;
+  order = o;
+  coef_bits = c;
+  return 0;
+}
+
 // fsqrt
 float fsqrt(float x) {
   union Num x_num;
@@ -21,32 +38,43 @@ float fsqrt(float x) {
   uint32_t m, h;
   union Num mn;
   m = slice(x_num.nat, 23, 1);
-  h = slice(x_num.nat, 24, 15) ^ 0x00000200;
+  h = slice(x_num.nat, 24, 25-key_bits) ^ (1u << (key_bits-1));
   if (e & 1) {
     mn.nat = mkfloat(0, 127, m);
   } else {
     mn.nat = mkfloat(0, 128, m);
   }
 
-  // 線形近似の傾きと切片
-  // 数値誤差を抑えるために面倒な計算をしている
-  double d_grad, d_intercept;
-  if (h < 512) {
-    d_grad = 512.0 * (sqrt((double)(513+h)/512.0) - sqrt((double)(512+h)/512.0));
-    d_intercept = (2.0*sqrt((double)(1025+2*h)/1024.0) + sqrt((double)(513+h)/512.0) + sqrt((double)(512+h)/512.0)) / 4.0 - ((double)(1025+2*h)/2.0) * (sqrt((double)(513+h)/512.0) - sqrt((double)(512+h)/512.0));
-  } else {
-    d_grad = 256.0 * (sqrt((double)(1+h)/256.0) - sqrt((double)h/256.0));
-    d_intercept = (2.0*sqrt((double)(1+2*h)/512.0) + sqrt((double)(1+h)/256.0) + sqrt((double)h/256.0)) / 4.0 - ((double)(1+2*h)/2.0) * (sqrt((double)(1+h)/256.0) - sqrt((double)h/256.0));
-  }
-  float grad, intercept;
-  grad = (float) d_grad;
-  intercept = (float) d_intercept;
-
   // 平方根計算
-  float ax;
+  // キーの最上位ビットは指数部の偶奇で、仮数部は [1, 2) か [2, 4) にある
   union Num msqrt;
-  ax = fmul(grad, mn.real);
-  msqrt.real = intercept + ax;
+  double fn, hn, qn;
+  fn = ldexp(1.0, key_bits);
+  hn = ldexp(1.0, key_bits-1);
+  qn = ldexp(1.0, key_bits-2);
+  if (order == 1) {
+    // 線形近似の傾きと切片
+    // 数値誤差を抑えるために面倒な計算をしている
+    double d_grad, d_intercept;
+    if (h < hn) {
+      d_grad = hn * (sqrt((hn+1.0+(double)h)/hn) - sqrt((hn+(double)h)/hn));
+      d_intercept = (2.0*sqrt((fn+1.0+2.0*(double)h)/fn) + sqrt((hn+1.0+(double)h)/hn) + sqrt((hn+(double)h)/hn)) / 4.0 - ((fn+1.0+2.0*(double)h)/2.0) * (sqrt((hn+1.0+(double)h)/hn) - sqrt((hn+(double)h)/hn));
+    } else {
+      d_grad = qn * (sqrt((1.0+(double)h)/qn) - sqrt((double)h/qn));
+      d_intercept = (2.0*sqrt((1.0+2.0*(double)h)/hn) + sqrt((1.0+(double)h)/qn) + sqrt((double)h/qn)) / 4.0 - ((1.0+2.0*(double)h)/2.0) * (sqrt((1.0+(double)h)/qn) - sqrt((double)h/qn));
+    }
+    float grad, intercept;
+    grad = round_mantissa((float) d_grad, coef_bits);
+    intercept = round_mantissa((float) d_intercept, coef_bits);
+
+    float ax;
+    ax = fmul(grad, mn.real);
+    msqrt.real = intercept + ax;
+  } else if (h < hn) {
+    msqrt.real = approx_poly(sqrt, (hn+(double)h)/hn, (hn+1.0+(double)h)/hn, mn.real, order, coef_bits);
+  } else {
+    msqrt.real = approx_poly(sqrt, (double)h/qn, (1.0+(double)h)/qn, mn.real, order, coef_bits);
+  }
 
   // 出力の符号部、指数部、仮数部
   uint32_t ey, my;
@@ -1,6 +1,9 @@
 #ifndef _FSQRT_H_
 #define _FSQRT_H_
 
+#include <stdint.h>
+
 float fsqrt(float);
+int32_t fsqrt_set_approx(int32_t, int32_t, int32_t);
 
 #endif  // _FSQRT_H_
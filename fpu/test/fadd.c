@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include "../impl/fpulib.h"
+#include "../impl/fadd.h"
+
+// 仮数部のテストパターン
+static uint32_t mantissa(int32_t k) {
+  switch (k) {
+    case 0 : return 0;
+    case 1 : return 1;
+    case 2 : return 2;
+    case 3 : return 0x380000;
+    case 4 : return 0x400000;
+    case 5 : return 0x5fffff;
+    case 6 : return 0x7fffff;
+    default : return slice(rand(), 23, 1);
+  }
+}
+
+// 実装基準を満たすかのテスト用
+// 結果が正規化数ならホストの加算とビット単位で一致し、高速経路はモデルと一致する
+void test_fadd(void) {
+  union Num x1_num, x2_num, y_true, y_model, y_num;
+  for (int32_t i = 0; i < 256; ++i) {
+    for (int32_t j = 0; j < 256; ++j) {
+      for (int32_t s1 = 0; s1 < 2; ++s1) {
+        for (int32_t s2 = 0; s2 < 2; ++s2) {
+          for (int32_t it = 0; it < 10; ++it) {
+            for (int32_t jt = 0; jt < 10; ++jt) {
+              x1_num.nat = mkfloat(s1, i, mantissa(it));
+              x2_num.nat = mkfloat(s2, j, mantissa(jt));
+              y_true.real = x1_num.real + x2_num.real;
+              y_model.real = fadd_model(x1_num.real, x2_num.real);
+              y_num.real = fadd(x1_num.real, x2_num.real);
+              uint32_t ey = slice(y_true.nat, 31, 24);
+              int32_t normal_in = i != 0 && j != 0;
+              if ((normal_in && ey != 0 && y_model.nat != y_true.nat && !isnan(y_true.real))
+                  || (normal_in && ey == 0 && slice(y_model.nat, 31, 1) != 0)
+                  || (y_num.nat != y_model.nat && !isnan(y_model.real))) {
+                printf("%e %e %e %e %e\n", x1_num.real, x2_num.real, y_true.real, y_model.real, y_num.real);
+                printf("%u %u\n", x1_num.nat, x2_num.nat);
+                printf("%u %u\n", y_model.nat, y_num.nat);
+                puts("here");
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Verilogの方と出力が一致するかのテスト用
+void test_fadd_emu(void) {
+  FILE *fp;
+  fp = fopen("fadd_emu.txt", "w");
+  union Num x1_num, x2_num, y_num;
+  for (int32_t i = 1; i < 254; i += 7) {
+    for (int32_t j = 1; j < 254; j += 7) {
+      for (int32_t s1 = 0; s1 < 2; ++s1) {
+        for (int32_t s2 = 0; s2 < 2; ++s2) {
+          x1_num.nat = mkfloat(s1, i, slice(rand(), 23, 1));
+          x2_num.nat = mkfloat(s2, j, slice(rand(), 23, 1));
+          y_num.real = fadd_model(x1_num.real, x2_num.real);
+          for (int32_t k = 0; k < 32; k++) {
+            int32_t bin = 1 & ((x1_num.nat)>>(31-k));
+            fprintf(fp, "%d", bin);
+          }
+          fprintf(fp, "\n");
+          for (int32_t k = 0; k < 32; k++) {
+            int32_t bin = 1 & ((x2_num.nat)>>(31-k));
+            fprintf(fp, "%d", bin);
+          }
+          fprintf(fp, "\n");
+          for (int32_t k = 0; k < 32; k++) {
+            int32_t bin = 1 & ((y_num.nat)>>(31-k));
+            fprintf(fp, "%d", bin);
+          }
+          fprintf(fp, "\n");
+        }
+      }
+    }
+  }
+  fclose(fp);
+}
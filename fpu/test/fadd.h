@@ -0,0 +1,7 @@
+#ifndef _FADD_H_
+#define _FADD_H_
+
+void test_fadd(void);
+void test_fadd_emu(void);
+
+#endif // _FADD_H_
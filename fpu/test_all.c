@@ -1,3 +1,4 @@
+#include "./test/fadd.h"
 #include "./test/fmul.h"
 #include "./test/fdiv.h"
 #include "./test/fsqrt.h"
@@ -6,6 +7,9 @@
 #include "./test/ffloor.h"
 
 int main(void) {
+  test_fadd();
+  // test_fadd_emu();
+
   // test_fmul();
   // test_fmul_emu();
 
@@ -1,3 +1,4 @@
+#include "./impl/fadd.h"
 #include "./impl/fmul.h"
 #include "./impl/fdiv.h"
 #include "./impl/fsqrt.h"